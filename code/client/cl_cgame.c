@@ -763,6 +763,9 @@ void CL_InitCGame( void ) {
 	// on the card even if the driver does deferred loading
 	re.EndRegistration();
 
+	// anything prefetched for the load that wasn't used isn't going to be
+	FS_ClearPrefetch();
+
 	// make sure everything is paged in
 	if (!Sys_LowPhysicalMemory()) {
 		Com_TouchMemory();
@@ -2449,6 +2449,10 @@ void CL_InitRef( void ) {
 	ri.Milliseconds = CL_ScaledMilliseconds;
 	ri.Malloc = CL_RefMalloc;
 	ri.Free = Z_Free;
+	ri.WorkerThreads = Com_WorkerThreads;
+	ri.ParallelFor = Com_ParallelFor;
+	ri.Microseconds = Sys_Microseconds;
+	ri.GetProcessorFeatures = Sys_GetProcessorFeatures;
 #ifdef HUNK_DEBUG
 	ri.Hunk_AllocDebug = Hunk_AllocDebug;
 #else
@@ -2463,6 +2467,7 @@ void CL_InitRef( void ) {
 	ri.FS_FreeFileList = FS_FreeFileList;
 	ri.FS_ListFiles = FS_ListFiles;
 	ri.FS_FileIsInPAK = FS_FileIsInPAK;
+	ri.FS_FileOrigin = FS_FileOrigin;
 	ri.FS_FileExists = FS_FileExists;
 	ri.Cvar_Get = Cvar_Get;
 	ri.Cvar_Set = Cvar_Set;
@@ -433,6 +433,92 @@ static void CL_ParseServerInfo(void)
 		sizeof(clc.sv_dlURL));
 }
 
+/*
+==================
+CL_PrefetchMapImages
+
+Queues the images named by the shaders of the bsp.  Shader scripts
+can use other images, but most surfaces use the one with the shader's
+name.  Only the start of the bsp up to the shader lump is read here.
+==================
+*/
+static void CL_PrefetchMapImages( const char *bspName ) {
+	fileHandle_t	f;
+	dheader_t		header;
+	dshader_t		*shaders;
+	char			name[MAX_QPATH + 4];
+	int				i, ofs, count;
+
+	FS_FOpenFileRead( bspName, &f, qfalse );
+	if ( !f ) {
+		return;
+	}
+
+	if ( FS_Read( &header, sizeof( header ), f ) != sizeof( header )
+		|| LittleLong( header.ident ) != BSP_IDENT || LittleLong( header.version ) != BSP_VERSION ) {
+		FS_FCloseFile( f );
+		return;
+	}
+
+	ofs = LittleLong( header.lumps[LUMP_SHADERS].fileofs );
+	count = LittleLong( header.lumps[LUMP_SHADERS].filelen ) / sizeof( dshader_t );
+	if ( ofs < sizeof( header ) || count <= 0 || count > MAX_MAP_SHADERS ) {
+		FS_FCloseFile( f );
+		return;
+	}
+
+	shaders = Z_Malloc( count * sizeof( *shaders ) );
+	FS_Seek( f, ofs, FS_SEEK_SET );
+	if ( FS_Read( shaders, count * sizeof( *shaders ), f ) == count * sizeof( *shaders ) ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			shaders[i].shader[MAX_QPATH - 1] = 0;
+			Com_sprintf( name, sizeof( name ), "%s.tga", shaders[i].shader );
+			FS_PrefetchFile( name );
+			Com_sprintf( name, sizeof( name ), "%s.jpg", shaders[i].shader );
+			FS_PrefetchFile( name );
+		}
+	}
+	Z_Free( shaders );
+
+	FS_FCloseFile( f );
+}
+
+/*
+==================
+CL_PrefetchGamestate
+
+Starts reading the files the cgame is going to load for this gamestate
+in the background, so reading and inflating them overlaps the loading
+that comes before them
+==================
+*/
+static void CL_PrefetchGamestate( void ) {
+	char		bspName[MAX_QPATH];
+	const char	*info, *name;
+	int			i;
+
+	info = cl.gameState.stringData + cl.gameState.stringOffsets[ CS_SERVERINFO ];
+	Com_sprintf( bspName, sizeof( bspName ), "maps/%s.bsp", Info_ValueForKey( info, "mapname" ) );
+
+	// the world and its images are loaded first
+	FS_PrefetchFile( bspName );
+	CL_PrefetchMapImages( bspName );
+
+	for ( i = 1 ; i < MAX_MODELS ; i++ ) {
+		name = cl.gameState.stringData + cl.gameState.stringOffsets[ CS_MODELS + i ];
+		if ( !name[0] ) {
+			break;
+		}
+		if ( name[0] != '*' ) {
+			// not an inline model
+			FS_PrefetchFile( name );
+		}
+	}
+
+	// sounds aren't prefetched, the codecs read them through a file
+	// handle and FS_ReadFile would only be probing for them
+}
+
 /*
 ==================
 CL_ParseGamestate
@@ -513,6 +599,9 @@ void CL_ParseGamestate( msg_t *msg ) {
 	// reinitialize the filesystem if the game directory has changed
 	FS_ConditionalRestart( clc.checksumFeed );
 
+	// start reading what the cgame will load
+	CL_PrefetchGamestate();
+
 	// This used to call CL_StartHunkUsers, but now we enter the download state before loading the
 	// cgame
 	CL_InitDownloads();
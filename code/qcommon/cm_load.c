@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // cmodel.c -- model loading
 
 #include "cm_local.h"
+#include "cm_patch.h"
 
 #ifdef BSPC
 
@@ -57,11 +58,13 @@ int			c_traces, c_brush_traces, c_patch_traces;
 
 
 byte		*cmod_base;
+unsigned	cmod_checksum;
 
 #ifndef BSPC
 cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
+cvar_t		*cm_patchCache;
 #endif
 
 cmodel_t	box_model;
@@ -261,6 +264,52 @@ void CMod_LoadBrushes( lump_t *l ) {
 
 }
 
+#ifdef CM_SIMD_SSE
+/*
+=================
+CMod_BuildBrushSides4
+
+Copies the brush planes into blocks of four sides for the SIMD trace
+kernels.  The box brush is left without blocks, its planes are rewritten
+by every CM_TempBoxModel.
+=================
+*/
+void CMod_BuildBrushSides4( void ) {
+	cbrush_t		*brush;
+	cbrushSides4_t	*out;
+	cplane_t		*plane;
+	int				i, j, k, side, count;
+
+	count = 0;
+	for ( i = 0 ; i < cm.numBrushes ; i++ ) {
+		count += ( cm.brushes[i].numsides + 3 ) >> 2;
+	}
+
+	out = Hunk_Alloc( count * sizeof( *out ), h_high );
+
+	for ( i = 0, brush = cm.brushes ; i < cm.numBrushes ; i++, brush++ ) {
+		if ( !brush->numsides ) {
+			continue;
+		}
+		brush->sides4 = out;
+		for ( j = 0 ; j < brush->numsides ; j += 4, out++ ) {
+			for ( k = 0 ; k < 4 ; k++ ) {
+				side = j + k;
+				if ( side >= brush->numsides ) {
+					side = brush->numsides - 1;
+				}
+				plane = brush->sides[side].plane;
+				out->normal[0][k] = plane->normal[0];
+				out->normal[1][k] = plane->normal[1];
+				out->normal[2][k] = plane->normal[2];
+				out->dist[k] = plane->dist;
+				out->signbits[k] = plane->signbits;
+			}
+		}
+	}
+}
+#endif
+
 /*
 =================
 CMod_LoadLeafs
@@ -475,13 +524,261 @@ void CMod_LoadVisibility( lump_t *l ) {
 //==================================================================
 
 
+/*
+===============================================================================
+
+PATCH COLLISION CACHE
+
+Generating the patch collision facets is by far the slowest part of
+loading a map with many curves, so the results are saved under the home
+path and reused as long as the bsp checksum matches.  The file is only
+ever read by the machine that wrote it, a cache from another version or
+byte order is simply rebuilt.
+
+===============================================================================
+*/
+
+#define	PATCH_CACHE_IDENT	(('C'<<24)+('P'<<16)+('M'<<8)+'C')
+#define	PATCH_CACHE_VERSION	1
+
+typedef struct {
+	int			ident;
+	int			version;
+	unsigned	bspChecksum;
+	int			numSurfaces;
+	int			dataLength;			// everything after the header
+	unsigned	dataChecksum;
+} patchCacheHeader_t;
+
+// followed by numFacets facet_t and numPlanes patchPlane_t
+typedef struct {
+	int			surfaceNum;
+	int			width, height;
+	vec3_t		bounds[2];
+	int			numPlanes;
+	int			numFacets;
+} patchCacheEntry_t;
+
+typedef struct {
+	byte		*data;
+	byte		*cursor;
+	byte		*end;
+} patchCache_t;
+
+#ifndef BSPC
+/*
+=================
+CMod_PatchCachePath
+=================
+*/
+static const char *CMod_PatchCachePath( const char *name ) {
+	char	base[MAX_QPATH];
+
+	COM_StripExtension( COM_SkipPath( (char *)name ), base, sizeof( base ) );
+	return va( "cmcache/%s.cpc", base );
+}
+
+/*
+=================
+CMod_OpenPatchCache
+
+Returns qfalse if there is no usable cache for this map
+=================
+*/
+static qboolean CMod_OpenPatchCache( const char *name, patchCache_t *cache ) {
+	patchCacheHeader_t	*header;
+	fileHandle_t		f;
+	int					len;
+
+	Com_Memset( cache, 0, sizeof( *cache ) );
+
+	if ( !cm_patchCache->integer ) {
+		return qfalse;
+	}
+
+	len = FS_SV_FOpenFileRead( CMod_PatchCachePath( name ), &f );
+	if ( !f ) {
+		return qfalse;
+	}
+	if ( len < sizeof( *header ) ) {
+		FS_FCloseFile( f );
+		return qfalse;
+	}
+
+	cache->data = Hunk_AllocateTempMemory( len );
+	if ( FS_Read( cache->data, len, f ) != len ) {
+		FS_FCloseFile( f );
+		Hunk_FreeTempMemory( cache->data );
+		cache->data = NULL;
+		return qfalse;
+	}
+	FS_FCloseFile( f );
+
+	header = (patchCacheHeader_t *)cache->data;
+	if ( header->ident != PATCH_CACHE_IDENT
+		|| header->version != PATCH_CACHE_VERSION
+		|| header->bspChecksum != cmod_checksum
+		|| header->numSurfaces != cm.numSurfaces
+		|| header->dataLength != len - sizeof( *header )
+		|| header->dataChecksum != Com_BlockChecksum( header + 1, header->dataLength ) ) {
+		Com_DPrintf( "%s is out of date\n", CMod_PatchCachePath( name ) );
+		Hunk_FreeTempMemory( cache->data );
+		cache->data = NULL;
+		return qfalse;
+	}
+
+	cache->cursor = (byte *)( header + 1 );
+	cache->end = cache->data + len;
+	return qtrue;
+}
+
+/*
+=================
+CMod_CachedPatchCollide
+
+Returns the next cached patch if it belongs to this surface, or NULL
+if the rest of the cache can't be used and the patches must be generated
+=================
+*/
+static patchCollide_t *CMod_CachedPatchCollide( patchCache_t *cache, int surfaceNum, int width, int height ) {
+	patchCacheEntry_t	entry;
+	patchCollide_t		*pf;
+	facet_t				*facet;
+	int					i, j, size;
+
+	if ( !cache->cursor ) {
+		return NULL;
+	}
+
+	if ( cache->end - cache->cursor < sizeof( entry ) ) {
+		cache->cursor = NULL;
+		return NULL;
+	}
+	Com_Memcpy( &entry, cache->cursor, sizeof( entry ) );
+
+	size = sizeof( entry ) + entry.numFacets * sizeof( facet_t ) + entry.numPlanes * sizeof( patchPlane_t );
+	if ( entry.surfaceNum != surfaceNum || entry.width != width || entry.height != height
+		|| entry.numPlanes < 0 || entry.numPlanes > MAX_PATCH_PLANES
+		|| entry.numFacets < 0 || entry.numFacets > MAX_FACETS
+		|| cache->end - cache->cursor < size ) {
+		cache->cursor = NULL;
+		return NULL;
+	}
+
+	pf = Hunk_Alloc( sizeof( *pf ), h_high );
+	VectorCopy( entry.bounds[0], pf->bounds[0] );
+	VectorCopy( entry.bounds[1], pf->bounds[1] );
+	pf->numPlanes = entry.numPlanes;
+	pf->numFacets = entry.numFacets;
+	cache->cursor += sizeof( entry );
+
+	pf->facets = Hunk_Alloc( pf->numFacets * sizeof( *pf->facets ), h_high );
+	Com_Memcpy( pf->facets, cache->cursor, pf->numFacets * sizeof( *pf->facets ) );
+	cache->cursor += pf->numFacets * sizeof( *pf->facets );
+
+	pf->planes = Hunk_Alloc( pf->numPlanes * sizeof( *pf->planes ), h_high );
+	Com_Memcpy( pf->planes, cache->cursor, pf->numPlanes * sizeof( *pf->planes ) );
+	cache->cursor += pf->numPlanes * sizeof( *pf->planes );
+
+	// never trust plane numbers from disk
+	for ( i = 0, facet = pf->facets ; i < pf->numFacets ; i++, facet++ ) {
+		if ( facet->surfacePlane < 0 || facet->surfacePlane >= pf->numPlanes
+			|| facet->numBorders < 0 || facet->numBorders > 4+6+16 ) {
+			break;
+		}
+		for ( j = 0 ; j < facet->numBorders ; j++ ) {
+			if ( facet->borderPlanes[j] < 0 || facet->borderPlanes[j] >= pf->numPlanes ) {
+				break;
+			}
+		}
+		if ( j < facet->numBorders ) {
+			break;
+		}
+	}
+	if ( i < pf->numFacets ) {
+		Com_DPrintf( "CMod_CachedPatchCollide: bad facet in surface %i\n", surfaceNum );
+		cache->cursor = NULL;
+		return NULL;
+	}
+
+	return pf;
+}
+
+/*
+=================
+CMod_WritePatchCache
+=================
+*/
+static void CMod_WritePatchCache( const char *name, dsurface_t *surfaces ) {
+	patchCacheHeader_t	*header;
+	patchCacheEntry_t	entry;
+	patchCollide_t		*pf;
+	fileHandle_t		f;
+	byte				*data, *cursor;
+	int					i, len;
+
+	len = sizeof( *header );
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pf = cm.surfaces[i]->pc;
+		len += sizeof( entry ) + pf->numFacets * sizeof( facet_t ) + pf->numPlanes * sizeof( patchPlane_t );
+	}
+
+	data = Hunk_AllocateTempMemory( len );
+	cursor = data + sizeof( *header );
+
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pf = cm.surfaces[i]->pc;
+
+		Com_Memset( &entry, 0, sizeof( entry ) );
+		entry.surfaceNum = i;
+		entry.width = LittleLong( surfaces[i].patchWidth );
+		entry.height = LittleLong( surfaces[i].patchHeight );
+		VectorCopy( pf->bounds[0], entry.bounds[0] );
+		VectorCopy( pf->bounds[1], entry.bounds[1] );
+		entry.numPlanes = pf->numPlanes;
+		entry.numFacets = pf->numFacets;
+
+		Com_Memcpy( cursor, &entry, sizeof( entry ) );
+		cursor += sizeof( entry );
+		Com_Memcpy( cursor, pf->facets, pf->numFacets * sizeof( *pf->facets ) );
+		cursor += pf->numFacets * sizeof( *pf->facets );
+		Com_Memcpy( cursor, pf->planes, pf->numPlanes * sizeof( *pf->planes ) );
+		cursor += pf->numPlanes * sizeof( *pf->planes );
+	}
+
+	header = (patchCacheHeader_t *)data;
+	header->ident = PATCH_CACHE_IDENT;
+	header->version = PATCH_CACHE_VERSION;
+	header->bspChecksum = cmod_checksum;
+	header->numSurfaces = cm.numSurfaces;
+	header->dataLength = len - sizeof( *header );
+	header->dataChecksum = Com_BlockChecksum( header + 1, header->dataLength );
+
+	f = FS_SV_FOpenFileWrite( CMod_PatchCachePath( name ) );
+	if ( f ) {
+		FS_Write( data, len, f );
+		FS_FCloseFile( f );
+	} else {
+		Com_Printf( "Couldn't write %s\n", CMod_PatchCachePath( name ) );
+	}
+
+	Hunk_FreeTempMemory( data );
+}
+#endif
+
 /*
 =================
 CMod_LoadPatches
 =================
 */
 #define	MAX_PATCH_VERTS		1024
-void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
+void CMod_LoadPatches( const char *name, lump_t *surfs, lump_t *verts ) {
 	drawVert_t	*dv, *dv_p;
 	dsurface_t	*in;
 	int			count;
@@ -491,6 +788,10 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 	vec3_t		points[MAX_PATCH_VERTS];
 	int			width, height;
 	int			shaderNum;
+#ifndef BSPC
+	patchCache_t	cache;
+	qboolean	cached, generated;
+#endif
 
 	in = (void *)(cmod_base + surfs->fileofs);
 	if (surfs->filelen % sizeof(*in))
@@ -502,6 +803,11 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 	if (verts->filelen % sizeof(*dv))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 
+#ifndef BSPC
+	cached = CMod_OpenPatchCache( name, &cache );
+	generated = qfalse;
+#endif
+
 	// scan through all the surfaces, but only load patches,
 	// not planar faces
 	for ( i = 0 ; i < count ; i++, in++ ) {
@@ -520,6 +826,18 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 			Com_Error( ERR_DROP, "ParseMesh: MAX_PATCH_VERTS" );
 		}
 
+		shaderNum = LittleLong( in->shaderNum );
+		patch->contents = cm.shaders[shaderNum].contentFlags;
+		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+
+#ifndef BSPC
+		patch->pc = CMod_CachedPatchCollide( &cache, i, width, height );
+		if ( patch->pc ) {
+			continue;
+		}
+		generated = qtrue;
+#endif
+
 		dv_p = dv + LittleLong( in->firstVert );
 		for ( j = 0 ; j < c ; j++, dv_p++ ) {
 			points[j][0] = LittleFloat( dv_p->xyz[0] );
@@ -527,13 +845,18 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 			points[j][2] = LittleFloat( dv_p->xyz[2] );
 		}
 
-		shaderNum = LittleLong( in->shaderNum );
-		patch->contents = cm.shaders[shaderNum].contentFlags;
-		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
-
 		// create the internal facet structure
 		patch->pc = CM_GeneratePatchCollide( width, height, points );
 	}
+
+#ifndef BSPC
+	if ( cached ) {
+		Hunk_FreeTempMemory( cache.data );
+	}
+	if ( generated && cm_patchCache->integer ) {
+		CMod_WritePatchCache( name, (void *)(cmod_base + surfs->fileofs) );
+	}
+#endif
 }
 
 //==================================================================
@@ -581,6 +904,7 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	cm_noAreas = Cvar_Get ("cm_noAreas", "0", CVAR_CHEAT);
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE|CVAR_CHEAT );
+	cm_patchCache = Cvar_Get ("cm_patchCache", "1", CVAR_ARCHIVE );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -617,6 +941,7 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 
 	last_checksum = LittleLong (Com_BlockChecksum (buf, length));
 	*checksum = last_checksum;
+	cmod_checksum = last_checksum;
 
 	header = *(dheader_t *)buf;
 	for (i=0 ; i<sizeof(dheader_t)/4 ; i++) {
@@ -638,11 +963,14 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	CMod_LoadPlanes (&header.lumps[LUMP_PLANES]);
 	CMod_LoadBrushSides (&header.lumps[LUMP_BRUSHSIDES]);
 	CMod_LoadBrushes (&header.lumps[LUMP_BRUSHES]);
+#ifdef CM_SIMD_SSE
+	CMod_BuildBrushSides4 ();
+#endif
 	CMod_LoadSubmodels (&header.lumps[LUMP_MODELS]);
 	CMod_LoadNodes (&header.lumps[LUMP_NODES]);
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
 	CMod_LoadVisibility( &header.lumps[LUMP_VISIBILITY] );
-	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
+	CMod_LoadPatches( name, &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
 
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile (buf);
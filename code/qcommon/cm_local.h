@@ -56,12 +56,26 @@ typedef struct {
 	int			shaderNum;
 } cbrushside_t;
 
+// the brush plane kernels in cm_trace.c test four sides at a time
+#if defined( __SSE2__ ) && ( defined( __x86_64__ ) || defined( __SSE2_MATH__ ) )
+#define	CM_SIMD_SSE
+#endif
+
+// four brush sides in structure of arrays form, a brush that doesn't
+// fill its last block repeats its last side, which never changes a trace
+typedef struct {
+	float		normal[3][4];
+	float		dist[4];
+	int			signbits[4];
+} cbrushSides4_t;
+
 typedef struct {
 	int			shaderNum;		// the shader that determined the contents
 	int			contents;
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
+	cbrushSides4_t	*sides4;	// [( numsides + 3 ) / 4], NULL if not built
 	int			checkcount;		// to avoid repeated testings
 } cbrush_t;
 
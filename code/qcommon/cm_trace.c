@@ -148,6 +148,228 @@ float SquareRootFloat(float number) {
 }
 
 
+/*
+===============================================================================
+
+SIMD BRUSH SIDES
+
+The plane distances for four brush sides at a time.  Every lane is computed
+with the same single precision operations in the same order as the scalar
+loops, so the traces come out bit identical to the scalar code, which
+client prediction and the server depend on.
+
+===============================================================================
+*/
+
+#ifdef CM_SIMD_SSE
+#include <emmintrin.h>
+
+#define	Dot4(x,y,z,nx,ny,nz)	_mm_add_ps( _mm_add_ps( _mm_mul_ps( x, nx ), _mm_mul_ps( y, ny ) ), _mm_mul_ps( z, nz ) )
+
+typedef struct {
+	__m128		start[3];
+	__m128		end[3];
+	__m128		size[2][3];		// box traces
+	__m128		startNeg[3];	// capsule traces, start - sphere.offset
+	__m128		startPos[3];	// start + sphere.offset
+	__m128		endNeg[3];
+	__m128		endPos[3];
+	__m128		offset[3];
+	__m128		radius;
+} traceWork4_t;
+
+/*
+================
+CM_SetupTraceWork4
+================
+*/
+static void CM_SetupTraceWork4( const traceWork_t *tw, traceWork4_t *tw4 ) {
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		tw4->start[i] = _mm_set1_ps( tw->start[i] );
+		tw4->end[i] = _mm_set1_ps( tw->end[i] );
+		if ( tw->sphere.use ) {
+			tw4->startNeg[i] = _mm_set1_ps( tw->start[i] - tw->sphere.offset[i] );
+			tw4->startPos[i] = _mm_set1_ps( tw->start[i] + tw->sphere.offset[i] );
+			tw4->endNeg[i] = _mm_set1_ps( tw->end[i] - tw->sphere.offset[i] );
+			tw4->endPos[i] = _mm_set1_ps( tw->end[i] + tw->sphere.offset[i] );
+			tw4->offset[i] = _mm_set1_ps( tw->sphere.offset[i] );
+		} else {
+			tw4->size[0][i] = _mm_set1_ps( tw->size[0][i] );
+			tw4->size[1][i] = _mm_set1_ps( tw->size[1][i] );
+		}
+	}
+	tw4->radius = _mm_set1_ps( tw->sphere.radius );
+}
+
+/*
+================
+CM_SideDistances4
+
+Start and end distances in front of four sides, d2 is skipped if NULL
+================
+*/
+static ID_INLINE void CM_SideDistances4( const traceWork_t *tw, const traceWork4_t *tw4,
+										const cbrushSides4_t *s4, __m128 *d1, __m128 *d2 ) {
+	__m128		nx, ny, nz, dist, mask;
+	__m128		px, py, pz;
+	__m128i		signbits, bit;
+	__m128		offset[3];
+	int			i;
+
+	nx = _mm_load_ps( s4->normal[0] );
+	ny = _mm_load_ps( s4->normal[1] );
+	nz = _mm_load_ps( s4->normal[2] );
+
+	if ( tw->sphere.use ) {
+		// adjust the plane distance apropriately for radius
+		dist = _mm_add_ps( _mm_load_ps( s4->dist ), tw4->radius );
+
+		// find the closest point on the capsule to the plane
+		mask = _mm_cmpgt_ps( Dot4( nx, ny, nz, tw4->offset[0], tw4->offset[1], tw4->offset[2] ), _mm_setzero_ps() );
+
+		px = _mm_or_ps( _mm_and_ps( mask, tw4->startNeg[0] ), _mm_andnot_ps( mask, tw4->startPos[0] ) );
+		py = _mm_or_ps( _mm_and_ps( mask, tw4->startNeg[1] ), _mm_andnot_ps( mask, tw4->startPos[1] ) );
+		pz = _mm_or_ps( _mm_and_ps( mask, tw4->startNeg[2] ), _mm_andnot_ps( mask, tw4->startPos[2] ) );
+		*d1 = _mm_sub_ps( Dot4( px, py, pz, nx, ny, nz ), dist );
+
+		if ( d2 ) {
+			px = _mm_or_ps( _mm_and_ps( mask, tw4->endNeg[0] ), _mm_andnot_ps( mask, tw4->endPos[0] ) );
+			py = _mm_or_ps( _mm_and_ps( mask, tw4->endNeg[1] ), _mm_andnot_ps( mask, tw4->endPos[1] ) );
+			pz = _mm_or_ps( _mm_and_ps( mask, tw4->endNeg[2] ), _mm_andnot_ps( mask, tw4->endPos[2] ) );
+			*d2 = _mm_sub_ps( Dot4( px, py, pz, nx, ny, nz ), dist );
+		}
+	} else {
+		// pick the corner of the box for each plane, like tw->offsets[signbits]
+		signbits = _mm_load_si128( (const __m128i *)s4->signbits );
+		for ( i = 0 ; i < 3 ; i++ ) {
+			bit = _mm_set1_epi32( 1 << i );
+			mask = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( signbits, bit ), bit ) );
+			offset[i] = _mm_or_ps( _mm_and_ps( mask, tw4->size[1][i] ), _mm_andnot_ps( mask, tw4->size[0][i] ) );
+		}
+
+		// adjust the plane distance apropriately for mins/maxs
+		dist = _mm_sub_ps( _mm_load_ps( s4->dist ), Dot4( offset[0], offset[1], offset[2], nx, ny, nz ) );
+
+		*d1 = _mm_sub_ps( Dot4( tw4->start[0], tw4->start[1], tw4->start[2], nx, ny, nz ), dist );
+		if ( d2 ) {
+			*d2 = _mm_sub_ps( Dot4( tw4->end[0], tw4->end[1], tw4->end[2], nx, ny, nz ), dist );
+		}
+	}
+}
+
+/*
+================
+CM_TestBoxInBrushSides4
+
+Returns qtrue if the box is in front of any of the non axial sides
+================
+*/
+static qboolean CM_TestBoxInBrushSides4( traceWork_t *tw, cbrush_t *brush ) {
+	traceWork4_t	tw4;
+	__m128			d1;
+	int				i, lanes;
+
+	CM_SetupTraceWork4( tw, &tw4 );
+
+	// the first six planes are the axial planes, so we only
+	// need to test the remainder
+	for ( i = 1 ; i < ( brush->numsides + 3 ) >> 2 ; i++ ) {
+		lanes = ( i == 1 ) ? 0xc : 0xf;
+		if ( brush->numsides - ( i << 2 ) < 4 ) {
+			lanes &= ( 1 << ( brush->numsides - ( i << 2 ) ) ) - 1;
+		}
+
+		CM_SideDistances4( tw, &tw4, brush->sides4 + i, &d1, NULL );
+
+		// if completely in front of face, no intersection
+		if ( _mm_movemask_ps( _mm_cmpgt_ps( d1, _mm_setzero_ps() ) ) & lanes ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+/*
+================
+CM_TraceThroughBrushSides4
+
+Returns qfalse if the trace is completely in front of a side, otherwise
+finds the latest entering and the earliest leaving fraction.  The
+fractions themselves are still computed one side at a time, in the
+same precision as the scalar loop.
+================
+*/
+static qboolean CM_TraceThroughBrushSides4( traceWork_t *tw, cbrush_t *brush, float *enterFrac, float *leaveFrac,
+										   cbrushside_t **leadside, qboolean *startout, qboolean *getout ) {
+	traceWork4_t	tw4;
+	__m128			d1, d2, eps;
+	float			dist1[4] ALIGN(16);
+	float			dist2[4] ALIGN(16);
+	int				i, j, startMask, getMask;
+	float			f;
+
+	CM_SetupTraceWork4( tw, &tw4 );
+	eps = _mm_set1_ps( SURFACE_CLIP_EPSILON );
+
+	startMask = getMask = 0;
+	for ( i = 0 ; i < ( brush->numsides + 3 ) >> 2 ; i++ ) {
+		CM_SideDistances4( tw, &tw4, brush->sides4 + i, &d1, &d2 );
+
+		getMask |= _mm_movemask_ps( _mm_cmpgt_ps( d2, _mm_setzero_ps() ) );
+		startMask |= _mm_movemask_ps( _mm_cmpgt_ps( d1, _mm_setzero_ps() ) );
+
+		// if completely in front of face, no intersection with the entire brush
+		if ( _mm_movemask_ps( _mm_and_ps( _mm_cmpgt_ps( d1, _mm_setzero_ps() ),
+			_mm_or_ps( _mm_cmpge_ps( d2, eps ), _mm_cmpge_ps( d2, d1 ) ) ) ) ) {
+			return qfalse;
+		}
+
+		// if none of the sides are crossed, none are relevent
+		if ( !_mm_movemask_ps( _mm_or_ps( _mm_cmpgt_ps( d1, _mm_setzero_ps() ), _mm_cmpgt_ps( d2, _mm_setzero_ps() ) ) ) ) {
+			continue;
+		}
+
+		_mm_store_ps( dist1, d1 );
+		_mm_store_ps( dist2, d2 );
+
+		for ( j = 0 ; j < 4 ; j++ ) {
+			// if it doesn't cross the plane, the plane isn't relevent
+			if ( dist1[j] <= 0 && dist2[j] <= 0 ) {
+				continue;
+			}
+
+			// crosses face
+			if ( dist1[j] > dist2[j] ) {	// enter
+				f = ( dist1[j] - SURFACE_CLIP_EPSILON ) / ( dist1[j] - dist2[j] );
+				if ( f < 0 ) {
+					f = 0;
+				}
+				if ( f > *enterFrac ) {
+					*enterFrac = f;
+					*leadside = brush->sides + ( i << 2 ) + j;
+				}
+			} else {	// leave
+				f = ( dist1[j] + SURFACE_CLIP_EPSILON ) / ( dist1[j] - dist2[j] );
+				if ( f > 1 ) {
+					f = 1;
+				}
+				if ( f < *leaveFrac ) {
+					*leaveFrac = f;
+				}
+			}
+		}
+	}
+
+	*startout = startMask != 0;
+	*getout = getMask != 0;
+
+	return qtrue;
+}
+#endif
+
 /*
 ===============================================================================
 
@@ -185,6 +407,13 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 		return;
 	}
 
+#ifdef CM_SIMD_SSE
+	if ( brush->sides4 ) {
+		if ( CM_TestBoxInBrushSides4( tw, brush ) ) {
+			return;
+		}
+	} else
+#endif
    if ( tw->sphere.use ) {
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
@@ -510,6 +739,16 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 
 	leadside = NULL;
 
+#ifdef CM_SIMD_SSE
+	if ( brush->sides4 ) {
+		if ( !CM_TraceThroughBrushSides4( tw, brush, &enterFrac, &leaveFrac, &leadside, &startout, &getout ) ) {
+			return;
+		}
+		if ( leadside ) {
+			clipplane = leadside->plane;
+		}
+	} else
+#endif
 	if ( tw->sphere.use ) {
 		//
 		// compare the trace against all planes of the brush
@@ -1363,7 +1602,9 @@ CM_BoxTrace
 void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
 						  vec3_t mins, vec3_t maxs,
 						  clipHandle_t model, int brushmask, int capsule ) {
+	PROFILE_BEGIN( "CM_Trace", -1 );
 	CM_Trace( results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+	PROFILE_END();
 }
 
 /*
@@ -1448,7 +1689,9 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	}
 
 	// sweep the box through the model
+	PROFILE_BEGIN( "CM_Trace", -1 );
 	CM_Trace( &trace, start_l, end_l, symetricSize[0], symetricSize[1], model, origin, brushmask, capsule, &sphere );
+	PROFILE_END();
 
 	// if the bmodel was rotated and there was a collision
 	if ( rotated && trace.fraction != 1.0 ) {
@@ -1997,6 +1997,7 @@ sysEvent_t Com_GetSystemEvent( void )
 	char        *s;
 	msg_t       netmsg;
 	netadr_t    adr;
+	int         time;
 
 	// return if we have data
 	if ( eventHead > eventTail )
@@ -2020,7 +2021,8 @@ sysEvent_t Com_GetSystemEvent( void )
 
 	// check for network packets
 	MSG_Init( &netmsg, sys_packetReceived, sizeof( sys_packetReceived ) );
-	if ( Sys_GetPacket ( &adr, &netmsg ) )
+	time = 0;
+	if ( NET_GetQueuedPacket( &adr, &netmsg, &time ) || Sys_GetPacket ( &adr, &netmsg ) )
 	{
 		netadr_t  *buf;
 		int       len;
@@ -2030,7 +2032,7 @@ sysEvent_t Com_GetSystemEvent( void )
 		buf = Z_Malloc( len );
 		*buf = adr;
 		memcpy( buf+1, netmsg.data, netmsg.cursize );
-		Com_QueueEvent( 0, SE_PACKET, 0, 0, len, buf );
+		Com_QueueEvent( time, SE_PACKET, 0, 0, len, buf );
 	}
 
 	// return if we have data
@@ -2610,6 +2612,8 @@ void Com_Init( char *commandLine ) {
 	}
 	Cmd_AddCommand ("quit", Com_Quit_f);
 	Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
+	Cmd_AddCommand ("huffbench", MSG_HuffBench_f );
+	Com_ProfileInit();
 	Cmd_AddCommand ("writeconfig", Com_WriteConfig_f );
 
 	s = va("%s %s %s", Q3_VERSION, PLATFORM_STRING, __DATE__ );
@@ -2814,6 +2818,7 @@ void Com_Frame( void ) {
 
 
 	if ( setjmp (abortframe) ) {
+		Com_ProfileUnwind();
 		return;			// an ERR_DROP was thrown
 	}
 
@@ -2850,6 +2855,9 @@ void Com_Frame( void ) {
 		}
 		msec = com_frameTime - lastTime;
 	} while ( msec < minMsec );
+
+	PROFILE_BEGIN( "Com_Frame", -1 );
+
 	Cbuf_Execute ();
 
 	if (com_altivec->modified)
@@ -2909,7 +2917,9 @@ void Com_Frame( void ) {
 		timeBeforeClient = Sys_Milliseconds ();
 	}
 
+	PROFILE_BEGIN( "CL_Frame", -1 );
 	CL_Frame( msec );
+	PROFILE_END();
 
 	if ( com_speeds->integer ) {
 		timeAfter = Sys_Milliseconds ();
@@ -2953,6 +2963,8 @@ void Com_Frame( void ) {
 	key = lastTime * 0x87243987;
 
 	com_frameNumber++;
+
+	PROFILE_END();
 }
 
 /*
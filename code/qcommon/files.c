@@ -197,15 +197,20 @@ static const unsigned pak_checksums[] = {
 
 #define MAX_ZPATH			256
 #define	MAX_SEARCH_PATHS	4096
-#define MAX_FILEHASH_SIZE	1024
+#define	MAX_FOUND_FILES		0x1000
 
 typedef struct fileInPack_s {
 	char					*name;		// name of the file
 	unsigned long			pos;		// file info position in zip
-	struct	fileInPack_s*	next;		// next file in the hash
+	unsigned long			localHeader;	// local header position in zip
+	unsigned long			compressedSize;
+	unsigned long			size;
+	int						method;		// UNZ_STORED or UNZ_DEFLATED
+	struct pack_s			*pack;
+	struct	fileInPack_s*	next;		// same name in the next pack of the search path
 } fileInPack_t;
 
-typedef struct {
+typedef struct pack_s {
 	char			pakFilename[MAX_OSPATH];	// c:\quake3\baseq3\pak0.pk3
 	char			pakBasename[MAX_OSPATH];	// pak0
 	char			pakGamename[MAX_OSPATH];	// baseq3
@@ -214,14 +219,23 @@ typedef struct {
 	int				pure_checksum;				// checksum for pure
 	int				numfiles;					// number of files in pk3
 	int				referenced;					// referenced file flags
-	int				hashSize;					// hash table size (power of 2)
-	fileInPack_t*	*hashTable;					// hash table
 	fileInPack_t*	buildBuffer;				// buffer with the filenames etc.
+	byte			*mapping;					// the whole pk3 if fs_mapPaks
+	int				mappingLength;
 } pack_t;
 
+typedef struct dirFile_s {
+	struct dirFile_s	*next;		// next in the hash
+	int					pathLength;	// of the directory the file is in
+	qboolean			isDir;
+	char				name[1];	// relative to the game directory, variable sized
+} dirFile_t;
+
 typedef struct {
 	char		path[MAX_OSPATH];		// c:\quake3
 	char		gamedir[MAX_OSPATH];	// baseq3
+	dirFile_t	**files;				// snapshot of the tree, NULL if there is none
+	int			numFiles;
 } directory_t;
 
 typedef struct searchpath_s {
@@ -248,6 +262,17 @@ static	int			fs_readCount;			// total bytes read
 static	int			fs_loadCount;			// total files read
 static	int			fs_loadStack;			// total files in memory
 static	int			fs_packFiles;			// total number of files in packs
+static	cvar_t		*fs_mapPaks;
+static	cvar_t		*fs_dirCache;
+
+// counters for fs_stats
+static	int			fs_statLookups;			// FS_FOpenFileRead searches
+static	int			fs_statMissingHits;		// answered by the missing file cache
+static	int			fs_statDirSkips;		// directories the snapshot said not to open
+static	int			fs_statOpens;			// fopen calls of the searches
+static	int			fs_statListings;		// Sys_ListFiles calls
+static	cvar_t		*fs_prefetchThreads;
+static	cvar_t		*fs_prefetchMemory;
 
 static int fs_fakeChkSum;
 static int fs_checksumFeed;
@@ -275,6 +300,15 @@ typedef struct {
 
 static fileHandleData_t	fsh[MAX_FILE_HANDLES];
 
+// open addressed, the first file with each name in search path order
+static fileInPack_t	**fs_fileIndex;
+static int			fs_fileIndexMask;
+
+// FS_ReadFile buffers pointing into pack mappings
+#define	MAX_MAPPED_BUFFERS	64
+static const void	*fs_mappedBuffers[MAX_MAPPED_BUFFERS];
+static int			fs_numMappedBuffers;
+
 // TTimo - https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=540
 // wether we did a reorder on the current search path when joining the server
 static qboolean fs_reordered;
@@ -367,6 +401,109 @@ static long FS_HashFileName( const char *fname, int hashSize ) {
 	return hash;
 }
 
+/*
+================
+FS_HashFullName
+
+Hashes the whole name the way FS_FilenameCompare compares it
+================
+*/
+static unsigned FS_HashFullName( const char *fname ) {
+	unsigned	hash;
+	int			letter;
+
+	hash = 2166136261u;
+	while ( *fname ) {
+		letter = *fname++;
+		if ( letter >= 'a' && letter <= 'z' ) {
+			letter -= ( 'a' - 'A' );
+		}
+		if ( letter == '\\' || letter == ':' ) {
+			letter = '/';
+		}
+		hash = ( hash ^ letter ) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+================
+FS_IndexedFile
+
+Returns the first pack file named fname in search path order, the
+packs after it that have the file too follow through next
+================
+*/
+static fileInPack_t *FS_IndexedFile( const char *fname ) {
+	fileInPack_t	*pakFile;
+	unsigned		i;
+
+	if ( !fs_fileIndex ) {
+		return NULL;
+	}
+	for ( i = FS_HashFullName( fname ) ; ; i++ ) {
+		pakFile = fs_fileIndex[i & fs_fileIndexMask];
+		if ( !pakFile || !FS_FilenameCompare( pakFile->name, fname ) ) {
+			return pakFile;
+		}
+	}
+}
+
+/*
+================
+FS_BuildFileIndex
+
+Must be redone whenever the search path changes
+================
+*/
+static void FS_BuildFileIndex( void ) {
+	searchpath_t	*search;
+	fileInPack_t	*pakFile, **slot;
+	int				i, count, size;
+	unsigned		j;
+
+	if ( fs_fileIndex ) {
+		Z_Free( fs_fileIndex );
+		fs_fileIndex = NULL;
+	}
+
+	count = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			count += search->pack->numfiles;
+		}
+	}
+
+	// keep it at most half full
+	size = 64;
+	while ( size < count * 2 ) {
+		size <<= 1;
+	}
+	fs_fileIndex = Z_Malloc( size * sizeof( *fs_fileIndex ) );
+	fs_fileIndexMask = size - 1;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( !search->pack ) {
+			continue;
+		}
+		for ( i = 0 ; i < search->pack->numfiles ; i++ ) {
+			pakFile = &search->pack->buildBuffer[i];
+			pakFile->next = NULL;
+			for ( j = FS_HashFullName( pakFile->name ) ; ; j++ ) {
+				slot = &fs_fileIndex[j & fs_fileIndexMask];
+				if ( !*slot || !FS_FilenameCompare( (*slot)->name, pakFile->name ) ) {
+					break;
+				}
+			}
+			// append, the earlier packs come first
+			while ( *slot ) {
+				slot = &(*slot)->next;
+			}
+			*slot = pakFile;
+		}
+	}
+}
+
 static fileHandle_t	FS_HandleForFile(void) {
 	int		i;
 
@@ -494,6 +631,366 @@ static qboolean FS_CreatePath (char *OSPath) {
 	return qfalse;
 }
 
+/*
+=================================================================================
+
+DIRECTORY SNAPSHOTS
+
+The trees of the directories in the search path are listed once by
+FS_Startup, so looking for files that aren't there doesn't have to
+touch the disk.  Files the game writes are added as it goes, anything
+else needs an fs_restart to show up.
+
+=================================================================================
+*/
+
+#define	DIR_HASH_SIZE		1024
+#define	MAX_DIR_FILES		8192		// don't cache bigger trees
+#define	MISSING_HASH_SIZE	256
+#define	MAX_MISSING_FILES	1024
+
+typedef struct missingFile_s {
+	struct missingFile_s	*next;
+	char					name[1];		// variable sized
+} missingFile_t;
+
+static missingFile_t	*fs_missingFiles[MISSING_HASH_SIZE];
+static int				fs_numMissingFiles;
+
+/*
+=================
+FS_FindDirFile
+=================
+*/
+static dirFile_t *FS_FindDirFile( directory_t *dir, const char *name ) {
+	dirFile_t	*file;
+
+	for ( file = dir->files[FS_HashFullName( name ) & ( DIR_HASH_SIZE - 1 )] ; file ; file = file->next ) {
+		if ( !FS_FilenameCompare( file->name, name ) ) {
+			return file;
+		}
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_AddDirFile
+
+name has to use '/' separators
+=================
+*/
+static void FS_AddDirFile( directory_t *dir, const char *name, qboolean isDir ) {
+	dirFile_t	*file;
+	const char	*s;
+	int			hash;
+
+	file = FS_FindDirFile( dir, name );
+	if ( file ) {
+		file->isDir = isDir;
+		return;
+	}
+
+	file = Z_Malloc( sizeof( *file ) + strlen( name ) );
+	strcpy( file->name, name );
+	file->isDir = isDir;
+	file->pathLength = 0;
+	for ( s = name ; *s ; s++ ) {
+		if ( *s == '/' ) {
+			file->pathLength = s - name;
+		}
+	}
+
+	hash = FS_HashFullName( name ) & ( DIR_HASH_SIZE - 1 );
+	file->next = dir->files[hash];
+	dir->files[hash] = file;
+	dir->numFiles++;
+}
+
+/*
+=================
+FS_FreeDirSnapshot
+=================
+*/
+static void FS_FreeDirSnapshot( directory_t *dir ) {
+	dirFile_t	*file, *next;
+	int			i;
+
+	if ( !dir->files ) {
+		return;
+	}
+	for ( i = 0 ; i < DIR_HASH_SIZE ; i++ ) {
+		for ( file = dir->files[i] ; file ; file = next ) {
+			next = file->next;
+			Z_Free( file );
+		}
+	}
+	Z_Free( dir->files );
+	dir->files = NULL;
+	dir->numFiles = 0;
+}
+
+/*
+=================
+FS_ScanDirectory
+
+Adds everything below subdir to the snapshot, returns qfalse if the
+snapshot couldn't hold it all
+=================
+*/
+static qboolean FS_ScanDirectory( directory_t *dir, const char *subdir ) {
+	char		ospath[MAX_OSPATH];
+	char		name[MAX_ZPATH];
+	char		**list;
+	int			i, count;
+	qboolean	ok;
+
+	Q_strncpyz( ospath, FS_BuildOSPath( dir->path, dir->gamedir, subdir ), sizeof( ospath ) );
+
+	// a full list may have been cut short
+	list = Sys_ListFiles( ospath, "", NULL, &count, qfalse );
+	fs_statListings++;
+	ok = ( count < MAX_FOUND_FILES - 1 );
+	for ( i = 0 ; i < count && ok ; i++ ) {
+		if ( strlen( subdir ) + strlen( list[i] ) + 2 > sizeof( name ) ) {
+			ok = qfalse;
+			break;
+		}
+		Com_sprintf( name, sizeof( name ), "%s%s%s", subdir, subdir[0] ? "/" : "", list[i] );
+		FS_AddDirFile( dir, name, qfalse );
+		ok = ( dir->numFiles <= MAX_DIR_FILES );
+	}
+	Sys_FreeFileList( list );
+	if ( !ok ) {
+		return qfalse;
+	}
+
+	list = Sys_ListFiles( ospath, "/", NULL, &count, qfalse );
+	fs_statListings++;
+	ok = ( count < MAX_FOUND_FILES - 1 );
+	for ( i = 0 ; i < count && ok ; i++ ) {
+		if ( !strcmp( list[i], "." ) || !strcmp( list[i], ".." ) ) {
+			continue;
+		}
+		if ( strlen( subdir ) + strlen( list[i] ) + 2 > sizeof( name ) ) {
+			ok = qfalse;
+			break;
+		}
+		Com_sprintf( name, sizeof( name ), "%s%s%s", subdir, subdir[0] ? "/" : "", list[i] );
+		FS_AddDirFile( dir, name, qtrue );
+		ok = ( dir->numFiles <= MAX_DIR_FILES ) && FS_ScanDirectory( dir, name );
+	}
+	Sys_FreeFileList( list );
+
+	return ok;
+}
+
+/*
+=================
+FS_SnapshotDirectory
+=================
+*/
+static void FS_SnapshotDirectory( directory_t *dir ) {
+	dir->files = Z_Malloc( DIR_HASH_SIZE * sizeof( *dir->files ) );
+	dir->numFiles = 0;
+
+	if ( !FS_ScanDirectory( dir, "" ) ) {
+		Com_DPrintf( "%s/%s has too many files to cache\n", dir->path, dir->gamedir );
+		FS_FreeDirSnapshot( dir );
+	}
+}
+
+/*
+=================
+FS_DirMayHaveFile
+
+Returns qfalse if the snapshot of the directory says there's no such
+file, so it doesn't need to be opened.  Config files are always looked
+for, they get written by hand while the game is running.
+=================
+*/
+static qboolean FS_DirMayHaveFile( directory_t *dir, const char *filename ) {
+	dirFile_t	*file;
+	const char	*s;
+
+	if ( !dir->files || !Q_stricmp( COM_GetExtension( filename ), "cfg" ) ) {
+		return qtrue;
+	}
+
+	// the snapshot only knows the plain spelling of names
+	for ( s = filename ; *s ; s++ ) {
+		if ( ( *s == '/' || *s == '\\' ) && ( s[1] == '/' || s[1] == '\\' || s[1] == 0 ) ) {
+			return qtrue;
+		}
+		if ( s[0] == '.' && ( s == filename || s[-1] == '/' || s[-1] == '\\' ) ) {
+			return qtrue;
+		}
+	}
+	if ( s == filename || s[-1] == '.' || s[-1] == ' ' ) {
+		return qtrue;
+	}
+
+	file = FS_FindDirFile( dir, filename );
+	if ( file && !file->isDir ) {
+		return qtrue;
+	}
+
+	fs_statDirSkips++;
+	return qfalse;
+}
+
+/*
+=================
+FS_DirForOSPath
+
+Returns the directory with a snapshot that ospath is in, and the name
+in it with '/' separators
+=================
+*/
+static directory_t *FS_DirForOSPath( const char *ospath, char *name, int nameSize ) {
+	searchpath_t	*search;
+	char			prefix[MAX_OSPATH];
+	int				length, i;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( !search->dir || !search->dir->files ) {
+			continue;
+		}
+		Com_sprintf( prefix, sizeof( prefix ), "%s/%s/", search->dir->path, search->dir->gamedir );
+		FS_ReplaceSeparators( prefix );
+		length = strlen( prefix );
+		if ( Q_stricmpn( ospath, prefix, length ) ) {
+			continue;
+		}
+
+		Q_strncpyz( name, ospath + length, nameSize );
+		for ( i = 0 ; name[i] ; i++ ) {
+			if ( name[i] == PATH_SEP ) {
+				name[i] = '/';
+			}
+		}
+		return search->dir;
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_ClearMissingFiles
+=================
+*/
+static void FS_ClearMissingFiles( void ) {
+	missingFile_t	*missing, *next;
+	int				i;
+
+	for ( i = 0 ; i < MISSING_HASH_SIZE ; i++ ) {
+		for ( missing = fs_missingFiles[i] ; missing ; missing = next ) {
+			next = missing->next;
+			Z_Free( missing );
+		}
+		fs_missingFiles[i] = NULL;
+	}
+	fs_numMissingFiles = 0;
+}
+
+/*
+=================
+FS_IsMissingFile
+=================
+*/
+static qboolean FS_IsMissingFile( const char *filename ) {
+	missingFile_t	*missing;
+
+	for ( missing = fs_missingFiles[FS_HashFullName( filename ) & ( MISSING_HASH_SIZE - 1 )] ; missing ; missing = missing->next ) {
+		if ( !FS_FilenameCompare( missing->name, filename ) ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
+/*
+=================
+FS_AddMissingFile
+
+Remembers a file FS_FOpenFileRead couldn't find anywhere
+=================
+*/
+static void FS_AddMissingFile( const char *filename ) {
+	missingFile_t	*missing;
+	int				hash;
+
+	if ( !fs_dirCache->integer || !Q_stricmp( COM_GetExtension( filename ), "cfg" ) ) {
+		return;
+	}
+	if ( fs_numMissingFiles == MAX_MISSING_FILES ) {
+		FS_ClearMissingFiles();
+	}
+
+	missing = Z_Malloc( sizeof( *missing ) + strlen( filename ) );
+	strcpy( missing->name, filename );
+	hash = FS_HashFullName( filename ) & ( MISSING_HASH_SIZE - 1 );
+	missing->next = fs_missingFiles[hash];
+	fs_missingFiles[hash] = missing;
+	fs_numMissingFiles++;
+}
+
+/*
+=================
+FS_FileWritten
+
+Keeps the snapshots up to date with a file the game wrote
+=================
+*/
+static void FS_FileWritten( const char *ospath ) {
+	directory_t	*dir;
+	char		name[MAX_ZPATH];
+	char		*s;
+
+	FS_ClearMissingFiles();
+
+	dir = FS_DirForOSPath( ospath, name, sizeof( name ) );
+	if ( !dir || !name[0] ) {
+		return;
+	}
+
+	// FS_CreatePath made the directories
+	for ( s = name ; *s ; s++ ) {
+		if ( *s == '/' ) {
+			*s = 0;
+			FS_AddDirFile( dir, name, qtrue );
+			*s = '/';
+		}
+	}
+	FS_AddDirFile( dir, name, qfalse );
+}
+
+/*
+=================
+FS_FileRemoved
+=================
+*/
+static void FS_FileRemoved( const char *ospath ) {
+	directory_t	*dir;
+	dirFile_t	**prev, *file;
+	char		name[MAX_ZPATH];
+
+	dir = FS_DirForOSPath( ospath, name, sizeof( name ) );
+	if ( !dir ) {
+		return;
+	}
+
+	for ( prev = &dir->files[FS_HashFullName( name ) & ( DIR_HASH_SIZE - 1 )] ; *prev ; prev = &(*prev)->next ) {
+		file = *prev;
+		if ( !file->isDir && !FS_FilenameCompare( file->name, name ) ) {
+			*prev = file->next;
+			Z_Free( file );
+			dir->numFiles--;
+			return;
+		}
+	}
+}
+
 /*
 =================
 FS_CopyFile
@@ -550,6 +1047,7 @@ FS_Remove
 */
 void FS_Remove( const char *osPath ) {
 	remove( osPath );
+	FS_FileRemoved( osPath );
 }
 
 /*
@@ -559,7 +1057,7 @@ FS_HomeRemove
 ===========
 */
 void FS_HomeRemove( const char *homePath ) {
-	remove( FS_BuildOSPath( fs_homepath->string,
+	FS_Remove( FS_BuildOSPath( fs_homepath->string,
 			fs_gamedir, homePath ) );
 }
 
@@ -648,6 +1146,8 @@ fileHandle_t FS_SV_FOpenFileWrite( const char *filename ) {
 	fsh[f].handleSync = qfalse;
 	if (!fsh[f].handleFiles.file.o) {
 		f = 0;
+	} else {
+		FS_FileWritten( ospath );
 	}
 	return f;
 }
@@ -750,6 +1250,8 @@ void FS_SV_Rename( const char *from, const char *to ) {
 		FS_CopyFile ( from_ospath, to_ospath );
 		FS_Remove ( from_ospath );
 	}
+	FS_FileRemoved( from_ospath );
+	FS_FileWritten( to_ospath );
 }
 
 
@@ -782,6 +1284,8 @@ void FS_Rename( const char *from, const char *to ) {
 		FS_CopyFile ( from_ospath, to_ospath );
 		FS_Remove ( from_ospath );
 	}
+	FS_FileRemoved( from_ospath );
+	FS_FileWritten( to_ospath );
 }
 
 /*
@@ -852,6 +1356,8 @@ fileHandle_t FS_FOpenFileWrite( const char *filename ) {
 	fsh[f].handleSync = qfalse;
 	if (!fsh[f].handleFiles.file.o) {
 		f = 0;
+	} else {
+		FS_FileWritten( ospath );
 	}
 	return f;
 }
@@ -892,6 +1398,8 @@ fileHandle_t FS_FOpenFileAppend( const char *filename ) {
 	fsh[f].handleSync = qfalse;
 	if (!fsh[f].handleFiles.file.o) {
 		f = 0;
+	} else {
+		FS_FileWritten( ospath );
 	}
 	return f;
 }
@@ -934,69 +1442,71 @@ qboolean FS_FilenameCompare( const char *s1, const char *s2 ) {
 
 /*
 ===========
-FS_FOpenFileRead
+FS_PackFileData
 
-Finds the file in the search path.
-Returns filesize and an open FILE pointer.
-Used for streaming data out of either a
-separate file or a ZIP file.
+Returns the data of a file in a mapped pack, or NULL if the pack isn't
+mapped or the zip entry is damaged
 ===========
 */
-extern qboolean		com_fullyInitialized;
-
-int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
-	searchpath_t	*search;
-	char			*netpath;
+static const byte *FS_PackFileData( fileInPack_t *pakFile ) {
 	pack_t			*pak;
-	fileInPack_t	*pakFile;
-	directory_t		*dir;
-	long			hash;
-	unz_s			*zfi;
-	FILE			*temp;
-	int				l;
-	char demoExt[16];
-
-	hash = 0;
+	const byte		*header;
+	unsigned long	offset;
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	pak = pakFile->pack;
+	if ( !pak->mapping || pakFile->localHeader + 30 > pak->mappingLength ) {
+		return NULL;
 	}
 
-	if ( file == NULL ) {
-		// just wants to see if file is there
-		for ( search = fs_searchpaths ; search ; search = search->next ) {
-			//
-			if ( search->pack ) {
-				hash = FS_HashFileName(filename, search->pack->hashSize);
-			}
-			// is the element a pak file?
-			if ( search->pack && search->pack->hashTable[hash] ) {
-				// look through all the pak file elements
-				pak = search->pack;
-				pakFile = pak->hashTable[hash];
-				do {
-					// case and separator insensitive comparisons
-					if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-						// found it!
-						return qtrue;
-					}
-					pakFile = pakFile->next;
-				} while(pakFile != NULL);
-			} else if ( search->dir ) {
-				dir = search->dir;
-			
-				netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
-				temp = fopen (netpath, "rb");
-				if ( !temp ) {
-					continue;
-				}
-				fclose(temp);
-				return qtrue;
-			}
+	header = pak->mapping + pakFile->localHeader;
+	if ( header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4 ) {
+		return NULL;
+	}
+
+	// skip the file name and the local extra field
+	offset = pakFile->localHeader + 30 + ( header[26] | ( header[27] << 8 ) ) + ( header[28] | ( header[29] << 8 ) );
+
+	// inflate reads a dummy byte after the data, there's always the
+	// central directory after it
+	if ( offset + pakFile->compressedSize >= pak->mappingLength ) {
+		return NULL;
+	}
+	if ( pakFile->method == UNZ_STORED ) {
+		if ( pakFile->compressedSize != pakFile->size ) {
+			return NULL;
 		}
-		return qfalse;
+	} else if ( pakFile->method != UNZ_DEFLATED ) {
+		return NULL;
 	}
 
+	return pak->mapping + offset;
+}
+
+extern qboolean		com_fullyInitialized;
+
+/*
+===========
+FS_OpenFileRead
+
+FS_FOpenFileRead that also returns the pack file it found.  When mapped
+is set a file in a mapped pack isn't opened, *file is 0 for it and
+FS_PackFileData has the contents.
+===========
+*/
+static int FS_OpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE,
+						   qboolean mapped, fileInPack_t **pakFileFound ) {
+	searchpath_t	*search;
+	char			*netpath;
+	pack_t			*pak;
+	fileInPack_t	*pakFile, *indexed;
+	directory_t		*dir;
+	unz_s			*zfi;
+	FILE			*temp;
+	int				l;
+	char demoExt[16];
+
+	*pakFileFound = NULL;
+
 	if ( !filename ) {
 		Com_Error( ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n" );
 	}
@@ -1022,6 +1532,13 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 		return -1;
 	}
 
+	fs_statLookups++;
+	if ( FS_IsMissingFile( filename ) ) {
+		fs_statMissingHits++;
+		*file = 0;
+		return -1;
+	}
+
 	//
 	// search through the path, one element at a time
 	//
@@ -1029,88 +1546,95 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 	*file = FS_HandleForFile();
 	fsh[*file].handleFiles.unique = uniqueFILE;
 
+	// the packs that have the file, in search path order
+	indexed = FS_IndexedFile( filename );
+
 	for ( search = fs_searchpaths ; search ; search = search->next ) {
-		//
-		if ( search->pack ) {
-			hash = FS_HashFileName(filename, search->pack->hashSize);
-		}
 		// is the element a pak file?
-		if ( search->pack && search->pack->hashTable[hash] ) {
+		if ( search->pack ) {
+			if ( !indexed || indexed->pack != search->pack ) {
+				continue;
+			}
+			pakFile = indexed;
+			indexed = indexed->next;
+
 			// disregard if it doesn't match one of the allowed pure pak files
 			if ( !FS_PakIsPure(search->pack) ) {
 				continue;
 			}
 
-			// look through all the pak file elements
+			// found it!
 			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do {
-				// case and separator insensitive comparisons
-				if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-					// found it!
-
-					// mark the pak as having been referenced and mark specifics on cgame and ui
-					// shaders, txt, arena files  by themselves do not count as a reference as 
-					// these are loaded from all pk3s 
-					// from every pk3 file.. 
-					l = strlen( filename );
-					if ( !(pak->referenced & FS_GENERAL_REF)) {
-						if ( Q_stricmp(filename + l - 7, ".shader") != 0 &&
-							Q_stricmp(filename + l - 4, ".txt") != 0 &&
-							Q_stricmp(filename + l - 4, ".cfg") != 0 &&
-							Q_stricmp(filename + l - 7, ".config") != 0 &&
-							strstr(filename, "levelshots") == NULL &&
-							Q_stricmp(filename + l - 4, ".bot") != 0 &&
-							Q_stricmp(filename + l - 6, ".arena") != 0 &&
-							Q_stricmp(filename + l - 5, ".menu") != 0) {
-							pak->referenced |= FS_GENERAL_REF;
-						}
-					}
+			*pakFileFound = pakFile;
 
-					if (!(pak->referenced & FS_QAGAME_REF) && strstr(filename, "qagame.qvm")) {
-						pak->referenced |= FS_QAGAME_REF;
-					}
-					if (!(pak->referenced & FS_CGAME_REF) && strstr(filename, "cgame.qvm")) {
-						pak->referenced |= FS_CGAME_REF;
-					}
-					if (!(pak->referenced & FS_UI_REF) && strstr(filename, "ui.qvm")) {
-						pak->referenced |= FS_UI_REF;
-					}
+			// mark the pak as having been referenced and mark specifics on cgame and ui
+			// shaders, txt, arena files  by themselves do not count as a reference as 
+			// these are loaded from all pk3s 
+			// from every pk3 file.. 
+			l = strlen( filename );
+			if ( !(pak->referenced & FS_GENERAL_REF)) {
+				if ( Q_stricmp(filename + l - 7, ".shader") != 0 &&
+					Q_stricmp(filename + l - 4, ".txt") != 0 &&
+					Q_stricmp(filename + l - 4, ".cfg") != 0 &&
+					Q_stricmp(filename + l - 7, ".config") != 0 &&
+					strstr(filename, "levelshots") == NULL &&
+					Q_stricmp(filename + l - 4, ".bot") != 0 &&
+					Q_stricmp(filename + l - 6, ".arena") != 0 &&
+					Q_stricmp(filename + l - 5, ".menu") != 0) {
+					pak->referenced |= FS_GENERAL_REF;
+				}
+			}
 
-					if ( uniqueFILE ) {
-						// open a new file on the pakfile
-						fsh[*file].handleFiles.file.z = unzReOpen (pak->pakFilename, pak->handle);
-						if (fsh[*file].handleFiles.file.z == NULL) {
-							Com_Error (ERR_FATAL, "Couldn't reopen %s", pak->pakFilename);
-						}
-					} else {
-						fsh[*file].handleFiles.file.z = pak->handle;
-					}
-					Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
-					fsh[*file].zipFile = qtrue;
-					zfi = (unz_s *)fsh[*file].handleFiles.file.z;
-					// in case the file was new
-					temp = zfi->file;
-					// set the file position in the zip file (also sets the current file info)
-					unzSetCurrentFileInfoPosition(pak->handle, pakFile->pos);
-                                        if ( zfi != pak->handle ) {
-						// copy the file info into the unzip structure
-						Com_Memcpy( zfi, pak->handle, sizeof(unz_s) );
-                                        }
-					// we copy this back into the structure
-					zfi->file = temp;
-					// open the file in the zip
-					unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
-					fsh[*file].zipFilePos = pakFile->pos;
-
-					if ( fs_debug->integer ) {
-						Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n", 
-							filename, pak->pakFilename );
-					}
-					return zfi->cur_file_info.uncompressed_size;
+			if (!(pak->referenced & FS_QAGAME_REF) && strstr(filename, "qagame.qvm")) {
+				pak->referenced |= FS_QAGAME_REF;
+			}
+			if (!(pak->referenced & FS_CGAME_REF) && strstr(filename, "cgame.qvm")) {
+				pak->referenced |= FS_CGAME_REF;
+			}
+			if (!(pak->referenced & FS_UI_REF) && strstr(filename, "ui.qvm")) {
+				pak->referenced |= FS_UI_REF;
+			}
+
+			if ( mapped && pak->mapping ) {
+				*file = 0;
+				if ( fs_debug->integer ) {
+					Com_Printf( "FS_FOpenFileRead: %s (mapped from '%s')\n", 
+						filename, pak->pakFilename );
 				}
-				pakFile = pakFile->next;
-			} while(pakFile != NULL);
+				return pakFile->size;
+			}
+
+			if ( uniqueFILE ) {
+				// open a new file on the pakfile
+				fsh[*file].handleFiles.file.z = unzReOpen (pak->pakFilename, pak->handle);
+				if (fsh[*file].handleFiles.file.z == NULL) {
+					Com_Error (ERR_FATAL, "Couldn't reopen %s", pak->pakFilename);
+				}
+			} else {
+				fsh[*file].handleFiles.file.z = pak->handle;
+			}
+			Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
+			fsh[*file].zipFile = qtrue;
+			zfi = (unz_s *)fsh[*file].handleFiles.file.z;
+			// in case the file was new
+			temp = zfi->file;
+			// set the file position in the zip file (also sets the current file info)
+			unzSetCurrentFileInfoPosition(pak->handle, pakFile->pos);
+			if ( zfi != pak->handle ) {
+				// copy the file info into the unzip structure
+				Com_Memcpy( zfi, pak->handle, sizeof(unz_s) );
+			}
+			// we copy this back into the structure
+			zfi->file = temp;
+			// open the file in the zip
+			unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
+			fsh[*file].zipFilePos = pakFile->pos;
+
+			if ( fs_debug->integer ) {
+				Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n", 
+					filename, pak->pakFilename );
+			}
+			return zfi->cur_file_info.uncompressed_size;
 		} else if ( search->dir ) {
 			// check a file in the directory tree
 
@@ -1134,9 +1658,13 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 			}
 
 			dir = search->dir;
+			if ( !FS_DirMayHaveFile( dir, filename ) ) {
+				continue;
+			}
 			
 			netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
 			fsh[*file].handleFiles.file.o = fopen (netpath, "rb");
+			fs_statOpens++;
 			if ( !fsh[*file].handleFiles.file.o ) {
 				continue;
 			}
@@ -1165,10 +1693,55 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 		fprintf(missingFiles, "%s\n", filename);
 	}
 #endif
+	FS_AddMissingFile( filename );
 	*file = 0;
 	return -1;
 }
 
+/*
+===========
+FS_FOpenFileRead
+
+Finds the file in the search path.
+Returns filesize and an open FILE pointer.
+Used for streaming data out of either a
+separate file or a ZIP file.
+===========
+*/
+int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
+	searchpath_t	*search;
+	fileInPack_t	*pakFile;
+	char			*netpath;
+	FILE			*temp;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	if ( file == NULL ) {
+		// just wants to see if file is there
+		if ( FS_IndexedFile( filename ) ) {
+			return qtrue;
+		}
+		for ( search = fs_searchpaths ; search ; search = search->next ) {
+			if ( !search->dir || !FS_DirMayHaveFile( search->dir, filename ) ) {
+				continue;
+			}
+			netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, filename );
+			temp = fopen (netpath, "rb");
+			fs_statOpens++;
+			if ( !temp ) {
+				continue;
+			}
+			fclose(temp);
+			return qtrue;
+		}
+		return qfalse;
+	}
+
+	return FS_OpenFileRead( filename, file, uniqueFILE, qfalse, &pakFile );
+}
+
 
 /*
 =================
@@ -1286,103 +1859,552 @@ int FS_Write( const void *buffer, int len, fileHandle_t h ) {
 			return 0;
 		}
 
-		remaining -= written;
-		buf += written;
+		remaining -= written;
+		buf += written;
+	}
+	if ( fsh[h].handleSync ) {
+		fflush( f );
+	}
+	return len;
+}
+
+void QDECL FS_Printf( fileHandle_t h, const char *fmt, ... ) {
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+
+	va_start (argptr,fmt);
+	Q_vsnprintf (msg, sizeof(msg), fmt, argptr);
+	va_end (argptr);
+
+	FS_Write(msg, strlen(msg), h);
+}
+
+#define PK3_SEEK_BUFFER_SIZE 65536
+
+/*
+=================
+FS_Seek
+
+=================
+*/
+int FS_Seek( fileHandle_t f, long offset, int origin ) {
+	int		_origin;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+		return -1;
+	}
+
+	if (fsh[f].streamed) {
+		fsh[f].streamed = qfalse;
+	 	FS_Seek( f, offset, origin );
+		fsh[f].streamed = qtrue;
+	}
+
+	if (fsh[f].zipFile == qtrue) {
+		//FIXME: this is incomplete and really, really
+		//crappy (but better than what was here before)
+		byte	buffer[PK3_SEEK_BUFFER_SIZE];
+		int		remainder = offset;
+
+		if( offset < 0 || origin == FS_SEEK_END ) {
+			Com_Error( ERR_FATAL, "Negative offsets and FS_SEEK_END not implemented "
+					"for FS_Seek on pk3 file contents\n" );
+			return -1;
+		}
+
+		switch( origin ) {
+			case FS_SEEK_SET:
+				unzSetCurrentFileInfoPosition(fsh[f].handleFiles.file.z, fsh[f].zipFilePos);
+				unzOpenCurrentFile(fsh[f].handleFiles.file.z);
+				//fallthrough
+
+			case FS_SEEK_CUR:
+				while( remainder > PK3_SEEK_BUFFER_SIZE ) {
+					FS_Read( buffer, PK3_SEEK_BUFFER_SIZE, f );
+					remainder -= PK3_SEEK_BUFFER_SIZE;
+				}
+				FS_Read( buffer, remainder, f );
+				return offset;
+				break;
+
+			default:
+				Com_Error( ERR_FATAL, "Bad origin in FS_Seek\n" );
+				return -1;
+				break;
+		}
+	} else {
+		FILE *file;
+		file = FS_FileForHandle(f);
+		switch( origin ) {
+		case FS_SEEK_CUR:
+			_origin = SEEK_CUR;
+			break;
+		case FS_SEEK_END:
+			_origin = SEEK_END;
+			break;
+		case FS_SEEK_SET:
+			_origin = SEEK_SET;
+			break;
+		default:
+			_origin = SEEK_CUR;
+			Com_Error( ERR_FATAL, "Bad origin in FS_Seek\n" );
+			break;
+		}
+
+		return fseek( file, offset, _origin );
+	}
+}
+
+
+/*
+======================================================================================
+
+BACKGROUND PREFETCH
+
+FS_PrefetchFile looks a file up on the main thread and queues it for the
+prefetch threads, which read and inflate it into malloc'd memory with
+stdio only, because the pk3 handles and the zone are not thread safe.
+The FS_ReadFile of it still opens the file as usual, so pure checks and
+pak references don't change, and takes the data instead of reading it
+when the file was found in the same place.
+
+======================================================================================
+*/
+
+#define	MAX_PREFETCH_FILES		1024
+#define	PREFETCH_HASH_SIZE		256
+#define	MAX_PREFETCH_THREADS	8
+
+typedef enum {
+	PF_FREE,
+	PF_QUEUED,
+	PF_READING,
+	PF_DONE,
+	PF_FAILED
+} prefetchState_t;
+
+typedef struct prefetchFile_s {
+	char			name[MAX_ZPATH];
+	struct prefetchFile_s	*next;		// next file in the hash
+	int				sequence;			// queue order
+
+	// where FS_FOpenFileRead should find it
+	fileInPack_t	*pakFile;			// NULL for a file in a directory
+
+	// what the prefetch thread reads
+	char			ospath[MAX_OSPATH];
+	unz_file_info	info;
+	const byte		*mapped;			// deflated data in a mapped pack
+	int				length;
+
+	// changed with fs_prefetchLock held
+	volatile prefetchState_t	state;
+	byte			*data;
+} prefetchFile_t;
+
+static prefetchFile_t	fs_prefetch[MAX_PREFETCH_FILES];
+static prefetchFile_t	*fs_prefetchHash[PREFETCH_HASH_SIZE];
+static int				fs_numPrefetch;			// files that are not PF_FREE
+static int				fs_prefetchBytes;
+static int				fs_prefetchSequence;
+static int				fs_prefetchHits;
+
+static int				fs_numPrefetchThreads;
+static void				*fs_prefetchLock;
+static void				*fs_prefetchWake;		// posted for every queued file
+static void				*fs_prefetchDone;		// posted for every finished file
+static void				*fs_prefetchExit;		// posted by each thread as it exits
+static volatile int		fs_prefetchStop;		// set by FS_StopPrefetchThreads
+
+/*
+=================
+FS_PrefetchThread
+=================
+*/
+static void FS_PrefetchThread( void *data ) {
+	prefetchFile_t	*pf, *next;
+	FILE			*f;
+	byte			*buf;
+	qboolean		ok;
+	int				i;
+
+	while ( 1 ) {
+		Sys_SemaphoreWait( fs_prefetchWake );
+		if ( fs_prefetchStop ) {
+			break;
+		}
+
+		// take the oldest queued file, there may be none left
+		// if the main thread got to it first
+		Sys_LockMutex( fs_prefetchLock );
+		next = NULL;
+		for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+			if ( pf->state == PF_QUEUED && ( !next || pf->sequence < next->sequence ) ) {
+				next = pf;
+			}
+		}
+		if ( next ) {
+			next->state = PF_READING;
+		}
+		Sys_UnlockMutex( fs_prefetchLock );
+
+		if ( !next ) {
+			continue;
+		}
+
+		ok = qfalse;
+		buf = malloc( next->length + 1 );
+		if ( buf ) {
+			if ( next->mapped ) {
+				ok = ( unzInflateBuffer( next->mapped, next->info.compressed_size, buf, next->length ) == UNZ_OK );
+			} else if ( next->pakFile ) {
+				ok = ( unzReadLocalFile( next->ospath, next->pakFile->localHeader, &next->info, buf ) == UNZ_OK );
+			} else {
+				f = fopen( next->ospath, "rb" );
+				if ( f ) {
+					ok = ( !next->length || fread( buf, next->length, 1, f ) == 1 );
+					fclose( f );
+				}
+			}
+			if ( !ok ) {
+				free( buf );
+				buf = NULL;
+			}
+		}
+
+		Sys_LockMutex( fs_prefetchLock );
+		next->data = buf;
+		next->state = ok ? PF_DONE : PF_FAILED;
+		Sys_UnlockMutex( fs_prefetchLock );
+
+		Sys_SemaphorePost( fs_prefetchDone );
+	}
+
+	Sys_SemaphorePost( fs_prefetchExit );
+}
+
+/*
+=================
+FS_StartPrefetchThreads
+
+Grows the prefetch threads to fs_prefetchThreads, returns how many there are
+=================
+*/
+static int FS_StartPrefetchThreads( void ) {
+	int		count;
+
+	count = fs_prefetchThreads->integer;
+	if ( count > MAX_PREFETCH_THREADS ) {
+		count = MAX_PREFETCH_THREADS;
+	}
+	if ( count <= 0 ) {
+		return 0;
+	}
+
+	if ( !fs_prefetchLock ) {
+		fs_prefetchLock = Sys_CreateMutex();
+		fs_prefetchWake = Sys_CreateSemaphore();
+		fs_prefetchDone = Sys_CreateSemaphore();
+		fs_prefetchExit = Sys_CreateSemaphore();
+		if ( !fs_prefetchLock || !fs_prefetchWake || !fs_prefetchDone || !fs_prefetchExit ) {
+			Sys_DestroyMutex( fs_prefetchLock );
+			Sys_DestroySemaphore( fs_prefetchWake );
+			Sys_DestroySemaphore( fs_prefetchDone );
+			Sys_DestroySemaphore( fs_prefetchExit );
+			fs_prefetchLock = fs_prefetchWake = fs_prefetchDone = fs_prefetchExit = NULL;
+			return 0;
+		}
+	}
+
+	while ( fs_numPrefetchThreads < count ) {
+		if ( !Sys_CreateThread( FS_PrefetchThread, NULL ) ) {
+			break;
+		}
+		fs_numPrefetchThreads++;
+	}
+
+	return fs_numPrefetchThreads;
+}
+
+/*
+=================
+FS_StopPrefetchThreads
+
+Waits for the prefetch threads to exit, nothing may be queued or
+being read.  FS_StartPrefetchThreads starts them again when needed.
+=================
+*/
+static void FS_StopPrefetchThreads( void ) {
+	int		i;
+
+	if ( !fs_prefetchLock ) {
+		return;
+	}
+
+	// every thread that is still running takes one of the posts
+	fs_prefetchStop = 1;
+	for ( i = 0 ; i < fs_numPrefetchThreads ; i++ ) {
+		Sys_SemaphorePost( fs_prefetchWake );
+	}
+	for ( i = 0 ; i < fs_numPrefetchThreads ; i++ ) {
+		Sys_SemaphoreWait( fs_prefetchExit );
+	}
+	fs_numPrefetchThreads = 0;
+	fs_prefetchStop = 0;
+
+	Sys_DestroyMutex( fs_prefetchLock );
+	Sys_DestroySemaphore( fs_prefetchWake );
+	Sys_DestroySemaphore( fs_prefetchDone );
+	Sys_DestroySemaphore( fs_prefetchExit );
+	fs_prefetchLock = fs_prefetchWake = fs_prefetchDone = fs_prefetchExit = NULL;
+}
+
+/*
+=================
+FS_FindPrefetch
+=================
+*/
+static prefetchFile_t *FS_FindPrefetch( const char *qpath ) {
+	prefetchFile_t	*pf;
+
+	if ( qpath[0] == '/' || qpath[0] == '\\' ) {
+		qpath++;
+	}
+
+	for ( pf = fs_prefetchHash[FS_HashFileName( qpath, PREFETCH_HASH_SIZE )] ; pf ; pf = pf->next ) {
+		if ( !FS_FilenameCompare( pf->name, qpath ) ) {
+			return pf;
+		}
+	}
+	return NULL;
+}
+
+/*
+=================
+FS_FinishPrefetch
+
+Cancels the file if no thread has started on it, or waits for the thread
+=================
+*/
+static void FS_FinishPrefetch( prefetchFile_t *pf ) {
+	Sys_LockMutex( fs_prefetchLock );
+	if ( pf->state == PF_QUEUED ) {
+		pf->state = PF_FAILED;
+	}
+	while ( pf->state == PF_READING ) {
+		Sys_UnlockMutex( fs_prefetchLock );
+		Sys_SemaphoreWaitTimeout( fs_prefetchDone, 10 );
+		Sys_LockMutex( fs_prefetchLock );
+	}
+	Sys_UnlockMutex( fs_prefetchLock );
+}
+
+/*
+=================
+FS_ReleasePrefetch
+
+The file must be finished
+=================
+*/
+static void FS_ReleasePrefetch( prefetchFile_t *pf ) {
+	prefetchFile_t	**prev;
+
+	for ( prev = &fs_prefetchHash[FS_HashFileName( pf->name, PREFETCH_HASH_SIZE )] ; *prev ; prev = &(*prev)->next ) {
+		if ( *prev == pf ) {
+			*prev = pf->next;
+			break;
+		}
+	}
+
+	free( pf->data );
+	pf->data = NULL;
+	pf->next = NULL;
+
+	fs_prefetchBytes -= pf->length;
+	fs_numPrefetch--;
+
+	Sys_LockMutex( fs_prefetchLock );
+	pf->state = PF_FREE;
+	Sys_UnlockMutex( fs_prefetchLock );
+}
+
+/*
+=================
+FS_ReadPrefetched
+
+Copies the prefetched data of the file just found in pakFile, or in a
+directory if that's NULL, into buf.  Returns qfalse if it has to be
+read normally.
+=================
+*/
+static qboolean FS_ReadPrefetched( const char *qpath, fileInPack_t *pakFile, byte *buf, int len ) {
+	prefetchFile_t	*pf;
+
+	if ( !fs_numPrefetch ) {
+		return qfalse;
 	}
-	if ( fsh[h].handleSync ) {
-		fflush( f );
+	pf = FS_FindPrefetch( qpath );
+	if ( !pf ) {
+		return qfalse;
 	}
-	return len;
-}
 
-void QDECL FS_Printf( fileHandle_t h, const char *fmt, ... ) {
-	va_list		argptr;
-	char		msg[MAXPRINTMSG];
+	FS_FinishPrefetch( pf );
 
-	va_start (argptr,fmt);
-	Q_vsnprintf (msg, sizeof(msg), fmt, argptr);
-	va_end (argptr);
+	// the search path or the pure list may have changed since
+	if ( pf->state == PF_DONE && pf->pakFile == pakFile && pf->length == len ) {
+		Com_Memcpy( buf, pf->data, len );
+		fs_prefetchHits++;
+		FS_ReleasePrefetch( pf );
+		return qtrue;
+	}
 
-	FS_Write(msg, strlen(msg), h);
+	FS_ReleasePrefetch( pf );
+	return qfalse;
 }
 
-#define PK3_SEEK_BUFFER_SIZE 65536
-
 /*
 =================
-FS_Seek
-
+FS_PrefetchFile
 =================
 */
-int FS_Seek( fileHandle_t f, long offset, int origin ) {
-	int		_origin;
+void FS_PrefetchFile( const char *qpath ) {
+	searchpath_t	*search;
+	pack_t			*pak;
+	fileInPack_t	*pakFile, *indexed;
+	prefetchFile_t	*pf;
+	char			*netpath;
+	FILE			*f;
+	long			hash;
+	int				i, length;
 
 	if ( !fs_searchpaths ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
-		return -1;
 	}
 
-	if (fsh[f].streamed) {
-		fsh[f].streamed = qfalse;
-	 	FS_Seek( f, offset, origin );
-		fsh[f].streamed = qtrue;
+	if ( !qpath || !qpath[0] ) {
+		return;
+	}
+	if ( qpath[0] == '/' || qpath[0] == '\\' ) {
+		qpath++;
+	}
+	if ( strstr( qpath, ".." ) || strstr( qpath, "::" ) || strlen( qpath ) >= MAX_ZPATH ) {
+		return;
 	}
 
-	if (fsh[f].zipFile == qtrue) {
-		//FIXME: this is incomplete and really, really
-		//crappy (but better than what was here before)
-		byte	buffer[PK3_SEEK_BUFFER_SIZE];
-		int		remainder = offset;
+	if ( fs_numPrefetch == MAX_PREFETCH_FILES || FS_FindPrefetch( qpath ) ) {
+		return;
+	}
+	if ( !FS_StartPrefetchThreads() ) {
+		return;
+	}
 
-		if( offset < 0 || origin == FS_SEEK_END ) {
-			Com_Error( ERR_FATAL, "Negative offsets and FS_SEEK_END not implemented "
-					"for FS_Seek on pk3 file contents\n" );
-			return -1;
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_FREE ) {
+			break;
 		}
+	}
 
-		switch( origin ) {
-			case FS_SEEK_SET:
-				unzSetCurrentFileInfoPosition(fsh[f].handleFiles.file.z, fsh[f].zipFilePos);
-				unzOpenCurrentFile(fsh[f].handleFiles.file.z);
-				//fallthrough
+	// find it the same way FS_FOpenFileRead will
+	indexed = FS_IndexedFile( qpath );
+	length = -1;
+	for ( search = fs_searchpaths ; search && length < 0 ; search = search->next ) {
+		if ( search->pack ) {
+			if ( !indexed || indexed->pack != search->pack ) {
+				continue;
+			}
+			pakFile = indexed;
+			indexed = indexed->next;
 
-			case FS_SEEK_CUR:
-				while( remainder > PK3_SEEK_BUFFER_SIZE ) {
-					FS_Read( buffer, PK3_SEEK_BUFFER_SIZE, f );
-					remainder -= PK3_SEEK_BUFFER_SIZE;
-				}
-				FS_Read( buffer, remainder, f );
-				return offset;
-				break;
+			pak = search->pack;
+			if ( !FS_PakIsPure( pak ) ) {
+				continue;
+			}
 
-			default:
-				Com_Error( ERR_FATAL, "Bad origin in FS_Seek\n" );
-				return -1;
-				break;
-		}
-	} else {
-		FILE *file;
-		file = FS_FileForHandle(f);
-		switch( origin ) {
-		case FS_SEEK_CUR:
-			_origin = SEEK_CUR;
-			break;
-		case FS_SEEK_END:
-			_origin = SEEK_END;
-			break;
-		case FS_SEEK_SET:
-			_origin = SEEK_SET;
-			break;
-		default:
-			_origin = SEEK_CUR;
-			Com_Error( ERR_FATAL, "Bad origin in FS_Seek\n" );
-			break;
+			// FS_ReadFile copies stored files straight from the mapping
+			pf->mapped = FS_PackFileData( pakFile );
+			if ( pf->mapped && pakFile->method == UNZ_STORED ) {
+				return;
+			}
+
+			pf->pakFile = pakFile;
+			pf->info.compression_method = pakFile->method;
+			pf->info.compressed_size = pakFile->compressedSize;
+			pf->info.uncompressed_size = pakFile->size;
+			Q_strncpyz( pf->ospath, pak->pakFilename, sizeof( pf->ospath ) );
+			length = pakFile->size;
+		} else if ( search->dir ) {
+			// only pak files are prefetched on pure servers
+			if ( fs_numServerPaks || !FS_DirMayHaveFile( search->dir, qpath ) ) {
+				continue;
+			}
+			netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, qpath );
+			f = fopen( netpath, "rb" );
+			fs_statOpens++;
+			if ( !f ) {
+				continue;
+			}
+			fseek( f, 0, SEEK_END );
+			length = ftell( f );
+			fclose( f );
+
+			pf->pakFile = NULL;
+			pf->mapped = NULL;
+			Q_strncpyz( pf->ospath, netpath, sizeof( pf->ospath ) );
 		}
+	}
 
-		return fseek( file, offset, _origin );
+	if ( length < 0 || fs_prefetchBytes + length > fs_prefetchMemory->integer * 1024 * 1024 ) {
+		return;
+	}
+
+	Q_strncpyz( pf->name, qpath, sizeof( pf->name ) );
+	pf->length = length;
+	pf->sequence = fs_prefetchSequence++;
+	pf->data = NULL;
+
+	hash = FS_HashFileName( qpath, PREFETCH_HASH_SIZE );
+	pf->next = fs_prefetchHash[hash];
+	fs_prefetchHash[hash] = pf;
+
+	fs_numPrefetch++;
+	fs_prefetchBytes += length;
+
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_PrefetchFile: %s (%i bytes from '%s')\n", qpath, length, pf->ospath );
 	}
+
+	Sys_LockMutex( fs_prefetchLock );
+	pf->state = PF_QUEUED;
+	Sys_UnlockMutex( fs_prefetchLock );
+
+	Sys_SemaphorePost( fs_prefetchWake );
 }
 
+/*
+=================
+FS_ClearPrefetch
+=================
+*/
+void FS_ClearPrefetch( void ) {
+	prefetchFile_t	*pf;
+	int				i, unused;
+
+	unused = 0;
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES && fs_numPrefetch ; i++, pf++ ) {
+		if ( pf->state == PF_FREE ) {
+			continue;
+		}
+		FS_FinishPrefetch( pf );
+		FS_ReleasePrefetch( pf );
+		unused++;
+	}
+
+	if ( fs_prefetchHits || unused ) {
+		Com_DPrintf( "%i prefetched files were read, %i were not\n", fs_prefetchHits, unused );
+	}
+	fs_prefetchHits = 0;
+}
 
 /*
 ======================================================================================
@@ -1393,10 +2415,7 @@ CONVENIENCE FUNCTIONS FOR ENTIRE FILES
 */
 
 int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
-	searchpath_t	*search;
-	pack_t			*pak;
 	fileInPack_t	*pakFile;
-	long			hash = 0;
 
 	if ( !fs_searchpaths ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
@@ -1418,40 +2437,77 @@ int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
 		return -1;
 	}
 
-	//
-	// search through the path, one element at a time
-	//
-
-	for ( search = fs_searchpaths ; search ; search = search->next ) {
-		//
-		if (search->pack) {
-			hash = FS_HashFileName(filename, search->pack->hashSize);
-		}
-		// is the element a pak file?
-		if ( search->pack && search->pack->hashTable[hash] ) {
-			// disregard if it doesn't match one of the allowed pure pak files
-			if ( !FS_PakIsPure(search->pack) ) {
-				continue;
+	// the packs that have the file, in search path order
+	for ( pakFile = FS_IndexedFile( filename ) ; pakFile ; pakFile = pakFile->next ) {
+		// disregard if it doesn't match one of the allowed pure pak files
+		if ( FS_PakIsPure( pakFile->pack ) ) {
+			if (pChecksum) {
+				*pChecksum = pakFile->pack->pure_checksum;
 			}
-
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do {
-				// case and separator insensitive comparisons
-				if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-					if (pChecksum) {
-						*pChecksum = pak->pure_checksum;
-					}
-					return 1;
-				}
-				pakFile = pakFile->next;
-			} while(pakFile != NULL);
+			return 1;
 		}
 	}
 	return -1;
 }
 
+/*
+============
+FS_FileOrigin
+
+Identifies the copy of a file that FS_ReadFile would load.  For a file
+in a pack the checksum is the pure checksum of the pack and the file
+isn't read, for a file in a directory it is a checksum of the contents.
+Returns the length of the file, or -1 if there is no such file.
+============
+*/
+int FS_FileOrigin( const char *qpath, int *checksum ) {
+	fileHandle_t	f;
+	fileInPack_t	*pakFile;
+	byte			*buf;
+	int				len;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	*checksum = 0;
+
+	len = FS_OpenFileRead( qpath, &f, qfalse, qtrue, &pakFile );
+	if ( len < 0 ) {
+		return -1;
+	}
+
+	if ( pakFile ) {
+		*checksum = pakFile->pack->pure_checksum;
+	} else {
+		buf = Hunk_AllocateTempMemory( len + 1 );
+		FS_Read( buf, len, f );
+		*checksum = Com_BlockChecksum( buf, len );
+		Hunk_FreeTempMemory( buf );
+	}
+
+	if ( f ) {
+		FS_FCloseFile( f );
+	}
+	return len;
+}
+
+/*
+============
+FS_ZeroCopyFile
+
+Stored files of these formats are returned by FS_ReadFile as pointers
+into the pack mapping, their loaders don't write to the buffer or need
+the trailing 0
+============
+*/
+static qboolean FS_ZeroCopyFile( const char *qpath ) {
+	const char	*ext;
+
+	ext = COM_GetExtension( qpath );
+	return !Q_stricmp( ext, "tga" ) || !Q_stricmp( ext, "jpg" ) || !Q_stricmp( ext, "bsp" );
+}
+
 /*
 ============
 FS_ReadFile
@@ -1462,6 +2518,8 @@ a null buffer will just return the file length without loading
 */
 int FS_ReadFile( const char *qpath, void **buffer ) {
 	fileHandle_t	h;
+	fileInPack_t	*pakFile;
+	const byte		*data;
 	byte*			buf;
 	qboolean		isConfig;
 	int				len;
@@ -1521,9 +2579,10 @@ int FS_ReadFile( const char *qpath, void **buffer ) {
 		isConfig = qfalse;
 	}
 
-	// look for it in the filesystem or pack files
-	len = FS_FOpenFileRead( qpath, &h, qfalse );
-	if ( h == 0 ) {
+	// look for it in the filesystem or pack files, files in mapped
+	// packs are read from the mapping without a handle
+	len = FS_OpenFileRead( qpath, &h, qfalse, !isConfig, &pakFile );
+	if ( h == 0 && !pakFile ) {
 		if ( buffer ) {
 			*buffer = NULL;
 		}
@@ -1543,21 +2602,60 @@ int FS_ReadFile( const char *qpath, void **buffer ) {
 			FS_Write( &len, sizeof( len ), com_journalDataFile );
 			FS_Flush( com_journalDataFile );
 		}
-		FS_FCloseFile( h);
+		if ( h ) {
+			FS_FCloseFile( h );
+		}
 		return len;
 	}
 
 	fs_loadCount++;
 	fs_loadStack++;
 
+	data = NULL;
+	if ( !h ) {
+		data = FS_PackFileData( pakFile );
+
+		if ( data && pakFile->method == UNZ_STORED && FS_ZeroCopyFile( qpath )
+			&& fs_numMappedBuffers < MAX_MAPPED_BUFFERS ) {
+			fs_mappedBuffers[fs_numMappedBuffers++] = data;
+			fs_readCount += len;
+			*buffer = (void *)data;
+			return len;
+		}
+	}
+
 	buf = Hunk_AllocateTempMemory(len+1);
 	*buffer = buf;
 
-	FS_Read (buf, len, h);
+	if ( FS_ReadPrefetched( qpath, pakFile, buf, len ) ) {
+		// a prefetch thread read it
+	} else if ( h ) {
+		FS_Read (buf, len, h);
+	} else if ( data && pakFile->method == UNZ_STORED ) {
+		Com_Memcpy( buf, data, len );
+		fs_readCount += len;
+	} else if ( data && unzInflateBuffer( data, pakFile->compressedSize, buf, len ) == UNZ_OK ) {
+		fs_readCount += len;
+	} else {
+		// damaged zip entry, let unzip deal with it through a real
+		// handle, and don't hand out the buffer if it can't read it either
+		FS_OpenFileRead( qpath, &h, qfalse, qfalse, &pakFile );
+		if ( !h || FS_Read( buf, len, h ) != len ) {
+			if ( h ) {
+				FS_FCloseFile( h );
+			}
+			Hunk_FreeTempMemory( buf );
+			*buffer = NULL;
+			fs_loadStack--;
+			Com_Error( ERR_DROP, "FS_ReadFile: couldn't read %s, the pk3 entry is damaged", qpath );
+		}
+	}
 
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
-	FS_FCloseFile( h );
+	if ( h ) {
+		FS_FCloseFile( h );
+	}
 
 	// if we are journalling and it is a config file, write it to the journal file
 	if ( isConfig && com_journal && com_journal->integer == 1 ) {
@@ -1575,6 +2673,8 @@ FS_FreeFile
 =============
 */
 void FS_FreeFile( void *buffer ) {
+	int		i;
+
 	if ( !fs_searchpaths ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
 	}
@@ -1583,7 +2683,17 @@ void FS_FreeFile( void *buffer ) {
 	}
 	fs_loadStack--;
 
-	Hunk_FreeTempMemory( buffer );
+	for ( i = 0 ; i < fs_numMappedBuffers ; i++ ) {
+		if ( fs_mappedBuffers[i] == buffer ) {
+			break;
+		}
+	}
+	if ( i < fs_numMappedBuffers ) {
+		// points into a pack mapping
+		fs_mappedBuffers[i] = fs_mappedBuffers[--fs_numMappedBuffers];
+	} else {
+		Hunk_FreeTempMemory( buffer );
+	}
 
 	// if all of our temp files are free, clear all of our space
 	if ( fs_loadStack == 0 ) {
@@ -1648,7 +2758,6 @@ static pack_t *FS_LoadZipFile( char *zipfile, const char *basename )
 	char			filename_inzip[MAX_ZPATH];
 	unz_file_info	file_info;
 	int				i, len;
-	long			hash;
 	int				fs_numHeaderLongs;
 	int				*fs_headerLongs;
 	char			*namePtr;
@@ -1680,20 +2789,7 @@ static pack_t *FS_LoadZipFile( char *zipfile, const char *basename )
 	fs_headerLongs = Z_Malloc( ( gi.number_entry + 1 ) * sizeof(int) );
 	fs_headerLongs[ fs_numHeaderLongs++ ] = LittleLong( fs_checksumFeed );
 
-	// get the hash table size from the number of files in the zip
-	// because lots of custom pk3 files have less than 32 or 64 files
-	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > gi.number_entry) {
-			break;
-		}
-	}
-
-	pack = Z_Malloc( sizeof( pack_t ) + i * sizeof(fileInPack_t *) );
-	pack->hashSize = i;
-	pack->hashTable = (fileInPack_t **) (((char *) pack) + sizeof( pack_t ));
-	for(i = 0; i < pack->hashSize; i++) {
-		pack->hashTable[i] = NULL;
-	}
+	pack = Z_Malloc( sizeof( pack_t ) );
 
 	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
 	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
@@ -1717,17 +2813,25 @@ static pack_t *FS_LoadZipFile( char *zipfile, const char *basename )
 			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
 		}
 		Q_strlwr( filename_inzip );
-		hash = FS_HashFileName(filename_inzip, pack->hashSize);
 		buildBuffer[i].name = namePtr;
 		strcpy( buildBuffer[i].name, filename_inzip );
 		namePtr += strlen(filename_inzip) + 1;
 		// store the file position in the zip
 		unzGetCurrentFileInfoPosition(uf, &buildBuffer[i].pos);
-		//
-		buildBuffer[i].next = pack->hashTable[hash];
-		pack->hashTable[hash] = &buildBuffer[i];
+		// and what FS_ReadFile needs to read it from the mapping
+		unzGetCurrentFileLocation(uf, &buildBuffer[i].localHeader);
+		buildBuffer[i].compressedSize = file_info.compressed_size;
+		buildBuffer[i].size = file_info.uncompressed_size;
+		buildBuffer[i].method = file_info.compression_method;
+		buildBuffer[i].pack = pack;
 		unzGoToNextFile(uf);
 	}
+	// FS_BuildFileIndex only sees the files that could be read
+	pack->numfiles = i;
+
+	if ( fs_mapPaks->integer ) {
+		pack->mapping = Sys_MapFile( zipfile, &pack->mappingLength );
+	}
 
 	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], 4 * ( fs_numHeaderLongs - 1 ) );
 	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, 4 * fs_numHeaderLongs );
@@ -1748,8 +2852,6 @@ DIRECTORY SCANNING FUNCTIONS
 =================================================================================
 */
 
-#define	MAX_FOUND_FILES	0x1000
-
 static int FS_ReturnPath( const char *zname, char *zpath, int *depth ) {
 	int len, at, newdep;
 
@@ -1795,6 +2897,75 @@ static int FS_AddFileToList( char *name, char *list[MAX_FOUND_FILES], int nfiles
 	return nfiles;
 }
 
+/*
+===============
+FS_ListDirSnapshot
+
+Adds what Sys_ListFiles would find in path to list, returns qfalse if
+path isn't plain enough to look it up
+===============
+*/
+static qboolean FS_ListDirSnapshot( directory_t *dir, const char *path, const char *extension,
+								   char **list, int *nfiles ) {
+	char		dirname[MAX_ZPATH];
+	dirFile_t	*file, *parent;
+	const char	*name;
+	qboolean	dironly;
+	int			i, length, extensionLength;
+
+	while ( *path == '/' || *path == '\\' ) {
+		path++;
+	}
+	Q_strncpyz( dirname, path, sizeof( dirname ) );
+	length = strlen( dirname );
+	while ( length && ( dirname[length-1] == '/' || dirname[length-1] == '\\' ) ) {
+		dirname[--length] = 0;
+	}
+	for ( i = 0 ; i < length ; i++ ) {
+		if ( dirname[i] == '\\' ) {
+			dirname[i] = '/';
+		}
+		if ( ( dirname[i] == '/' && dirname[i+1] == '/' )
+			|| ( dirname[i] == '.' && ( i == 0 || dirname[i-1] == '/' ) ) ) {
+			return qfalse;
+		}
+	}
+
+	// Sys_ListFiles finds nothing in a directory that doesn't exist
+	if ( length ) {
+		parent = FS_FindDirFile( dir, dirname );
+		if ( !parent || !parent->isDir ) {
+			return qtrue;
+		}
+	} else if ( !dir->numFiles ) {
+		return qtrue;
+	}
+
+	dironly = !strcmp( extension, "/" );
+	if ( dironly ) {
+		extension = "";
+		*nfiles = FS_AddFileToList( ".", list, *nfiles );
+		*nfiles = FS_AddFileToList( "..", list, *nfiles );
+	}
+	extensionLength = strlen( extension );
+
+	for ( i = 0 ; i < DIR_HASH_SIZE ; i++ ) {
+		for ( file = dir->files[i] ; file ; file = file->next ) {
+			if ( file->isDir != dironly || file->pathLength != length
+				|| Q_stricmpn( file->name, dirname, length ) ) {
+				continue;
+			}
+			name = file->name + length + ( length ? 1 : 0 );
+			if ( strlen( name ) < extensionLength
+				|| Q_stricmp( name + strlen( name ) - extensionLength, extension ) ) {
+				continue;
+			}
+			*nfiles = FS_AddFileToList( (char *)name, list, *nfiles );
+		}
+	}
+	return qtrue;
+}
+
 /*
 ===============
 FS_ListFilteredFiles
@@ -1901,9 +3072,11 @@ char **FS_ListFilteredFiles( const char *path, const char *extension, char *filt
 			// don't scan directories for files if we are pure or restricted
 			if ( fs_numServerPaks ) {
 		        continue;
-		    } else {
+		    } else if ( filter || !search->dir->files
+				|| !FS_ListDirSnapshot( search->dir, path, extension, list, &nfiles ) ) {
 				netpath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, path );
 				sysFiles = Sys_ListFiles( netpath, extension, filter, &numSysFiles, qfalse );
+				fs_statListings++;
 				for ( i = 0 ; i < numSysFiles ; i++ ) {
 					// unique the match
 					name = sysFiles[i];
@@ -2327,6 +3500,33 @@ void FS_NewDir_f( void ) {
 	FS_FreeFileList( dirnames );
 }
 
+/*
+============
+FS_Stats_f
+
+How much the directory snapshots and the missing file cache save
+============
+*/
+static void FS_Stats_f( void ) {
+	searchpath_t	*s;
+
+	Com_Printf( "%i lookups, %i missing file cache hits, %i misses, %i files cached as missing\n",
+		fs_statLookups, fs_statMissingHits, fs_statLookups - fs_statMissingHits, fs_numMissingFiles );
+	Com_Printf( "%i directory checks skipped, %i fopen calls, %i directory listings\n",
+		fs_statDirSkips, fs_statOpens, fs_statListings );
+
+	for ( s = fs_searchpaths ; s ; s = s->next ) {
+		if ( !s->dir ) {
+			continue;
+		}
+		if ( s->dir->files ) {
+			Com_Printf( "%s/%s: %i files cached\n", s->dir->path, s->dir->gamedir, s->dir->numFiles );
+		} else {
+			Com_Printf( "%s/%s: not cached\n", s->dir->path, s->dir->gamedir );
+		}
+	}
+}
+
 /*
 ============
 FS_Path_f
@@ -2348,6 +3548,8 @@ void FS_Path_f( void ) {
 					Com_Printf( "    on the pure list\n" );
 				}
 			}
+		} else if ( s->dir->files ) {
+			Com_Printf ("%s/%s (%i files cached)\n", s->dir->path, s->dir->gamedir, s->dir->numFiles );
 		} else {
 			Com_Printf ("%s/%s\n", s->dir->path, s->dir->gamedir );
 		}
@@ -2430,6 +3632,10 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 	search->next = fs_searchpaths;
 	fs_searchpaths = search;
 
+	if ( fs_dirCache->integer ) {
+		FS_SnapshotDirectory( search->dir );
+	}
+
 	// find all pak files in this directory
 	pakfile = FS_BuildOSPath( path, dir, "" );
 	pakfile[ strlen(pakfile) - 1 ] = 0;	// strip the trailing slash
@@ -2626,6 +3832,10 @@ void FS_Shutdown( qboolean closemfp ) {
 	searchpath_t	*p, *next;
 	int	i;
 
+	// the prefetched files point into the packs
+	FS_ClearPrefetch();
+	FS_StopPrefetchThreads();
+
 	for(i = 0; i < MAX_FILE_HANDLES; i++) {
 		if (fsh[i].fileSize) {
 			FS_FCloseFile(i);
@@ -2638,10 +3848,14 @@ void FS_Shutdown( qboolean closemfp ) {
 
 		if ( p->pack ) {
 			unzClose(p->pack->handle);
+			if ( p->pack->mapping ) {
+				Sys_UnmapFile( p->pack->mapping, p->pack->mappingLength );
+			}
 			Z_Free( p->pack->buildBuffer );
 			Z_Free( p->pack );
 		}
 		if ( p->dir ) {
+			FS_FreeDirSnapshot( p->dir );
 			Z_Free( p->dir );
 		}
 		Z_Free( p );
@@ -2650,10 +3864,18 @@ void FS_Shutdown( qboolean closemfp ) {
 	// any FS_ calls will now be an error until reinitialized
 	fs_searchpaths = NULL;
 
+	if ( fs_fileIndex ) {
+		Z_Free( fs_fileIndex );
+		fs_fileIndex = NULL;
+	}
+	fs_numMappedBuffers = 0;
+	FS_ClearMissingFiles();
+
 	Cmd_RemoveCommand( "path" );
 	Cmd_RemoveCommand( "dir" );
 	Cmd_RemoveCommand( "fdir" );
 	Cmd_RemoveCommand( "touchFile" );
+	Cmd_RemoveCommand( "fs_stats" );
 
 #ifdef FS_MISSING
 	if (closemfp) {
@@ -2719,6 +3941,11 @@ static void FS_Startup( const char *gameName )
 	Com_Printf( "----- FS_Startup -----\n" );
 
 	fs_debug = Cvar_Get( "fs_debug", "0", 0 );
+	fs_prefetchThreads = Cvar_Get( "fs_prefetchThreads", "2", CVAR_ARCHIVE );
+	fs_prefetchMemory = Cvar_Get( "fs_prefetchMemory", "64", CVAR_ARCHIVE );	// megabytes
+	// paks can use up a 32 bit address space
+	fs_mapPaks = Cvar_Get( "fs_mapPaks", sizeof( void * ) > 4 ? "1" : "0", CVAR_ARCHIVE | CVAR_LATCH );
+	fs_dirCache = Cvar_Get( "fs_dirCache", "1", CVAR_ARCHIVE | CVAR_LATCH );
 	fs_basepath = Cvar_Get ("fs_basepath", Sys_DefaultInstallPath(), CVAR_INIT );
 	fs_basegame = Cvar_Get ("fs_basegame", "", CVAR_INIT );
 	homePath = Sys_DefaultHomePath();
@@ -2784,11 +4011,14 @@ static void FS_Startup( const char *gameName )
 	Cmd_AddCommand ("dir", FS_Dir_f );
 	Cmd_AddCommand ("fdir", FS_NewDir_f );
 	Cmd_AddCommand ("touchFile", FS_TouchFile_f );
+	Cmd_AddCommand ("fs_stats", FS_Stats_f );
 
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=506
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
 
+	FS_BuildFileIndex();
+
 	// print the current search paths
 	FS_Path_f();
 
@@ -3172,6 +4402,9 @@ void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames ) {
 		fs_serverPaks[i] = atoi( Cmd_Argv( i ) );
 	}
 
+	// what can be found depends on the pure list
+	FS_ClearMissingFiles();
+
 	if (fs_numServerPaks) {
 		Com_DPrintf( "Connected to a pure server.\n" );
 	}
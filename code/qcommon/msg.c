@@ -23,6 +23,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qcommon.h"
 
 static huffman_t		msgHuff;
+static huffTables_t		msgHuffTables;
+static qboolean			msgHuffUseTables;	// the tree is only walked for very long codes
 
 static qboolean			msgInit = qfalse;
 
@@ -37,8 +39,6 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
-int oldsize = 0;
-
 void MSG_initHuffman( void );
 
 void MSG_Init( msg_t *buf, byte *data, int length ) {
@@ -101,15 +101,173 @@ bit functions
 =============================================================================
 */
 
-int	overflows;
-
 // negative bit values include signs
+/*
+=================
+MSG_PutBits
+
+Appends up to 32 bits, first bit lowest, exactly like that many
+Huff_putBit calls would
+=================
+*/
+static void MSG_PutBits( byte *data, int *offset, unsigned int value, int count ) {
+	int		b, n;
+
+	b = *offset;
+	while ( count > 0 ) {
+		n = 8 - ( b & 7 );
+		if ( n > count ) {
+			n = count;
+		}
+		if ( ( b & 7 ) == 0 ) {
+			data[b >> 3] = 0;
+		}
+		data[b >> 3] |= ( value & ( ( 1 << n ) - 1 ) ) << ( b & 7 );
+		value >>= n;
+		count -= n;
+		b += n;
+	}
+	*offset = b;
+}
+
+/*
+=================
+MSG_PeekBits
+
+The next 57 to 64 bits of the message, first bit lowest.  Bytes past
+the end of the buffer read as zero.
+=================
+*/
+static uint64_t MSG_PeekBits( const msg_t *msg, int offset ) {
+	const byte	*p;
+	uint64_t	bits;
+	int			i, count;
+
+	p = msg->data + ( offset >> 3 );
+	count = msg->maxsize - ( offset >> 3 );
+
+	if ( count >= 8 ) {
+		bits = (uint64_t)p[0] | ( (uint64_t)p[1] << 8 ) | ( (uint64_t)p[2] << 16 ) | ( (uint64_t)p[3] << 24 )
+			| ( (uint64_t)p[4] << 32 ) | ( (uint64_t)p[5] << 40 ) | ( (uint64_t)p[6] << 48 ) | ( (uint64_t)p[7] << 56 );
+	} else {
+		bits = 0;
+		for ( i = 0 ; i < count ; i++ ) {
+			bits |= (uint64_t)p[i] << ( i * 8 );
+		}
+	}
+
+	return bits >> ( offset & 7 );
+}
+
+/*
+=================
+MSG_WriteHuffBits
+
+The huffman part of MSG_WriteBits, using the code tables and collecting
+the bits in an accumulator instead of sending them one at a time
+=================
+*/
+static void MSG_WriteHuffBits( msg_t *msg, unsigned int value, int bits ) {
+	uint64_t	acc;
+	int			accBits;
+	int			i, nbits, symbol, length;
+
+	acc = 0;
+	accBits = 0;
+
+	nbits = bits & 7;
+	if ( nbits ) {
+		acc = value & ( ( 1 << nbits ) - 1 );
+		accBits = nbits;
+		value >>= nbits;
+		bits -= nbits;
+	}
+
+	for ( i = 0 ; i < bits ; i += 8, value >>= 8 ) {
+		symbol = value & 0xff;
+		length = msgHuffTables.length[symbol];
+		if ( !length ) {
+			// too long for the table, flush and walk the tree
+			while ( accBits > 0 ) {
+				MSG_PutBits( msg->data, &msg->bit, (unsigned int)acc, accBits > 32 ? 32 : accBits );
+				acc >>= 32;
+				accBits -= 32;
+			}
+			acc = 0;
+			accBits = 0;
+			Huff_offsetTransmit( &msgHuff.compressor, symbol, msg->data, &msg->bit );
+			continue;
+		}
+
+		acc |= (uint64_t)msgHuffTables.code[symbol] << accBits;
+		accBits += length;
+		if ( accBits >= 32 ) {
+			MSG_PutBits( msg->data, &msg->bit, (unsigned int)acc, 32 );
+			acc >>= 32;
+			accBits -= 32;
+		}
+	}
+
+	if ( accBits > 0 ) {
+		MSG_PutBits( msg->data, &msg->bit, (unsigned int)acc, accBits );
+	}
+}
+
+/*
+=================
+MSG_ReadHuffBits
+
+The huffman part of MSG_ReadBits, resolving HUFF_LOOKUP_BITS bits per
+table lookup
+=================
+*/
+static int MSG_ReadHuffBits( msg_t *msg, int nbits, int bits ) {
+	uint64_t	acc;
+	int			avail, b;
+	int			i, value, get, length, index;
+
+	b = msg->bit;
+	acc = MSG_PeekBits( msg, b );
+	avail = 64 - ( b & 7 );
+
+	value = 0;
+	if ( nbits ) {
+		value = (int)acc & ( ( 1 << nbits ) - 1 );
+		acc >>= nbits;
+		avail -= nbits;
+		b += nbits;
+	}
+
+	for ( i = 0 ; i < bits ; i += 8 ) {
+		if ( avail < HUFF_LOOKUP_BITS ) {
+			acc = MSG_PeekBits( msg, b );
+			avail = 64 - ( b & 7 );
+		}
+
+		index = (int)acc & ( ( 1 << HUFF_LOOKUP_BITS ) - 1 );
+		length = msgHuffTables.symbolLength[index];
+		if ( length ) {
+			get = msgHuffTables.symbol[index];
+			acc >>= length;
+			avail -= length;
+			b += length;
+		} else {
+			// too long for the table, walk the tree
+			Huff_offsetReceive( msgHuff.decompressor.tree, &get, msg->data, &b );
+			avail = 0;
+		}
+
+		value |= ( get << ( i + nbits ) );
+	}
+
+	msg->bit = b;
+	return value;
+}
+
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	int	i;
 //	FILE*	fp;
 
-	oldsize += bits;
-
 	// this isn't an exact overflow check, but close enough
 	if ( msg->maxsize - msg->cursize < 4 ) {
 		msg->overflowed = qtrue;
@@ -120,22 +278,6 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		Com_Error( ERR_DROP, "MSG_WriteBits: bad bits %i", bits );
 	}
 
-	// check for overflows
-	if ( bits != 32 ) {
-		if ( bits > 0 ) {
-			if ( value > ( ( 1 << bits ) - 1 ) || value < 0 ) {
-				overflows++;
-			}
-		} else {
-			int	r;
-
-			r = 1 << (bits-1);
-
-			if ( value >  r - 1 || value < -r ) {
-				overflows++;
-			}
-		}
-	}
 	if ( bits < 0 ) {
 		bits = -bits;
 	}
@@ -160,6 +302,11 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	} else {
 //		fp = fopen("c:\\netchan.bin", "a");
 		value &= (0xffffffff>>(32-bits));
+		if ( msgHuffUseTables ) {
+			MSG_WriteHuffBits( msg, value, bits );
+			msg->cursize = (msg->bit>>3)+1;
+			return;
+		}
 		if (bits&7) {
 			int nbits;
 			nbits = bits&7;
@@ -215,6 +362,11 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		} else {
 			Com_Error(ERR_DROP, "can't read %d bits\n", bits);
 		}
+	} else if ( msgHuffUseTables ) {
+		nbits = bits&7;
+		value = MSG_ReadHuffBits( msg, nbits, bits - nbits );
+		bits = bits - nbits;
+		msg->readcount = (msg->bit>>3)+1;
 	} else {
 		nbits = 0;
 		if (bits&7) {
@@ -252,6 +404,51 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 // writing functions
 //
 
+/*
+=================
+MSG_CopyBits
+
+Appends bits that MSG_WriteBits stored at the start of another message.
+The huffman codes do not depend on the bit position, so the result is
+the same as repeating the writes.
+=================
+*/
+void MSG_CopyBits( msg_t *msg, const byte *data, int bits ) {
+	unsigned int	value;
+	int				i, n;
+
+	if ( msg->oob ) {
+		Com_Error( ERR_DROP, "MSG_CopyBits: oob message" );
+	}
+	if ( bits <= 0 ) {
+		return;
+	}
+	if ( msg->maxsize - msg->cursize < 4 + ( ( bits + 7 ) >> 3 ) ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	for ( i = 0 ; i < bits ; i += 32, data += 4 ) {
+		n = bits - i;
+		if ( n > 32 ) {
+			n = 32;
+		}
+		value = data[0];
+		if ( n > 8 ) {
+			value |= data[1] << 8;
+		}
+		if ( n > 16 ) {
+			value |= data[2] << 16;
+		}
+		if ( n > 24 ) {
+			value |= (unsigned int)data[3] << 24;
+		}
+		MSG_PutBits( msg->data, &msg->bit, value, n );
+	}
+
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
 void MSG_WriteChar( msg_t *sb, int c ) {
 #ifdef PARANOID
 	if (c < -128 || c > 127)
@@ -710,7 +907,6 @@ void MSG_WriteDeltaUsercmdKey( msg_t *msg, int key, usercmd_t *from, usercmd_t *
 		from->buttons == to->buttons &&
 		from->weapon == to->weapon) {
 			MSG_WriteBits( msg, 0, 1 );				// no change
-			oldsize += 7;
 			return;
 	}
 	key ^= to->serverTime;
@@ -923,8 +1119,6 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
-	oldsize += numFields;
-
 	for ( i = 0, field = entityStateFields ; i < lc ; i++, field++ ) {
 		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
@@ -943,7 +1137,6 @@ void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entity
 
 			if (fullFloat == 0.0f) {
 					MSG_WriteBits( msg, 0, 1 );
-					oldsize += FLOAT_INT_BITS;
 			} else {
 				MSG_WriteBits( msg, 1, 1 );
 				if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && 
@@ -1199,8 +1392,6 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
-	oldsize += numFields - lc;
-
 	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
 		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
@@ -1266,7 +1457,6 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 
 	if (!statsbits && !persistantbits && !ammobits && !powerupbits) {
 		MSG_WriteBits( msg, 0, 1 );	// no change
-		oldsize += 4;
 		return;
 	}
 	MSG_WriteBits( msg, 1, 1 );	// changed
@@ -1726,6 +1916,341 @@ void MSG_initHuffman( void ) {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+
+	Huff_BuildTables( &msgHuff.compressor, &msgHuffTables );
+	msgHuffUseTables = qtrue;
+}
+
+/*
+==============================================================================
+
+			HUFFMAN BENCHMARK
+
+huffbench [demo] [passes] times the tree walking and the table driven
+paths of MSG_WriteBits and MSG_ReadBits against each other, after
+checking that they produce exactly the same bits.  The fields are the
+bytes of every message in the demo, or without a demo random fields of
+the usual snapshot sizes, with bytes drawn from msg_hData.
+
+==============================================================================
+*/
+
+#define	HUFFBENCH_MAX_FIELDS	0x100000
+#define	HUFFBENCH_MESSAGE		256		// fields per message without a demo
+
+typedef struct {
+	int			value;
+	int			bits;
+} huffBenchField_t;
+
+typedef struct {
+	huffBenchField_t	*fields;
+	int					numFields;
+	int					*messages;		// first field of each message
+	int					numMessages;
+} huffBench_t;
+
+/*
+=================
+MSG_HuffBenchLoadDemo
+
+Returns the number of messages read
+=================
+*/
+static int MSG_HuffBenchLoadDemo( huffBench_t *bench, const char *name ) {
+	char			path[MAX_QPATH];
+	fileHandle_t	f;
+	byte			data[MAX_MSGLEN];
+	msg_t			msg;
+	int				sequence, length;
+
+	if ( strchr( name, '.' ) ) {
+		Com_sprintf( path, sizeof( path ), "demos/%s", name );
+	} else {
+		Com_sprintf( path, sizeof( path ), "demos/%s.dm_%d", name, PROTOCOL_VERSION );
+	}
+	FS_FOpenFileRead( path, &f, qtrue );
+	if ( !f ) {
+		Com_Printf( "Couldn't open %s\n", path );
+		return 0;
+	}
+
+	while ( bench->numMessages < HUFFBENCH_MAX_FIELDS / 8 ) {
+		if ( FS_Read( &sequence, 4, f ) != 4 || FS_Read( &length, 4, f ) != 4 ) {
+			break;
+		}
+		length = LittleLong( length );
+		if ( length <= 0 || length > sizeof( data ) || FS_Read( data, length, f ) != length ) {
+			break;
+		}
+
+		// the message is a bit stream, turn it back into the bytes
+		// that were sent through the tree
+		bench->messages[bench->numMessages++] = bench->numFields;
+		MSG_Init( &msg, data, sizeof( data ) );
+		msg.cursize = length;
+		while ( ( msg.bit >> 3 ) < length && bench->numFields < HUFFBENCH_MAX_FIELDS ) {
+			bench->fields[bench->numFields].value = MSG_ReadBits( &msg, 8 );
+			bench->fields[bench->numFields].bits = 8;
+			bench->numFields++;
+		}
+	}
+
+	FS_FCloseFile( f );
+	return bench->numMessages;
+}
+
+/*
+=================
+MSG_HuffBenchRandom
+=================
+*/
+static void MSG_HuffBenchRandom( huffBench_t *bench ) {
+	static const int	sizes[] = { 1, 4, 7, 8, 8, 8, 10, 13, 16, 19, 32 };
+	int					total, i, j, r, bits, value;
+	int					numSizes = sizeof( sizes ) / sizeof( sizes[0] );
+	int					seed;
+
+	total = 0;
+	for ( i = 0 ; i < 256 ; i++ ) {
+		total += msg_hData[i];
+	}
+
+	seed = 0x1234;
+	while ( bench->numFields < HUFFBENCH_MAX_FIELDS / 4 ) {
+		if ( bench->numFields % HUFFBENCH_MESSAGE == 0 ) {
+			bench->messages[bench->numMessages++] = bench->numFields;
+		}
+
+		bits = sizes[(int)( Q_random( &seed ) * numSizes ) % numSizes];
+		value = 0;
+		for ( i = 0 ; i < bits ; i += 8 ) {
+			r = (int)( Q_random( &seed ) * total );
+			for ( j = 0 ; j < 255 && r >= msg_hData[j] ; j++ ) {
+				r -= msg_hData[j];
+			}
+			value |= j << i;
+		}
+		if ( bits < 32 ) {
+			value &= ( 1 << bits ) - 1;
+		}
+
+		bench->fields[bench->numFields].value = value;
+		bench->fields[bench->numFields].bits = bits;
+		bench->numFields++;
+	}
+}
+
+/*
+=================
+MSG_HuffBenchEncode
+=================
+*/
+static void MSG_HuffBenchEncode( const huffBench_t *bench, int message, msg_t *msg ) {
+	const huffBenchField_t	*field, *end;
+
+	field = bench->fields + bench->messages[message];
+	if ( message + 1 < bench->numMessages ) {
+		end = bench->fields + bench->messages[message + 1];
+	} else {
+		end = bench->fields + bench->numFields;
+	}
+
+	MSG_Clear( msg );
+	for ( ; field < end ; field++ ) {
+		MSG_WriteBits( msg, field->value, field->bits );
+	}
+}
+
+/*
+=================
+MSG_HuffBenchDecode
+
+Returns a checksum of the values read
+=================
+*/
+static int MSG_HuffBenchDecode( const huffBench_t *bench, int message, msg_t *msg, int *values ) {
+	const huffBenchField_t	*field, *end;
+	int						sum, value;
+
+	field = bench->fields + bench->messages[message];
+	if ( message + 1 < bench->numMessages ) {
+		end = bench->fields + bench->messages[message + 1];
+	} else {
+		end = bench->fields + bench->numFields;
+	}
+
+	msg->bit = 0;
+	msg->readcount = 0;
+	sum = 0;
+	for ( ; field < end ; field++ ) {
+		value = MSG_ReadBits( msg, field->bits );
+		if ( values ) {
+			*values++ = value;
+		}
+		sum = sum * 31 + value;
+	}
+
+	return sum;
+}
+
+/*
+=================
+MSG_HuffBenchFree
+=================
+*/
+static void MSG_HuffBenchFree( huffBench_t *bench, byte **data, int **values ) {
+	int		i;
+
+	for ( i = 0 ; i < 2 ; i++ ) {
+		free( data[i] );
+		free( values[i] );
+	}
+	free( bench->fields );
+	free( bench->messages );
+}
+
+/*
+=================
+MSG_HuffBench_f
+
+The buffers come from malloc, they are too big to take out of the
+zone on a running server
+=================
+*/
+void MSG_HuffBench_f( void ) {
+	huffBench_t	bench;
+	byte		*data[2];
+	int			*values[2];
+	msg_t		msg[2];
+	int			passes, pass, i, j, start;
+	int			encodeMsec[2], decodeMsec[2];
+	int			bytes;
+	byte		*stream;
+	int			*streamOfs;
+	qboolean	useTables;
+
+	if ( !msgInit ) {
+		MSG_initHuffman();
+	}
+
+	Com_Memset( &bench, 0, sizeof( bench ) );
+	Com_Memset( data, 0, sizeof( data ) );
+	Com_Memset( values, 0, sizeof( values ) );
+	bench.fields = malloc( HUFFBENCH_MAX_FIELDS * sizeof( *bench.fields ) );
+	bench.messages = malloc( HUFFBENCH_MAX_FIELDS / 8 * sizeof( *bench.messages ) );
+	if ( !bench.fields || !bench.messages ) {
+		Com_Printf( "huffbench: out of memory\n" );
+		MSG_HuffBenchFree( &bench, data, values );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 && Q_stricmp( Cmd_Argv( 1 ), "random" ) ) {
+		if ( !MSG_HuffBenchLoadDemo( &bench, Cmd_Argv( 1 ) ) ) {
+			MSG_HuffBenchFree( &bench, data, values );
+			return;
+		}
+	} else {
+		MSG_HuffBenchRandom( &bench );
+	}
+
+	passes = 10;
+	if ( Cmd_Argc() > 2 ) {
+		passes = atoi( Cmd_Argv( 2 ) );
+		if ( passes < 1 ) {
+			passes = 1;
+		}
+	}
+
+	useTables = msgHuffUseTables;
+	for ( i = 0 ; i < 2 ; i++ ) {
+		// no message has more fields than were generated
+		data[i] = malloc( MAX_MSGLEN * 2 );
+		values[i] = malloc( ( bench.numFields + 1 ) * sizeof( int ) );
+		if ( !data[i] || !values[i] ) {
+			Com_Printf( "huffbench: out of memory\n" );
+			MSG_HuffBenchFree( &bench, data, values );
+			return;
+		}
+		MSG_Init( &msg[i], data[i], MAX_MSGLEN * 2 );
+	}
+
+	// both paths must send and receive exactly the same bits
+	bytes = 0;
+	for ( i = 0 ; i < bench.numMessages ; i++ ) {
+		for ( j = 0 ; j < 2 ; j++ ) {
+			msgHuffUseTables = j;
+			MSG_HuffBenchEncode( &bench, i, &msg[j] );
+		}
+		bytes += msg[0].cursize;
+		if ( msg[0].bit != msg[1].bit || memcmp( data[0], data[1], ( msg[0].bit + 7 ) >> 3 ) ) {
+			Com_Printf( "huffbench: message %i encodes differently\n", i );
+			break;
+		}
+		for ( j = 0 ; j < 2 ; j++ ) {
+			msgHuffUseTables = j;
+			MSG_HuffBenchDecode( &bench, i, &msg[0], values[j] );
+		}
+		start = bench.messages[i];
+		j = ( i + 1 < bench.numMessages ? bench.messages[i + 1] : bench.numFields ) - start;
+		if ( memcmp( values[0], values[1], j * sizeof( int ) ) ) {
+			Com_Printf( "huffbench: message %i decodes differently\n", i );
+			break;
+		}
+	}
+
+	if ( i == bench.numMessages ) {
+		// keep every encoded message around for the decode timing
+		stream = malloc( bytes + bench.numMessages * 8 );
+		streamOfs = malloc( ( bench.numMessages + 1 ) * sizeof( *streamOfs ) );
+		if ( !stream || !streamOfs ) {
+			Com_Printf( "huffbench: out of memory\n" );
+			free( stream );
+			free( streamOfs );
+			msgHuffUseTables = useTables;
+			MSG_HuffBenchFree( &bench, data, values );
+			return;
+		}
+		streamOfs[0] = 0;
+		for ( i = 0 ; i < bench.numMessages ; i++ ) {
+			MSG_HuffBenchEncode( &bench, i, &msg[0] );
+			Com_Memcpy( stream + streamOfs[i], data[0], msg[0].cursize );
+			streamOfs[i + 1] = streamOfs[i] + msg[0].cursize;
+		}
+
+		for ( j = 0 ; j < 2 ; j++ ) {
+			msgHuffUseTables = j;
+
+			start = Sys_Milliseconds();
+			for ( pass = 0 ; pass < passes ; pass++ ) {
+				for ( i = 0 ; i < bench.numMessages ; i++ ) {
+					MSG_HuffBenchEncode( &bench, i, &msg[j] );
+				}
+			}
+			encodeMsec[j] = Sys_Milliseconds() - start;
+
+			start = Sys_Milliseconds();
+			for ( pass = 0 ; pass < passes ; pass++ ) {
+				for ( i = 0 ; i < bench.numMessages ; i++ ) {
+					MSG_Init( &msg[1], stream + streamOfs[i], streamOfs[i + 1] - streamOfs[i] );
+					msg[1].cursize = msg[1].maxsize;
+					MSG_HuffBenchDecode( &bench, i, &msg[1], NULL );
+				}
+			}
+			decodeMsec[j] = Sys_Milliseconds() - start;
+		}
+
+		Com_Printf( "%i messages, %i fields, %i bytes, %i passes\n",
+			bench.numMessages, bench.numFields, bytes, passes );
+		Com_Printf( "tree:   %5i msec encode, %5i msec decode\n", encodeMsec[0], decodeMsec[0] );
+		Com_Printf( "tables: %5i msec encode, %5i msec decode\n", encodeMsec[1], decodeMsec[1] );
+
+		free( stream );
+		free( streamOfs );
+	}
+
+	msgHuffUseTables = useTables;
+	MSG_HuffBenchFree( &bench, data, values );
 }
 
 /*
@@ -461,16 +461,17 @@ qboolean	NET_IsLocalAddress( netadr_t adr ) {
 
 /*
 ==================
-Sys_GetPacket
+NET_RecvFrom
 
-Never called by the game logic, just the system event queing
+Reads one packet from sock.  The receive thread passes quiet, it isn't
+allowed to print.
 ==================
 */
 #ifdef _DEBUG
 int	recvfromCount;
 #endif
 
-qboolean Sys_GetPacket( netadr_t *net_from, msg_t *net_message ) {
+static qboolean NET_RecvFrom( SOCKET sock, netadr_t *net_from, msg_t *net_message, qboolean quiet ) {
 	int 	ret;
 	struct sockaddr_storage from;
 	socklen_t	fromlen;
@@ -479,108 +480,296 @@ qboolean Sys_GetPacket( netadr_t *net_from, msg_t *net_message ) {
 #ifdef _DEBUG
 	recvfromCount++;		// performance check
 #endif
-	
-	if(ip_socket != INVALID_SOCKET)
+
+	fromlen = sizeof(from);
+	ret = recvfrom( sock, net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
+
+	if (ret == SOCKET_ERROR)
 	{
-		fromlen = sizeof(from);
-		ret = recvfrom( ip_socket, net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
-		
-		if (ret == SOCKET_ERROR)
-		{
-			err = socketError;
+		err = socketError;
 
-			if( err != EAGAIN && err != ECONNRESET )
-				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
-		}
-		else
-		{
+		if( err != EAGAIN && err != ECONNRESET && !quiet )
+			Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+		return qfalse;
+	}
 
-			memset( ((struct sockaddr_in *)&from)->sin_zero, 0, 8 );
-		
-			if ( usingSocks && memcmp( &from, &socksRelayAddr, fromlen ) == 0 ) {
-				if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
-					return qfalse;
-				}
-				net_from->type = NA_IP;
-				net_from->ip[0] = net_message->data[4];
-				net_from->ip[1] = net_message->data[5];
-				net_from->ip[2] = net_message->data[6];
-				net_from->ip[3] = net_message->data[7];
-				net_from->port = *(short *)&net_message->data[8];
-				net_message->readcount = 10;
-			}
-			else {
-				SockadrToNetadr( (struct sockaddr *) &from, net_from );
-				net_message->readcount = 0;
-			}
-		
-			if( ret == net_message->maxsize ) {
-				Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
-				return qfalse;
-			}
-			
-			net_message->cursize = ret;
-			return qtrue;
-		}
+	if ( sock == ip_socket ) {
+		memset( ((struct sockaddr_in *)&from)->sin_zero, 0, 8 );
 	}
-	
-	if(ip6_socket != INVALID_SOCKET)
-	{
-		fromlen = sizeof(from);
-		ret = recvfrom(ip6_socket, net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
-		
-		if (ret == SOCKET_ERROR)
-		{
-			err = socketError;
 
-			if( err != EAGAIN && err != ECONNRESET )
-				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+	if ( sock == ip_socket && usingSocks && memcmp( &from, &socksRelayAddr, fromlen ) == 0 ) {
+		if ( ret < 10 || net_message->data[0] != 0 || net_message->data[1] != 0 || net_message->data[2] != 0 || net_message->data[3] != 1 ) {
+			return qfalse;
 		}
-		else
-		{
-			SockadrToNetadr((struct sockaddr *) &from, net_from);
-			net_message->readcount = 0;
-		
-			if(ret == net_message->maxsize)
-			{
-				Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
-				return qfalse;
-			}
-			
-			net_message->cursize = ret;
-			return qtrue;
+		net_from->type = NA_IP;
+		net_from->ip[0] = net_message->data[4];
+		net_from->ip[1] = net_message->data[5];
+		net_from->ip[2] = net_message->data[6];
+		net_from->ip[3] = net_message->data[7];
+		net_from->port = *(short *)&net_message->data[8];
+		net_message->readcount = 10;
+	}
+	else {
+		SockadrToNetadr( (struct sockaddr *) &from, net_from );
+		net_message->readcount = 0;
+	}
+
+	if( ret == net_message->maxsize ) {
+		if ( !quiet ) {
+			Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
 		}
+		return qfalse;
 	}
 
-	if(multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket)
-	{
-		fromlen = sizeof(from);
-		ret = recvfrom(multicast6_socket, net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
-		
-		if (ret == SOCKET_ERROR)
-		{
-			err = socketError;
+	net_message->cursize = ret;
+	return qtrue;
+}
+
+/*
+===============================================================================
+
+RECEIVE THREAD
+
+With net_recvThread 1 a dedicated server drains its sockets on a thread
+of its own.  Packets are stamped with their arrival time and handed to
+the event loop through a single producer, single consumer ring, and
+NET_Sleep wakes up as soon as one is queued.
+
+===============================================================================
+*/
+
+#define	RECV_QUEUE_SIZE		128		// must be a power of two
+
+typedef struct {
+	netadr_t	from;
+	int			time;
+	int			cursize;
+	byte		data[MAX_MSGLEN];
+} recvPacket_t;
+
+typedef struct {
+	recvPacket_t	*packets;		// [RECV_QUEUE_SIZE]
+	volatile int	head;			// only written by the thread
+	volatile int	tail;			// only written by the main thread
+
+	volatile int	run;
+	volatile int	sleeping;		// set while NET_Sleep is waiting on wake
+	void			*wake;			// posted when a packet is queued on an empty ring during NET_Sleep
+	void			*done;			// posted when the thread exits
+
+	volatile int	dropped;
+	int				reportedDropped;
+} recvQueue_t;
+
+static cvar_t		*net_recvThread;
+static recvQueue_t	recvQueue;
+static qboolean		recvThreadActive;
+
+/*
+==================
+NET_RecvThread
+==================
+*/
+static void NET_RecvThread( void *data ) {
+	SOCKET			sockets[3];
+	int				i, numSockets;
+	SOCKET			highestfd;
+	fd_set			fdset;
+	struct timeval	timeout;
+	recvPacket_t	*packet, discard;
+	msg_t			msg;
+
+	// the sockets can't change until the thread has been stopped
+	numSockets = 0;
+	if ( ip_socket != INVALID_SOCKET ) {
+		sockets[numSockets++] = ip_socket;
+	}
+	if ( ip6_socket != INVALID_SOCKET ) {
+		sockets[numSockets++] = ip6_socket;
+	}
+	if ( multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket ) {
+		sockets[numSockets++] = multicast6_socket;
+	}
+
+	while ( recvQueue.run ) {
+		FD_ZERO( &fdset );
+		highestfd = 0;
+		for ( i = 0 ; i < numSockets ; i++ ) {
+			FD_SET( sockets[i], &fdset );
+			if ( sockets[i] > highestfd ) {
+				highestfd = sockets[i];
+			}
+		}
 
-			if( err != EAGAIN && err != ECONNRESET )
-				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+		// wake up now and then to see if we should exit
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100000;
+		if ( select( highestfd + 1, &fdset, NULL, NULL, &timeout ) <= 0 ) {
+			continue;
 		}
-		else
-		{
-			SockadrToNetadr((struct sockaddr *) &from, net_from);
-			net_message->readcount = 0;
-		
-			if(ret == net_message->maxsize)
-			{
-				Com_Printf( "Oversize packet from %s\n", NET_AdrToString (*net_from) );
-				return qfalse;
+
+		for ( i = 0 ; i < numSockets ; i++ ) {
+			if ( !FD_ISSET( sockets[i], &fdset ) ) {
+				continue;
+			}
+
+			while ( 1 ) {
+				if ( recvQueue.head - recvQueue.tail >= RECV_QUEUE_SIZE ) {
+					// the frame is running late, keep the socket drained anyway
+					packet = &discard;
+				} else {
+					packet = &recvQueue.packets[recvQueue.head & ( RECV_QUEUE_SIZE - 1 )];
+				}
+
+				MSG_Init( &msg, packet->data, sizeof( packet->data ) );
+				if ( !NET_RecvFrom( sockets[i], &packet->from, &msg, qtrue ) ) {
+					break;
+				}
+
+				if ( packet == &discard ) {
+					Sys_AtomicAdd( &recvQueue.dropped, 1 );
+					continue;
+				}
+
+				packet->time = Sys_Milliseconds();
+				packet->cursize = msg.cursize;
+
+				// publish the packet, only waking the main thread if it's waiting
+				if ( Sys_AtomicAdd( &recvQueue.head, 1 ) - 1 == recvQueue.tail && recvQueue.sleeping ) {
+					Sys_SemaphorePost( recvQueue.wake );
+				}
 			}
-			
-			net_message->cursize = ret;
-			return qtrue;
 		}
 	}
-	
-	
+
+	Sys_SemaphorePost( recvQueue.done );
+}
+
+/*
+==================
+NET_StopRecvThread
+
+Must be called before any socket is closed
+==================
+*/
+static void NET_StopRecvThread( void ) {
+	if ( !recvThreadActive ) {
+		return;
+	}
+
+	recvQueue.run = 0;
+	Sys_SemaphoreWait( recvQueue.done );
+	recvThreadActive = qfalse;
+
+	Sys_DestroySemaphore( recvQueue.wake );
+	Sys_DestroySemaphore( recvQueue.done );
+	Z_Free( recvQueue.packets );
+	Com_Memset( &recvQueue, 0, sizeof( recvQueue ) );
+}
+
+/*
+==================
+NET_StartRecvThread
+==================
+*/
+static void NET_StartRecvThread( void ) {
+	if ( recvThreadActive || !net_recvThread->integer || !com_dedicated->integer ) {
+		return;
+	}
+	if ( ip_socket == INVALID_SOCKET && ip6_socket == INVALID_SOCKET ) {
+		return;
+	}
+
+	Com_Memset( &recvQueue, 0, sizeof( recvQueue ) );
+	recvQueue.wake = Sys_CreateSemaphore();
+	recvQueue.done = Sys_CreateSemaphore();
+	if ( !recvQueue.wake || !recvQueue.done ) {
+		Sys_DestroySemaphore( recvQueue.wake );
+		Sys_DestroySemaphore( recvQueue.done );
+		return;
+	}
+	recvQueue.packets = Z_Malloc( RECV_QUEUE_SIZE * sizeof( *recvQueue.packets ) );
+	recvQueue.run = 1;
+
+	if ( !Sys_CreateThread( NET_RecvThread, NULL ) ) {
+		Com_Printf( "WARNING: couldn't start the network receive thread\n" );
+		Sys_DestroySemaphore( recvQueue.wake );
+		Sys_DestroySemaphore( recvQueue.done );
+		Z_Free( recvQueue.packets );
+		Com_Memset( &recvQueue, 0, sizeof( recvQueue ) );
+		return;
+	}
+
+	recvThreadActive = qtrue;
+	Com_Printf( "Network receive thread started\n" );
+}
+
+/*
+==================
+NET_GetQueuedPacket
+
+Takes the oldest packet off the receive thread's ring, time is when
+it arrived
+==================
+*/
+qboolean NET_GetQueuedPacket( netadr_t *net_from, msg_t *net_message, int *time ) {
+	recvPacket_t	*packet;
+	int				dropped;
+
+	if ( !recvThreadActive ) {
+		return qfalse;
+	}
+
+	dropped = recvQueue.dropped;
+	if ( dropped != recvQueue.reportedDropped ) {
+		Com_DPrintf( "NET_GetQueuedPacket: receive queue full, %i packets dropped\n",
+			dropped - recvQueue.reportedDropped );
+		recvQueue.reportedDropped = dropped;
+	}
+
+	if ( recvQueue.tail == recvQueue.head ) {
+		return qfalse;
+	}
+
+	packet = &recvQueue.packets[recvQueue.tail & ( RECV_QUEUE_SIZE - 1 )];
+	*net_from = packet->from;
+	*time = packet->time;
+	Com_Memcpy( net_message->data, packet->data, packet->cursize );
+	net_message->cursize = packet->cursize;
+	net_message->readcount = 0;
+
+	// hand the slot back to the thread
+	Sys_AtomicAdd( &recvQueue.tail, 1 );
+
+	return qtrue;
+}
+
+/*
+==================
+Sys_GetPacket
+
+Never called by the game logic, just the system event queing
+==================
+*/
+qboolean Sys_GetPacket( netadr_t *net_from, msg_t *net_message ) {
+	// the receive thread owns the sockets
+	if ( recvThreadActive ) {
+		return qfalse;
+	}
+
+	if ( ip_socket != INVALID_SOCKET && NET_RecvFrom( ip_socket, net_from, net_message, qfalse ) ) {
+		return qtrue;
+	}
+
+	if ( ip6_socket != INVALID_SOCKET && NET_RecvFrom( ip6_socket, net_from, net_message, qfalse ) ) {
+		return qtrue;
+	}
+
+	if ( multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket
+		&& NET_RecvFrom( multicast6_socket, net_from, net_message, qfalse ) ) {
+		return qtrue;
+	}
+
 	return qfalse;
 }
 
@@ -1425,6 +1614,11 @@ static qboolean NET_GetCvars( void ) {
 	}
 	net_socksPassword = Cvar_Get( "net_socksPassword", "", CVAR_LATCH | CVAR_ARCHIVE );
 
+	if( net_recvThread && net_recvThread->modified ) {
+		modified = qtrue;
+	}
+	net_recvThread = Cvar_Get( "net_recvThread", "0", CVAR_LATCH | CVAR_ARCHIVE );
+
 
 	return modified;
 }
@@ -1475,6 +1669,8 @@ void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if( stop ) {
+		NET_StopRecvThread();
+
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1506,6 +1702,7 @@ void NET_Config( qboolean enableNetworking ) {
 		{
 			NET_OpenIP();
 			NET_SetMulticast6();
+			NET_StartRecvThread();
 		}
 	}
 }
@@ -1577,6 +1774,22 @@ void NET_Sleep( int msec ) {
 	if (msec < 0 )
 		return;
 
+	if ( recvThreadActive ) {
+		// announce the wait before looking at the ring, so a packet
+		// queued after the look is sure to post
+		Sys_AtomicAdd( &recvQueue.sleeping, 1 );
+
+		// throw away posts for packets that were read without waiting
+		while ( Sys_SemaphoreWaitTimeout( recvQueue.wake, 0 ) )
+			;
+
+		if ( recvQueue.tail == recvQueue.head ) {
+			Sys_SemaphoreWaitTimeout( recvQueue.wake, msec );
+		}
+		Sys_AtomicAdd( &recvQueue.sleeping, -1 );
+		return;
+	}
+
 	FD_ZERO(&fdset);
 
 	if(ip_socket != INVALID_SOCKET)
@@ -0,0 +1,386 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// profile.c -- scoped zone profiler with chrome trace output
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/*
+=============================================================================
+
+profile_start begins a capture and profile_stop writes it to
+profiles/<name>.json in the chrome trace event format, which can be
+opened in chrome://tracing or https://ui.perfetto.dev.
+
+Every thread that enters a zone while a capture is running gets its own
+ring of completed zones, so recording never takes a lock.  When a ring
+fills up the oldest zones are overwritten.  The rings are allocated with
+malloc the first time a thread records, because the worker threads must
+not touch the zone, and are kept for later captures.
+
+Outside of a capture a zone costs one test of com_profiling.
+
+=============================================================================
+*/
+
+#ifdef _MSC_VER
+#define	PROFILE_TLS		__declspec(thread)
+#else
+#define	PROFILE_TLS		__thread
+#endif
+
+#define	MAX_PROFILE_THREADS		32
+#define	MAX_PROFILE_DEPTH		32
+#define	DEFAULT_PROFILE_EVENTS	65536
+
+typedef struct {
+	const char		*name;
+	int				arg;				// -1 for none
+	unsigned int	start;				// microseconds into the capture
+	unsigned int	duration;
+} profileEvent_t;
+
+typedef struct {
+	const char		*name;
+	int				arg;
+	uint64_t		start;
+} profileZone_t;
+
+typedef struct {
+	int				generation;			// capture the ring was last reset for
+	const char		*threadName;
+
+	profileEvent_t	*events;
+	int				eventMask;			// ring size - 1
+	volatile int	numEvents;			// total recorded, the ring has the last ones
+
+	int				depth;
+	profileZone_t	zones[MAX_PROFILE_DEPTH];
+} profileThread_t;
+
+volatile int				com_profiling;		// generation of the running capture, 0 if none
+cvar_t						*com_profileSyscalls;
+
+static profileThread_t		*prof_threads[MAX_PROFILE_THREADS];
+static volatile int			prof_numThreads;
+static int					prof_generation;
+static int					prof_maxEvents;
+static uint64_t				prof_startTime;
+
+static PROFILE_TLS profileThread_t	*prof_thread;
+static profileThread_t		prof_noThread;		// for threads past MAX_PROFILE_THREADS
+
+/*
+=================
+Com_ProfileThread
+
+The calling thread's ring, reset for the running capture
+=================
+*/
+static profileThread_t *Com_ProfileThread( void ) {
+	profileThread_t	*t;
+	int				i, generation;
+
+	t = prof_thread;
+	if ( !t ) {
+		i = Sys_AtomicAdd( &prof_numThreads, 1 ) - 1;
+		if ( i >= MAX_PROFILE_THREADS ) {
+			prof_thread = &prof_noThread;
+			return NULL;
+		}
+		t = calloc( 1, sizeof( *t ) );
+		if ( !t ) {
+			prof_thread = &prof_noThread;
+			return NULL;
+		}
+		prof_threads[i] = t;
+		prof_thread = t;
+	}
+	if ( t == &prof_noThread ) {
+		return NULL;
+	}
+
+	generation = com_profiling;
+	if ( !generation ) {
+		return NULL;		// stopped while the caller was testing com_profiling
+	}
+	if ( t->generation != generation ) {
+		if ( t->eventMask + 1 != prof_maxEvents ) {
+			free( t->events );
+			t->events = malloc( prof_maxEvents * sizeof( *t->events ) );
+			t->eventMask = t->events ? prof_maxEvents - 1 : -1;
+		}
+		t->numEvents = 0;
+		t->depth = 0;
+		t->generation = generation;
+	}
+	if ( !t->events ) {
+		return NULL;
+	}
+
+	return t;
+}
+
+/*
+=================
+Com_ProfileBegin
+
+Opens a zone on the calling thread, use PROFILE_BEGIN so nothing
+is called outside of a capture.  The name must stay valid until the
+capture has been written.
+=================
+*/
+void Com_ProfileBegin( const char *name, int arg ) {
+	profileThread_t	*t;
+	profileZone_t	*zone;
+
+	t = Com_ProfileThread();
+	if ( !t ) {
+		return;
+	}
+
+	if ( t->depth < MAX_PROFILE_DEPTH ) {
+		zone = &t->zones[t->depth];
+		zone->name = name;
+		zone->arg = arg;
+		zone->start = Sys_Microseconds();
+	}
+	t->depth++;
+}
+
+/*
+=================
+Com_ProfileEnd
+
+Closes the innermost zone of the calling thread.  Zones that were
+opened before the capture started are ignored.
+=================
+*/
+void Com_ProfileEnd( void ) {
+	profileThread_t	*t;
+	profileZone_t	*zone;
+	profileEvent_t	*event;
+	uint64_t		now;
+
+	t = prof_thread;
+	if ( !t || t->generation != com_profiling || !t->events || t->depth <= 0 ) {
+		return;
+	}
+
+	now = Sys_Microseconds();
+
+	t->depth--;
+	if ( t->depth >= MAX_PROFILE_DEPTH ) {
+		return;
+	}
+
+	zone = &t->zones[t->depth];
+	event = &t->events[t->numEvents & t->eventMask];
+	event->name = zone->name;
+	event->arg = zone->arg;
+	event->start = (unsigned int)( zone->start - prof_startTime );
+	event->duration = (unsigned int)( now - zone->start );
+	t->numEvents++;
+}
+
+/*
+=================
+Com_ProfileUnwind
+
+Closes all zones of the calling thread, for when an error
+longjmps past their ends
+=================
+*/
+void Com_ProfileUnwind( void ) {
+	profileThread_t	*t;
+
+	t = prof_thread;
+	if ( !t || t->generation != com_profiling ) {
+		return;
+	}
+	while ( t->depth > 0 ) {
+		Com_ProfileEnd();
+	}
+}
+
+/*
+=================
+Com_ProfileStart_f
+
+profile_start [events per thread]
+=================
+*/
+static void Com_ProfileStart_f( void ) {
+	profileThread_t	*t;
+	int				events;
+
+	events = DEFAULT_PROFILE_EVENTS;
+	if ( Cmd_Argc() > 1 ) {
+		events = atoi( Cmd_Argv( 1 ) );
+		if ( events < 1024 ) {
+			events = 1024;
+		} else if ( events > 0x1000000 ) {
+			events = 0x1000000;
+		}
+	}
+
+	// round up to a power of two for the ring index
+	prof_maxEvents = 1;
+	while ( prof_maxEvents < events ) {
+		prof_maxEvents <<= 1;
+	}
+
+	prof_startTime = Sys_Microseconds();
+	prof_generation++;
+	com_profiling = prof_generation;
+
+	t = Com_ProfileThread();
+	if ( t ) {
+		t->threadName = "main";
+	}
+
+	VM_ProfileSyscalls( com_profileSyscalls->integer != 0 );
+
+	Com_Printf( "Profiling started, %i zones per thread\n", prof_maxEvents );
+}
+
+/*
+=================
+Com_ProfileWriteThread
+=================
+*/
+static int Com_ProfileWriteThread( fileHandle_t f, profileThread_t *t, int tid, qboolean *first ) {
+	profileEvent_t	*event;
+	int				i, start, count;
+
+	count = t->numEvents;
+	start = count - ( t->eventMask + 1 );
+	if ( start < 0 ) {
+		start = 0;
+	}
+
+	if ( t->threadName ) {
+		FS_Printf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}",
+			*first ? "\n" : ",\n", tid, t->threadName );
+	} else {
+		FS_Printf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"thread %i\"}}",
+			*first ? "\n" : ",\n", tid, tid );
+	}
+	*first = qfalse;
+
+	for ( i = start ; i < count ; i++ ) {
+		event = &t->events[i & t->eventMask];
+		if ( event->arg >= 0 ) {
+			FS_Printf( f, ",\n{\"name\":\"%s %i\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%u,\"dur\":%u}",
+				event->name, event->arg, tid, event->start, event->duration );
+		} else {
+			FS_Printf( f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%u,\"dur\":%u}",
+				event->name, tid, event->start, event->duration );
+		}
+	}
+
+	return count - start;
+}
+
+/*
+=================
+Com_ProfileStop_f
+
+profile_stop [name]
+=================
+*/
+static void Com_ProfileStop_f( void ) {
+	char			name[MAX_QPATH];
+	fileHandle_t	f;
+	profileThread_t	*t;
+	qtime_t			now;
+	qboolean		first;
+	int				generation;
+	int				i, numThreads, total, dropped;
+
+	if ( !com_profiling ) {
+		Com_Printf( "Not profiling\n" );
+		return;
+	}
+
+	// zones being written right now by other threads may be
+	// torn, everything else is complete
+	generation = com_profiling;
+	com_profiling = 0;
+	VM_ProfileSyscalls( qfalse );
+
+	if ( Cmd_Argc() > 1 ) {
+		Com_sprintf( name, sizeof( name ), "profiles/%s", Cmd_Argv( 1 ) );
+	} else {
+		Com_RealTime( &now );
+		Com_sprintf( name, sizeof( name ), "profiles/profile-%04i%02i%02i-%02i%02i%02i",
+			now.tm_year + 1900, now.tm_mon + 1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec );
+	}
+	COM_DefaultExtension( name, sizeof( name ), ".json" );
+
+	f = FS_FOpenFileWrite( name );
+	if ( !f ) {
+		Com_Printf( "Couldn't write %s\n", name );
+		return;
+	}
+
+	FS_Printf( f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+
+	numThreads = prof_numThreads;
+	if ( numThreads > MAX_PROFILE_THREADS ) {
+		numThreads = MAX_PROFILE_THREADS;
+	}
+
+	first = qtrue;
+	total = dropped = 0;
+	for ( i = 0 ; i < numThreads ; i++ ) {
+		t = prof_threads[i];
+		if ( !t || t->generation != generation || !t->events ) {
+			continue;
+		}
+		total += Com_ProfileWriteThread( f, t, i, &first );
+		if ( t->numEvents > t->eventMask + 1 ) {
+			dropped += t->numEvents - t->eventMask - 1;
+		}
+	}
+
+	FS_Printf( f, "\n]}\n" );
+	FS_FCloseFile( f );
+
+	Com_Printf( "Wrote %i zones to %s", total, name );
+	if ( dropped ) {
+		Com_Printf( ", %i older zones were overwritten", dropped );
+	}
+	Com_Printf( "\n" );
+}
+
+/*
+=================
+Com_ProfileInit
+=================
+*/
+void Com_ProfileInit( void ) {
+	com_profileSyscalls = Cvar_Get( "com_profileSyscalls", "1", 0 );
+
+	Cmd_AddCommand( "profile_start", Com_ProfileStart_f );
+	Cmd_AddCommand( "profile_stop", Com_ProfileStop_f );
+}
@@ -67,6 +67,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_CopyBits( msg_t *msg, const byte *data, int bits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -110,6 +111,7 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct pl
 
 
 void MSG_ReportChangeVectors_f( void );
+void MSG_HuffBench_f( void );
 
 //============================================================================
 
@@ -176,6 +178,7 @@ qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_messag
 void		NET_JoinMulticast6(void);
 void		NET_LeaveMulticast6(void);
 void		NET_Sleep(int msec);
+qboolean	NET_GetQueuedPacket( netadr_t *net_from, msg_t *net_message, int *time );
 
 
 #define	MAX_MSGLEN				16384		// max length of a message, which may
@@ -337,6 +340,30 @@ vm_t	*VM_Restart( vm_t *vm );
 
 intptr_t		QDECL VM_Call( vm_t *vm, int callNum, ... );
 
+typedef intptr_t (*vmSyscall_t)( intptr_t *args );
+
+void	VM_SetSyscallTable( vm_t *vm, const vmSyscall_t *table, int numSyscalls );
+// handlers in the table are called directly, with the same arguments the
+// systemCalls function given to VM_Create would get.  NULL entries and
+// numbers past the end still go to that function.
+
+byte	*VM_DataImage( vm_t *vm, intptr_t *mask );
+// pointer arguments of vm is base + ( arg & mask ), for handlers that
+// want to convert them without VM_ArgPtr
+
+void	VM_ProfileSyscalls( qboolean enable );
+// puts a profiler zone around every system call of all vms
+
+void	VM_InterpreterBench( vm_t *vm, void (*reset)( void ), int callnum, int arg, int passes );
+// times VM_Call( vm, callnum, arg ) with the switch and the threaded
+// interpreter, starting every pass from the current vm data.  reset is
+// called after the data has been put back, to resync outside state.
+
+void	VM_CompareCompiled( vm_t *vm, void (*reset)( void ), int callnum, int arg );
+// runs VM_Call( vm, callnum, arg ) on an interpreted vm with the
+// interpreter and with freshly compiled code, and reports the first
+// system call, return value or data that differs
+
 void	VM_Debug( int level );
 
 void	*VM_ArgPtr( intptr_t intValue );
@@ -600,6 +627,10 @@ int		FS_FOpenFileRead( const char *qpath, fileHandle_t *file, qboolean uniqueFIL
 int		FS_FileIsInPAK(const char *filename, int *pChecksum );
 // returns 1 if a file is in the PAK file, otherwise -1
 
+int		FS_FileOrigin( const char *qpath, int *checksum );
+// returns the length of the file FS_ReadFile would load, or -1, and a checksum
+// that changes when a different copy or contents would be loaded
+
 int		FS_Write( const void *buffer, int len, fileHandle_t f );
 
 int		FS_Read2( void *buffer, int len, fileHandle_t f );
@@ -623,6 +654,13 @@ void	FS_ForceFlush( fileHandle_t f );
 void	FS_FreeFile( void *buffer );
 // frees the memory returned by FS_ReadFile
 
+void	FS_PrefetchFile( const char *qpath );
+// starts reading and inflating the file on a background thread, the
+// next FS_ReadFile of it takes the data instead of reading it again
+
+void	FS_ClearPrefetch( void );
+// drops the prefetched files nothing has read yet
+
 void	FS_WriteFile( const char *qpath, const void *buffer, int size );
 // writes a complete file, creating any subdirectories needed
 
@@ -724,7 +762,8 @@ typedef enum
   CF_3DNOW_EXT  = 1 << 4,
   CF_SSE        = 1 << 5,
   CF_SSE2       = 1 << 6,
-  CF_ALTIVEC    = 1 << 7
+  CF_ALTIVEC    = 1 << 7,
+  CF_NEON       = 1 << 8
 } cpuFeatures_t;
 
 // centralized and cleaned, that's the max string you can send to a Com_Printf / Com_DPrintf (above gets truncated)
@@ -765,6 +804,33 @@ void 		QDECL Com_Error( int code, const char *fmt, ... ) __attribute__ ((format
 void 		Com_Quit_f( void );
 
 int			Com_Milliseconds( void );	// will be journaled properly
+
+// worker pool, see threads.c
+#define	MAX_WORKER_THREADS	16
+typedef void (*workerFunc_t)( void *data, int index );
+
+int			Com_WorkerThreads( int requested );
+void		Com_ParallelFor( int numThreads, workerFunc_t func, void *data, int count );
+// runs func( data, 0 ) .. func( data, count - 1 ) spread over numThreads
+// threads (including the caller) and returns when all of them are done.
+// Falls back to a plain loop for numThreads <= 1, or when another
+// parallel loop is already running.  The job functions must not call
+// Com_Error, Com_Printf or touch the zone or hunk.
+
+// zone profiler, see profile.c
+extern volatile int	com_profiling;
+extern cvar_t		*com_profileSyscalls;	// zones around vm system calls too
+
+void		Com_ProfileInit( void );
+void		Com_ProfileBegin( const char *name, int arg );
+void		Com_ProfileEnd( void );
+void		Com_ProfileUnwind( void );
+
+// zones are recorded on the calling thread and must nest, arg is
+// appended to the name unless it is negative
+#define	PROFILE_BEGIN( name, arg )	do { if ( com_profiling ) Com_ProfileBegin( name, arg ); } while ( 0 )
+#define	PROFILE_END()				do { if ( com_profiling ) Com_ProfileEnd(); } while ( 0 )
+
 unsigned	Com_BlockChecksum( const void *buffer, int length );
 char		*Com_MD5File(const char *filename, int length, const char *prefix, int prefix_len);
 int			Com_HashKey(char *string, int maxlen);
@@ -1015,6 +1081,7 @@ void	Sys_Print( const char *msg );
 // Sys_Milliseconds should only be used for profiling purposes,
 // any game related timing information should come from event timestamps
 int		Sys_Milliseconds (void);
+uint64_t	Sys_Microseconds( void );	// also only for profiling
 
 void	Sys_SnapVector( float *v );
 
@@ -1053,10 +1120,30 @@ char *Sys_ConsoleInput(void);
 
 char **Sys_ListFiles( const char *directory, const char *extension, char *filter, int *numfiles, qboolean wantsubs );
 void	Sys_FreeFileList( char **list );
+
+// maps a whole file read only, NULL if it can't be mapped
+void	*Sys_MapFile( const char *path, int *length );
+void	Sys_UnmapFile( void *base, int length );
+
 void	Sys_Sleep(int msec);
 
 qboolean Sys_LowPhysicalMemory( void );
 
+// threads are detached and run until the process exits
+qboolean Sys_CreateThread( void (*function)( void *data ), void *data );
+void	*Sys_CreateMutex( void );
+void	Sys_DestroyMutex( void *mutex );
+void	Sys_LockMutex( void *mutex );
+void	Sys_UnlockMutex( void *mutex );
+// counting semaphores start at zero
+void	*Sys_CreateSemaphore( void );
+void	Sys_DestroySemaphore( void *semaphore );
+void	Sys_SemaphorePost( void *semaphore );
+void	Sys_SemaphoreWait( void *semaphore );
+qboolean	Sys_SemaphoreWaitTimeout( void *semaphore, int msec );
+int		Sys_AtomicAdd( volatile int *value, int add );	// returns the new value
+int		Sys_NumProcessors( void );
+
 /* This is based on the Adaptive Huffman algorithm described in Sayood's Data
  * Compression book.  The ranks are not actually stored, but implicitly defined
  * by the location of a node within a doubly-linked list */
@@ -1093,6 +1180,16 @@ typedef struct {
 	huff_t		decompressor;
 } huffman_t;
 
+// flattened codes of a tree that isn't updated anymore
+#define	HUFF_LOOKUP_BITS	11
+
+typedef struct {
+	unsigned int	code[HMAX+1];			// first bit sent is the lowest
+	byte			length[HMAX+1];			// 0 = longer than 32 bits, use the tree
+	short			symbol[1<<HUFF_LOOKUP_BITS];	// indexed by the next bits received
+	byte			symbolLength[1<<HUFF_LOOKUP_BITS];	// 0 = longer, use the tree
+} huffTables_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1103,6 +1200,7 @@ void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset);
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset);
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
+void	Huff_BuildTables( const huff_t *huff, huffTables_t *tables );
 
 extern huffman_t clientHuffTables;
 
@@ -0,0 +1,194 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// threads.c -- worker pool for data parallel loops
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/*
+=============================================================================
+
+The pool is grown on demand and its threads are never destroyed, they
+just sleep on their semaphore between loops.  Only one loop runs at a
+time; a loop started while another is active (from a worker, or from
+the SMP render thread) simply runs on the calling thread.
+
+=============================================================================
+*/
+
+typedef struct {
+	void			*wake;
+} worker_t;
+
+typedef struct {
+	int				numWorkers;
+	worker_t		workers[MAX_WORKER_THREADS - 1];
+	void			*done;
+
+	volatile int	busy;
+
+	// current loop
+	workerFunc_t	func;
+	void			*data;
+	int				count;
+	volatile int	next;
+} workerPool_t;
+
+static workerPool_t	pool;
+
+/*
+=================
+Com_RunParallelJobs
+
+Pull indices off the current loop until it is exhausted
+=================
+*/
+static void Com_RunParallelJobs( void ) {
+	int		index;
+
+	while ( 1 ) {
+		index = Sys_AtomicAdd( &pool.next, 1 ) - 1;
+		if ( index >= pool.count ) {
+			break;
+		}
+		pool.func( pool.data, index );
+	}
+}
+
+/*
+=================
+Com_WorkerThread
+=================
+*/
+static void Com_WorkerThread( void *data ) {
+	worker_t	*worker = data;
+
+	while ( 1 ) {
+		Sys_SemaphoreWait( worker->wake );
+		Com_RunParallelJobs();
+		Sys_SemaphorePost( pool.done );
+	}
+}
+
+/*
+=================
+Com_SpawnWorkers
+
+Make sure at least count pool threads exist, returns how many do
+=================
+*/
+static int Com_SpawnWorkers( int count ) {
+	worker_t	*worker;
+
+	if ( !pool.done ) {
+		pool.done = Sys_CreateSemaphore();
+		if ( !pool.done ) {
+			return 0;
+		}
+	}
+
+	while ( pool.numWorkers < count ) {
+		worker = &pool.workers[pool.numWorkers];
+		worker->wake = Sys_CreateSemaphore();
+		if ( !worker->wake ) {
+			break;
+		}
+		if ( !Sys_CreateThread( Com_WorkerThread, worker ) ) {
+			Sys_DestroySemaphore( worker->wake );
+			worker->wake = NULL;
+			break;
+		}
+		pool.numWorkers++;
+	}
+
+	return pool.numWorkers;
+}
+
+/*
+=================
+Com_WorkerThreads
+
+Clamps a thread count cvar value, negative values mean one per processor
+=================
+*/
+int Com_WorkerThreads( int requested ) {
+	if ( requested < 0 ) {
+		requested = Sys_NumProcessors();
+	}
+	if ( requested < 1 ) {
+		return 1;
+	}
+	if ( requested > MAX_WORKER_THREADS ) {
+		return MAX_WORKER_THREADS;
+	}
+	return requested;
+}
+
+/*
+=================
+Com_ParallelFor
+=================
+*/
+void Com_ParallelFor( int numThreads, workerFunc_t func, void *data, int count ) {
+	int		i, numWorkers;
+
+	numThreads = Com_WorkerThreads( numThreads );
+	if ( numThreads > count ) {
+		numThreads = count;
+	}
+
+	if ( numThreads > 1 && Sys_AtomicAdd( &pool.busy, 1 ) != 1 ) {
+		Sys_AtomicAdd( &pool.busy, -1 );
+		numThreads = 1;
+	}
+
+	if ( numThreads <= 1 ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			func( data, i );
+		}
+		return;
+	}
+
+	numWorkers = Com_SpawnWorkers( numThreads - 1 );
+	if ( numWorkers > numThreads - 1 ) {
+		numWorkers = numThreads - 1;
+	}
+
+	pool.func = func;
+	pool.data = data;
+	pool.count = count;
+	pool.next = 0;
+
+	for ( i = 0 ; i < numWorkers ; i++ ) {
+		Sys_SemaphorePost( pool.workers[i].wake );
+	}
+
+	Com_RunParallelJobs();
+
+	for ( i = 0 ; i < numWorkers ; i++ ) {
+		Sys_SemaphoreWait( pool.done );
+	}
+
+	pool.func = NULL;
+	pool.data = NULL;
+	Sys_AtomicAdd( &pool.busy, -1 );
+}
@@ -4295,3 +4295,135 @@ void  zcfree (voidp opaque, voidp ptr)
 }
 
 
+
+/*
+  Get the offset of the local header of the current file, for
+  unzReadLocalFile
+*/
+extern int unzGetCurrentFileLocation (unzFile file, unsigned long *localHeader)
+{
+	unz_s* s;
+	if (file==NULL)
+		return UNZ_PARAMERROR;
+	s=(unz_s*)file;
+	if (!s->current_file_ok)
+		return UNZ_END_OF_LIST_OF_FILE;
+	*localHeader = s->cur_file_info_internal.offset_curfile + s->byte_before_the_zipfile;
+	return UNZ_OK;
+}
+
+static voidp unzlocal_malloc (voidp opaque, unsigned items, unsigned size)
+{
+	return malloc(items*size);
+}
+
+static void unzlocal_free (voidp opaque, voidp ptr)
+{
+	free(ptr);
+}
+
+/*
+  Inflate a whole deflated file.  Like unzReadLocalFile it only uses
+  malloc, so it can be called from any thread.
+*/
+extern int unzInflateBuffer (const void *compressed, unsigned long compressedSize, void *buf, unsigned long uncompressedSize)
+{
+	z_stream stream;
+	int err;
+
+	if (uncompressedSize==0)
+		return UNZ_OK;
+
+	memset(&stream,0,sizeof(stream));
+	stream.zalloc=(alloc_func)unzlocal_malloc;
+	stream.zfree=(free_func)unzlocal_free;
+	stream.next_in=(Byte*)compressed;
+	stream.avail_in=(uInt)compressedSize+1;
+	stream.next_out=(Byte*)buf;
+	stream.avail_out=(uInt)uncompressedSize;
+
+	err=inflateInit2(&stream,-MAX_WBITS);
+	if (err!=Z_OK)
+		return UNZ_INTERNALERROR;
+	while (stream.total_out<uncompressedSize)
+	{
+		err=inflate(&stream,Z_SYNC_FLUSH);
+		if (err!=Z_OK)
+			break;
+	}
+	if (stream.total_out==uncompressedSize)
+		err=UNZ_OK;
+	else if (err==Z_OK || err==Z_STREAM_END)
+		err=UNZ_BADZIPFILE;
+	inflateEnd(&stream);
+	return err;
+}
+
+/*
+  Read a whole file of the zipfile at path into buf, without an unzFile.
+  Only stdio and malloc are used, so unlike the rest of this file it can
+  be called from any thread.
+*/
+extern int unzReadLocalFile (const char *path, unsigned long localHeader, const unz_file_info *info, void *buf)
+{
+	FILE* f;
+	unsigned char header[SIZEZIPLOCALHEADER];
+	unsigned char* compressed;
+	uLong sizeVar;
+	int err=UNZ_OK;
+
+	f=fopen(path,"rb");
+	if (f==NULL)
+		return UNZ_ERRNO;
+
+	if (fseek(f,localHeader,SEEK_SET)!=0 ||
+		fread(header,SIZEZIPLOCALHEADER,1,f)!=1)
+	{
+		fclose(f);
+		return UNZ_ERRNO;
+	}
+	if (header[0]!=0x50 || header[1]!=0x4b || header[2]!=0x03 || header[3]!=0x04)
+	{
+		fclose(f);
+		return UNZ_BADZIPFILE;
+	}
+
+	/* skip the file name and the local extra field */
+	sizeVar = (header[26] | (header[27]<<8)) + (header[28] | (header[29]<<8));
+	if (fseek(f,localHeader+SIZEZIPLOCALHEADER+sizeVar,SEEK_SET)!=0)
+	{
+		fclose(f);
+		return UNZ_ERRNO;
+	}
+
+	if (info->compression_method==0)
+	{
+		if (info->compressed_size!=info->uncompressed_size)
+			err=UNZ_BADZIPFILE;
+		else if (info->uncompressed_size &&
+			fread(buf,info->uncompressed_size,1,f)!=1)
+			err=UNZ_ERRNO;
+	}
+	else if (info->compression_method==Z_DEFLATED)
+	{
+		/* inflate wants a dummy byte after the stream, see unzOpenCurrentFile */
+		compressed=(unsigned char*)malloc(info->compressed_size+1);
+		if (compressed==NULL)
+			err=UNZ_INTERNALERROR;
+		else if (info->compressed_size &&
+			fread(compressed,info->compressed_size,1,f)!=1)
+			err=UNZ_ERRNO;
+
+		if (err==UNZ_OK)
+		{
+			compressed[info->compressed_size]=0;
+			err=unzInflateBuffer(compressed,info->compressed_size,buf,info->uncompressed_size);
+		}
+		free(compressed);
+	}
+	else
+		err=UNZ_BADZIPFILE;
+
+	fclose(f);
+	return err;
+}
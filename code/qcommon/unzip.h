@@ -167,6 +167,10 @@ typedef struct
 #define UNZ_NOTCASESENSITIVE	2
 #define UNZ_OSDEFAULTCASE		0
 
+// compression methods of unz_file_info that can be read
+#define UNZ_STORED				0
+#define UNZ_DEFLATED			8
+
 extern int unzStringFileNameCompare (const char* fileName1, const char* fileName2, int iCaseSensitivity);
 
 /*
@@ -334,3 +338,29 @@ extern int unzGetLocalExtrafield (unzFile file, void* buf, unsigned len);
   the return value is the number of unsigned chars copied in buf, or (if <0) 
 	the error code
 */
+
+extern int unzGetCurrentFileLocation (unzFile file, unsigned long *localHeader);
+
+/*
+  Get the offset of the local header of the current file in the zipfile,
+  for unzReadLocalFile
+*/
+
+extern int unzReadLocalFile (const char *path, unsigned long localHeader, const unz_file_info *info, void *buf);
+
+/*
+  Read and decompress a whole file of the zipfile at path into buf, which
+  must hold info->uncompressed_size unsigned chars.  localHeader and info
+  come from unzGetCurrentFileLocation and unzGetCurrentFileInfo.
+  It doesn't use an unzFile or the zone, so it is safe from any thread.
+  return UNZ_OK if there is no problem
+*/
+
+extern int unzInflateBuffer (const void *compressed, unsigned long compressedSize, void *buf, unsigned long uncompressedSize);
+
+/*
+  Inflate the deflated data of a file into buf, which must hold
+  uncompressedSize unsigned chars.  Like inflate in unzOpenCurrentFile it
+  reads one dummy byte after the compressedSize ones.
+  return UNZ_OK if there is no problem
+*/
@@ -40,6 +40,10 @@ vm_t	*currentVM = NULL;
 vm_t	*lastVM    = NULL;
 int		vm_debugLevel;
 
+cvar_t	*vm_threadedInterpreter;
+cvar_t	*vm_elideBoundsChecks;
+cvar_t	*vm_syscallStats;
+
 // used by Com_Error to get rid of running vm's before longjmp
 static int forced_unload;
 
@@ -49,6 +53,9 @@ vm_t	vmTable[MAX_VM];
 
 void VM_VmInfo_f( void );
 void VM_VmProfile_f( void );
+#ifndef NO_VM_COMPILED
+static void VM_EndCompare( vm_t *vm );
+#endif
 
 
 
@@ -74,6 +81,13 @@ void VM_Init( void ) {
 	Cvar_Get( "vm_game", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_ui", "2", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
 
+	// these take effect when a vm is loaded
+	vm_threadedInterpreter = Cvar_Get( "vm_threadedInterpreter", "1", CVAR_ARCHIVE );
+	vm_elideBoundsChecks = Cvar_Get( "vm_elideBoundsChecks", "0", CVAR_ARCHIVE );	// trusted qvms only
+
+	// counts and times every syscall for vmprofile
+	vm_syscallStats = Cvar_Get( "vm_syscallStats", "0", 0 );
+
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
 
@@ -460,6 +474,104 @@ vmHeader_t *VM_LoadQVM( vm_t *vm, qboolean alloc ) {
 	return header;
 }
 
+/*
+=================
+VM_InstrumentedSystemCall
+=================
+*/
+static intptr_t VM_InstrumentedSystemCall( vm_t *vm, vmSyscall_t func, intptr_t *args ) {
+	vmSyscallStat_t	*stat;
+	uint64_t		start;
+	intptr_t		num, r;
+
+	num = args[0];
+	stat = NULL;
+	if ( vm_syscallStats->integer ) {
+		if ( !vm->syscallStats ) {
+			vm->syscallStats = Z_Malloc( MAX_SYSCALL_STATS * sizeof( *vm->syscallStats ) );
+		}
+		stat = &vm->syscallStats[ (uintptr_t)num < MAX_SYSCALL_STATS ? num : MAX_SYSCALL_STATS - 1 ];
+	}
+
+	if ( vm->profileSyscalls ) {
+		PROFILE_BEGIN( vm->syscallZone, num );
+	}
+	start = stat ? Sys_Microseconds() : 0;
+
+	r = func( args );
+
+	// the vm may have been freed by an error in the call,
+	// but then this never gets here
+	if ( stat ) {
+		stat->count++;
+		stat->usec += Sys_Microseconds() - start;
+	}
+	if ( vm->profileSyscalls ) {
+		PROFILE_END();
+	}
+
+	return r;
+}
+
+/*
+=================
+VM_DispatchSystemCall
+
+The systemCall of every vm
+=================
+*/
+static intptr_t VM_DispatchSystemCall( intptr_t *args ) {
+	vm_t		*vm = currentVM;
+	vmSyscall_t	func;
+
+	if ( (uintptr_t)args[0] < (uintptr_t)vm->numSyscalls && vm->syscallTable[args[0]] ) {
+		func = vm->syscallTable[args[0]];
+	} else {
+		func = vm->moduleSystemCall;
+	}
+
+	if ( vm->profileSyscalls || vm_syscallStats->integer ) {
+		return VM_InstrumentedSystemCall( vm, func, args );
+	}
+
+	return func( args );
+}
+
+/*
+=================
+VM_SetSyscallTable
+=================
+*/
+void VM_SetSyscallTable( vm_t *vm, const vmSyscall_t *table, int numSyscalls ) {
+	vm->syscallTable = table;
+	vm->numSyscalls = table ? numSyscalls : 0;
+}
+
+/*
+=================
+VM_DataImage
+=================
+*/
+byte *VM_DataImage( vm_t *vm, intptr_t *mask ) {
+	// dll arguments are real pointers and dataBase is NULL
+	*mask = vm->entryPoint ? -1 : vm->dataMask;
+	return vm->dataBase;
+}
+
+/*
+=================
+VM_ProfileSyscalls
+=================
+*/
+void VM_ProfileSyscalls( qboolean enable ) {
+	vm_t	*vm;
+	int		i;
+
+	for ( i = 0, vm = vmTable ; i < MAX_VM ; i++, vm++ ) {
+		vm->profileSyscalls = enable;
+	}
+}
+
 /*
 =================
 VM_Restart
@@ -475,13 +587,20 @@ vm_t *VM_Restart( vm_t *vm ) {
 	if ( vm->dllHandle ) {
 		char	name[MAX_QPATH];
 		intptr_t	(*systemCall)( intptr_t *parms );
+		const vmSyscall_t	*syscallTable;
+		int			numSyscalls;
 		
-		systemCall = vm->systemCall;	
+		systemCall = vm->moduleSystemCall;
+		syscallTable = vm->syscallTable;
+		numSyscalls = vm->numSyscalls;
 		Q_strncpyz( name, vm->name, sizeof( name ) );
 
 		VM_Free( vm );
 
 		vm = VM_Create( name, systemCall, VMI_NATIVE );
+		if ( vm ) {
+			VM_SetSyscallTable( vm, syscallTable, numSyscalls );
+		}
 		return vm;
 	}
 
@@ -544,7 +663,11 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 	vm = &vmTable[i];
 
 	Q_strncpyz( vm->name, module, sizeof( vm->name ) );
-	vm->systemCall = systemCalls;
+	vm->systemCall = VM_DispatchSystemCall;
+	vm->moduleSystemCall = systemCalls;
+
+	Com_sprintf( vm->syscallZone, sizeof( vm->syscallZone ), "%s syscall", vm->name );
+	vm->profileSyscalls = ( com_profiling && com_profileSyscalls->integer );
 
 	if ( interpret == VMI_NATIVE ) {
 		// try to load as a system dll
@@ -624,9 +747,19 @@ void VM_Free( vm_t *vm ) {
 		}
 	}
 
+	// an error in the middle of vm_interpreterBench or vm_compileCompare
+	VM_EndInterpreterBench();
+#ifndef NO_VM_COMPILED
+	VM_EndCompare( vm );
+#endif
+
 	if(vm->destroy)
 		vm->destroy(vm);
 
+	if ( vm->syscallStats ) {
+		Z_Free( vm->syscallStats );
+	}
+
 	if ( vm->dllHandle ) {
 		Sys_UnloadDll( vm->dllHandle );
 		Com_Memset( vm, 0, sizeof( *vm ) );
@@ -657,6 +790,12 @@ void VM_Clear(void) {
 
 void VM_Forced_Unload_Start(void) {
 	forced_unload = 1;
+
+	// an error may have cut the bench or the compare short in any vm
+	VM_EndInterpreterBench();
+#ifndef NO_VM_COMPILED
+	VM_EndCompare( NULL );
+#endif
 }
 
 void VM_Forced_Unload_Done(void) {
@@ -741,6 +880,8 @@ intptr_t	QDECL VM_Call( vm_t *vm, int callnum, ... ) {
 	  Com_Printf( "VM_Call( %d )\n", callnum );
 	}
 
+	PROFILE_BEGIN( vm->name, callnum );
+
 	++vm->callLevel;
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) {
@@ -787,6 +928,8 @@ intptr_t	QDECL VM_Call( vm_t *vm, int callnum, ... ) {
 	}
 	--vm->callLevel;
 
+	PROFILE_END();
+
 	if ( oldVM != NULL )
 	  currentVM = oldVM;
 	return r;
@@ -794,6 +937,345 @@ intptr_t	QDECL VM_Call( vm_t *vm, int callnum, ... ) {
 
 //=================================================================
 
+#ifndef NO_VM_COMPILED
+
+/*
+vm_compileCompare support: the same call is made with the interpreter
+and with code compiled for a shadow of the vm, recording the system
+calls of both.  The code between two system calls is one block, so the
+first differing system call tells which block the compiler got wrong.
+*/
+
+#define	MAX_COMPARE_SYSCALLS	8192
+
+typedef struct {
+	int			args[6];
+	int			programStack;
+} vmCompareSyscall_t;
+
+typedef struct {
+	vmCompareSyscall_t	*calls;
+	int					numCalls;		// may be past MAX_COMPARE_SYSCALLS
+} vmCompareRun_t;
+
+static vmCompareRun_t	*vm_compareRun;
+
+// everything VM_CompareCompiled has to undo, kept out of its stack frame
+// so VM_EndCompare can still undo it after an error in the call
+typedef struct {
+	vm_t				*vm;			// NULL when no compare is running
+	vm_t				shadow;
+	vmCompareRun_t		runs[2];
+	byte				*saved;			// the data before the runs
+	byte				*interpreted;	// the data after the interpreted run
+
+	// the vm's own code
+	qboolean			compiled;
+	byte				*codeBase;
+	int					codeLength;
+	int					*instructionPointers;
+	void				(*destroy)( vm_t *self );
+	intptr_t			(*systemCall)( intptr_t *parms );
+} vmCompare_t;
+
+static vmCompare_t		vm_compare;
+
+/*
+=================
+VM_CompareSystemCall
+=================
+*/
+static intptr_t VM_CompareSystemCall( intptr_t *args ) {
+	vmCompareSyscall_t	*call;
+	int					i;
+
+	if ( vm_compareRun && currentVM->callLevel == 1 ) {
+		if ( vm_compareRun->numCalls < MAX_COMPARE_SYSCALLS ) {
+			call = &vm_compareRun->calls[vm_compareRun->numCalls];
+			for ( i = 0 ; i < 6 ; i++ ) {
+				call->args[i] = args[i];
+			}
+			call->programStack = currentVM->programStack;
+		}
+		vm_compareRun->numCalls++;
+	}
+
+	return VM_DispatchSystemCall( args );
+}
+
+/*
+=================
+VM_LoadCompareHeader
+
+Reads the qvm again for VM_Compile, without touching the vm
+=================
+*/
+static vmHeader_t *VM_LoadCompareHeader( vm_t *vm ) {
+	char		filename[MAX_QPATH];
+	vmHeader_t	*header;
+	int			i, length, headerLength;
+
+	Com_sprintf( filename, sizeof( filename ), "vm/%s.qvm", vm->name );
+	length = FS_ReadFile( filename, (void **)&header );
+	if ( !header ) {
+		Com_Printf( "Couldn't read %s\n", filename );
+		return NULL;
+	}
+
+	if ( LittleLong( header->vmMagic ) == VM_MAGIC_VER2 ) {
+		headerLength = sizeof( vmHeader_t );
+	} else if ( LittleLong( header->vmMagic ) == VM_MAGIC ) {
+		headerLength = sizeof( vmHeader_t ) - sizeof( int );
+	} else {
+		headerLength = 0;
+	}
+	if ( !headerLength || length < headerLength ) {
+		Com_Printf( "%s has a bad header\n", filename );
+		FS_FreeFile( header );
+		return NULL;
+	}
+
+	for ( i = 0 ; i < headerLength / 4 ; i++ ) {
+		((int *)header)[i] = LittleLong( ((int *)header)[i] );
+	}
+
+	if ( header->instructionCount * 4 != vm->instructionPointersLength
+		|| header->codeOffset < 0 || header->codeLength <= 0
+		|| header->codeOffset + header->codeLength > length ) {
+		Com_Printf( "%s has changed since it was loaded\n", filename );
+		FS_FreeFile( header );
+		return NULL;
+	}
+
+	return header;
+}
+
+/*
+=================
+VM_RestoreCompared
+
+Gives the vm back its own code
+=================
+*/
+static void VM_RestoreCompared( void ) {
+	vm_t	*vm;
+
+	vm = vm_compare.vm;
+	vm->compiled = vm_compare.compiled;
+	vm->codeBase = vm_compare.codeBase;
+	vm->codeLength = vm_compare.codeLength;
+	vm->instructionPointers = vm_compare.instructionPointers;
+	vm->destroy = vm_compare.destroy;
+	vm->systemCall = vm_compare.systemCall;
+	vm_compareRun = NULL;
+}
+
+/*
+=================
+VM_EndCompare
+
+Restores the vm and frees everything VM_CompareCompiled allocated.
+When an error ends the compare in the middle of a call, VM_Free and
+VM_Forced_Unload_Start call this before the vm is used again.  With a
+vm, only ends a compare of that vm.
+=================
+*/
+static void VM_EndCompare( vm_t *vm ) {
+	int		mode;
+
+	if ( !vm_compare.vm || ( vm && vm != vm_compare.vm ) ) {
+		return;
+	}
+
+	VM_RestoreCompared();
+
+	for ( mode = 0 ; mode < 2 ; mode++ ) {
+		free( vm_compare.runs[mode].calls );
+	}
+	free( vm_compare.interpreted );
+	free( vm_compare.saved );
+
+	if ( vm_compare.shadow.destroy ) {
+		vm_compare.shadow.destroy( &vm_compare.shadow );
+	}
+	free( vm_compare.shadow.instructionPointers );
+
+	Com_Memset( &vm_compare, 0, sizeof( vm_compare ) );
+}
+
+/*
+=================
+VM_CompareCompiled
+
+Runs VM_Call( vm, callnum, arg ) on an interpreted vm, then puts the
+data back and runs it again with compiled code.  reset is called after
+the data has been put back, to resync outside state.  An error in
+either run drops the vm as usual, VM_EndCompare puts its own code back
+before it goes.  The buffers come from malloc, the data image is too
+big to copy into the zone.
+=================
+*/
+void VM_CompareCompiled( vm_t *vm, void (*reset)( void ), int callnum, int arg ) {
+	vmHeader_t		*header;
+	vm_t			*shadow;
+	vmCompareRun_t	*runs;
+	vmCompareSyscall_t	*a, *b;
+	intptr_t		result[2];
+	int				mode, i, j, size, numCalls;
+
+	if ( !vm || vm->dllHandle || vm->compiled ) {
+		Com_Printf( "%s is not interpreted, set vm_game 1 and restart the map\n", vm ? vm->name : "vm" );
+		return;
+	}
+	if ( vm->callLevel ) {
+		Com_Printf( "%s is running\n", vm->name );
+		return;
+	}
+
+	header = VM_LoadCompareHeader( vm );
+	if ( !header ) {
+		return;
+	}
+
+	// from here on VM_EndCompare undoes everything
+	VM_EndCompare( NULL );
+	vm_compare.vm = vm;
+	vm_compare.compiled = vm->compiled;
+	vm_compare.codeBase = vm->codeBase;
+	vm_compare.codeLength = vm->codeLength;
+	vm_compare.instructionPointers = vm->instructionPointers;
+	vm_compare.destroy = vm->destroy;
+	vm_compare.systemCall = vm->systemCall;
+
+	// compile for a shadow that has its own code and instruction pointers
+	shadow = &vm_compare.shadow;
+	*shadow = *vm;
+	shadow->destroy = NULL;
+	shadow->instructionPointers = malloc( vm->instructionPointersLength );
+	if ( !shadow->instructionPointers ) {
+		Com_Printf( "Couldn't allocate the instruction pointers for %s\n", vm->name );
+		FS_FreeFile( header );
+		VM_EndCompare( vm );
+		return;
+	}
+	shadow->compiled = qtrue;
+	VM_Compile( shadow, header );
+	FS_FreeFile( header );
+	if ( !shadow->compiled ) {
+		Com_Printf( "%s couldn't be compiled\n", vm->name );
+		VM_EndCompare( vm );
+		return;
+	}
+
+	size = vm->dataMask + 1;
+	runs = vm_compare.runs;
+	vm_compare.saved = malloc( size );
+	vm_compare.interpreted = malloc( vm->stackBottom );
+	for ( mode = 0 ; mode < 2 ; mode++ ) {
+		runs[mode].calls = malloc( MAX_COMPARE_SYSCALLS * sizeof( vmCompareSyscall_t ) );
+		runs[mode].numCalls = 0;
+	}
+	if ( !vm_compare.saved || !vm_compare.interpreted || !runs[0].calls || !runs[1].calls ) {
+		Com_Printf( "Couldn't allocate the buffers to compare %s\n", vm->name );
+		VM_EndCompare( vm );
+		return;
+	}
+	Com_Memcpy( vm_compare.saved, vm->dataBase, size );
+
+	vm->systemCall = VM_CompareSystemCall;
+	for ( mode = 0 ; mode < 2 ; mode++ ) {
+		Com_Memcpy( vm->dataBase, vm_compare.saved, size );
+		reset();
+
+		if ( mode == 1 ) {
+			vm->compiled = qtrue;
+			vm->codeBase = shadow->codeBase;
+			vm->codeLength = shadow->codeLength;
+			vm->instructionPointers = shadow->instructionPointers;
+			vm->destroy = shadow->destroy;
+		}
+
+		vm_compareRun = &runs[mode];
+		result[mode] = VM_Call( vm, callnum, arg );
+		vm_compareRun = NULL;
+
+		if ( mode == 0 ) {
+			// the stack is scratch, only compare the program data
+			Com_Memcpy( vm_compare.interpreted, vm->dataBase, vm->stackBottom );
+		}
+	}
+
+	VM_RestoreCompared();
+
+	Com_Printf( "%s call %i: %i system calls interpreted, %i compiled\n",
+		vm->name, callnum, runs[0].numCalls, runs[1].numCalls );
+
+	// the first system call that differs ends the first block that differs
+	numCalls = runs[0].numCalls < runs[1].numCalls ? runs[0].numCalls : runs[1].numCalls;
+	if ( numCalls > MAX_COMPARE_SYSCALLS ) {
+		numCalls = MAX_COMPARE_SYSCALLS;
+	}
+	for ( i = 0 ; i < numCalls ; i++ ) {
+		a = &runs[0].calls[i];
+		b = &runs[1].calls[i];
+		for ( j = 0 ; j < 6 ; j++ ) {
+			if ( a->args[j] != b->args[j] ) {
+				break;
+			}
+		}
+		if ( j < 6 || a->programStack != b->programStack ) {
+			break;
+		}
+	}
+	if ( i < numCalls ) {
+		a = &runs[0].calls[i];
+		b = &runs[1].calls[i];
+		Com_Printf( S_COLOR_YELLOW "block %i differs, it ends in system call %i:\n", i, i );
+		Com_Printf( "interpreted: %i ( %i %i %i %i %i ) stack 0x%x\n",
+			a->args[0], a->args[1], a->args[2], a->args[3], a->args[4], a->args[5], a->programStack );
+		Com_Printf( "compiled:    %i ( %i %i %i %i %i ) stack 0x%x\n",
+			b->args[0], b->args[1], b->args[2], b->args[3], b->args[4], b->args[5], b->programStack );
+	} else if ( runs[0].numCalls != runs[1].numCalls ) {
+		Com_Printf( S_COLOR_YELLOW "block %i differs, only one run made system call %i\n", i, i );
+	} else if ( result[0] != result[1] ) {
+		Com_Printf( S_COLOR_YELLOW "the last block differs, the call returned %i interpreted and %i compiled\n",
+			(int)result[0], (int)result[1] );
+	} else {
+		for ( i = 0 ; i < vm->stackBottom ; i++ ) {
+			if ( vm_compare.interpreted[i] != vm->dataBase[i] ) {
+				break;
+			}
+		}
+		if ( i < vm->stackBottom ) {
+			Com_Printf( S_COLOR_YELLOW "the data differs from 0x%x\n", i );
+		} else {
+			Com_Printf( "results match\n" );
+		}
+	}
+	// system calls that read the clock or other outside state can make
+	// the runs differ without a compiler bug
+
+	Com_Memcpy( vm->dataBase, vm_compare.saved, size );
+	reset();
+
+	VM_EndCompare( vm );
+}
+
+#else
+
+/*
+=================
+VM_CompareCompiled
+=================
+*/
+void VM_CompareCompiled( vm_t *vm, void (*reset)( void ), int callnum, int arg ) {
+	Com_Printf( "Architecture doesn't have a bytecode compiler\n" );
+}
+
+#endif
+
+//=================================================================
+
 static int QDECL VM_ProfileSort( const void *a, const void *b ) {
 	vmSymbol_t	*sa, *sb;
 
@@ -809,6 +1291,66 @@ static int QDECL VM_ProfileSort( const void *a, const void *b ) {
 	return 0;
 }
 
+static vmSyscallStat_t	*vm_sortStats;
+
+static int QDECL VM_SyscallStatSort( const void *a, const void *b ) {
+	vmSyscallStat_t	*sa, *sb;
+
+	sa = &vm_sortStats[ *(const int *)a ];
+	sb = &vm_sortStats[ *(const int *)b ];
+
+	if ( sa->usec > sb->usec ) {
+		return -1;
+	}
+	if ( sa->usec < sb->usec ) {
+		return 1;
+	}
+	return sb->count - sa->count;
+}
+
+/*
+==============
+VM_SyscallProfile
+
+Prints and clears the vm_syscallStats histogram of a vm, slowest first
+==============
+*/
+static void VM_SyscallProfile( vm_t *vm ) {
+	vmSyscallStat_t	*stat;
+	int			sorted[MAX_SYSCALL_STATS];
+	int			i, num, count;
+	uint64_t	total;
+
+	count = 0;
+	total = 0;
+	for ( i = 0 ; i < MAX_SYSCALL_STATS ; i++ ) {
+		if ( vm->syscallStats[i].count ) {
+			sorted[count++] = i;
+			total += vm->syscallStats[i].usec;
+		}
+	}
+	if ( !count ) {
+		return;
+	}
+
+	vm_sortStats = vm->syscallStats;
+	qsort( sorted, count, sizeof( sorted[0] ), VM_SyscallStatSort );
+
+	Com_Printf( "%s syscalls:\n", vm->name );
+	Com_Printf( "time      calls      usec   usec/call syscall\n" );
+	for ( i = 0 ; i < count ; i++ ) {
+		num = sorted[i];
+		stat = &vm->syscallStats[num];
+		Com_Printf( "%3i%% %9i %9u %11.2f %s%i\n",
+			total ? (int)( 100 * stat->usec / total ) : 0, stat->count,
+			(unsigned)stat->usec, (double)stat->usec / stat->count,
+			num == MAX_SYSCALL_STATS - 1 ? ">=" : "", num );
+	}
+	Com_Printf( "     %9u usec total\n", (unsigned)total );
+
+	Com_Memset( vm->syscallStats, 0, MAX_SYSCALL_STATS * sizeof( *vm->syscallStats ) );
+}
+
 /*
 ==============
 VM_VmProfile_f
@@ -821,6 +1363,12 @@ void VM_VmProfile_f( void ) {
 	int			i;
 	double		total;
 
+	for ( i = 0 ; i < MAX_VM ; i++ ) {
+		if ( vmTable[i].syscallStats ) {
+			VM_SyscallProfile( &vmTable[i] );
+		}
+	}
+
 	if ( !lastVM ) {
 		return;
 	}
@@ -880,7 +1428,7 @@ void VM_VmInfo_f( void ) {
 		if ( vm->compiled ) {
 			Com_Printf( "compiled on load\n" );
 		} else {
-			Com_Printf( "interpreted\n" );
+			Com_Printf( vm->instructions ? "interpreted, threaded\n" : "interpreted\n" );
 		}
 		Com_Printf( "    code length : %7i\n", vm->codeLength );
 		Com_Printf( "    table length: %7i\n", vm->instructionPointersLength );
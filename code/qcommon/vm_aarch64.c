@@ -0,0 +1,1066 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_aarch64.c -- load time compiler and execution environment for AArch64
+
+#include "vm_local.h"
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+/*
+
+  The instruction words are emitted directly, there is no assembler.
+  Like the other compilers this makes two passes over the code, the
+  first one only measures it to fill in vm->instructionPointers.
+
+  x0 - x7	helper call arguments
+  w8 - w15	top of the opStack, see below
+  x16, x17	scratch
+  x19		vm->dataBase
+  w20		vm->dataMask
+  x21		opStack memory
+  w22		programStack
+  x23		vm->instructionPointers
+  x24		start of generated code
+  w25		vm->dataMask & ~3, for aligned stores
+  w26		vm->stackBottom
+  w27		byte offset of the top of the opStack memory
+  x28		vmEntry_t of the current VM_CallCompiled
+  x30		qvm return addresses, saved on the native stack by OP_ENTER
+
+  Up to MAX_CACHED of the topmost opStack values are kept in w8 - w15
+  instead of memory.  The compiler tracks which register holds which
+  slot, so pushing and popping them costs nothing at run time.  They are
+  written back to memory before every jump target and every call, so
+  any path into an instruction finds the whole opStack in memory.
+
+  Jump targets are the branch arguments, the function entries and the
+  jump table targets of VM_MAGIC_VER2 files.  Older files don't list the
+  targets of switch tables, but lcc only jumps through those to case
+  labels, where the opStack is empty.
+
+  Every data access is masked inline with w20 or w25, and the opStack
+  offset in w27 wraps at OPSTACK_SIZE, so a bad qvm can't touch memory
+  outside of its own.
+
+*/
+
+#define	OPSTACK_SIZE		256				// ints
+#define	MAX_CACHED			4				// opStack slots kept in registers
+#define	FIRST_CACHE_REG		8
+#define	NUM_CACHE_REGS		8
+
+#define	R_DATA				19
+#define	R_MASK				20
+#define	R_OPSTACK			21
+#define	R_PSTACK			22
+#define	R_IPOINTERS			23
+#define	R_CODE				24
+#define	R_MASK4				25
+#define	R_BOTTOM			26
+#define	R_OPOFS				27
+#define	R_ENTRY				28
+#define	R_FP				29
+#define	R_LR				30
+#define	R_ZR				31
+#define	R_SP				31
+#define	R_TMP0				16
+#define	R_TMP1				17
+
+// condition codes
+#define	C_EQ				0
+#define	C_NE				1
+#define	C_HS				2
+#define	C_LO				3
+#define	C_MI				4
+#define	C_HI				8
+#define	C_LS				9
+#define	C_GE				10
+#define	C_LT				11
+#define	C_GT				12
+#define	C_LE				13
+
+// 32 bit data processing
+#define	A64_ADD(d,n,m)		( 0x0B000000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_SUB(d,n,m)		( 0x4B000000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_ADDI(d,n,i)		( 0x11000000 | ((i)<<10) | ((n)<<5) | (d) )
+#define	A64_SUBI(d,n,i)		( 0x51000000 | ((i)<<10) | ((n)<<5) | (d) )
+#define	A64_CMP(n,m)		( 0x6B00001F | ((m)<<16) | ((n)<<5) )
+#define	A64_AND(d,n,m)		( 0x0A000000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_ORR(d,n,m)		( 0x2A000000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_EOR(d,n,m)		( 0x4A000000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_MVN(d,m)		( 0x2A2003E0 | ((m)<<16) | (d) )
+#define	A64_MOV(d,m)		( 0x2A0003E0 | ((m)<<16) | (d) )
+#define	A64_NEG(d,m)		( 0x4B0003E0 | ((m)<<16) | (d) )
+#define	A64_MUL(d,n,m)		( 0x1B007C00 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_MSUB(d,n,m,a)	( 0x1B008000 | ((m)<<16) | ((a)<<10) | ((n)<<5) | (d) )
+#define	A64_SDIV(d,n,m)		( 0x1AC00C00 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_UDIV(d,n,m)		( 0x1AC00800 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_LSL(d,n,m)		( 0x1AC02000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_LSR(d,n,m)		( 0x1AC02400 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_ASR(d,n,m)		( 0x1AC02800 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_SXTB(d,n)		( 0x13001C00 | ((n)<<5) | (d) )
+#define	A64_SXTH(d,n)		( 0x13003C00 | ((n)<<5) | (d) )
+#define	A64_MOVZ(d,i,hw)	( 0x52800000 | ((hw)<<21) | ((i)<<5) | (d) )
+#define	A64_MOVN(d,i,hw)	( 0x12800000 | ((hw)<<21) | ((i)<<5) | (d) )
+#define	A64_MOVK(d,i,hw)	( 0x72800000 | ((hw)<<21) | ((i)<<5) | (d) )
+// and with a run of ones rotated right by immr
+#define	A64_ANDI(d,n,immr,imms)	( 0x12000000 | ((immr)<<16) | ((imms)<<10) | ((n)<<5) | (d) )
+#define	A64_AND_OPSTACK(d,n)	A64_ANDI( d, n, 30, 7 )		// & ( OPSTACK_SIZE - 1 ) * 4
+#define	A64_AND_NOT3(d,n)		A64_ANDI( d, n, 30, 29 )	// & ~3
+#define	A64_AND_NOT1(d,n)		A64_ANDI( d, n, 31, 30 )	// & ~1
+
+// 64 bit
+#define	A64_ADDX(d,n,m)		( 0x8B000000 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_MOVX(d,m)		( 0xAA0003E0 | ((m)<<16) | (d) )
+#define	A64_MOVSPX(d,n)		( 0x91000000 | ((n)<<5) | (d) )			// mov to or from sp
+#define	A64_LDRX(t,n,o)		( 0xF9400000 | (((o)>>3)<<10) | ((n)<<5) | (t) )
+#define	A64_LDRW(t,n,o)		( 0xB9400000 | (((o)>>2)<<10) | ((n)<<5) | (t) )
+#define	A64_STRW(t,n,o)		( 0xB9000000 | (((o)>>2)<<10) | ((n)<<5) | (t) )
+#define	A64_STP_PRE(a,b,n,o)	( 0xA9800000 | ((((o)>>3)&0x7F)<<15) | ((b)<<10) | ((n)<<5) | (a) )
+#define	A64_LDP_POST(a,b,n,o)	( 0xA8C00000 | ((((o)>>3)&0x7F)<<15) | ((b)<<10) | ((n)<<5) | (a) )
+#define	A64_STP(a,b,n,o)	( 0xA9000000 | ((((o)>>3)&0x7F)<<15) | ((b)<<10) | ((n)<<5) | (a) )
+#define	A64_LDP(a,b,n,o)	( 0xA9400000 | ((((o)>>3)&0x7F)<<15) | ((b)<<10) | ((n)<<5) | (a) )
+#define	A64_STRX_PRE(t,n,o)	( 0xF8000C00 | (((o)&0x1FF)<<12) | ((n)<<5) | (t) )
+#define	A64_LDRX_POST(t,n,o)	( 0xF8400400 | (((o)&0x1FF)<<12) | ((n)<<5) | (t) )
+
+// [xn, wm, uxtw]
+#define	A64_LDRB_R(t,n,m)	( 0x38604800 | ((m)<<16) | ((n)<<5) | (t) )
+#define	A64_LDRH_R(t,n,m)	( 0x78604800 | ((m)<<16) | ((n)<<5) | (t) )
+#define	A64_LDR_R(t,n,m)	( 0xB8604800 | ((m)<<16) | ((n)<<5) | (t) )
+#define	A64_LDR_R2(t,n,m)	( 0xB8605800 | ((m)<<16) | ((n)<<5) | (t) )	// wm scaled by 4
+#define	A64_STRB_R(t,n,m)	( 0x38204800 | ((m)<<16) | ((n)<<5) | (t) )
+#define	A64_STRH_R(t,n,m)	( 0x78204800 | ((m)<<16) | ((n)<<5) | (t) )
+#define	A64_STR_R(t,n,m)	( 0xB8204800 | ((m)<<16) | ((n)<<5) | (t) )
+
+// single precision
+#define	A64_FMOV_SW(d,n)	( 0x1E270000 | ((n)<<5) | (d) )
+#define	A64_FMOV_WS(d,n)	( 0x1E260000 | ((n)<<5) | (d) )
+#define	A64_FADD(d,n,m)		( 0x1E202800 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_FSUB(d,n,m)		( 0x1E203800 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_FMUL(d,n,m)		( 0x1E200800 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_FDIV(d,n,m)		( 0x1E201800 | ((m)<<16) | ((n)<<5) | (d) )
+#define	A64_FNEG(d,n)		( 0x1E214000 | ((n)<<5) | (d) )
+#define	A64_FCMP(n,m)		( 0x1E202000 | ((m)<<16) | ((n)<<5) )
+#define	A64_SCVTF(d,n)		( 0x1E220000 | ((n)<<5) | (d) )
+#define	A64_FCVTZS(d,n)		( 0x1E380000 | ((n)<<5) | (d) )
+
+// branches, displacements are in instructions
+#define	A64_B				0x14000000
+#define	A64_BL				0x94000000
+#define	A64_BCOND(c,disp)	( 0x54000000 | (((disp)&0x7FFFF)<<5) | (c) )
+#define	A64_TBNZ31(t,disp)	( 0x37F80000 | (((disp)&0x3FFF)<<5) | (t) )
+#define	A64_BR(n)			( 0xD61F0000 | ((n)<<5) )
+#define	A64_BLR(n)			( 0xD63F0000 | ((n)<<5) )
+#define	A64_RET				0xD65F03C0
+#define	A64_BRK				0xD4200000
+
+typedef enum {
+	VMERR_STACK_OVERFLOW,
+	VMERR_BAD_CALL,
+	VMERR_BAD_JUMP,
+	VMERR_UNDEF
+} vmError_t;
+
+// filled in by VM_CallCompiled, the generated code keeps it in x28
+typedef struct {
+	byte		*dataBase;
+	byte		*codeBase;
+	int			*instructionPointers;
+	int			*opStack;
+	int			dataMask;
+	int			programStack;
+	int			opStackOfs;
+	int			stackBottom;
+	int			(*systemCall)( int programStack, int syscallNum );
+	void		(*blockCopy)( unsigned dest, unsigned src, unsigned count );
+	void		(*error)( int error );
+} vmEntry_t;
+
+static unsigned	*jitCode;			// NULL in the measuring pass
+static int		jitOfs;				// bytes
+static int		errorStubOfs;		// VM_ErrorArm64 with the code in w0
+
+static int		cacheRegs[MAX_CACHED];	// [0] is the deepest slot
+static int		numCached;
+static int		busyRegs;			// registers used by the current instruction
+
+static void VM_Destroy_Compiled( vm_t *self );
+
+/*
+=================
+VM_SystemCallArm64
+
+Called from the generated code for negative OP_CALL targets
+=================
+*/
+static int VM_SystemCallArm64( int programStack, int syscallNum ) {
+	vm_t		*savedVM;
+	intptr_t	args[16];
+	int			i, r;
+
+	savedVM = currentVM;
+
+	// save the stack to allow recursive VM entry
+	currentVM->programStack = programStack - 4;
+
+	args[0] = syscallNum;
+	for ( i = 1 ; i < 16 ; i++ ) {
+		args[i] = *(int *)&currentVM->dataBase[ ( programStack + 4 + 4 * i ) & currentVM->dataMask ];
+	}
+	r = currentVM->systemCall( args );
+
+	currentVM = savedVM;
+
+	return r;
+}
+
+/*
+=================
+VM_BlockCopyArm64
+=================
+*/
+static void VM_BlockCopyArm64( unsigned dest, unsigned src, unsigned count ) {
+	unsigned	dataMask = currentVM->dataMask;
+
+	if ( ( dest & dataMask ) != dest
+		|| ( src & dataMask ) != src
+		|| ( ( dest + count ) & dataMask ) != dest + count
+		|| ( ( src + count ) & dataMask ) != src + count ) {
+		Com_Error( ERR_DROP, "OP_BLOCK_COPY out of range!" );
+	}
+
+	// like the interpreter, only whole words are copied
+	memmove( currentVM->dataBase + dest, currentVM->dataBase + src, count & ~3 );
+}
+
+/*
+=================
+VM_ErrorArm64
+=================
+*/
+static void VM_ErrorArm64( int error ) {
+	switch ( error ) {
+	case VMERR_STACK_OVERFLOW:
+		Com_Error( ERR_DROP, "VM stack overflow" );
+	case VMERR_BAD_CALL:
+		Com_Error( ERR_DROP, "VM program counter out of range in OP_CALL" );
+	case VMERR_BAD_JUMP:
+		Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
+	default:
+		Com_Error( ERR_DROP, "VM OP_UNDEF" );
+	}
+}
+
+/*
+=============================================================================
+
+EMITTING
+
+=============================================================================
+*/
+
+static void Emit( unsigned insn ) {
+	if ( jitCode ) {
+		jitCode[ jitOfs >> 2 ] = insn;
+	}
+	jitOfs += 4;
+}
+
+/*
+=================
+EmitBranch
+
+b or bl to a code offset, which isn't known yet in the measuring pass
+=================
+*/
+static void EmitBranch( unsigned insn, int target ) {
+	Emit( insn | ( ( ( target - jitOfs ) >> 2 ) & 0x3FFFFFF ) );
+}
+
+/*
+=================
+EmitError
+
+Calls VM_ErrorArm64 unless the flags satisfy cond
+=================
+*/
+static void EmitError( int cond, vmError_t error ) {
+	Emit( A64_BCOND( cond, 3 ) );
+	Emit( A64_MOVZ( 0, error, 0 ) );
+	EmitBranch( A64_BL, errorStubOfs );
+}
+
+static void EmitMovImm( int r, int value ) {
+	unsigned	v = value;
+
+	if ( v < 0x10000 ) {
+		Emit( A64_MOVZ( r, v, 0 ) );
+	} else if ( ~v < 0x10000 ) {
+		Emit( A64_MOVN( r, ~v, 0 ) );
+	} else if ( !( v & 0xFFFF ) ) {
+		Emit( A64_MOVZ( r, v >> 16, 1 ) );
+	} else {
+		Emit( A64_MOVZ( r, v & 0xFFFF, 0 ) );
+		Emit( A64_MOVK( r, v >> 16, 1 ) );
+	}
+}
+
+static void EmitAddImm( int d, int n, int value ) {
+	if ( value >= 0 && value < 4096 ) {
+		Emit( A64_ADDI( d, n, value ) );
+	} else if ( value < 0 && value > -4096 ) {
+		Emit( A64_SUBI( d, n, -value ) );
+	} else {
+		EmitMovImm( R_TMP1, value );
+		Emit( A64_ADD( d, n, R_TMP1 ) );
+	}
+}
+
+/*
+=================
+EmitCallHelper
+
+Calls one of the C functions in vmEntry_t
+=================
+*/
+static void EmitCallHelper( int offset ) {
+	Emit( A64_LDRX( R_TMP0, R_ENTRY, offset ) );
+	Emit( A64_BLR( R_TMP0 ) );
+}
+
+/*
+=============================================================================
+
+OPSTACK REGISTERS
+
+=============================================================================
+*/
+
+static void EmitPushMemory( int r ) {
+	Emit( A64_ADDI( R_OPOFS, R_OPOFS, 4 ) );
+	Emit( A64_AND_OPSTACK( R_OPOFS, R_OPOFS ) );
+	Emit( A64_STR_R( r, R_OPSTACK, R_OPOFS ) );
+}
+
+static void EmitPopMemory( int r ) {
+	Emit( A64_LDR_R( r, R_OPSTACK, R_OPOFS ) );
+	Emit( A64_SUBI( R_OPOFS, R_OPOFS, 4 ) );
+	Emit( A64_AND_OPSTACK( R_OPOFS, R_OPOFS ) );
+}
+
+/*
+=================
+AllocReg
+
+A register that holds no opStack slot and isn't used by the
+current instruction yet
+=================
+*/
+static int AllocReg( void ) {
+	int		i, r, used;
+
+	used = busyRegs;
+	for ( i = 0 ; i < numCached ; i++ ) {
+		used |= 1 << cacheRegs[i];
+	}
+	for ( r = FIRST_CACHE_REG ; r < FIRST_CACHE_REG + NUM_CACHE_REGS ; r++ ) {
+		if ( !( used & ( 1 << r ) ) ) {
+			busyRegs |= 1 << r;
+			return r;
+		}
+	}
+
+	// MAX_CACHED plus the three operands of the widest instruction fit
+	Com_Error( ERR_FATAL, "VM_Compile: out of registers" );
+	return -1;
+}
+
+/*
+=================
+PopReg
+
+The register with the top of the opStack, which is removed from it
+=================
+*/
+static int PopReg( void ) {
+	int		r;
+
+	if ( numCached ) {
+		r = cacheRegs[ --numCached ];
+		busyRegs |= 1 << r;
+		return r;
+	}
+
+	r = AllocReg();
+	EmitPopMemory( r );
+	return r;
+}
+
+/*
+=================
+PushReg
+
+Makes r the top of the opStack, spilling the deepest cached
+slot if there is no room
+=================
+*/
+static void PushReg( int r ) {
+	int		i;
+
+	if ( numCached == MAX_CACHED ) {
+		EmitPushMemory( cacheRegs[0] );
+		for ( i = 1 ; i < MAX_CACHED ; i++ ) {
+			cacheRegs[i - 1] = cacheRegs[i];
+		}
+		numCached--;
+	}
+	cacheRegs[ numCached++ ] = r;
+}
+
+/*
+=================
+FlushCache
+
+Writes all cached slots to the opStack memory
+=================
+*/
+static void FlushCache( void ) {
+	int		i;
+
+	for ( i = 0 ; i < numCached ; i++ ) {
+		EmitPushMemory( cacheRegs[i] );
+	}
+	numCached = 0;
+}
+
+/*
+=============================================================================
+
+COMPILING
+
+=============================================================================
+*/
+
+/*
+=================
+EmitPrologue
+
+The VM_CallCompiled entry point and the error stub
+=================
+*/
+static void EmitPrologue( vm_t *vm ) {
+	Emit( A64_STP_PRE( R_FP, R_LR, R_SP, -96 ) );
+	Emit( A64_MOVSPX( R_FP, R_SP ) );
+	Emit( A64_STP( 19, 20, R_SP, 16 ) );
+	Emit( A64_STP( 21, 22, R_SP, 32 ) );
+	Emit( A64_STP( 23, 24, R_SP, 48 ) );
+	Emit( A64_STP( 25, 26, R_SP, 64 ) );
+	Emit( A64_STP( 27, 28, R_SP, 80 ) );
+
+	Emit( A64_MOVX( R_ENTRY, 0 ) );
+	Emit( A64_LDRX( R_DATA, R_ENTRY, offsetof( vmEntry_t, dataBase ) ) );
+	Emit( A64_LDRX( R_CODE, R_ENTRY, offsetof( vmEntry_t, codeBase ) ) );
+	Emit( A64_LDRX( R_IPOINTERS, R_ENTRY, offsetof( vmEntry_t, instructionPointers ) ) );
+	Emit( A64_LDRX( R_OPSTACK, R_ENTRY, offsetof( vmEntry_t, opStack ) ) );
+	Emit( A64_LDRW( R_MASK, R_ENTRY, offsetof( vmEntry_t, dataMask ) ) );
+	Emit( A64_LDRW( R_PSTACK, R_ENTRY, offsetof( vmEntry_t, programStack ) ) );
+	Emit( A64_LDRW( R_OPOFS, R_ENTRY, offsetof( vmEntry_t, opStackOfs ) ) );
+	Emit( A64_LDRW( R_BOTTOM, R_ENTRY, offsetof( vmEntry_t, stackBottom ) ) );
+	Emit( A64_AND_NOT3( R_MASK4, R_MASK ) );
+
+	// vmMain is always the first instruction
+	EmitBranch( A64_BL, vm->instructionPointers[0] );
+
+	Emit( A64_STRW( R_PSTACK, R_ENTRY, offsetof( vmEntry_t, programStack ) ) );
+	Emit( A64_STRW( R_OPOFS, R_ENTRY, offsetof( vmEntry_t, opStackOfs ) ) );
+	Emit( A64_LDP( 19, 20, R_SP, 16 ) );
+	Emit( A64_LDP( 21, 22, R_SP, 32 ) );
+	Emit( A64_LDP( 23, 24, R_SP, 48 ) );
+	Emit( A64_LDP( 25, 26, R_SP, 64 ) );
+	Emit( A64_LDP( 27, 28, R_SP, 80 ) );
+	Emit( A64_LDP_POST( R_FP, R_LR, R_SP, 96 ) );
+	Emit( A64_RET );
+
+	// the error code is in w0, VM_ErrorArm64 doesn't return
+	errorStubOfs = jitOfs;
+	Emit( A64_LDRX( R_TMP0, R_ENTRY, offsetof( vmEntry_t, error ) ) );
+	Emit( A64_BR( R_TMP0 ) );
+}
+
+/*
+=================
+EmitCompareJump
+
+Both operands are popped before the cache is flushed, so the
+branch leaves with the whole opStack in memory
+=================
+*/
+static void EmitCompareJump( vm_t *vm, int cond, qboolean isFloat, int target ) {
+	int		a, b;
+
+	b = PopReg();
+	a = PopReg();
+	FlushCache();
+
+	if ( isFloat ) {
+		Emit( A64_FMOV_SW( 0, a ) );
+		Emit( A64_FMOV_SW( 1, b ) );
+		Emit( A64_FCMP( 0, 1 ) );
+	} else {
+		Emit( A64_CMP( a, b ) );
+	}
+
+	// b.cond only reaches 1MB, so skip over an unconditional branch
+	Emit( A64_BCOND( cond ^ 1, 2 ) );
+	EmitBranch( A64_B, vm->instructionPointers[target] );
+}
+
+/*
+=================
+EmitCallTarget
+
+Calls the qvm function or system call with the number in r
+=================
+*/
+static void EmitCallTarget( vm_t *vm, int r, int instructionCount ) {
+	int		toSyscall, toEnd;
+
+	FlushCache();
+
+	toSyscall = jitOfs;
+	Emit( A64_TBNZ31( r, 0 ) );
+
+	EmitMovImm( R_TMP1, instructionCount );
+	Emit( A64_CMP( r, R_TMP1 ) );
+	EmitError( C_LO, VMERR_BAD_CALL );
+	Emit( A64_LDR_R2( R_TMP0, R_IPOINTERS, r ) );
+	Emit( A64_ADDX( R_TMP0, R_CODE, R_TMP0 ) );
+	Emit( A64_BLR( R_TMP0 ) );
+	toEnd = jitOfs;
+	Emit( A64_B );
+
+	// system call, the result goes to memory as well
+	if ( jitCode ) {
+		jitCode[ toSyscall >> 2 ] = A64_TBNZ31( r, ( jitOfs - toSyscall ) >> 2 );
+	}
+	Emit( A64_MOV( 0, R_PSTACK ) );
+	Emit( A64_MVN( 1, r ) );
+	EmitCallHelper( offsetof( vmEntry_t, systemCall ) );
+	EmitPushMemory( 0 );
+
+	if ( jitCode ) {
+		jitCode[ toEnd >> 2 ] = A64_B | ( ( jitOfs - toEnd ) >> 2 );
+	}
+}
+
+/*
+=================
+VM_FindJumpTargets
+
+Marks the instructions that can be reached other than by falling
+through, the opStack registers are flushed before those
+=================
+*/
+static qboolean VM_FindJumpTargets( vm_t *vm, const int *ops, const int *args, int count, byte *targets ) {
+	int		i, t;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		t = -1;
+		if ( ops[i] >= OP_EQ && ops[i] <= OP_GEF ) {
+			t = args[i];
+		} else if ( ops[i] == OP_ENTER ) {
+			targets[i] = 1;
+		} else if ( ( ops[i] == OP_JUMP || ops[i] == OP_CALL ) && i > 0 && ops[i - 1] == OP_CONST ) {
+			t = args[i - 1];
+			if ( ops[i] == OP_CALL && t < 0 ) {
+				continue;
+			}
+		} else {
+			continue;
+		}
+
+		if ( t < 0 || t >= count ) {
+			if ( ops[i] >= OP_EQ && ops[i] <= OP_GEF ) {
+				Com_Printf( S_COLOR_YELLOW "VM_Compile: %s branches out of range at %i\n", vm->name, i );
+				return qfalse;
+			}
+			continue;	// errors at run time
+		}
+		targets[t] = 1;
+	}
+
+	for ( i = 0 ; i < vm->numJumpTableTargets ; i++ ) {
+		t = ((int *)vm->jumpTableTargets)[i];
+		if ( t >= 0 && t < count ) {
+			targets[t] = 1;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+VM_CompileInstructions
+
+One pass over the code, only measuring it if jitCode is NULL
+=================
+*/
+static void VM_CompileInstructions( vm_t *vm, const int *ops, const int *args, const byte *targets, int count ) {
+	int		i, op, arg, a, b, d;
+
+	jitOfs = 0;
+	numCached = 0;
+
+	EmitPrologue( vm );
+
+	for ( i = 0 ; i < count ; i++ ) {
+		op = ops[i];
+		arg = args[i];
+
+		if ( targets[i] ) {
+			FlushCache();
+		}
+		vm->instructionPointers[i] = jitOfs;
+		busyRegs = 0;
+
+		switch ( op ) {
+		case OP_UNDEF:
+			Emit( A64_MOVZ( 0, VMERR_UNDEF, 0 ) );
+			EmitBranch( A64_BL, errorStubOfs );
+			break;
+		case OP_IGNORE:
+			break;
+		case OP_BREAK:
+			Emit( A64_BRK );
+			break;
+
+		case OP_ENTER:
+			Emit( A64_STRX_PRE( R_LR, R_SP, -16 ) );
+			EmitAddImm( R_PSTACK, R_PSTACK, -arg );
+			Emit( A64_CMP( R_PSTACK, R_BOTTOM ) );
+			EmitError( C_GE, VMERR_STACK_OVERFLOW );
+			break;
+		case OP_LEAVE:
+			EmitAddImm( R_PSTACK, R_PSTACK, arg );
+			FlushCache();
+			Emit( A64_LDRX_POST( R_LR, R_SP, 16 ) );
+			Emit( A64_RET );
+			break;
+
+		case OP_CONST:
+			// calls and jumps to constants are direct
+			if ( i + 1 < count && !targets[i + 1] && ( ops[i + 1] == OP_CALL || ops[i + 1] == OP_JUMP ) ) {
+				i++;
+				vm->instructionPointers[i] = jitOfs;
+				FlushCache();
+				if ( ops[i] == OP_CALL && arg < 0 ) {
+					Emit( A64_MOV( 0, R_PSTACK ) );
+					EmitMovImm( 1, -1 - arg );
+					EmitCallHelper( offsetof( vmEntry_t, systemCall ) );
+					d = AllocReg();
+					Emit( A64_MOV( d, 0 ) );
+					PushReg( d );
+				} else if ( arg < 0 || arg >= count ) {
+					Emit( A64_MOVZ( 0, ops[i] == OP_CALL ? VMERR_BAD_CALL : VMERR_BAD_JUMP, 0 ) );
+					EmitBranch( A64_BL, errorStubOfs );
+				} else {
+					EmitBranch( ops[i] == OP_CALL ? A64_BL : A64_B, vm->instructionPointers[arg] );
+				}
+				break;
+			}
+			d = AllocReg();
+			EmitMovImm( d, arg );
+			PushReg( d );
+			break;
+		case OP_LOCAL:
+			d = AllocReg();
+			EmitAddImm( d, R_PSTACK, arg );
+			PushReg( d );
+			break;
+
+		case OP_CALL:
+			a = PopReg();
+			EmitCallTarget( vm, a, count );
+			break;
+		case OP_JUMP:
+			a = PopReg();
+			FlushCache();
+			EmitMovImm( R_TMP1, count );
+			Emit( A64_CMP( a, R_TMP1 ) );
+			EmitError( C_LO, VMERR_BAD_JUMP );
+			Emit( A64_LDR_R2( R_TMP0, R_IPOINTERS, a ) );
+			Emit( A64_ADDX( R_TMP0, R_CODE, R_TMP0 ) );
+			Emit( A64_BR( R_TMP0 ) );
+			break;
+
+		// push and pop are only needed for discarded or bad function return values
+		case OP_PUSH:
+			d = AllocReg();
+			Emit( A64_MOV( d, R_ZR ) );
+			PushReg( d );
+			break;
+		case OP_POP:
+			if ( numCached ) {
+				numCached--;
+			} else {
+				Emit( A64_SUBI( R_OPOFS, R_OPOFS, 4 ) );
+				Emit( A64_AND_OPSTACK( R_OPOFS, R_OPOFS ) );
+			}
+			break;
+
+		case OP_EQ:		EmitCompareJump( vm, C_EQ, qfalse, arg );	break;
+		case OP_NE:		EmitCompareJump( vm, C_NE, qfalse, arg );	break;
+		case OP_LTI:	EmitCompareJump( vm, C_LT, qfalse, arg );	break;
+		case OP_LEI:	EmitCompareJump( vm, C_LE, qfalse, arg );	break;
+		case OP_GTI:	EmitCompareJump( vm, C_GT, qfalse, arg );	break;
+		case OP_GEI:	EmitCompareJump( vm, C_GE, qfalse, arg );	break;
+		case OP_LTU:	EmitCompareJump( vm, C_LO, qfalse, arg );	break;
+		case OP_LEU:	EmitCompareJump( vm, C_LS, qfalse, arg );	break;
+		case OP_GTU:	EmitCompareJump( vm, C_HI, qfalse, arg );	break;
+		case OP_GEU:	EmitCompareJump( vm, C_HS, qfalse, arg );	break;
+		// these are false when either side is a NaN, except for NEF
+		case OP_EQF:	EmitCompareJump( vm, C_EQ, qtrue, arg );	break;
+		case OP_NEF:	EmitCompareJump( vm, C_NE, qtrue, arg );	break;
+		case OP_LTF:	EmitCompareJump( vm, C_MI, qtrue, arg );	break;
+		case OP_LEF:	EmitCompareJump( vm, C_LS, qtrue, arg );	break;
+		case OP_GTF:	EmitCompareJump( vm, C_GT, qtrue, arg );	break;
+		case OP_GEF:	EmitCompareJump( vm, C_GE, qtrue, arg );	break;
+
+		case OP_LOAD1:
+			a = PopReg();
+			Emit( A64_AND( R_TMP0, a, R_MASK ) );
+			Emit( A64_LDRB_R( a, R_DATA, R_TMP0 ) );
+			PushReg( a );
+			break;
+		case OP_LOAD2:
+			a = PopReg();
+			Emit( A64_AND( R_TMP0, a, R_MASK ) );
+			Emit( A64_LDRH_R( a, R_DATA, R_TMP0 ) );
+			PushReg( a );
+			break;
+		case OP_LOAD4:
+			a = PopReg();
+			Emit( A64_AND( R_TMP0, a, R_MASK ) );
+			Emit( A64_LDR_R( a, R_DATA, R_TMP0 ) );
+			PushReg( a );
+			break;
+		case OP_STORE1:
+			b = PopReg();
+			a = PopReg();
+			Emit( A64_AND( R_TMP0, a, R_MASK ) );
+			Emit( A64_STRB_R( b, R_DATA, R_TMP0 ) );
+			break;
+		case OP_STORE2:
+			b = PopReg();
+			a = PopReg();
+			Emit( A64_AND( R_TMP0, a, R_MASK ) );
+			Emit( A64_AND_NOT1( R_TMP0, R_TMP0 ) );
+			Emit( A64_STRH_R( b, R_DATA, R_TMP0 ) );
+			break;
+		case OP_STORE4:
+			b = PopReg();
+			a = PopReg();
+			Emit( A64_AND( R_TMP0, a, R_MASK4 ) );
+			Emit( A64_STR_R( b, R_DATA, R_TMP0 ) );
+			break;
+		case OP_ARG:
+			a = PopReg();
+			Emit( A64_ADDI( R_TMP0, R_PSTACK, arg ) );
+			Emit( A64_AND( R_TMP0, R_TMP0, R_MASK ) );
+			Emit( A64_STR_R( a, R_DATA, R_TMP0 ) );
+			break;
+		case OP_BLOCK_COPY:
+			b = PopReg();
+			a = PopReg();
+			FlushCache();
+			Emit( A64_MOV( 0, a ) );
+			Emit( A64_MOV( 1, b ) );
+			EmitMovImm( 2, arg );
+			EmitCallHelper( offsetof( vmEntry_t, blockCopy ) );
+			break;
+
+		case OP_SEX8:
+			a = PopReg();
+			Emit( A64_SXTB( a, a ) );
+			PushReg( a );
+			break;
+		case OP_SEX16:
+			a = PopReg();
+			Emit( A64_SXTH( a, a ) );
+			PushReg( a );
+			break;
+		case OP_NEGI:
+			a = PopReg();
+			Emit( A64_NEG( a, a ) );
+			PushReg( a );
+			break;
+		case OP_BCOM:
+			a = PopReg();
+			Emit( A64_MVN( a, a ) );
+			PushReg( a );
+			break;
+
+		case OP_ADD:
+		case OP_SUB:
+		case OP_DIVI:
+		case OP_DIVU:
+		case OP_MODI:
+		case OP_MODU:
+		case OP_MULI:
+		case OP_MULU:
+		case OP_BAND:
+		case OP_BOR:
+		case OP_BXOR:
+		case OP_LSH:
+		case OP_RSHI:
+		case OP_RSHU:
+			b = PopReg();
+			a = PopReg();
+			switch ( op ) {
+			case OP_ADD:	Emit( A64_ADD( a, a, b ) );		break;
+			case OP_SUB:	Emit( A64_SUB( a, a, b ) );		break;
+			case OP_DIVI:	Emit( A64_SDIV( a, a, b ) );	break;
+			case OP_DIVU:	Emit( A64_UDIV( a, a, b ) );	break;
+			case OP_MODI:
+				Emit( A64_SDIV( R_TMP0, a, b ) );
+				Emit( A64_MSUB( a, R_TMP0, b, a ) );
+				break;
+			case OP_MODU:
+				Emit( A64_UDIV( R_TMP0, a, b ) );
+				Emit( A64_MSUB( a, R_TMP0, b, a ) );
+				break;
+			case OP_MULI:
+			case OP_MULU:	Emit( A64_MUL( a, a, b ) );		break;
+			case OP_BAND:	Emit( A64_AND( a, a, b ) );		break;
+			case OP_BOR:	Emit( A64_ORR( a, a, b ) );		break;
+			case OP_BXOR:	Emit( A64_EOR( a, a, b ) );		break;
+			case OP_LSH:	Emit( A64_LSL( a, a, b ) );		break;
+			case OP_RSHI:	Emit( A64_ASR( a, a, b ) );		break;
+			case OP_RSHU:	Emit( A64_LSR( a, a, b ) );		break;
+			}
+			PushReg( a );
+			break;
+
+		case OP_NEGF:
+			a = PopReg();
+			Emit( A64_FMOV_SW( 0, a ) );
+			Emit( A64_FNEG( 0, 0 ) );
+			Emit( A64_FMOV_WS( a, 0 ) );
+			PushReg( a );
+			break;
+		case OP_ADDF:
+		case OP_SUBF:
+		case OP_DIVF:
+		case OP_MULF:
+			b = PopReg();
+			a = PopReg();
+			Emit( A64_FMOV_SW( 0, a ) );
+			Emit( A64_FMOV_SW( 1, b ) );
+			switch ( op ) {
+			case OP_ADDF:	Emit( A64_FADD( 0, 0, 1 ) );	break;
+			case OP_SUBF:	Emit( A64_FSUB( 0, 0, 1 ) );	break;
+			case OP_DIVF:	Emit( A64_FDIV( 0, 0, 1 ) );	break;
+			case OP_MULF:	Emit( A64_FMUL( 0, 0, 1 ) );	break;
+			}
+			Emit( A64_FMOV_WS( a, 0 ) );
+			PushReg( a );
+			break;
+		case OP_CVIF:
+			a = PopReg();
+			Emit( A64_SCVTF( 0, a ) );
+			Emit( A64_FMOV_WS( a, 0 ) );
+			PushReg( a );
+			break;
+		case OP_CVFI:
+			a = PopReg();
+			Emit( A64_FMOV_SW( 0, a ) );
+			Emit( A64_FCVTZS( a, 0 ) );
+			PushReg( a );
+			break;
+		}
+	}
+
+	// falling off the end
+	FlushCache();
+	Emit( A64_BRK );
+}
+
+/*
+=================
+VM_Compile
+=================
+*/
+void VM_Compile( vm_t *vm, vmHeader_t *header ) {
+	int		*ops, *args;
+	byte	*targets, *code;
+	int		i, pc, op, count, start;
+
+	start = Sys_Milliseconds();
+
+	count = header->instructionCount;
+	ops = Z_Malloc( count * sizeof( *ops ) );
+	args = Z_Malloc( count * sizeof( *args ) );
+	targets = Z_Malloc( count );
+
+	// decode
+	code = (byte *)header + header->codeOffset;
+	pc = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( pc >= header->codeLength ) {
+			break;
+		}
+		op = code[ pc++ ];
+		if ( op > OP_CVFI ) {
+			break;
+		}
+		ops[i] = op;
+		args[i] = 0;
+		if ( op == OP_ARG ) {
+			if ( pc + 1 > header->codeLength ) {
+				break;
+			}
+			args[i] = code[ pc++ ];
+		} else if ( op == OP_ENTER || op == OP_LEAVE || op == OP_CONST || op == OP_LOCAL
+			|| op == OP_BLOCK_COPY || ( op >= OP_EQ && op <= OP_GEF ) ) {
+			if ( pc + 4 > header->codeLength ) {
+				break;
+			}
+			args[i] = LittleLong( *(int *)&code[ pc ] );
+			pc += 4;
+		}
+	}
+
+	if ( !count || i < count || ops[0] != OP_ENTER || !VM_FindJumpTargets( vm, ops, args, count, targets ) ) {
+		if ( i < count ) {
+			Com_Printf( S_COLOR_YELLOW "VM_Compile: %s has bad code at instruction %i\n", vm->name, i );
+		}
+		Z_Free( targets );
+		Z_Free( args );
+		Z_Free( ops );
+		vm->compiled = qfalse;
+		return;
+	}
+
+	// measure, then emit with the final instruction pointers
+	jitCode = NULL;
+	VM_CompileInstructions( vm, ops, args, targets, count );
+
+	vm->codeLength = jitOfs;
+	vm->codeBase = mmap( NULL, vm->codeLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( vm->codeBase == (void *)MAP_FAILED ) {
+		Com_Error( ERR_FATAL, "VM_Compile: can't mmap memory" );
+	}
+
+	jitCode = (unsigned *)vm->codeBase;
+	VM_CompileInstructions( vm, ops, args, targets, count );
+	jitCode = NULL;
+
+	if ( jitOfs != vm->codeLength ) {
+		Com_Error( ERR_FATAL, "VM_Compile: code size changed between passes" );
+	}
+
+	if ( mprotect( vm->codeBase, vm->codeLength, PROT_READ | PROT_EXEC ) ) {
+		Com_Error( ERR_FATAL, "VM_Compile: mprotect failed" );
+	}
+	__builtin___clear_cache( (char *)vm->codeBase, (char *)vm->codeBase + vm->codeLength );
+
+	Z_Free( targets );
+	Z_Free( args );
+	Z_Free( ops );
+
+	vm->destroy = VM_Destroy_Compiled;
+
+	Com_Printf( "VM file %s compiled to %i bytes of code in %i msec\n", vm->name, vm->codeLength,
+		Sys_Milliseconds() - start );
+}
+
+/*
+=================
+VM_Destroy_Compiled
+=================
+*/
+static void VM_Destroy_Compiled( vm_t *self ) {
+	munmap( self->codeBase, self->codeLength );
+}
+
+/*
+==============
+VM_CallCompiled
+
+This function is called directly by the generated code
+==============
+*/
+int	VM_CallCompiled( vm_t *vm, int *args ) {
+	vmEntry_t	entry;
+	int			programStack;
+	int			stackOnEntry;
+	byte		*image;
+	int			i;
+	int			opStack[OPSTACK_SIZE];
+
+	currentVM = vm;
+	vm->currentlyInterpreting = qtrue;
+
+	// we might be called recursively, so this might not be the very top
+	programStack = vm->programStack;
+	stackOnEntry = programStack;
+
+	// set up the stack frame
+	image = vm->dataBase;
+
+	programStack -= 48;
+
+	for ( i = 0 ; i < 10 ; i++ ) {
+		*(int *)&image[ programStack + 8 + 4 * i ] = args[i];
+	}
+	*(int *)&image[ programStack + 4 ] = 0x77777777;	// return stack
+	*(int *)&image[ programStack ] = -1;	// will terminate the loop on return
+
+	entry.dataBase = image;
+	entry.codeBase = vm->codeBase;
+	entry.instructionPointers = vm->instructionPointers;
+	entry.opStack = opStack;
+	entry.dataMask = vm->dataMask;
+	entry.programStack = programStack;
+	entry.opStackOfs = 0;
+	entry.stackBottom = vm->stackBottom;
+	entry.systemCall = VM_SystemCallArm64;
+	entry.blockCopy = VM_BlockCopyArm64;
+	entry.error = VM_ErrorArm64;
+
+	// off we go into generated code...
+	((void (*)( vmEntry_t * ))vm->codeBase)( &entry );
+
+	if ( entry.opStackOfs != 4 ) {
+		Com_Error( ERR_DROP, "opStack corrupted in compiled code (offset %i)\n", entry.opStackOfs );
+	}
+	if ( entry.programStack != stackOnEntry - 48 ) {
+		Com_Error( ERR_DROP, "programStack corrupted in compiled code\n" );
+	}
+
+	vm->programStack = stackOnEntry;
+	vm->currentlyInterpreting = qfalse;
+
+	return opStack[1];
+}
@@ -141,6 +141,62 @@ static ID_INLINE unsigned int __lwbrx(register void *addr,
     }
 #endif
 
+/*
+=============================================================================
+
+THREADED INTERPRETER
+
+VM_PrepareInterpreter also decodes the qvm into one vmInstruction_t per
+instruction, which VM_CallThreaded runs with a computed goto on gcc.
+Common sequences are fused into superinstructions.  Only the first slot
+of a sequence is rewritten, so a jump into the middle of it still runs
+the plain instructions.
+
+With vm_elideBoundsChecks, local loads and stores in functions whose
+frame is known to be consistent skip the data mask, and the function's
+OP_ENTER checks for stack overflow instead.  Only use it with trusted
+qvms, a hostile one can still get programStack out of range.
+
+=============================================================================
+*/
+
+typedef enum {
+	OPX_LOCAL_LOAD4 = OP_CVFI + 1,		// LOCAL, LOAD4
+	OPX_LOCAL_LOAD4_DIRECT,
+	OPX_CONST_ADD,						// CONST, ADD
+	OPX_CONST_JUMP,						// CONST, JUMP
+	OPX_CONST_EQ,						// CONST, EQ ... CONST, GEI
+	OPX_CONST_NE,
+	OPX_CONST_LTI,
+	OPX_CONST_LEI,
+	OPX_CONST_GTI,
+	OPX_CONST_GEI,
+	OPX_LOCAL_CONST_STORE4,				// LOCAL, CONST, STORE4
+	OPX_LOCAL_CONST_STORE4_DIRECT,
+	OPX_ENTER_CHECK,					// ENTER with a stack overflow check
+	OPX_OUT_OF_RANGE,					// after the last instruction
+
+	OPX_MAX
+} superOpcode_t;
+
+// qvm instructions executed by each op, for vm_interpreterBench
+static const byte	opLength[OPX_MAX] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,		// OP_UNDEF ... OP_CVFI
+	2, 2, 2, 2,								// LOCAL_LOAD4 ... CONST_JUMP
+	2, 2, 2, 2, 2, 2,						// CONST_EQ ... CONST_GEI
+	3, 3,									// LOCAL_CONST_STORE4
+	1,										// ENTER_CHECK
+	0										// OUT_OF_RANGE
+};
+
+static qboolean	vm_switchInterpreter;		// set by the bench to time the old loop
+static int		*vm_countInstructions;		// set by the bench to count instructions
+static int		vm_benchInstructions;		// not on the stack, an error can leave it counting
+static byte		*vm_benchSaved;				// malloc'd copy of the data while the bench runs
+
 char *VM_Indent( vm_t *vm ) {
 	static char	*string = "                                        ";
 	if ( vm->callLevel > 20 ) {
@@ -162,6 +218,183 @@ void VM_StackTrace( vm_t *vm, int programCounter, int programStack ) {
 }
 
 
+/*
+====================
+VM_IsBranch
+====================
+*/
+static qboolean VM_IsBranch( int op ) {
+	return op >= OP_EQ && op <= OP_GEF;
+}
+
+/*
+====================
+VM_ElideBoundsChecks
+
+Switches the fused local accesses of every function that keeps its
+frame consistent to the unmasked versions.  A function runs from its
+OP_ENTER to the next one.
+====================
+*/
+static void VM_ElideBoundsChecks( vm_t *vm, const vmInstruction_t *original ) {
+	vmInstruction_t	*code;
+	int				start, end, i, op, frame;
+	int				functions, elided;
+	qboolean		consistent;
+
+	code = vm->instructions;
+	functions = elided = 0;
+
+	for ( start = 0 ; start < vm->instructionCount ; start = end ) {
+		if ( original[start].op != OP_ENTER ) {
+			end = start + 1;
+			continue;
+		}
+		for ( end = start + 1 ; end < vm->instructionCount ; end++ ) {
+			if ( original[end].op == OP_ENTER ) {
+				break;
+			}
+		}
+		functions++;
+
+		frame = original[start].arg;
+		consistent = ( frame >= 0 && !( frame & 3 ) );
+		for ( i = start + 1 ; i < end && consistent ; i++ ) {
+			op = original[i].op;
+			if ( op == OP_LEAVE && original[i].arg != frame ) {
+				consistent = qfalse;
+			} else if ( VM_IsBranch( op ) && ( original[i].arg < start || original[i].arg >= end ) ) {
+				consistent = qfalse;
+			} else if ( code[i].op == OPX_CONST_JUMP && ( original[i].arg < start || original[i].arg >= end ) ) {
+				consistent = qfalse;
+			}
+		}
+		if ( !consistent ) {
+			continue;
+		}
+		elided++;
+
+		// locals and the caller's argument area are inside the frame
+		code[start].op = OPX_ENTER_CHECK;
+		for ( i = start + 1 ; i < end ; i++ ) {
+			op = code[i].op;
+			if ( op != OPX_LOCAL_LOAD4 && op != OPX_LOCAL_CONST_STORE4 ) {
+				continue;
+			}
+			if ( code[i].arg < 0 || ( code[i].arg & 3 ) || code[i].arg + 4 > frame + 48 ) {
+				continue;
+			}
+			code[i].op = ( op == OPX_LOCAL_LOAD4 ) ? OPX_LOCAL_LOAD4_DIRECT : OPX_LOCAL_CONST_STORE4_DIRECT;
+		}
+	}
+
+	Com_Printf( "%s: elided bounds checks in %i of %i functions\n", vm->name, elided, functions );
+}
+
+/*
+====================
+VM_PrepareThreadedCode
+
+Decodes the qvm for VM_CallThreaded.  Anything that can't be
+checked here is checked at run time, and a qvm that fails the
+checks is left to the switch interpreter.
+====================
+*/
+static void VM_PrepareThreadedCode( vm_t *vm, vmHeader_t *header ) {
+	vmInstruction_t	*original, *code;
+	byte			*image;
+	int				count, pc, i, op, next, next2;
+	int				fused;
+
+	count = header->instructionCount;
+	image = (byte *)header + header->codeOffset;
+
+	// decode into a scratch copy first, the fusion below
+	// has to look at the original ops
+	original = Z_Malloc( ( count + 1 ) * sizeof( *original ) );
+	pc = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( pc >= header->codeLength ) {
+			Com_Printf( S_COLOR_YELLOW "%s: code ends at instruction %i, using the switch interpreter\n", vm->name, i );
+			Z_Free( original );
+			return;
+		}
+		op = image[pc++];
+		if ( op > OP_CVFI ) {
+			Com_Printf( S_COLOR_YELLOW "%s: bad opcode %i at instruction %i, using the switch interpreter\n", vm->name, op, i );
+			Z_Free( original );
+			return;
+		}
+		original[i].op = op;
+		original[i].arg = 0;
+
+		switch ( op ) {
+		case OP_ENTER:
+		case OP_CONST:
+		case OP_LOCAL:
+		case OP_LEAVE:
+		case OP_BLOCK_COPY:
+			original[i].arg = loadWord( &image[pc] );
+			pc += 4;
+			break;
+		case OP_ARG:
+			original[i].arg = image[pc];
+			pc += 1;
+			break;
+		default:
+			if ( VM_IsBranch( op ) ) {
+				original[i].arg = loadWord( &image[pc] );
+				pc += 4;
+				if ( (unsigned)original[i].arg >= (unsigned)count ) {
+					Com_Printf( S_COLOR_YELLOW "%s: branch out of range at instruction %i, using the switch interpreter\n", vm->name, i );
+					Z_Free( original );
+					return;
+				}
+			}
+			break;
+		}
+	}
+	original[count].op = OPX_OUT_OF_RANGE;
+	original[count].arg = 0;
+
+	code = Hunk_Alloc( ( count + 1 ) * sizeof( *code ), h_high );
+	Com_Memcpy( code, original, ( count + 1 ) * sizeof( *code ) );
+
+	// fuse superinstructions, original[count] stops all lookaheads
+	fused = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		op = original[i].op;
+		next = original[i+1].op;
+		next2 = ( next == OPX_OUT_OF_RANGE ) ? OPX_OUT_OF_RANGE : original[i+2].op;
+
+		if ( op == OP_LOCAL && next == OP_LOAD4 ) {
+			code[i].op = OPX_LOCAL_LOAD4;
+		} else if ( op == OP_LOCAL && next == OP_CONST && next2 == OP_STORE4 ) {
+			code[i].op = OPX_LOCAL_CONST_STORE4;
+		} else if ( op == OP_CONST && next == OP_ADD ) {
+			code[i].op = OPX_CONST_ADD;
+		} else if ( op == OP_CONST && next == OP_JUMP && (unsigned)original[i].arg < (unsigned)count ) {
+			code[i].op = OPX_CONST_JUMP;
+		} else if ( op == OP_CONST && next >= OP_EQ && next <= OP_GEI ) {
+			code[i].op = OPX_CONST_EQ + ( next - OP_EQ );
+		} else {
+			continue;
+		}
+		fused++;
+	}
+
+	vm->instructions = code;
+	vm->instructionCount = count;
+
+	if ( vm_elideBoundsChecks->integer ) {
+		VM_ElideBoundsChecks( vm, original );
+	}
+
+	Z_Free( original );
+
+	Com_Printf( "%s: %i superinstructions in %i instructions\n", vm->name, fused, count );
+}
+
 /*
 ====================
 VM_PrepareInterpreter
@@ -294,6 +527,12 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		}
 
 	}
+
+	vm->instructions = NULL;
+	vm->instructionCount = 0;
+	if ( vm_threadedInterpreter->integer ) {
+		VM_PrepareThreadedCode( vm, header );
+	}
 }
 
 /*
@@ -324,6 +563,616 @@ locals from sp
 
 #define	DEBUGSTR va("%s%i", VM_Indent(vm), opStack-stack )
 
+/*
+==============
+VM_CallThreaded
+
+Runs the code from VM_PrepareThreadedCode.  The saved return
+addresses are instruction numbers instead of code offsets.
+==============
+*/
+#if defined( __GNUC__ )
+#define	VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define	OPCODE(x)	op_##x
+#define	NEXT		goto *dispatch[ip->op]
+#else
+#define	OPCODE(x)	case x
+#define	NEXT		goto nextInstruction
+#endif
+
+#define	BRANCH(cmp) \
+	opStack -= 2; \
+	if ( opStack[1] cmp opStack[2] ) { \
+		ip = code + ip->arg; \
+	} else { \
+		ip++; \
+	} \
+	NEXT
+
+#define	BRANCHU(cmp) \
+	opStack -= 2; \
+	if ( (unsigned)opStack[1] cmp (unsigned)opStack[2] ) { \
+		ip = code + ip->arg; \
+	} else { \
+		ip++; \
+	} \
+	NEXT
+
+#define	BRANCHF(cmp) \
+	opStack -= 2; \
+	if ( ((float *)opStack)[1] cmp ((float *)opStack)[2] ) { \
+		ip = code + ip->arg; \
+	} else { \
+		ip++; \
+	} \
+	NEXT
+
+#define	BRANCHCONST(cmp) \
+	opStack--; \
+	if ( opStack[1] cmp ip->arg ) { \
+		ip = code + ip[1].arg; \
+	} else { \
+		ip += 2; \
+	} \
+	NEXT
+
+static int VM_CallThreaded( vm_t *vm, int *args ) {
+	int				stack[MAX_STACK];
+	int				*opStack;
+	int				programStack;
+	int				stackOnEntry;
+	byte			*image;
+	int				dataMask;
+	vmInstruction_t	*code, *ip;
+	int				*count;
+#ifdef VM_COMPUTED_GOTO
+	static const void * const opTable[OPX_MAX] = {
+		[OP_UNDEF] = &&op_OP_UNDEF,
+		[OP_IGNORE] = &&op_OP_IGNORE,
+		[OP_BREAK] = &&op_OP_BREAK,
+		[OP_ENTER] = &&op_OP_ENTER,
+		[OP_LEAVE] = &&op_OP_LEAVE,
+		[OP_CALL] = &&op_OP_CALL,
+		[OP_PUSH] = &&op_OP_PUSH,
+		[OP_POP] = &&op_OP_POP,
+		[OP_CONST] = &&op_OP_CONST,
+		[OP_LOCAL] = &&op_OP_LOCAL,
+		[OP_JUMP] = &&op_OP_JUMP,
+		[OP_EQ] = &&op_OP_EQ,
+		[OP_NE] = &&op_OP_NE,
+		[OP_LTI] = &&op_OP_LTI,
+		[OP_LEI] = &&op_OP_LEI,
+		[OP_GTI] = &&op_OP_GTI,
+		[OP_GEI] = &&op_OP_GEI,
+		[OP_LTU] = &&op_OP_LTU,
+		[OP_LEU] = &&op_OP_LEU,
+		[OP_GTU] = &&op_OP_GTU,
+		[OP_GEU] = &&op_OP_GEU,
+		[OP_EQF] = &&op_OP_EQF,
+		[OP_NEF] = &&op_OP_NEF,
+		[OP_LTF] = &&op_OP_LTF,
+		[OP_LEF] = &&op_OP_LEF,
+		[OP_GTF] = &&op_OP_GTF,
+		[OP_GEF] = &&op_OP_GEF,
+		[OP_LOAD1] = &&op_OP_LOAD1,
+		[OP_LOAD2] = &&op_OP_LOAD2,
+		[OP_LOAD4] = &&op_OP_LOAD4,
+		[OP_STORE1] = &&op_OP_STORE1,
+		[OP_STORE2] = &&op_OP_STORE2,
+		[OP_STORE4] = &&op_OP_STORE4,
+		[OP_ARG] = &&op_OP_ARG,
+		[OP_BLOCK_COPY] = &&op_OP_BLOCK_COPY,
+		[OP_SEX8] = &&op_OP_SEX8,
+		[OP_SEX16] = &&op_OP_SEX16,
+		[OP_NEGI] = &&op_OP_NEGI,
+		[OP_ADD] = &&op_OP_ADD,
+		[OP_SUB] = &&op_OP_SUB,
+		[OP_DIVI] = &&op_OP_DIVI,
+		[OP_DIVU] = &&op_OP_DIVU,
+		[OP_MODI] = &&op_OP_MODI,
+		[OP_MODU] = &&op_OP_MODU,
+		[OP_MULI] = &&op_OP_MULI,
+		[OP_MULU] = &&op_OP_MULU,
+		[OP_BAND] = &&op_OP_BAND,
+		[OP_BOR] = &&op_OP_BOR,
+		[OP_BXOR] = &&op_OP_BXOR,
+		[OP_BCOM] = &&op_OP_BCOM,
+		[OP_LSH] = &&op_OP_LSH,
+		[OP_RSHI] = &&op_OP_RSHI,
+		[OP_RSHU] = &&op_OP_RSHU,
+		[OP_NEGF] = &&op_OP_NEGF,
+		[OP_ADDF] = &&op_OP_ADDF,
+		[OP_SUBF] = &&op_OP_SUBF,
+		[OP_DIVF] = &&op_OP_DIVF,
+		[OP_MULF] = &&op_OP_MULF,
+		[OP_CVIF] = &&op_OP_CVIF,
+		[OP_CVFI] = &&op_OP_CVFI,
+		[OPX_LOCAL_LOAD4] = &&op_OPX_LOCAL_LOAD4,
+		[OPX_LOCAL_LOAD4_DIRECT] = &&op_OPX_LOCAL_LOAD4_DIRECT,
+		[OPX_CONST_ADD] = &&op_OPX_CONST_ADD,
+		[OPX_CONST_JUMP] = &&op_OPX_CONST_JUMP,
+		[OPX_CONST_EQ] = &&op_OPX_CONST_EQ,
+		[OPX_CONST_NE] = &&op_OPX_CONST_NE,
+		[OPX_CONST_LTI] = &&op_OPX_CONST_LTI,
+		[OPX_CONST_LEI] = &&op_OPX_CONST_LEI,
+		[OPX_CONST_GTI] = &&op_OPX_CONST_GTI,
+		[OPX_CONST_GEI] = &&op_OPX_CONST_GEI,
+		[OPX_LOCAL_CONST_STORE4] = &&op_OPX_LOCAL_CONST_STORE4,
+		[OPX_LOCAL_CONST_STORE4_DIRECT] = &&op_OPX_LOCAL_CONST_STORE4_DIRECT,
+		[OPX_ENTER_CHECK] = &&op_OPX_ENTER_CHECK,
+		[OPX_OUT_OF_RANGE] = &&op_OPX_OUT_OF_RANGE
+	};
+	// while counting every op goes through countInstruction first
+	static const void * const countTable[OPX_MAX] = {
+		[0 ... OPX_MAX-1] = &&countInstruction
+	};
+	const void * const	*dispatch;
+#endif
+
+	vm->currentlyInterpreting = qtrue;
+
+	// we might be called recursively, so this might not be the very top
+	programStack = stackOnEntry = vm->programStack;
+
+	image = vm->dataBase;
+	code = vm->instructions;
+	dataMask = vm->dataMask;
+	count = vm_countInstructions;
+
+	// leave a free spot at start of stack so
+	// that as long as opStack is valid, opStack-1 will
+	// not corrupt anything
+	opStack = stack;
+	ip = code;
+
+	programStack -= 48;
+
+	*(int *)&image[ programStack + 44] = args[9];
+	*(int *)&image[ programStack + 40] = args[8];
+	*(int *)&image[ programStack + 36] = args[7];
+	*(int *)&image[ programStack + 32] = args[6];
+	*(int *)&image[ programStack + 28] = args[5];
+	*(int *)&image[ programStack + 24] = args[4];
+	*(int *)&image[ programStack + 20] = args[3];
+	*(int *)&image[ programStack + 16] = args[2];
+	*(int *)&image[ programStack + 12] = args[1];
+	*(int *)&image[ programStack + 8 ] = args[0];
+	*(int *)&image[ programStack + 4 ] = 0;	// return stack
+	*(int *)&image[ programStack ] = -1;	// will terminate the loop on return
+
+	VM_Debug(0);
+
+#ifdef VM_COMPUTED_GOTO
+	dispatch = count ? countTable : opTable;
+	NEXT;
+
+countInstruction:
+	*count += opLength[ip->op];
+	goto *opTable[ip->op];
+#else
+nextInstruction:
+	if ( count ) {
+		*count += opLength[ip->op];
+	}
+	switch ( ip->op ) {
+	default:
+		Com_Error( ERR_DROP, "Bad VM instruction" );
+#endif
+
+	OPCODE(OP_UNDEF):
+	OPCODE(OP_IGNORE):
+		ip++;
+		NEXT;
+	OPCODE(OP_BREAK):
+		vm->breakCount++;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_CONST):
+		opStack++;
+		*opStack = ip->arg;
+		ip++;
+		NEXT;
+	OPCODE(OP_LOCAL):
+		opStack++;
+		*opStack = ip->arg + programStack;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_LOAD4):
+		*opStack = *(int *)&image[ *opStack&dataMask ];
+		ip++;
+		NEXT;
+	OPCODE(OP_LOAD2):
+		*opStack = *(unsigned short *)&image[ *opStack&dataMask ];
+		ip++;
+		NEXT;
+	OPCODE(OP_LOAD1):
+		*opStack = image[ *opStack&dataMask ];
+		ip++;
+		NEXT;
+
+	OPCODE(OP_STORE4):
+		*(int *)&image[ opStack[-1]&(dataMask & ~3) ] = opStack[0];
+		opStack -= 2;
+		ip++;
+		NEXT;
+	OPCODE(OP_STORE2):
+		*(short *)&image[ opStack[-1]&(dataMask & ~1) ] = opStack[0];
+		opStack -= 2;
+		ip++;
+		NEXT;
+	OPCODE(OP_STORE1):
+		image[ opStack[-1]&dataMask ] = opStack[0];
+		opStack -= 2;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_ARG):
+		// single byte offset from programStack
+		*(int *)&image[ ip->arg + programStack ] = *opStack;
+		opStack--;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_BLOCK_COPY):
+		{
+			int		*src, *dest;
+			int		i, n, srci, desti;
+
+			n = ip->arg;
+			// MrE: copy range check
+			srci = opStack[0] & dataMask;
+			desti = opStack[-1] & dataMask;
+			n = ((srci + n) & dataMask) - srci;
+			n = ((desti + n) & dataMask) - desti;
+
+			src = (int *)&image[ srci ];
+			dest = (int *)&image[ desti ];
+			if ( ( (intptr_t)src | (intptr_t)dest | n ) & 3 ) {
+				// happens in westernq3
+				Com_Printf( S_COLOR_YELLOW "Warning: OP_BLOCK_COPY not dword aligned\n");
+			}
+			n >>= 2;
+			for ( i = n-1 ; i>= 0 ; i-- ) {
+				dest[i] = src[i];
+			}
+			opStack -= 2;
+			ip++;
+		}
+		NEXT;
+
+	OPCODE(OP_CALL):
+		{
+			int		target;
+
+			// save the return instruction
+			*(int *)&image[ programStack ] = ( ip + 1 ) - code;
+
+			target = *opStack;
+			opStack--;
+			if ( target < 0 ) {
+				// system call
+				int		r;
+
+				// save the stack to allow recursive VM entry
+				vm->programStack = programStack - 4;
+				*(int *)&image[ programStack + 4 ] = -1 - target;
+				{
+					intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
+				#if __WORDSIZE == 64
+				// the vm has ints on the stack, we expect
+				// longs so we have to convert it
+					intptr_t argarr[16];
+					int i;
+					for (i = 0; i < 16; ++i) {
+						argarr[i] = *(int*)&image[ programStack + 4 + 4*i ];
+					}
+					argptr = argarr;
+				#endif
+					r = vm->systemCall( argptr );
+				}
+
+				// save return value
+				opStack++;
+				*opStack = r;
+				ip++;
+			} else if ( (unsigned)target >= (unsigned)vm->instructionCount ) {
+				Com_Error( ERR_DROP, "VM program counter out of range in OP_CALL" );
+			} else {
+				ip = code + target;
+			}
+		}
+		NEXT;
+
+	// push and pop are only needed for discarded or bad function return values
+	OPCODE(OP_PUSH):
+		opStack++;
+		ip++;
+		NEXT;
+	OPCODE(OP_POP):
+		opStack--;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_ENTER):
+		programStack -= ip->arg;
+		ip++;
+		NEXT;
+	OPCODE(OPX_ENTER_CHECK):
+		programStack -= ip->arg;
+		if ( programStack < vm->stackBottom ) {
+			Com_Error( ERR_DROP, "VM stack overflow" );
+		}
+		ip++;
+		NEXT;
+	OPCODE(OP_LEAVE):
+		{
+			int		target;
+
+			// remove our stack frame
+			programStack += ip->arg;
+
+			// grab the saved return instruction
+			target = *(int *)&image[ programStack ];
+
+			// check for leaving the VM
+			if ( target == -1 ) {
+				goto done;
+			} else if ( (unsigned)target >= (unsigned)vm->instructionCount ) {
+				Com_Error( ERR_DROP, "VM program counter out of range in OP_LEAVE" );
+			}
+			ip = code + target;
+		}
+		NEXT;
+
+	OPCODE(OPX_OUT_OF_RANGE):
+		Com_Error( ERR_DROP, "VM program counter out of range" );
+		NEXT;
+
+	/*
+	===================================================================
+	BRANCHES
+	===================================================================
+	*/
+
+	OPCODE(OP_JUMP):
+		if ( (unsigned)*opStack >= (unsigned)vm->instructionCount ) {
+			Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
+		}
+		ip = code + *opStack;
+		opStack--;
+		NEXT;
+
+	OPCODE(OP_EQ):
+		BRANCH( == );
+	OPCODE(OP_NE):
+		BRANCH( != );
+	OPCODE(OP_LTI):
+		BRANCH( < );
+	OPCODE(OP_LEI):
+		BRANCH( <= );
+	OPCODE(OP_GTI):
+		BRANCH( > );
+	OPCODE(OP_GEI):
+		BRANCH( >= );
+
+	OPCODE(OP_LTU):
+		BRANCHU( < );
+	OPCODE(OP_LEU):
+		BRANCHU( <= );
+	OPCODE(OP_GTU):
+		BRANCHU( > );
+	OPCODE(OP_GEU):
+		BRANCHU( >= );
+
+	OPCODE(OP_EQF):
+		BRANCHF( == );
+	OPCODE(OP_NEF):
+		BRANCHF( != );
+	OPCODE(OP_LTF):
+		BRANCHF( < );
+	OPCODE(OP_LEF):
+		BRANCHF( <= );
+	OPCODE(OP_GTF):
+		BRANCHF( > );
+	OPCODE(OP_GEF):
+		BRANCHF( >= );
+
+	//===================================================================
+
+	OPCODE(OP_NEGI):
+		*opStack = -*opStack;
+		ip++;
+		NEXT;
+	OPCODE(OP_ADD):
+		opStack[-1] = opStack[-1] + opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_SUB):
+		opStack[-1] = opStack[-1] - opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_DIVI):
+		opStack[-1] = opStack[-1] / opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_DIVU):
+		opStack[-1] = ((unsigned)opStack[-1]) / ((unsigned)opStack[0]);
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_MODI):
+		opStack[-1] = opStack[-1] % opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_MODU):
+		opStack[-1] = ((unsigned)opStack[-1]) % ((unsigned)opStack[0]);
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_MULI):
+		opStack[-1] = opStack[-1] * opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_MULU):
+		opStack[-1] = ((unsigned)opStack[-1]) * ((unsigned)opStack[0]);
+		opStack--;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_BAND):
+		opStack[-1] = ((unsigned)opStack[-1]) & ((unsigned)opStack[0]);
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_BOR):
+		opStack[-1] = ((unsigned)opStack[-1]) | ((unsigned)opStack[0]);
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_BXOR):
+		opStack[-1] = ((unsigned)opStack[-1]) ^ ((unsigned)opStack[0]);
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_BCOM):
+		*opStack = ~ ((unsigned)*opStack);
+		ip++;
+		NEXT;
+
+	OPCODE(OP_LSH):
+		opStack[-1] = opStack[-1] << opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_RSHI):
+		opStack[-1] = opStack[-1] >> opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_RSHU):
+		opStack[-1] = ((unsigned)opStack[-1]) >> opStack[0];
+		opStack--;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_NEGF):
+		*(float *)opStack =  -*(float *)opStack;
+		ip++;
+		NEXT;
+	OPCODE(OP_ADDF):
+		*(float *)(opStack-1) = *(float *)(opStack-1) + *(float *)opStack;
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_SUBF):
+		*(float *)(opStack-1) = *(float *)(opStack-1) - *(float *)opStack;
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_DIVF):
+		*(float *)(opStack-1) = *(float *)(opStack-1) / *(float *)opStack;
+		opStack--;
+		ip++;
+		NEXT;
+	OPCODE(OP_MULF):
+		*(float *)(opStack-1) = *(float *)(opStack-1) * *(float *)opStack;
+		opStack--;
+		ip++;
+		NEXT;
+
+	OPCODE(OP_CVIF):
+		*(float *)opStack =  (float)*opStack;
+		ip++;
+		NEXT;
+	OPCODE(OP_CVFI):
+		*opStack = (int) *(float *)opStack;
+		ip++;
+		NEXT;
+	OPCODE(OP_SEX8):
+		*opStack = (signed char)*opStack;
+		ip++;
+		NEXT;
+	OPCODE(OP_SEX16):
+		*opStack = (short)*opStack;
+		ip++;
+		NEXT;
+
+	/*
+	===================================================================
+	SUPERINSTRUCTIONS
+	===================================================================
+	*/
+
+	OPCODE(OPX_LOCAL_LOAD4):
+		opStack++;
+		*opStack = *(int *)&image[ ( ip->arg + programStack )&dataMask ];
+		ip += 2;
+		NEXT;
+	OPCODE(OPX_LOCAL_LOAD4_DIRECT):
+		opStack++;
+		*opStack = *(int *)&image[ ip->arg + programStack ];
+		ip += 2;
+		NEXT;
+
+	OPCODE(OPX_LOCAL_CONST_STORE4):
+		*(int *)&image[ ( ip->arg + programStack )&(dataMask & ~3) ] = ip[1].arg;
+		ip += 3;
+		NEXT;
+	OPCODE(OPX_LOCAL_CONST_STORE4_DIRECT):
+		*(int *)&image[ ip->arg + programStack ] = ip[1].arg;
+		ip += 3;
+		NEXT;
+
+	OPCODE(OPX_CONST_ADD):
+		*opStack += ip->arg;
+		ip += 2;
+		NEXT;
+
+	OPCODE(OPX_CONST_JUMP):
+		// checked when decoded
+		ip = code + ip->arg;
+		NEXT;
+
+	OPCODE(OPX_CONST_EQ):
+		BRANCHCONST( == );
+	OPCODE(OPX_CONST_NE):
+		BRANCHCONST( != );
+	OPCODE(OPX_CONST_LTI):
+		BRANCHCONST( < );
+	OPCODE(OPX_CONST_LEI):
+		BRANCHCONST( <= );
+	OPCODE(OPX_CONST_GTI):
+		BRANCHCONST( > );
+	OPCODE(OPX_CONST_GEI):
+		BRANCHCONST( >= );
+
+#ifndef VM_COMPUTED_GOTO
+	}
+#endif
+
+done:
+	vm->currentlyInterpreting = qfalse;
+
+	if ( opStack != &stack[1] ) {
+		Com_Error( ERR_DROP, "Interpreter error: opStack = %ld", (long int) (opStack - stack) );
+	}
+
+	vm->programStack = stackOnEntry;
+
+	// return the result
+	return *opStack;
+}
+
 int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	int		stack[MAX_STACK];
 	int		*opStack;
@@ -338,6 +1187,10 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	vmSymbol_t	*profileSymbol;
 #endif
 
+	if ( vm->instructions && !vm_switchInterpreter ) {
+		return VM_CallThreaded( vm, args );
+	}
+
 	// interpret the code
 	vm->currentlyInterpreting = qtrue;
 
@@ -917,3 +1770,108 @@ done:
 	// return the result
 	return *opStack;
 }
+
+/*
+==============
+VM_EndInterpreterBench
+
+Puts the interpreter back to normal and frees the copy of the data,
+also called when an error ends the bench in the middle of a call
+==============
+*/
+void VM_EndInterpreterBench( void ) {
+	vm_countInstructions = NULL;
+	vm_switchInterpreter = qfalse;
+	if ( vm_benchSaved ) {
+		free( vm_benchSaved );
+		vm_benchSaved = NULL;
+	}
+}
+
+/*
+==============
+VM_InterpreterBench
+
+Runs VM_Call( vm, callnum, arg ) from a snapshot of the current vm
+data, once to count the instructions and then passes times with each
+interpreter.  The data is put back afterwards.
+==============
+*/
+void VM_InterpreterBench( vm_t *vm, void (*reset)( void ), int callnum, int arg, int passes ) {
+	byte		*saved;
+	int			size, pass, mode, instructions;
+	unsigned	checksum[2];
+	uint64_t	start, usec[2];
+	double		rate[2];
+
+	if ( !vm || vm->dllHandle || vm->compiled ) {
+		Com_Printf( "%s is not interpreted, set vm_game 1 and restart the map\n", vm ? vm->name : "vm" );
+		return;
+	}
+	if ( !vm->instructions ) {
+		Com_Printf( "%s has no threaded code, set vm_threadedInterpreter 1 and restart the map\n", vm->name );
+		return;
+	}
+	if ( vm->callLevel ) {
+		Com_Printf( "%s is running\n", vm->name );
+		return;
+	}
+	if ( passes < 1 ) {
+		passes = 1;
+	}
+
+	// the data image can be several megabytes, too much for the zone
+	size = vm->dataMask + 1;
+	saved = malloc( size );
+	if ( !saved ) {
+		Com_Printf( "Couldn't allocate %i bytes for the data of %s\n", size, vm->name );
+		return;
+	}
+	vm_benchSaved = saved;
+	Com_Memcpy( saved, vm->dataBase, size );
+
+	// count the instructions of one call
+	vm_benchInstructions = 0;
+	vm_countInstructions = &vm_benchInstructions;
+	reset();
+	VM_Call( vm, callnum, arg );
+	vm_countInstructions = NULL;
+	instructions = vm_benchInstructions;
+
+	for ( mode = 0 ; mode < 2 ; mode++ ) {
+		vm_switchInterpreter = ( mode == 0 );
+		usec[mode] = 0;
+		for ( pass = 0 ; pass < passes ; pass++ ) {
+			Com_Memcpy( vm->dataBase, saved, size );
+			reset();
+			start = Sys_Microseconds();
+			VM_Call( vm, callnum, arg );
+			usec[mode] += Sys_Microseconds() - start;
+		}
+		// the stack is scratch, only compare the program data
+		checksum[mode] = Com_BlockChecksum( vm->dataBase, vm->stackBottom );
+	}
+	vm_switchInterpreter = qfalse;
+
+	Com_Memcpy( vm->dataBase, saved, size );
+	reset();
+	VM_EndInterpreterBench();
+
+	for ( mode = 0 ; mode < 2 ; mode++ ) {
+		if ( !usec[mode] ) {
+			usec[mode] = 1;
+		}
+		rate[mode] = (double)instructions * passes / usec[mode];
+	}
+
+	Com_Printf( "%s call %i: %i instructions, %i passes\n", vm->name, callnum, instructions, passes );
+	Com_Printf( "switch:   %8.2f ms %8.1f Minstr/s\n", usec[0] / ( 1000.0 * passes ), rate[0] );
+	Com_Printf( "threaded: %8.2f ms %8.1f Minstr/s\n", usec[1] / ( 1000.0 * passes ), rate[1] );
+	Com_Printf( "speedup:  %8.2fx\n", rate[1] / rate[0] );
+	if ( checksum[0] != checksum[1] ) {
+		// expected when the call reads the clock or other outside state
+		Com_Printf( S_COLOR_YELLOW "results differ\n" );
+	} else {
+		Com_Printf( "results match\n" );
+	}
+}
@@ -113,6 +113,21 @@ typedef enum {
 
 typedef int	vmptr_t;
 
+// an instruction decoded for the threaded interpreter, there is one for
+// every qvm instruction so all jump targets stay addressable.  op is an
+// opcode_t or one of the superinstructions in vm_interpreted.c
+typedef struct {
+	int			op;
+	int			arg;
+} vmInstruction_t;
+
+#define	MAX_SYSCALL_STATS	1024		// higher syscall numbers share the last one
+
+typedef struct {
+	int			count;
+	uint64_t	usec;
+} vmSyscallStat_t;
+
 typedef struct vmSymbol_s {
 	struct vmSymbol_s	*next;
 	int		symValue;
@@ -164,17 +179,36 @@ struct vm_s {
 
 	byte		*jumpTableTargets;
 	int			numJumpTableTargets;
+
+	// systemCall is VM_DispatchSystemCall, which runs the handler from
+	// syscallTable if there is one and moduleSystemCall otherwise
+	intptr_t	(*moduleSystemCall)( intptr_t *parms );
+	const vmSyscall_t	*syscallTable;
+	int			numSyscalls;
+
+	// VM_DispatchSystemCall takes the slow path while either is on
+	qboolean	profileSyscalls;
+	char		syscallZone[MAX_QPATH+8];
+	vmSyscallStat_t	*syscallStats;		// MAX_SYSCALL_STATS, allocated by vm_syscallStats
+
+	// threaded interpreter code, NULL when the switch interpreter is used
+	vmInstruction_t	*instructions;
+	int			instructionCount;
 };
 
 
 extern	vm_t	*currentVM;
 extern	int		vm_debugLevel;
+extern	cvar_t	*vm_threadedInterpreter;
+extern	cvar_t	*vm_elideBoundsChecks;
+extern	cvar_t	*vm_syscallStats;
 
 void VM_Compile( vm_t *vm, vmHeader_t *header );
 int	VM_CallCompiled( vm_t *vm, int *args );
 
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header );
 int	VM_CallInterpreted( vm_t *vm, int *args );
+void VM_EndInterpreterBench( void );
 
 vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
@@ -1122,6 +1122,24 @@ const void	*RB_SwapBuffers( const void *data ) {
 	return (const void *)(cmd + 1);
 }
 
+/*
+====================
+RB_SmpFrame
+
+Finds the backEndData a command list is in
+====================
+*/
+static int RB_SmpFrame( const void *data ) {
+	int		i;
+
+	for ( i = 1 ; i < tr.numSmpFrames ; i++ ) {
+		if ( data == backEndData[i]->commands.cmds ) {
+			return i;
+		}
+	}
+	return 0;
+}
+
 /*
 ====================
 RB_ExecuteRenderCommands
@@ -1135,11 +1153,9 @@ void RB_ExecuteRenderCommands( const void *data ) {
 
 	t1 = ri.Milliseconds ();
 
-	if ( !r_smp->integer || data == backEndData[0]->commands.cmds ) {
-		backEnd.smpFrame = 0;
-	} else {
-		backEnd.smpFrame = 1;
-	}
+	PROFILE_BEGIN( "RB_ExecuteRenderCommands", -1 );
+
+	backEnd.smpFrame = RB_SmpFrame( data );
 
 	while ( 1 ) {
 		switch ( *(const int *)data ) {
@@ -1175,6 +1191,7 @@ void RB_ExecuteRenderCommands( const void *data ) {
 			// stop rendering on this thread
 			t2 = ri.Milliseconds ();
 			backEnd.pc.msec = t2 - t1;
+			PROFILE_END();
 			return;
 		}
 	}
@@ -1189,21 +1206,33 @@ RB_RenderThread
 */
 void RB_RenderThread( void ) {
 	const void	*data;
+	int			frame, lastFrame;
+	uint64_t	start;
+
+	lastFrame = -1;
 
 	// wait for either a rendering command or a quit command
 	while ( 1 ) {
 		// sleep until we have work to do
+		start = ri.Microseconds();
 		data = GLimp_RendererSleep();
 
 		if ( !data ) {
 			return;	// all done, renderer is shutting down
 		}
 
-		renderThreadActive = qtrue;
+		// the counters add up over all the lists of a frame, then
+		// R_WaitRenderThread picks them up from its backEndData
+		frame = RB_SmpFrame( data );
+		if ( frame != lastFrame ) {
+			Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
+			lastFrame = frame;
+		}
+		backEnd.pc.c_smpIdleUsec += ri.Microseconds() - start;
 
 		RB_ExecuteRenderCommands( data );
 
-		renderThreadActive = qfalse;
+		backEndData[frame]->pc = backEnd.pc;
 	}
 }
 
@@ -1348,10 +1348,14 @@ R_SetParent
 static	void R_SetParent (mnode_t *node, mnode_t *parent)
 {
 	node->parent = parent;
-	if (node->contents != -1)
+	if (node->contents != -1) {
+		node->numSubtreeSurfaces = node->nummarksurfaces;
 		return;
+	}
 	R_SetParent (node->children[0], node);
 	R_SetParent (node->children[1], node);
+	node->numSubtreeSurfaces = node->children[0]->numSubtreeSurfaces
+		+ node->children[1]->numSubtreeSurfaces;
 }
 
 /*
@@ -1428,6 +1432,10 @@ static	void R_LoadNodesAndLeafs (lump_t *nodeLump, lump_t *leafLump) {
 
 	// chain decendants
 	R_SetParent (s_worldData.nodes, NULL);
+
+	// room for everything the leafs can give the front end jobs
+	s_worldData.surfRefs = ri.Hunk_Alloc( s_worldData.nodes->numSubtreeSurfaces
+		* sizeof( *s_worldData.surfRefs ), h_low );
 }
 
 //=============================================================================
@@ -1791,7 +1799,7 @@ Called directly from cgame
 */
 void RE_LoadWorldMap( const char *name ) {
 	int			i;
-	dheader_t	*header;
+	dheader_t	header;
 	byte		*buffer;
 	byte		*startMarker;
 
@@ -1828,10 +1836,11 @@ void RE_LoadWorldMap( const char *name ) {
 	startMarker = ri.Hunk_Alloc(0, h_low);
 	c_gridVerts = 0;
 
-	header = (dheader_t *)buffer;
-	fileBase = (byte *)header;
+	// the buffer may point into a mapped pk3, so it's read only
+	header = *(dheader_t *)buffer;
+	fileBase = (byte *)buffer;
 
-	i = LittleLong (header->version);
+	i = LittleLong (header.version);
 	if ( i != BSP_VERSION ) {
 		ri.Error (ERR_DROP, "RE_LoadWorldMap: %s has wrong version number (%i should be %i)", 
 			name, i, BSP_VERSION);
@@ -1839,21 +1848,21 @@ void RE_LoadWorldMap( const char *name ) {
 
 	// swap all the lumps
 	for (i=0 ; i<sizeof(dheader_t)/4 ; i++) {
-		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
+		((int *)&header)[i] = LittleLong ( ((int *)&header)[i]);
 	}
 
 	// load into heap
-	R_LoadShaders( &header->lumps[LUMP_SHADERS] );
-	R_LoadLightmaps( &header->lumps[LUMP_LIGHTMAPS] );
-	R_LoadPlanes (&header->lumps[LUMP_PLANES]);
-	R_LoadFogs( &header->lumps[LUMP_FOGS], &header->lumps[LUMP_BRUSHES], &header->lumps[LUMP_BRUSHSIDES] );
-	R_LoadSurfaces( &header->lumps[LUMP_SURFACES], &header->lumps[LUMP_DRAWVERTS], &header->lumps[LUMP_DRAWINDEXES] );
-	R_LoadMarksurfaces (&header->lumps[LUMP_LEAFSURFACES]);
-	R_LoadNodesAndLeafs (&header->lumps[LUMP_NODES], &header->lumps[LUMP_LEAFS]);
-	R_LoadSubmodels (&header->lumps[LUMP_MODELS]);
-	R_LoadVisibility( &header->lumps[LUMP_VISIBILITY] );
-	R_LoadEntities( &header->lumps[LUMP_ENTITIES] );
-	R_LoadLightGrid( &header->lumps[LUMP_LIGHTGRID] );
+	R_LoadShaders( &header.lumps[LUMP_SHADERS] );
+	R_LoadLightmaps( &header.lumps[LUMP_LIGHTMAPS] );
+	R_LoadPlanes (&header.lumps[LUMP_PLANES]);
+	R_LoadFogs( &header.lumps[LUMP_FOGS], &header.lumps[LUMP_BRUSHES], &header.lumps[LUMP_BRUSHSIDES] );
+	R_LoadSurfaces( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS], &header.lumps[LUMP_DRAWINDEXES] );
+	R_LoadMarksurfaces (&header.lumps[LUMP_LEAFSURFACES]);
+	R_LoadNodesAndLeafs (&header.lumps[LUMP_NODES], &header.lumps[LUMP_LEAFS]);
+	R_LoadSubmodels (&header.lumps[LUMP_MODELS]);
+	R_LoadVisibility( &header.lumps[LUMP_VISIBILITY] );
+	R_LoadEntities( &header.lumps[LUMP_ENTITIES] );
+	R_LoadLightGrid( &header.lumps[LUMP_LIGHTGRID] );
 
 	s_worldData.dataSize = (byte *)ri.Hunk_Alloc(0, h_low) - startMarker;
 
@@ -1861,5 +1870,7 @@ void RE_LoadWorldMap( const char *name ) {
 	tr.world = &s_worldData;
 
     ri.FS_FreeFile( buffer );
+
+	R_BuildWorldVBO();
 }
 
@@ -23,8 +23,6 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 volatile renderCommandList_t	*renderCommandList;
 
-volatile qboolean	renderThreadActive;
-
 
 /*
 =====================
@@ -32,18 +30,28 @@ R_PerformanceCounters
 =====================
 */
 void R_PerformanceCounters( void ) {
+	backEndCounters_t	*pc;
+
+	// the render thread owns backEnd.pc, so use the counters of
+	// the last frame it finished
+	if ( glConfig.smpActive ) {
+		pc = &tr.smpBackEndPc;
+	} else {
+		pc = &backEnd.pc;
+	}
+
 	if ( !r_speeds->integer ) {
 		// clear the counters even if we aren't printing
 		Com_Memset( &tr.pc, 0, sizeof( tr.pc ) );
-		Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
+		Com_Memset( pc, 0, sizeof( *pc ) );
 		return;
 	}
 
 	if (r_speeds->integer == 1) {
 		ri.Printf (PRINT_ALL, "%i/%i shaders/surfs %i leafs %i verts %i/%i tris %.2f mtex %.2f dc\n",
-			backEnd.pc.c_shaders, backEnd.pc.c_surfaces, tr.pc.c_leafs, backEnd.pc.c_vertexes, 
-			backEnd.pc.c_indexes/3, backEnd.pc.c_totalIndexes/3, 
-			R_SumOfUsedImages()/(1000000.0f), backEnd.pc.c_overDraw / (float)(glConfig.vidWidth * glConfig.vidHeight) ); 
+			pc->c_shaders, pc->c_surfaces, tr.pc.c_leafs, pc->c_vertexes, 
+			pc->c_indexes/3, pc->c_totalIndexes/3, 
+			R_SumOfUsedImages()/(1000000.0f), pc->c_overDraw / (float)(glConfig.vidWidth * glConfig.vidHeight) ); 
 	} else if (r_speeds->integer == 2) {
 		ri.Printf (PRINT_ALL, "(patch) %i sin %i sclip  %i sout %i bin %i bclip %i bout\n",
 			tr.pc.c_sphere_cull_patch_in, tr.pc.c_sphere_cull_patch_clip, tr.pc.c_sphere_cull_patch_out, 
@@ -53,11 +61,16 @@ void R_PerformanceCounters( void ) {
 			tr.pc.c_box_cull_md3_in, tr.pc.c_box_cull_md3_clip, tr.pc.c_box_cull_md3_out );
 	} else if (r_speeds->integer == 3) {
 		ri.Printf (PRINT_ALL, "viewcluster: %i\n", tr.viewCluster );
+		if ( r_visCache->integer ) {
+			ri.Printf( PRINT_ALL, "vis cache hits:%i misses:%i leafs cached:%i tested:%i\n",
+				tr.pc.c_visCacheHits, tr.pc.c_visCacheMisses,
+				tr.pc.c_visLeafsCached, tr.pc.c_visLeafsTested );
+		}
 	} else if (r_speeds->integer == 4) {
-		if ( backEnd.pc.c_dlightVertexes ) {
+		if ( pc->c_dlightVertexes ) {
 			ri.Printf (PRINT_ALL, "dlight srf:%i  culled:%i  verts:%i  tris:%i\n", 
 				tr.pc.c_dlightSurfaces, tr.pc.c_dlightSurfacesCulled,
-				backEnd.pc.c_dlightVertexes, backEnd.pc.c_dlightIndexes / 3 );
+				pc->c_dlightVertexes, pc->c_dlightIndexes / 3 );
 		}
 	} 
 	else if (r_speeds->integer == 5 )
@@ -67,11 +80,23 @@ void R_PerformanceCounters( void ) {
 	else if (r_speeds->integer == 6 )
 	{
 		ri.Printf( PRINT_ALL, "flare adds:%i tests:%i renders:%i\n", 
-			backEnd.pc.c_flareAdds, backEnd.pc.c_flareTests, backEnd.pc.c_flareRenders );
+			pc->c_flareAdds, pc->c_flareTests, pc->c_flareRenders );
+	}
+	else if (r_speeds->integer == 7 )
+	{
+		ri.Printf( PRINT_ALL, "vbo srf:%i tris:%i draws:%i copied:%i\n",
+			pc->c_vboSurfaces, pc->c_vboIndexes / 3,
+			pc->c_vboDraws, pc->c_vboCopied );
+	}
+	else if (r_speeds->integer == 8 )
+	{
+		ri.Printf( PRINT_ALL, "smp queued:%i waits:%i/%.2fms syncs:%i/%.2fms idle:%.2fms\n",
+			tr.pc.c_smpQueued, tr.pc.c_smpWaits, tr.pc.c_smpWaitUsec / 1000.0f,
+			tr.pc.c_smpSyncs, tr.pc.c_smpSyncUsec / 1000.0f, pc->c_smpIdleUsec / 1000.0f );
 	}
 
 	Com_Memset( &tr.pc, 0, sizeof( tr.pc ) );
-	Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
+	Com_Memset( pc, 0, sizeof( *pc ) );
 }
 
 
@@ -99,9 +124,10 @@ R_ShutdownCommandBuffers
 ====================
 */
 void R_ShutdownCommandBuffers( void ) {
-	// kill the rendering thread
+	// kill the rendering thread and take the context back
 	if ( glConfig.smpActive ) {
 		GLimp_WakeRenderer( NULL );
+		GLimp_FrontEndSleep();
 		glConfig.smpActive = qfalse;
 	}
 }
@@ -116,6 +142,7 @@ int	c_blockedOnMain;
 
 void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	renderCommandList_t	*cmdList;
+	int					used;
 
 	cmdList = &backEndData[tr.smpFrame]->commands;
 	assert(cmdList);
@@ -123,11 +150,14 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	*(int *)(cmdList->cmds + cmdList->used) = RC_END_OF_LIST;
 
 	// clear it out, in case this is a sync and not a buffer flip
+	used = cmdList->used;
 	cmdList->used = 0;
 
 	if ( glConfig.smpActive ) {
-		// if the render thread is not idle, wait for it
-		if ( renderThreadActive ) {
+		// the render thread only has to be done with this frame's
+		// buffers before they are reused, see R_WaitRenderThread
+		tr.pc.c_smpQueued = GLimp_RendererPending();
+		if ( tr.pc.c_smpQueued ) {
 			c_blockedOnRender++;
 			if ( r_showSmp->integer ) {
 				ri.Printf( PRINT_ALL, "R" );
@@ -139,12 +169,16 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 			}
 		}
 
-		// sleep until the renderer has completed
-		GLimp_FrontEndSleep();
+		// deferred images need the context
+		if ( R_ImageLoadsPending() ) {
+			GLimp_FrontEndSleep();
+		}
 	}
 
-	// at this point, the back end thread is idle, so it is ok
-	// to look at it's performance counters
+	// upload any images R_FindImageFile deferred before the
+	// back end gets a chance to use them
+	R_FinishImageLoads();
+
 	if ( runPerformanceCounters ) {
 		R_PerformanceCounters();
 	}
@@ -154,8 +188,8 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 		// let it start on the new batch
 		if ( !glConfig.smpActive ) {
 			RB_ExecuteRenderCommands( cmdList->cmds );
-		} else {
-			GLimp_WakeRenderer( cmdList );
+		} else if ( used ) {
+			GLimp_WakeRenderer( cmdList->cmds );
 		}
 	}
 }
@@ -172,6 +206,8 @@ OpenGL calls until R_IssueRenderCommands is called.
 ====================
 */
 void R_SyncRenderThread( void ) {
+	uint64_t	start;
+
 	if ( !tr.registered ) {
 		return;
 	}
@@ -180,7 +216,53 @@ void R_SyncRenderThread( void ) {
 	if ( !glConfig.smpActive ) {
 		return;
 	}
-	GLimp_FrontEndSleep();
+
+	if ( GLimp_RendererPending() ) {
+		start = ri.Microseconds();
+		GLimp_FrontEndSleep();
+		tr.pc.c_smpSyncs++;
+		tr.pc.c_smpSyncUsec += ri.Microseconds() - start;
+	} else {
+		GLimp_FrontEndSleep();
+	}
+}
+
+
+/*
+====================
+R_WaitRenderThread
+
+Called by R_ToggleSmpFrame before the front end starts filling
+backEndData[frame] again.  The render thread has to have finished
+the frame that last used it, and can be at most r_smpLatency frames
+behind, so the view doesn't lag too far behind the input.
+====================
+*/
+void R_WaitRenderThread( int frame ) {
+	int			latency;
+	uint64_t	start;
+
+	if ( !glConfig.smpActive ) {
+		return;
+	}
+
+	latency = r_smpLatency->integer;
+	if ( latency < 1 ) {
+		latency = 1;
+	} else if ( latency > tr.numSmpFrames - 1 ) {
+		latency = tr.numSmpFrames - 1;
+	}
+
+	if ( GLimp_RendererPending() > latency ) {
+		start = ri.Microseconds();
+		GLimp_FrontEndWait( latency );
+		tr.pc.c_smpWaits++;
+		tr.pc.c_smpWaitUsec += ri.Microseconds() - start;
+	}
+
+	// take the counters the render thread left in it
+	tr.smpBackEndPc = backEndData[frame]->pc;
+	Com_Memset( &backEndData[frame]->pc, 0, sizeof( backEndData[frame]->pc ) );
 }
 
 /*
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static byte			 s_intensitytable[256];
 static unsigned char s_gammatable[256];
+static byte			 s_lighttable[256];		// s_gammatable[s_intensitytable[i]]
 
 int		gl_filter_min = GL_LINEAR_MIPMAP_NEAREST;
 int		gl_filter_max = GL_LINEAR;
@@ -31,6 +32,12 @@ int		gl_filter_max = GL_LINEAR;
 #define FILE_HASH_SIZE		1024
 static	image_t*		hashTable[FILE_HASH_SIZE];
 
+// deferred loading statistics for imagelist
+static int			imageLoadBatches;
+static int			imageLoadJobs;
+static int			imageLoadThreads;
+static uint64_t		imageLoadUsec;
+
 /*
 ** R_GammaCorrect
 */
@@ -149,17 +156,22 @@ void R_ImageList_f( void ) {
 	int		i;
 	image_t	*image;
 	int		texels;
+	int		decodeUsec, mipUsec, uploadUsec;
 	const char *yesno[] = {
 		"no ", "yes"
 	};
 
-	ri.Printf (PRINT_ALL, "\n      -w-- -h-- -mm- -TMU- -if-- wrap --name-------\n");
+	ri.Printf (PRINT_ALL, "\n      -w-- -h-- -mm- -TMU- -if-- wrap -dec- -mip- -upl- --name-------\n");
 	texels = 0;
+	decodeUsec = mipUsec = uploadUsec = 0;
 
 	for ( i = 0 ; i < tr.numImages ; i++ ) {
 		image = tr.images[ i ];
 
 		texels += image->uploadWidth*image->uploadHeight;
+		decodeUsec += image->decodeUsec;
+		mipUsec += image->mipUsec;
+		uploadUsec += image->uploadUsec;
 		ri.Printf (PRINT_ALL,  "%4i: %4i %4i  %s   %d   ",
 			i, image->uploadWidth, image->uploadHeight, yesno[image->mipmap], image->TMU );
 		switch ( image->internalFormat ) {
@@ -184,6 +196,9 @@ void R_ImageList_f( void ) {
 		case GL_RGB4_S3TC:
 			ri.Printf( PRINT_ALL, "S3TC " );
 			break;
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			ri.Printf( PRINT_ALL, "DXT1 " );
+			break;
 		case GL_RGBA4:
 			ri.Printf( PRINT_ALL, "RGBA4" );
 			break;
@@ -206,15 +221,85 @@ void R_ImageList_f( void ) {
 			break;
 		}
 		
-		ri.Printf( PRINT_ALL, " %s\n", image->imgName );
+		// load times in msec
+		ri.Printf( PRINT_ALL, "%5.1f %5.1f %5.1f  %s\n", image->decodeUsec / 1000.0f,
+			image->mipUsec / 1000.0f, image->uploadUsec / 1000.0f, image->imgName );
 	}
 	ri.Printf (PRINT_ALL, " ---------\n");
 	ri.Printf (PRINT_ALL, " %i total texels (not including mipmaps)\n", texels);
-	ri.Printf (PRINT_ALL, " %i total images\n\n", tr.numImages );
+	ri.Printf (PRINT_ALL, " %i total images\n", tr.numImages );
+	ri.Printf (PRINT_ALL, " %.1f msec decoding, %.1f msec mipmapping, %.1f msec uploading\n",
+		decodeUsec / 1000.0f, mipUsec / 1000.0f, uploadUsec / 1000.0f );
+	if ( imageLoadBatches ) {
+		ri.Printf (PRINT_ALL, " %i deferred images in %i batches, %.1f msec on %i threads\n",
+			imageLoadJobs, imageLoadBatches, imageLoadUsec / 1000.0f, imageLoadThreads );
+	}
+	R_ImageCacheInfo();
+	ri.Printf (PRINT_ALL, "\n" );
 }
 
 //=======================================================================
 
+/*
+=======================================================================
+
+PIXEL KERNELS
+
+Every kernel has a plain C version and, where the instruction set helps,
+SSE2 or NEON versions that give exactly the same bytes.  Which one runs
+is decided per call from imageSIMD, set by R_InitImageKernels, the same
+way the AltiVec paths in tr_shade.c check com_altivec.
+
+=======================================================================
+*/
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define	IMAGE_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#define	IMAGE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// qtrue when the cpu has the instruction set compiled in above and
+// r_simd allows it, never changes while image jobs are running
+static qboolean	imageSIMD;
+
+/*
+================
+R_InitImageKernels
+================
+*/
+static void R_InitImageKernels( void ) {
+	imageSIMD = qfalse;
+	if ( !r_simd->integer ) {
+		return;
+	}
+#if defined( IMAGE_SIMD_SSE2 )
+	imageSIMD = ( ri.GetProcessorFeatures() & CF_SSE2 ) != 0;
+#elif defined( IMAGE_SIMD_NEON )
+	imageSIMD = ( ri.GetProcessorFeatures() & CF_NEON ) != 0;
+#endif
+}
+
+/*
+================
+R_ImageKernelsString
+
+For gfxinfo
+================
+*/
+const char *R_ImageKernelsString( void ) {
+	if ( !imageSIMD ) {
+		return "C";
+	}
+#if defined( IMAGE_SIMD_SSE2 )
+	return "SSE2";
+#else
+	return "NEON";
+#endif
+}
+
 /*
 ================
 ResampleTexture
@@ -226,18 +311,90 @@ is greater than half the original size.
 
 If a larger shrinking is needed, use the mipmap function 
 before or after.
+
+Returns qfalse if outwidth is too large.
 ================
 */
-static void ResampleTexture( unsigned *in, int inwidth, int inheight, unsigned *out,  
+static void ResampleRow_scalar( const unsigned *inrow, const unsigned *inrow2,
+							const unsigned *p1, const unsigned *p2, unsigned *out, int outwidth ) {
+	int		j;
+	const byte	*pix1, *pix2, *pix3, *pix4;
+
+	for (j=0 ; j<outwidth ; j++) {
+		pix1 = (const byte *)inrow + p1[j];
+		pix2 = (const byte *)inrow + p2[j];
+		pix3 = (const byte *)inrow2 + p1[j];
+		pix4 = (const byte *)inrow2 + p2[j];
+		((byte *)(out+j))[0] = (pix1[0] + pix2[0] + pix3[0] + pix4[0])>>2;
+		((byte *)(out+j))[1] = (pix1[1] + pix2[1] + pix3[1] + pix4[1])>>2;
+		((byte *)(out+j))[2] = (pix1[2] + pix2[2] + pix3[2] + pix4[2])>>2;
+		((byte *)(out+j))[3] = (pix1[3] + pix2[3] + pix3[3] + pix4[3])>>2;
+	}
+}
+
+#if defined( IMAGE_SIMD_SSE2 )
+static void ResampleRow_sse2( const unsigned *inrow, const unsigned *inrow2,
+							const unsigned *p1, const unsigned *p2, unsigned *out, int outwidth ) {
+	int		j;
+	const __m128i	zero = _mm_setzero_si128();
+	__m128i	a, b, c, d, lo, hi;
+
+	// the source pixels are gathered, the sums are four pixels at a time
+	for ( j = 0 ; j + 4 <= outwidth ; j += 4 ) {
+		a = _mm_set_epi32( inrow[p1[j+3]>>2], inrow[p1[j+2]>>2], inrow[p1[j+1]>>2], inrow[p1[j]>>2] );
+		b = _mm_set_epi32( inrow[p2[j+3]>>2], inrow[p2[j+2]>>2], inrow[p2[j+1]>>2], inrow[p2[j]>>2] );
+		c = _mm_set_epi32( inrow2[p1[j+3]>>2], inrow2[p1[j+2]>>2], inrow2[p1[j+1]>>2], inrow2[p1[j]>>2] );
+		d = _mm_set_epi32( inrow2[p2[j+3]>>2], inrow2[p2[j+2]>>2], inrow2[p2[j+1]>>2], inrow2[p2[j]>>2] );
+		lo = _mm_add_epi16( _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) ),
+			_mm_add_epi16( _mm_unpacklo_epi8( c, zero ), _mm_unpacklo_epi8( d, zero ) ) );
+		hi = _mm_add_epi16( _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) ),
+			_mm_add_epi16( _mm_unpackhi_epi8( c, zero ), _mm_unpackhi_epi8( d, zero ) ) );
+		_mm_storeu_si128( (__m128i *)( out + j ),
+			_mm_packus_epi16( _mm_srli_epi16( lo, 2 ), _mm_srli_epi16( hi, 2 ) ) );
+	}
+	ResampleRow_scalar( inrow, inrow2, p1 + j, p2 + j, out + j, outwidth - j );
+}
+#endif
+
+#if defined( IMAGE_SIMD_NEON )
+static void ResampleRow_neon( const unsigned *inrow, const unsigned *inrow2,
+							const unsigned *p1, const unsigned *p2, unsigned *out, int outwidth ) {
+	int		j, k;
+	unsigned	pix[4][4];
+	uint8x16_t	a, b, c, d;
+	uint16x8_t	lo, hi;
+
+	// the source pixels are gathered, the sums are four pixels at a time
+	for ( j = 0 ; j + 4 <= outwidth ; j += 4 ) {
+		for ( k = 0 ; k < 4 ; k++ ) {
+			pix[0][k] = inrow[p1[j+k]>>2];
+			pix[1][k] = inrow[p2[j+k]>>2];
+			pix[2][k] = inrow2[p1[j+k]>>2];
+			pix[3][k] = inrow2[p2[j+k]>>2];
+		}
+		a = vreinterpretq_u8_u32( vld1q_u32( pix[0] ) );
+		b = vreinterpretq_u8_u32( vld1q_u32( pix[1] ) );
+		c = vreinterpretq_u8_u32( vld1q_u32( pix[2] ) );
+		d = vreinterpretq_u8_u32( vld1q_u32( pix[3] ) );
+		lo = vaddq_u16( vaddl_u8( vget_low_u8( a ), vget_low_u8( b ) ),
+			vaddl_u8( vget_low_u8( c ), vget_low_u8( d ) ) );
+		hi = vaddq_u16( vaddl_u8( vget_high_u8( a ), vget_high_u8( b ) ),
+			vaddl_u8( vget_high_u8( c ), vget_high_u8( d ) ) );
+		vst1q_u8( (byte *)( out + j ), vcombine_u8( vshrn_n_u16( lo, 2 ), vshrn_n_u16( hi, 2 ) ) );
+	}
+	ResampleRow_scalar( inrow, inrow2, p1 + j, p2 + j, out + j, outwidth - j );
+}
+#endif
+
+static qboolean ResampleTexture( const unsigned *in, int inwidth, int inheight, unsigned *out,  
 							int outwidth, int outheight ) {
-	int		i, j;
-	unsigned	*inrow, *inrow2;
+	int		i;
+	const unsigned	*inrow, *inrow2;
 	unsigned	frac, fracstep;
 	unsigned	p1[2048], p2[2048];
-	byte		*pix1, *pix2, *pix3, *pix4;
 
 	if (outwidth>2048)
-		ri.Error(ERR_DROP, "ResampleTexture: max width");
+		return qfalse;
 								
 	fracstep = inwidth*0x10000/outwidth;
 
@@ -255,18 +412,21 @@ static void ResampleTexture( unsigned *in, int inwidth, int inheight, unsigned *
 	for (i=0 ; i<outheight ; i++, out += outwidth) {
 		inrow = in + inwidth*(int)((i+0.25)*inheight/outheight);
 		inrow2 = in + inwidth*(int)((i+0.75)*inheight/outheight);
-		frac = fracstep >> 1;
-		for (j=0 ; j<outwidth ; j++) {
-			pix1 = (byte *)inrow + p1[j];
-			pix2 = (byte *)inrow + p2[j];
-			pix3 = (byte *)inrow2 + p1[j];
-			pix4 = (byte *)inrow2 + p2[j];
-			((byte *)(out+j))[0] = (pix1[0] + pix2[0] + pix3[0] + pix4[0])>>2;
-			((byte *)(out+j))[1] = (pix1[1] + pix2[1] + pix3[1] + pix4[1])>>2;
-			((byte *)(out+j))[2] = (pix1[2] + pix2[2] + pix3[2] + pix4[2])>>2;
-			((byte *)(out+j))[3] = (pix1[3] + pix2[3] + pix3[3] + pix4[3])>>2;
+#if defined( IMAGE_SIMD_SSE2 )
+		if ( imageSIMD ) {
+			ResampleRow_sse2( inrow, inrow2, p1, p2, out, outwidth );
+			continue;
 		}
+#elif defined( IMAGE_SIMD_NEON )
+		if ( imageSIMD ) {
+			ResampleRow_neon( inrow, inrow2, p1, p2, out, outwidth );
+			continue;
+		}
+#endif
+		ResampleRow_scalar( inrow, inrow2, p1, p2, out, outwidth );
 	}
+
+	return qtrue;
 }
 
 /*
@@ -277,54 +437,73 @@ Scale up the pixel values in a texture to increase the
 lighting range
 ================
 */
-void R_LightScaleTexture (unsigned *in, int inwidth, int inheight, qboolean only_gamma )
-{
-	if ( only_gamma )
+static void R_LightScaleTexture_scalar( byte *p, int c, const byte *table ) {
+	int		i;
+
+	for (i=0 ; i<c ; i++, p+=4)
 	{
-		if ( !glConfig.deviceSupportsGamma )
-		{
-			int		i, c;
-			byte	*p;
+		p[0] = table[p[0]];
+		p[1] = table[p[1]];
+		p[2] = table[p[2]];
+	}
+}
 
-			p = (byte *)in;
+#if defined( IMAGE_SIMD_NEON ) && defined( __aarch64__ )
+// the 256 entry table is four 64 byte tbl lookups, an index out of
+// range for one of them leaves the byte from the earlier ones alone
+static void R_LightScaleTexture_neon( byte *p, int c, const byte *table ) {
+	int		i, k;
+	uint8x16x4_t	t[4];
+	uint8x16_t	v, s;
+	const uint8x16_t	step = vdupq_n_u8( 64 );
+	const uint8x16_t	alpha = vreinterpretq_u8_u32( vdupq_n_u32( LittleLong( 0xff000000 ) ) );
+
+	for ( k = 0 ; k < 16 ; k++ ) {
+		t[k>>2].val[k&3] = vld1q_u8( table + k * 16 );
+	}
+
+	for ( i = 0 ; i + 4 <= c ; i += 4, p += 16 ) {
+		v = vld1q_u8( p );
+		s = vqtbl4q_u8( t[0], v );
+		s = vqtbx4q_u8( s, t[1], vsubq_u8( v, step ) );
+		s = vqtbx4q_u8( s, t[2], vsubq_u8( v, vaddq_u8( step, step ) ) );
+		s = vqtbx4q_u8( s, t[3], vaddq_u8( v, step ) );
+		vst1q_u8( p, vbslq_u8( alpha, v, s ) );
+	}
+	R_LightScaleTexture_scalar( p, c - i, table );
+}
+#endif
 
-			c = inwidth*inheight;
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_gammatable[p[0]];
-				p[1] = s_gammatable[p[1]];
-				p[2] = s_gammatable[p[2]];
-			}
-		}
+/*
+================
+R_LightScaleTable
+
+The table R_LightScaleTexture applies, NULL if it leaves the texture alone
+================
+*/
+const byte *R_LightScaleTable( qboolean onlyGamma ) {
+	if ( onlyGamma ) {
+		return glConfig.deviceSupportsGamma ? NULL : s_gammatable;
 	}
-	else
-	{
-		int		i, c;
-		byte	*p;
+	return glConfig.deviceSupportsGamma ? s_intensitytable : s_lighttable;
+}
 
-		p = (byte *)in;
+void R_LightScaleTexture (unsigned *in, int inwidth, int inheight, qboolean only_gamma )
+{
+	const byte	*table;
 
-		c = inwidth*inheight;
+	table = R_LightScaleTable( only_gamma );
+	if ( !table )
+		return;
 
-		if ( glConfig.deviceSupportsGamma )
-		{
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_intensitytable[p[0]];
-				p[1] = s_intensitytable[p[1]];
-				p[2] = s_intensitytable[p[2]];
-			}
-		}
-		else
-		{
-			for (i=0 ; i<c ; i++, p+=4)
-			{
-				p[0] = s_gammatable[s_intensitytable[p[0]]];
-				p[1] = s_gammatable[s_intensitytable[p[1]]];
-				p[2] = s_gammatable[s_intensitytable[p[2]]];
-			}
-		}
+	// SSE2 has no byte table lookup
+#if defined( IMAGE_SIMD_NEON ) && defined( __aarch64__ )
+	if ( imageSIMD ) {
+		R_LightScaleTexture_neon( (byte *)in, inwidth*inheight, table );
+		return;
 	}
+#endif
+	R_LightScaleTexture_scalar( (byte *)in, inwidth*inheight, table );
 }
 
 
@@ -332,81 +511,356 @@ void R_LightScaleTexture (unsigned *in, int inwidth, int inheight, qboolean only
 ================
 R_MipMap2
 
-Operates in place, quartering the size of the texture
+Quarters the size of the texture into out
 Proper linear filter
 ================
 */
-static void R_MipMap2( unsigned *in, int inWidth, int inHeight ) {
-	int			i, j, k;
+static ID_INLINE void R_MipMap2Pixel( const unsigned *in, unsigned *out, int inWidth, int inHeight, int i, int j ) {
+	int			k;
 	byte		*outpix;
 	int			inWidthMask, inHeightMask;
 	int			total;
+
+	inWidthMask = inWidth - 1;
+	inHeightMask = inHeight - 1;
+
+	outpix = (byte *) ( out + i * ( inWidth >> 1 ) + j );
+	for ( k = 0 ; k < 4 ; k++ ) {
+		total = 
+			1 * ((const byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
+			2 * ((const byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
+			2 * ((const byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
+			1 * ((const byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k] +
+
+			2 * ((const byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
+			4 * ((const byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
+			4 * ((const byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
+			2 * ((const byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k] +
+
+			2 * ((const byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
+			4 * ((const byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
+			4 * ((const byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
+			2 * ((const byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k] +
+
+			1 * ((const byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
+			2 * ((const byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
+			2 * ((const byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
+			1 * ((const byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k];
+		outpix[k] = total / 36;
+	}
+}
+
+static void R_MipMap2_scalar( const unsigned *in, unsigned *out, int inWidth, int inHeight ) {
+	int			i, j;
+
+	for ( i = 0 ; i < inHeight >> 1 ; i++ ) {
+		for ( j = 0 ; j < inWidth >> 1 ; j++ ) {
+			R_MipMap2Pixel( in, out, inWidth, inHeight, i, j );
+		}
+	}
+}
+
+// The vector versions filter the columns first, then the rows.  The first
+// and last output pixel of a row wrap around to the other edge, they and
+// any pixels left over go through R_MipMap2Pixel.  Dividing by 36 is a
+// multiply by 2^21/36 rounded up, which is exact for every possible total.
+#define	MIP_DIV36_MUL		58255
+#define	MIP_DIV36_SHIFT		5
+
+#if defined( IMAGE_SIMD_SSE2 )
+static ID_INLINE __m128i R_MipMap2Columns_sse2( __m128i r0, __m128i r1, __m128i r2, __m128i r3 ) {
+	return _mm_add_epi16( _mm_add_epi16( r0, r3 ), _mm_slli_epi16( _mm_add_epi16( r1, r2 ), 1 ) );
+}
+
+// a is the column sums of pixels n-1 and n, b of n+1 and n+2,
+// c of n+3 and n+4, returns output pixels n/2 and n/2+1 unpacked
+static ID_INLINE __m128i R_MipMap2Rows_sse2( __m128i a, __m128i b, __m128i c ) {
+	__m128i	total;
+
+	total = _mm_add_epi16( _mm_add_epi16( _mm_unpacklo_epi64( a, b ), _mm_unpackhi_epi64( b, c ) ),
+		_mm_slli_epi16( _mm_add_epi16( _mm_unpackhi_epi64( a, b ), _mm_unpacklo_epi64( b, c ) ), 1 ) );
+	return _mm_srli_epi16( _mm_mulhi_epu16( total, _mm_set1_epi16( (short)MIP_DIV36_MUL ) ), MIP_DIV36_SHIFT );
+}
+
+static void R_MipMap2_sse2( const unsigned *in, unsigned *out, int inWidth, int inHeight ) {
+	int			i, j, k;
 	int			outWidth, outHeight;
-	unsigned	*temp;
+	const byte	*row[4];
+	__m128i		v[4], p[5];
+	const __m128i	zero = _mm_setzero_si128();
 
 	outWidth = inWidth >> 1;
 	outHeight = inHeight >> 1;
-	temp = ri.Hunk_AllocateTempMemory( outWidth * outHeight * 4 );
 
-	inWidthMask = inWidth - 1;
-	inHeightMask = inHeight - 1;
+	for ( i = 0 ; i < outHeight ; i++ ) {
+		for ( k = 0 ; k < 4 ; k++ ) {
+			row[k] = (const byte *)( in + ( ( i*2-1+k ) & ( inHeight-1 ) ) * inWidth );
+		}
+
+		R_MipMap2Pixel( in, out, inWidth, inHeight, i, 0 );
+
+		// four output pixels need input columns 2j-1 to 2j+8
+		for ( j = 1 ; j + 4 < outWidth ; j += 4 ) {
+			for ( k = 0 ; k < 4 ; k++ ) {
+				v[k] = _mm_loadu_si128( (const __m128i *)( row[k] + ( j*2-1 ) * 4 ) );
+			}
+			p[0] = R_MipMap2Columns_sse2( _mm_unpacklo_epi8( v[0], zero ), _mm_unpacklo_epi8( v[1], zero ),
+				_mm_unpacklo_epi8( v[2], zero ), _mm_unpacklo_epi8( v[3], zero ) );
+			p[1] = R_MipMap2Columns_sse2( _mm_unpackhi_epi8( v[0], zero ), _mm_unpackhi_epi8( v[1], zero ),
+				_mm_unpackhi_epi8( v[2], zero ), _mm_unpackhi_epi8( v[3], zero ) );
+			for ( k = 0 ; k < 4 ; k++ ) {
+				v[k] = _mm_loadu_si128( (const __m128i *)( row[k] + ( j*2+3 ) * 4 ) );
+			}
+			p[2] = R_MipMap2Columns_sse2( _mm_unpacklo_epi8( v[0], zero ), _mm_unpacklo_epi8( v[1], zero ),
+				_mm_unpacklo_epi8( v[2], zero ), _mm_unpacklo_epi8( v[3], zero ) );
+			p[3] = R_MipMap2Columns_sse2( _mm_unpackhi_epi8( v[0], zero ), _mm_unpackhi_epi8( v[1], zero ),
+				_mm_unpackhi_epi8( v[2], zero ), _mm_unpackhi_epi8( v[3], zero ) );
+			for ( k = 0 ; k < 4 ; k++ ) {
+				v[k] = _mm_loadl_epi64( (const __m128i *)( row[k] + ( j*2+7 ) * 4 ) );
+			}
+			p[4] = R_MipMap2Columns_sse2( _mm_unpacklo_epi8( v[0], zero ), _mm_unpacklo_epi8( v[1], zero ),
+				_mm_unpacklo_epi8( v[2], zero ), _mm_unpacklo_epi8( v[3], zero ) );
+
+			_mm_storeu_si128( (__m128i *)( out + i * outWidth + j ),
+				_mm_packus_epi16( R_MipMap2Rows_sse2( p[0], p[1], p[2] ), R_MipMap2Rows_sse2( p[2], p[3], p[4] ) ) );
+		}
+
+		for ( ; j < outWidth ; j++ ) {
+			R_MipMap2Pixel( in, out, inWidth, inHeight, i, j );
+		}
+	}
+}
+#endif
+
+#if defined( IMAGE_SIMD_NEON )
+static ID_INLINE uint16x8_t R_MipMap2Columns_neon( uint8x8_t r0, uint8x8_t r1, uint8x8_t r2, uint8x8_t r3 ) {
+	return vaddq_u16( vaddl_u8( r0, r3 ), vshlq_n_u16( vaddl_u8( r1, r2 ), 1 ) );
+}
+
+// a is the column sums of pixels n-1 and n, b of n+1 and n+2,
+// c of n+3 and n+4, returns output pixels n/2 and n/2+1
+static ID_INLINE uint8x8_t R_MipMap2Rows_neon( uint16x8_t a, uint16x8_t b, uint16x8_t c ) {
+	uint16x8_t	total;
+	const uint16x4_t	mul = vdup_n_u16( MIP_DIV36_MUL );
+
+	total = vaddq_u16( vaddq_u16( vcombine_u16( vget_low_u16( a ), vget_low_u16( b ) ),
+			vcombine_u16( vget_high_u16( b ), vget_high_u16( c ) ) ),
+		vshlq_n_u16( vaddq_u16( vcombine_u16( vget_high_u16( a ), vget_high_u16( b ) ),
+			vcombine_u16( vget_low_u16( b ), vget_low_u16( c ) ) ), 1 ) );
+	total = vcombine_u16( vshrn_n_u32( vmull_u16( vget_low_u16( total ), mul ), 16 ),
+		vshrn_n_u32( vmull_u16( vget_high_u16( total ), mul ), 16 ) );
+	return vmovn_u16( vshrq_n_u16( total, MIP_DIV36_SHIFT ) );
+}
+
+static void R_MipMap2_neon( const unsigned *in, unsigned *out, int inWidth, int inHeight ) {
+	int			i, j, k;
+	int			outWidth, outHeight;
+	const byte	*row[4];
+	uint8x16_t	v[4];
+	uint8x8_t	w[4];
+	uint16x8_t	p[5];
+
+	outWidth = inWidth >> 1;
+	outHeight = inHeight >> 1;
 
 	for ( i = 0 ; i < outHeight ; i++ ) {
-		for ( j = 0 ; j < outWidth ; j++ ) {
-			outpix = (byte *) ( temp + i * outWidth + j );
+		for ( k = 0 ; k < 4 ; k++ ) {
+			row[k] = (const byte *)( in + ( ( i*2-1+k ) & ( inHeight-1 ) ) * inWidth );
+		}
+
+		R_MipMap2Pixel( in, out, inWidth, inHeight, i, 0 );
+
+		// four output pixels need input columns 2j-1 to 2j+8
+		for ( j = 1 ; j + 4 < outWidth ; j += 4 ) {
+			for ( k = 0 ; k < 4 ; k++ ) {
+				v[k] = vld1q_u8( row[k] + ( j*2-1 ) * 4 );
+			}
+			p[0] = R_MipMap2Columns_neon( vget_low_u8( v[0] ), vget_low_u8( v[1] ), vget_low_u8( v[2] ), vget_low_u8( v[3] ) );
+			p[1] = R_MipMap2Columns_neon( vget_high_u8( v[0] ), vget_high_u8( v[1] ), vget_high_u8( v[2] ), vget_high_u8( v[3] ) );
+			for ( k = 0 ; k < 4 ; k++ ) {
+				v[k] = vld1q_u8( row[k] + ( j*2+3 ) * 4 );
+			}
+			p[2] = R_MipMap2Columns_neon( vget_low_u8( v[0] ), vget_low_u8( v[1] ), vget_low_u8( v[2] ), vget_low_u8( v[3] ) );
+			p[3] = R_MipMap2Columns_neon( vget_high_u8( v[0] ), vget_high_u8( v[1] ), vget_high_u8( v[2] ), vget_high_u8( v[3] ) );
 			for ( k = 0 ; k < 4 ; k++ ) {
-				total = 
-					1 * ((byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
-					2 * ((byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
-					2 * ((byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
-					1 * ((byte *)&in[ ((i*2-1)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k] +
-
-					2 * ((byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
-					4 * ((byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
-					4 * ((byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
-					2 * ((byte *)&in[ ((i*2)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k] +
-
-					2 * ((byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
-					4 * ((byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
-					4 * ((byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
-					2 * ((byte *)&in[ ((i*2+1)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k] +
-
-					1 * ((byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2-1)&inWidthMask) ])[k] +
-					2 * ((byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2)&inWidthMask) ])[k] +
-					2 * ((byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2+1)&inWidthMask) ])[k] +
-					1 * ((byte *)&in[ ((i*2+2)&inHeightMask)*inWidth + ((j*2+2)&inWidthMask) ])[k];
-				outpix[k] = total / 36;
+				w[k] = vld1_u8( row[k] + ( j*2+7 ) * 4 );
 			}
+			p[4] = R_MipMap2Columns_neon( w[0], w[1], w[2], w[3] );
+
+			vst1q_u8( (byte *)( out + i * outWidth + j ),
+				vcombine_u8( R_MipMap2Rows_neon( p[0], p[1], p[2] ), R_MipMap2Rows_neon( p[2], p[3], p[4] ) ) );
 		}
+
+		for ( ; j < outWidth ; j++ ) {
+			R_MipMap2Pixel( in, out, inWidth, inHeight, i, j );
+		}
+	}
+}
+#endif
+
+static void R_MipMap2( const unsigned *in, unsigned *out, int inWidth, int inHeight ) {
+	int			outWidth, outHeight;
+
+	outWidth = inWidth >> 1;
+	outHeight = inHeight >> 1;
+
+	if ( !outWidth || !outHeight ) {
+		// single rows and columns aren't filtered, the next level
+		// is just the start of this one
+		if ( !outWidth ) {
+			outWidth = 1;
+		}
+		if ( !outHeight ) {
+			outHeight = 1;
+		}
+		Com_Memcpy( out, in, outWidth * outHeight * 4 );
+		return;
 	}
 
-	Com_Memcpy( in, temp, outWidth * outHeight * 4 );
-	ri.Hunk_FreeTempMemory( temp );
+#if defined( IMAGE_SIMD_SSE2 )
+	if ( imageSIMD ) {
+		R_MipMap2_sse2( in, out, inWidth, inHeight );
+		return;
+	}
+#elif defined( IMAGE_SIMD_NEON )
+	if ( imageSIMD ) {
+		R_MipMap2_neon( in, out, inWidth, inHeight );
+		return;
+	}
+#endif
+	R_MipMap2_scalar( in, out, inWidth, inHeight );
 }
 
 /*
 ================
-R_MipMap
+R_MipMapBox
 
-Operates in place, quartering the size of the texture
+Quarters the size of the texture into out with a box filter,
+width and height are the output size and at least one
 ================
 */
-static void R_MipMap (byte *in, int width, int height) {
+static void R_MipMapBox_scalar( const byte *in, byte *out, int width, int height ) {
+	int		i, j;
+	int		row;
+
+	row = width * 8;
+	for (i=0 ; i<height ; i++, in+=row) {
+		for (j=0 ; j<width ; j++, out+=4, in+=8) {
+			out[0] = (in[0] + in[4] + in[row+0] + in[row+4])>>2;
+			out[1] = (in[1] + in[5] + in[row+1] + in[row+5])>>2;
+			out[2] = (in[2] + in[6] + in[row+2] + in[row+6])>>2;
+			out[3] = (in[3] + in[7] + in[row+3] + in[row+7])>>2;
+		}
+	}
+}
+
+#if defined( IMAGE_SIMD_SSE2 )
+static void R_MipMapBox_sse2( const byte *in, byte *out, int width, int height ) {
+	int		i, j;
+	int		row;
+	const byte	*in2;
+	__m128i	a, b, c, d, s0, s1, s2, s3;
+	const __m128i	zero = _mm_setzero_si128();
+
+	row = width * 8;
+	for ( i = 0 ; i < height ; i++, in += row ) {
+		in2 = in + row;
+		for ( j = 0 ; j + 4 <= width ; j += 4, in += 32, in2 += 32, out += 16 ) {
+			a = _mm_loadu_si128( (const __m128i *)in );
+			b = _mm_loadu_si128( (const __m128i *)( in + 16 ) );
+			c = _mm_loadu_si128( (const __m128i *)in2 );
+			d = _mm_loadu_si128( (const __m128i *)( in2 + 16 ) );
+			s0 = _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( c, zero ) );
+			s1 = _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( c, zero ) );
+			s2 = _mm_add_epi16( _mm_unpacklo_epi8( b, zero ), _mm_unpacklo_epi8( d, zero ) );
+			s3 = _mm_add_epi16( _mm_unpackhi_epi8( b, zero ), _mm_unpackhi_epi8( d, zero ) );
+			s0 = _mm_add_epi16( _mm_unpacklo_epi64( s0, s1 ), _mm_unpackhi_epi64( s0, s1 ) );
+			s2 = _mm_add_epi16( _mm_unpacklo_epi64( s2, s3 ), _mm_unpackhi_epi64( s2, s3 ) );
+			_mm_storeu_si128( (__m128i *)out, _mm_packus_epi16( _mm_srli_epi16( s0, 2 ), _mm_srli_epi16( s2, 2 ) ) );
+		}
+		for ( ; j < width ; j++, in += 8, out += 4 ) {
+			out[0] = (in[0] + in[4] + in[row+0] + in[row+4])>>2;
+			out[1] = (in[1] + in[5] + in[row+1] + in[row+5])>>2;
+			out[2] = (in[2] + in[6] + in[row+2] + in[row+6])>>2;
+			out[3] = (in[3] + in[7] + in[row+3] + in[row+7])>>2;
+		}
+	}
+}
+#endif
+
+#if defined( IMAGE_SIMD_NEON )
+static void R_MipMapBox_neon( const byte *in, byte *out, int width, int height ) {
 	int		i, j;
-	byte	*out;
 	int		row;
+	const byte	*in2;
+	uint8x16_t	a, b, c, d;
+	uint16x8_t	s0, s1, s2, s3;
+
+	row = width * 8;
+	for ( i = 0 ; i < height ; i++, in += row ) {
+		in2 = in + row;
+		for ( j = 0 ; j + 4 <= width ; j += 4, in += 32, in2 += 32, out += 16 ) {
+			a = vld1q_u8( in );
+			b = vld1q_u8( in + 16 );
+			c = vld1q_u8( in2 );
+			d = vld1q_u8( in2 + 16 );
+			s0 = vaddl_u8( vget_low_u8( a ), vget_low_u8( c ) );
+			s1 = vaddl_u8( vget_high_u8( a ), vget_high_u8( c ) );
+			s2 = vaddl_u8( vget_low_u8( b ), vget_low_u8( d ) );
+			s3 = vaddl_u8( vget_high_u8( b ), vget_high_u8( d ) );
+			s0 = vaddq_u16( vcombine_u16( vget_low_u16( s0 ), vget_low_u16( s1 ) ),
+				vcombine_u16( vget_high_u16( s0 ), vget_high_u16( s1 ) ) );
+			s2 = vaddq_u16( vcombine_u16( vget_low_u16( s2 ), vget_low_u16( s3 ) ),
+				vcombine_u16( vget_high_u16( s2 ), vget_high_u16( s3 ) ) );
+			vst1q_u8( out, vcombine_u8( vshrn_n_u16( s0, 2 ), vshrn_n_u16( s2, 2 ) ) );
+		}
+		for ( ; j < width ; j++, in += 8, out += 4 ) {
+			out[0] = (in[0] + in[4] + in[row+0] + in[row+4])>>2;
+			out[1] = (in[1] + in[5] + in[row+1] + in[row+5])>>2;
+			out[2] = (in[2] + in[6] + in[row+2] + in[row+6])>>2;
+			out[3] = (in[3] + in[7] + in[row+3] + in[row+7])>>2;
+		}
+	}
+}
+#endif
+
+static void R_MipMapBox( const byte *in, byte *out, int width, int height ) {
+#if defined( IMAGE_SIMD_SSE2 )
+	if ( imageSIMD ) {
+		R_MipMapBox_sse2( in, out, width, height );
+		return;
+	}
+#elif defined( IMAGE_SIMD_NEON )
+	if ( imageSIMD ) {
+		R_MipMapBox_neon( in, out, width, height );
+		return;
+	}
+#endif
+	R_MipMapBox_scalar( in, out, width, height );
+}
+
+/*
+================
+R_MipMap
+
+Quarters the size of the texture into out, which must not overlap in.
+Doesn't use any temporary memory so it can run on the image load
+worker threads.
+================
+*/
+static void R_MipMap (const byte *in, byte *out, int width, int height) {
+	int		i;
 
 	if ( !r_simpleMipMaps->integer ) {
-		R_MipMap2( (unsigned *)in, width, height );
+		R_MipMap2( (const unsigned *)in, (unsigned *)out, width, height );
 		return;
 	}
 
 	if ( width == 1 && height == 1 ) {
+		Com_Memcpy( out, in, 4 );
 		return;
 	}
 
-	row = width * 4;
-	out = in;
 	width >>= 1;
 	height >>= 1;
 
@@ -421,14 +875,7 @@ static void R_MipMap (byte *in, int width, int height) {
 		return;
 	}
 
-	for (i=0 ; i<height ; i++, in+=row) {
-		for (j=0 ; j<width ; j++, out+=4, in+=8) {
-			out[0] = (in[0] + in[4] + in[row+0] + in[row+4])>>2;
-			out[1] = (in[1] + in[5] + in[row+1] + in[row+5])>>2;
-			out[2] = (in[2] + in[6] + in[row+2] + in[row+6])>>2;
-			out[3] = (in[3] + in[7] + in[row+3] + in[row+7])>>2;
-		}
-	}
+	R_MipMapBox( in, out, width, height );
 }
 
 
@@ -439,8 +886,73 @@ R_BlendOverTexture
 Apply a color blend over a set of pixels
 ==================
 */
-static void R_BlendOverTexture( byte *data, int pixelCount, byte blend[4] ) {
+static void R_BlendOverTexture_scalar( byte *data, int pixelCount, int inverseAlpha, const int premult[3] ) {
+	int		i;
+
+	for ( i = 0 ; i < pixelCount ; i++, data+=4 ) {
+		data[0] = ( data[0] * inverseAlpha + premult[0] ) >> 9;
+		data[1] = ( data[1] * inverseAlpha + premult[1] ) >> 9;
+		data[2] = ( data[2] * inverseAlpha + premult[2] ) >> 9;
+	}
+}
+
+#if defined( IMAGE_SIMD_SSE2 )
+static void R_BlendOverTexture_sse2( byte *data, int pixelCount, int inverseAlpha, const int premult[3] ) {
+	int		i;
+	__m128i	v, lo, hi;
+	const __m128i	zero = _mm_setzero_si128();
+	const __m128i	alpha = _mm_set1_epi32( LittleLong( 0xff000000 ) );
+	const __m128i	inverse = _mm_set1_epi16( (short)inverseAlpha );
+	const __m128i	add = _mm_set_epi32( 0, premult[2], premult[1], premult[0] );
+
+	// the products are at most 255 * 255, the sums need 32 bits
+	for ( i = 0 ; i + 4 <= pixelCount ; i += 4, data += 16 ) {
+		v = _mm_loadu_si128( (const __m128i *)data );
+		lo = _mm_mullo_epi16( _mm_unpacklo_epi8( v, zero ), inverse );
+		hi = _mm_mullo_epi16( _mm_unpackhi_epi8( v, zero ), inverse );
+		lo = _mm_packs_epi32( _mm_srli_epi32( _mm_add_epi32( _mm_unpacklo_epi16( lo, zero ), add ), 9 ),
+			_mm_srli_epi32( _mm_add_epi32( _mm_unpackhi_epi16( lo, zero ), add ), 9 ) );
+		hi = _mm_packs_epi32( _mm_srli_epi32( _mm_add_epi32( _mm_unpacklo_epi16( hi, zero ), add ), 9 ),
+			_mm_srli_epi32( _mm_add_epi32( _mm_unpackhi_epi16( hi, zero ), add ), 9 ) );
+		v = _mm_or_si128( _mm_and_si128( v, alpha ), _mm_andnot_si128( alpha, _mm_packus_epi16( lo, hi ) ) );
+		_mm_storeu_si128( (__m128i *)data, v );
+	}
+	R_BlendOverTexture_scalar( data, pixelCount - i, inverseAlpha, premult );
+}
+#endif
+
+#if defined( IMAGE_SIMD_NEON )
+static void R_BlendOverTexture_neon( byte *data, int pixelCount, int inverseAlpha, const int premult[3] ) {
 	int		i;
+	unsigned	addPixel[4];
+	uint8x16_t	v;
+	uint16x8_t	lo, hi;
+	uint32x4_t	add;
+	const uint8x8_t	inverse = vdup_n_u8( inverseAlpha );
+	const uint8x16_t	alpha = vreinterpretq_u8_u32( vdupq_n_u32( LittleLong( 0xff000000 ) ) );
+
+	addPixel[0] = premult[0];
+	addPixel[1] = premult[1];
+	addPixel[2] = premult[2];
+	addPixel[3] = 0;
+	add = vld1q_u32( addPixel );
+
+	// the products are at most 255 * 255, the sums need 32 bits
+	for ( i = 0 ; i + 4 <= pixelCount ; i += 4, data += 16 ) {
+		v = vld1q_u8( data );
+		lo = vmull_u8( vget_low_u8( v ), inverse );
+		hi = vmull_u8( vget_high_u8( v ), inverse );
+		lo = vcombine_u16( vshrn_n_u32( vaddw_u16( add, vget_low_u16( lo ) ), 9 ),
+			vshrn_n_u32( vaddw_u16( add, vget_high_u16( lo ) ), 9 ) );
+		hi = vcombine_u16( vshrn_n_u32( vaddw_u16( add, vget_low_u16( hi ) ), 9 ),
+			vshrn_n_u32( vaddw_u16( add, vget_high_u16( hi ) ), 9 ) );
+		vst1q_u8( data, vbslq_u8( alpha, v, vcombine_u8( vmovn_u16( lo ), vmovn_u16( hi ) ) ) );
+	}
+	R_BlendOverTexture_scalar( data, pixelCount - i, inverseAlpha, premult );
+}
+#endif
+
+static void R_BlendOverTexture( byte *data, int pixelCount, byte blend[4] ) {
 	int		inverseAlpha;
 	int		premult[3];
 
@@ -449,11 +961,18 @@ static void R_BlendOverTexture( byte *data, int pixelCount, byte blend[4] ) {
 	premult[1] = blend[1] * blend[3];
 	premult[2] = blend[2] * blend[3];
 
-	for ( i = 0 ; i < pixelCount ; i++, data+=4 ) {
-		data[0] = ( data[0] * inverseAlpha + premult[0] ) >> 9;
-		data[1] = ( data[1] * inverseAlpha + premult[1] ) >> 9;
-		data[2] = ( data[2] * inverseAlpha + premult[2] ) >> 9;
+#if defined( IMAGE_SIMD_SSE2 )
+	if ( imageSIMD ) {
+		R_BlendOverTexture_sse2( data, pixelCount, inverseAlpha, premult );
+		return;
+	}
+#elif defined( IMAGE_SIMD_NEON )
+	if ( imageSIMD ) {
+		R_BlendOverTexture_neon( data, pixelCount, inverseAlpha, premult );
+		return;
 	}
+#endif
+	R_BlendOverTexture_scalar( data, pixelCount, inverseAlpha, premult );
 }
 
 byte	mipBlendColors[16][4] = {
@@ -476,30 +995,45 @@ byte	mipBlendColors[16][4] = {
 };
 
 
+/*
+================
+R_IsLightmapImage
+================
+*/
+static qboolean R_IsLightmapImage( const char *name ) {
+	return !strncmp( name, "*lightmap", 9 );
+}
+
 /*
 ===============
-Upload32
+R_PrepareImage
 
+Does all the CPU side work of an upload: power of two resampling,
+picmip, the internal format and all the mip levels, light scaled.
+Only uses malloc so it can run on the image load worker threads,
+returns an error message on failure.
 ===============
 */
 extern qboolean charSet;
-static void Upload32( unsigned *data, 
+static const char *R_PrepareImage( imageUpload_t *upload, const unsigned *data,
 						  int width, int height, 
 						  qboolean mipmap, 
 						  qboolean picmip, 
-							qboolean lightMap,
-						  int *format, 
-						  int *pUploadWidth, int *pUploadHeight )
+							qboolean lightMap )
 {
 	int			samples;
-	unsigned	*scaledBuffer = NULL;
 	unsigned	*resampledBuffer = NULL;
+	const byte	*src;
+	byte		*dst;
 	int			scaled_width, scaled_height;
-	int			i, c;
-	byte		*scan;
+	int			w, h;
+	int			i, c, size;
+	const byte	*scan;
 	GLenum		internalFormat = GL_RGB;
 	float		rMax = 0, gMax = 0, bMax = 0;
 
+	Com_Memset( upload, 0, sizeof( *upload ) );
+
 	//
 	// convert to exact power of 2 sizes
 	//
@@ -513,8 +1047,14 @@ static void Upload32( unsigned *data,
 		scaled_height >>= 1;
 
 	if ( scaled_width != width || scaled_height != height ) {
-		resampledBuffer = ri.Hunk_AllocateTempMemory( scaled_width * scaled_height * 4 );
-		ResampleTexture (data, width, height, resampledBuffer, scaled_width, scaled_height);
+		resampledBuffer = malloc( scaled_width * scaled_height * 4 );
+		if ( !resampledBuffer ) {
+			return "R_PrepareImage: out of memory";
+		}
+		if ( !ResampleTexture (data, width, height, resampledBuffer, scaled_width, scaled_height) ) {
+			free( resampledBuffer );
+			return "ResampleTexture: max width";
+		}
 		data = resampledBuffer;
 		width = scaled_width;
 		height = scaled_height;
@@ -549,14 +1089,12 @@ static void Upload32( unsigned *data,
 		scaled_height >>= 1;
 	}
 
-	scaledBuffer = ri.Hunk_AllocateTempMemory( sizeof( unsigned ) * scaled_width * scaled_height );
-
 	//
 	// scan the texture for each channel's max values
 	// and verify if the alpha channel is being used or not
 	//
 	c = width*height;
-	scan = ((byte *)data);
+	scan = ((const byte *)data);
 	samples = 3;
 
 	if(lightMap)
@@ -602,7 +1140,11 @@ static void Upload32( unsigned *data,
 			}
 			else
 			{
-				if ( glConfig.textureCompression == TC_S3TC )
+				if ( glConfig.textureCompression == TC_S3TC_ARB )
+				{
+					internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+				}
+				else if ( glConfig.textureCompression == TC_S3TC )
 				{
 					internalFormat = GL_RGB4_S3TC;
 				}
@@ -649,73 +1191,146 @@ static void Upload32( unsigned *data,
 		}
 	}
 
-	// copy or resample data as appropriate for first MIP level
+	upload->internalFormat = internalFormat;
+	upload->width = scaled_width;
+	upload->height = scaled_height;
+
+	// unmipped images that are already the right size go up as they are
 	if ( ( scaled_width == width ) && 
-		( scaled_height == height ) ) {
-		if (!mipmap)
-		{
-			qglTexImage2D (GL_TEXTURE_2D, 0, internalFormat, scaled_width, scaled_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			*pUploadWidth = scaled_width;
-			*pUploadHeight = scaled_height;
-			*format = internalFormat;
+		( scaled_height == height ) && !mipmap ) {
+		upload->numLevels = 1;
+		upload->levels[0] = (const byte *)data;
+		upload->buffer = (byte *)resampledBuffer;
+		return NULL;
+	}
 
-			goto done;
+	// room for the first level and every mip level below it
+	size = 0;
+	w = scaled_width;
+	h = scaled_height;
+	while ( 1 ) {
+		size += w * h * 4;
+		if ( !mipmap || ( w == 1 && h == 1 ) ) {
+			break;
 		}
-		Com_Memcpy (scaledBuffer, data, width*height*4);
-	}
-	else
-	{
-		// use the normal mip-mapping function to go down from here
-		while ( width > scaled_width || height > scaled_height ) {
-			R_MipMap( (byte *)data, width, height );
-			width >>= 1;
-			height >>= 1;
-			if ( width < 1 ) {
-				width = 1;
-			}
-			if ( height < 1 ) {
-				height = 1;
+		w = ( w > 1 ) ? w >> 1 : 1;
+		h = ( h > 1 ) ? h >> 1 : 1;
+	}
+	upload->buffer = malloc( size );
+	if ( !upload->buffer ) {
+		free( resampledBuffer );
+		return "R_PrepareImage: out of memory";
+	}
+	upload->levels[0] = upload->buffer;
+
+	// use the normal mip-mapping function to go down from here
+	src = (const byte *)data;
+	while ( width > scaled_width || height > scaled_height ) {
+		w = ( width > 1 ) ? width >> 1 : 1;
+		h = ( height > 1 ) ? height >> 1 : 1;
+		if ( w <= scaled_width && h <= scaled_height ) {
+			dst = upload->buffer;
+		} else {
+			dst = malloc( w * h * 4 );
+			if ( !dst ) {
+				if ( src != (const byte *)data ) {
+					free( (byte *)src );
+				}
+				free( resampledBuffer );
+				free( upload->buffer );
+				upload->buffer = NULL;
+				return "R_PrepareImage: out of memory";
 			}
 		}
-		Com_Memcpy( scaledBuffer, data, width * height * 4 );
+		R_MipMap( src, dst, width, height );
+		if ( src != (const byte *)data ) {
+			free( (byte *)src );
+		}
+		src = dst;
+		width = w;
+		height = h;
+	}
+	if ( src != upload->buffer ) {
+		Com_Memcpy( upload->buffer, src, width * height * 4 );
+	}
+	if ( resampledBuffer ) {
+		free( resampledBuffer );
 	}
 
-	R_LightScaleTexture (scaledBuffer, scaled_width, scaled_height, !mipmap );
-
-	*pUploadWidth = scaled_width;
-	*pUploadHeight = scaled_height;
-	*format = internalFormat;
-
-	qglTexImage2D (GL_TEXTURE_2D, 0, internalFormat, scaled_width, scaled_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledBuffer );
+	R_LightScaleTexture ((unsigned *)upload->buffer, scaled_width, scaled_height, !mipmap );
+	upload->numLevels = 1;
 
 	if (mipmap)
 	{
-		int		miplevel;
-
-		miplevel = 0;
-		while (scaled_width > 1 || scaled_height > 1)
+		w = scaled_width;
+		h = scaled_height;
+		while ( ( w > 1 || h > 1 ) && upload->numLevels < MAX_IMAGE_LEVELS )
 		{
-			R_MipMap( (byte *)scaledBuffer, scaled_width, scaled_height );
-			scaled_width >>= 1;
-			scaled_height >>= 1;
-			if (scaled_width < 1)
-				scaled_width = 1;
-			if (scaled_height < 1)
-				scaled_height = 1;
-			miplevel++;
+			src = upload->levels[upload->numLevels - 1];
+			dst = (byte *)src + w * h * 4;
+			R_MipMap( src, dst, w, h );
+			w >>= 1;
+			h >>= 1;
+			if (w < 1)
+				w = 1;
+			if (h < 1)
+				h = 1;
 
 			if ( r_colorMipLevels->integer ) {
-				R_BlendOverTexture( (byte *)scaledBuffer, scaled_width * scaled_height, mipBlendColors[miplevel] );
+				R_BlendOverTexture( dst, w * h, mipBlendColors[upload->numLevels] );
 			}
 
-			qglTexImage2D (GL_TEXTURE_2D, miplevel, internalFormat, scaled_width, scaled_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledBuffer );
+			upload->levels[upload->numLevels++] = dst;
 		}
 	}
-done:
 
-	if (mipmap)
-	{
-		if ( textureFilterAnisotropic )
+	return NULL;
+}
+
+/*
+===============
+R_UploadImage
+
+Sends the levels built by R_PrepareImage to the image's texture object
+===============
+*/
+static void R_UploadImage( image_t *image, const imageUpload_t *upload ) {
+	int			i;
+	int			width, height;
+	uint64_t	start;
+
+	start = ri.Microseconds();
+
+	if ( qglActiveTextureARB ) {
+		GL_SelectTexture( image->TMU );
+	}
+
+	GL_Bind(image);
+
+	width = upload->width;
+	height = upload->height;
+	for ( i = 0 ; i < upload->numLevels ; i++ ) {
+		if ( upload->compressed ) {
+			qglCompressedTexImage2DARB( GL_TEXTURE_2D, i, upload->internalFormat, width, height, 0,
+				upload->levelSizes[i], upload->levels[i] );
+		} else {
+			qglTexImage2D (GL_TEXTURE_2D, i, upload->internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, upload->levels[i] );
+		}
+		width >>= 1;
+		height >>= 1;
+		if (width < 1)
+			width = 1;
+		if (height < 1)
+			height = 1;
+	}
+
+	image->uploadWidth = upload->width;
+	image->uploadHeight = upload->height;
+	image->internalFormat = upload->internalFormat;
+
+	if (image->mipmap)
+	{
+		if ( textureFilterAnisotropic )
 			qglTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
 					(GLint)Com_Clamp( 1, maxAnisotropy, r_ext_max_anisotropy->integer ) );
 
@@ -733,32 +1348,47 @@ done:
 
 	GL_CheckErrors();
 
-	if ( scaledBuffer != 0 )
-		ri.Hunk_FreeTempMemory( scaledBuffer );
-	if ( resampledBuffer != 0 )
-		ri.Hunk_FreeTempMemory( resampledBuffer );
+	qglTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, image->wrapClampMode );
+	qglTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, image->wrapClampMode );
+
+	qglBindTexture( GL_TEXTURE_2D, 0 );
+
+	if ( image->TMU == 1 ) {
+		GL_SelectTexture( 0 );
+	}
+
+	image->uploadUsec = ri.Microseconds() - start;
+}
+
+/*
+===============
+R_FreeImageUpload
+===============
+*/
+static void R_FreeImageUpload( imageUpload_t *upload ) {
+	if ( upload->buffer ) {
+		free( upload->buffer );
+	}
+	Com_Memset( upload, 0, sizeof( *upload ) );
 }
 
 
 /*
 ================
-R_CreateImage
+R_AllocImage
 
-This is the only way any image_t are created
+This is the only way any image_t are created, the texture is
+filled in by R_UploadImage
 ================
 */
-image_t *R_CreateImage( const char *name, const byte *pic, int width, int height, 
+static image_t *R_AllocImage( const char *name, int width, int height, 
 					   qboolean mipmap, qboolean allowPicmip, int glWrapClampMode ) {
 	image_t		*image;
-	qboolean	isLightmap = qfalse;
 	long		hash;
 
 	if (strlen(name) >= MAX_QPATH ) {
 		ri.Error (ERR_DROP, "R_CreateImage: \"%s\" is too long\n", name);
 	}
-	if ( !strncmp( name, "*lightmap", 9 ) ) {
-		isLightmap = qtrue;
-	}
 
 	if ( tr.numImages == MAX_DRAWIMAGES ) {
 		ri.Error( ERR_DROP, "R_CreateImage: MAX_DRAWIMAGES hit\n");
@@ -778,74 +1408,352 @@ image_t *R_CreateImage( const char *name, const byte *pic, int width, int height
 	image->wrapClampMode = glWrapClampMode;
 
 	// lightmaps are always allocated on TMU 1
-	if ( qglActiveTextureARB && isLightmap ) {
+	if ( qglActiveTextureARB && R_IsLightmapImage( name ) ) {
 		image->TMU = 1;
 	} else {
 		image->TMU = 0;
 	}
 
-	if ( qglActiveTextureARB ) {
-		GL_SelectTexture( image->TMU );
-	}
+	hash = generateHashValue(name);
+	image->next = hashTable[hash];
+	hashTable[hash] = image;
 
-	GL_Bind(image);
+	return image;
+}
 
-	Upload32( (unsigned *)pic, image->width, image->height, 
-								image->mipmap,
-								allowPicmip,
-								isLightmap,
-								&image->internalFormat,
-								&image->uploadWidth,
-								&image->uploadHeight );
+/*
+================
+R_BuildImage
 
-	qglTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, glWrapClampMode );
-	qglTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, glWrapClampMode );
+R_CreateImage that can also put the levels in the image cache
+================
+*/
+static image_t *R_BuildImage( const char *name, const byte *pic, int width, int height, 
+					   qboolean mipmap, qboolean allowPicmip, int glWrapClampMode,
+					   const imageCacheKey_t *cacheKey ) {
+	image_t		*image;
+	imageUpload_t	upload;
+	const char	*error;
+	uint64_t	start;
 
-	qglBindTexture( GL_TEXTURE_2D, 0 );
+	image = R_AllocImage( name, width, height, mipmap, allowPicmip, glWrapClampMode );
 
-	if ( image->TMU == 1 ) {
-		GL_SelectTexture( 0 );
+	start = ri.Microseconds();
+	error = R_PrepareImage( &upload, (const unsigned *)pic, width, height,
+								mipmap, allowPicmip, R_IsLightmapImage( name ) );
+	if ( error ) {
+		ri.Error( ERR_DROP, "%s", error );
 	}
+	image->mipUsec = ri.Microseconds() - start;
 
-	hash = generateHashValue(name);
-	image->next = hashTable[hash];
-	hashTable[hash] = image;
+	R_UploadImage( image, &upload );
+	if ( cacheKey ) {
+		R_WriteImageCache( image, cacheKey, &upload );
+	}
+	R_FreeImageUpload( &upload );
 
 	return image;
 }
 
+/*
+================
+R_CreateImage
+================
+*/
+image_t *R_CreateImage( const char *name, const byte *pic, int width, int height, 
+					   qboolean mipmap, qboolean allowPicmip, int glWrapClampMode ) {
+	return R_BuildImage( name, pic, width, height, mipmap, allowPicmip, glWrapClampMode, NULL );
+}
+
 //===================================================================
 
 typedef struct
 {
 	char *ext;
 	void (*ImageLoader)( const char *, unsigned char **, int *, int * );
+	void (*ImageDecoder)( const char *, const byte *, int, imageDecode_t * );	// thread safe, can be NULL
 } imageExtToLoaderMap_t;
 
 // Note that the ordering indicates the order of preference used
 // when there are multiple images of different formats available
 static imageExtToLoaderMap_t imageLoaders[ ] =
 {
-	{ "tga",  R_LoadTGA },
-	{ "jpg",  R_LoadJPG },
-	{ "jpeg", R_LoadJPG },
-	{ "png",  R_LoadPNG },
-	{ "pcx",  R_LoadPCX },
-	{ "bmp",  R_LoadBMP }
+	{ "tga",  R_LoadTGA, R_DecodeTGA },
+	{ "jpg",  R_LoadJPG, R_DecodeJPG },
+	{ "jpeg", R_LoadJPG, R_DecodeJPG },
+	{ "png",  R_LoadPNG, NULL },
+	{ "pcx",  R_LoadPCX, NULL },
+	{ "bmp",  R_LoadBMP, NULL }
 };
 
 static int numImageLoaders = sizeof( imageLoaders ) /
 		sizeof( imageLoaders[ 0 ] );
 
+/*
+=============================================================================
+
+DEFERRED IMAGE LOADING
+
+With r_imageLoadThreads set, R_FindImageFile only reads the file and
+creates the image_t, which shader parsing can use right away.  Decoding,
+resampling, light scaling and mip generation for everything queued since
+the last flush run on the worker pool in R_FinishImageLoads, then the
+textures are uploaded on the calling thread in the order they were
+requested.  R_IssueRenderCommands flushes before the back end can
+reference any of them.
+
+Only TGA and JPG have thread safe decoders, PNG, PCX and BMP files are
+still decoded by R_FindImageFile and just have their mip levels built
+on the workers.
+
+=============================================================================
+*/
+
+#define	MAX_IMAGE_JOBS			512
+#define	MAX_IMAGE_JOB_BYTES		( 32 << 20 )	// file and pic data waiting in the queue
+#define	IMAGE_JOB_BATCH			32				// jobs decoded before their textures are uploaded
+
+typedef struct {
+	image_t			*image;
+	void			(*decoder)( const char *, const byte *, int, imageDecode_t * );
+	char			fileName[MAX_QPATH];	// can have a different extension than the image
+	byte			*buffer;				// malloc'd file contents for decoder
+	int				length;
+	imageDecode_t	decode;
+	imageUpload_t	upload;
+	qboolean		writeCache;				// put the levels in the image cache after the upload
+	imageCacheKey_t	cacheKey;
+} imageJob_t;
+
+static imageJob_t	imageJobs[MAX_IMAGE_JOBS];
+static int			numImageJobs;
+static int			imageJobBytes;
+
+/*
+================
+R_ImageJobMalloc
+================
+*/
+static void *R_ImageJobMalloc( int bytes ) {
+	return malloc( bytes );
+}
+
+/*
+================
+R_ImageJobFree
+================
+*/
+static void R_ImageJobFree( void *buf ) {
+	free( buf );
+}
+
+/*
+================
+R_FreeImageJob
+================
+*/
+static void R_FreeImageJob( imageJob_t *job ) {
+	if ( job->buffer ) {
+		free( job->buffer );
+		job->buffer = NULL;
+	}
+	if ( job->decode.pic ) {
+		free( job->decode.pic );
+		job->decode.pic = NULL;
+	}
+	R_FreeImageUpload( &job->upload );
+}
+
+/*
+================
+R_ClearImageJobs
+
+Drops everything in the queue without uploading it
+================
+*/
+static void R_ClearImageJobs( void ) {
+	int		i;
+
+	for ( i = 0 ; i < numImageJobs ; i++ ) {
+		R_FreeImageJob( &imageJobs[i] );
+	}
+	numImageJobs = 0;
+	imageJobBytes = 0;
+}
+
+/*
+================
+R_ImageLoadJob
+
+Runs on the worker pool, must not call ri.* other than Microseconds
+================
+*/
+static void R_ImageLoadJob( void *data, int index ) {
+	imageJob_t	*job = (imageJob_t *)data + index;
+	image_t		*image = job->image;
+	const char	*error;
+	uint64_t	start, end;
+
+	start = ri.Microseconds();
+
+	if ( job->buffer ) {
+		job->decoder( job->fileName, job->buffer, job->length, &job->decode );
+		free( job->buffer );
+		job->buffer = NULL;
+		if ( job->decode.failed ) {
+			return;
+		}
+	}
+
+	end = ri.Microseconds();
+	image->decodeUsec += end - start;
+
+	error = R_PrepareImage( &job->upload, (const unsigned *)job->decode.pic,
+		job->decode.width, job->decode.height, image->mipmap, image->allowPicmip,
+		R_IsLightmapImage( image->imgName ) );
+	if ( error ) {
+		R_ImageDecodeError( &job->decode, ERR_DROP, "%s", error );
+		return;
+	}
+
+	// the pic is only needed by the upload if it is the first level
+	if ( job->upload.levels[0] != job->decode.pic ) {
+		free( job->decode.pic );
+		job->decode.pic = NULL;
+	}
+
+	image->mipUsec = ri.Microseconds() - end;
+}
+
+/*
+================
+R_ImageLoadsPending
+================
+*/
+qboolean R_ImageLoadsPending( void ) {
+	return ( numImageJobs > 0 );
+}
+
+/*
+================
+R_FinishImageLoads
+
+Decodes and uploads everything R_FindImageFile has queued.  Has to be
+called with the GL context current, like R_CreateImage.
+================
+*/
+void R_FinishImageLoads( void ) {
+	imageJob_t	*job;
+	int			i, first, count;
+	int			numThreads;
+	int			errorLevel;
+	char		message[sizeof( imageJobs[0].decode.message )];
+	uint64_t	start;
+
+	if ( !numImageJobs ) {
+		return;
+	}
+
+	start = ri.Microseconds();
+	numThreads = ri.WorkerThreads( r_imageLoadThreads->integer );
+
+	// decoded pics and mip levels take a lot more memory than the
+	// files, so only a batch of them is held at a time
+	for ( first = 0 ; first < numImageJobs ; first += count ) {
+		count = numImageJobs - first;
+		if ( count > IMAGE_JOB_BATCH ) {
+			count = IMAGE_JOB_BATCH;
+		}
+
+		ri.ParallelFor( numThreads, R_ImageLoadJob, imageJobs + first, count );
+
+		for ( i = first ; i < first + count ; i++ ) {
+			job = &imageJobs[i];
+
+			if ( job->decode.failed ) {
+				errorLevel = job->decode.errorLevel;
+				Q_strncpyz( message, job->decode.message, sizeof( message ) );
+				R_ClearImageJobs();
+				ri.Error( errorLevel, "%s", message );
+			}
+			if ( job->decode.message[0] ) {
+				ri.Printf( PRINT_WARNING, "%s", job->decode.message );
+			}
+
+			job->image->width = job->decode.width;
+			job->image->height = job->decode.height;
+			R_UploadImage( job->image, &job->upload );
+			if ( job->writeCache ) {
+				R_WriteImageCache( job->image, &job->cacheKey, &job->upload );
+			}
+			R_FreeImageJob( job );
+		}
+	}
+
+	imageLoadBatches++;
+	imageLoadJobs += numImageJobs;
+	imageLoadThreads = numThreads;
+	imageLoadUsec += ri.Microseconds() - start;
+
+	numImageJobs = 0;
+	imageJobBytes = 0;
+}
+
+//===================================================================
+
+/*
+=================
+R_RunImageLoader
+
+Without a job, or for formats without a thread safe decoder, loads
+the pic right away.  Otherwise the file is only read into the job.
+Returns qfalse if the file doesn't exist or failed to load.
+=================
+*/
+static qboolean R_RunImageLoader( const imageExtToLoaderMap_t *loader, const char *name,
+								 byte **pic, int *width, int *height, imageJob_t *job ) {
+	void	*buffer;
+	int		length;
+
+	if ( !job || !loader->ImageDecoder ) {
+		loader->ImageLoader( name, pic, width, height );
+		return ( *pic != NULL );
+	}
+
+	length = ri.FS_ReadFile( name, &buffer );
+	if ( !buffer || length < 0 ) {
+		return qfalse;
+	}
+
+	// the file buffer is temp hunk memory, which has to be freed
+	// in order, so the job keeps its own copy
+	job->buffer = malloc( length + 1 );
+	if ( !job->buffer ) {
+		ri.FS_FreeFile( buffer );
+		ri.Error( ERR_DROP, "R_RunImageLoader: couldn't allocate %i bytes for %s", length + 1, name );
+	}
+	Com_Memcpy( job->buffer, buffer, length );
+	job->length = length;
+	ri.FS_FreeFile( buffer );
+
+	job->decoder = loader->ImageDecoder;
+	Q_strncpyz( job->fileName, name, sizeof( job->fileName ) );
+
+	return qtrue;
+}
+
 /*
 =================
 R_LoadImage
 
 Loads any of the supported image types into a cannonical
 32 bit format.
+
+With a job, a file with a thread safe decoder is only read and
+left in job->buffer for R_FinishImageLoads, *pic stays NULL.
 =================
 */
-void R_LoadImage( const char *name, byte **pic, int *width, int *height )
+static void R_LoadImage( const char *name, byte **pic, int *width, int *height, imageJob_t *job )
 {
 	qboolean orgNameFailed = qfalse;
 	int i;
@@ -867,8 +1775,6 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height )
 		{
 			if( !Q_stricmp( ext, imageLoaders[ i ].ext ) )
 			{
-				// Load
-				imageLoaders[ i ].ImageLoader( localName, pic, width, height );
 				break;
 			}
 		}
@@ -876,7 +1782,8 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height )
 		// A loader was found
 		if( i < numImageLoaders )
 		{
-			if( *pic == NULL )
+			// Load
+			if( !R_RunImageLoader( &imageLoaders[ i ], localName, pic, width, height, job ) )
 			{
 				// Loader failed, most likely because the file isn't there;
 				// try again without the extension
@@ -898,9 +1805,7 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height )
 		char *altName = va( "%s.%s", localName, imageLoaders[ i ].ext );
 
 		// Load
-		imageLoaders[ i ].ImageLoader( altName, pic, width, height );
-
-		if( *pic )
+		if( R_RunImageLoader( &imageLoaders[ i ], altName, pic, width, height, job ) )
 		{
 			if( orgNameFailed )
 			{
@@ -914,6 +1819,112 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height )
 }
 
 
+/*
+=================
+R_FindImageSource
+
+The file R_LoadImage would load the image from, along with its
+length and checksum from FS_FileOrigin.  Doesn't read pak files.
+=================
+*/
+qboolean R_FindImageSource( const char *name, char *fileName, int fileNameSize, int *length, int *checksum ) {
+	char		localName[ MAX_QPATH ];
+	const char	*ext;
+	int			i;
+
+	Q_strncpyz( localName, name, MAX_QPATH );
+
+	ext = COM_GetExtension( localName );
+	if ( *ext ) {
+		for ( i = 0 ; i < numImageLoaders ; i++ ) {
+			if ( !Q_stricmp( ext, imageLoaders[ i ].ext ) ) {
+				break;
+			}
+		}
+		if ( i < numImageLoaders ) {
+			*length = ri.FS_FileOrigin( localName, checksum );
+			if ( *length >= 0 ) {
+				Q_strncpyz( fileName, localName, fileNameSize );
+				return qtrue;
+			}
+			COM_StripExtension( name, localName, MAX_QPATH );
+		}
+	}
+
+	for ( i = 0 ; i < numImageLoaders ; i++ ) {
+		Com_sprintf( fileName, fileNameSize, "%s.%s", localName, imageLoaders[ i ].ext );
+		*length = ri.FS_FileOrigin( fileName, checksum );
+		if ( *length >= 0 ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+
+/*
+===============
+R_QueueImageFile
+
+R_FindImageFile for deferred loading
+===============
+*/
+static image_t *R_QueueImageFile( const char *name, qboolean mipmap, qboolean allowPicmip, int glWrapClampMode,
+								 const imageCacheKey_t *cacheKey ) {
+	imageJob_t	*job;
+	byte		*pic;
+	int			width, height;
+	int			size;
+	uint64_t	start;
+
+	if ( numImageJobs == MAX_IMAGE_JOBS || imageJobBytes >= MAX_IMAGE_JOB_BYTES ) {
+		R_FinishImageLoads();
+	}
+
+	start = ri.Microseconds();
+
+	job = &imageJobs[numImageJobs];
+	Com_Memset( job, 0, sizeof( *job ) );
+	R_InitImageDecode( &job->decode, R_ImageJobMalloc, R_ImageJobFree );
+
+	R_LoadImage( name, &pic, &width, &height, job );
+	if ( pic ) {
+		// decoded already, the workers get a copy because the
+		// zone isn't thread safe
+		size = width * height * 4;
+		job->decode.pic = malloc( size );
+		if ( !job->decode.pic ) {
+			ri.Free( pic );
+			ri.Error( ERR_DROP, "R_QueueImageFile: couldn't allocate %i bytes for %s", size, name );
+		}
+		Com_Memcpy( job->decode.pic, pic, size );
+		job->decode.width = width;
+		job->decode.height = height;
+		ri.Free( pic );
+	} else if ( job->buffer ) {
+		size = job->length;
+	} else {
+		return NULL;
+	}
+
+	// don't leave the data behind if R_AllocImage is going to drop
+	if ( strlen( name ) >= MAX_QPATH || tr.numImages == MAX_DRAWIMAGES ) {
+		R_FreeImageJob( job );
+	}
+
+	job->image = R_AllocImage( name, 0, 0, mipmap, allowPicmip, glWrapClampMode );
+	job->image->decodeUsec = ri.Microseconds() - start;
+	if ( cacheKey ) {
+		job->writeCache = qtrue;
+		job->cacheKey = *cacheKey;
+	}
+	numImageJobs++;
+	imageJobBytes += size;
+
+	return job->image;
+}
+
 /*
 ===============
 R_FindImageFile
@@ -927,6 +1938,11 @@ image_t	*R_FindImageFile( const char *name, qboolean mipmap, qboolean allowPicmi
 	int		width, height;
 	byte	*pic;
 	long	hash;
+	uint64_t	start;
+	int		decodeUsec;
+	imageCacheKey_t	key, *cacheKey;
+	imageUpload_t	upload;
+	void	*buffer;
 
 	if (!name) {
 		return NULL;
@@ -955,19 +1971,338 @@ image_t	*R_FindImageFile( const char *name, qboolean mipmap, qboolean allowPicmi
 		}
 	}
 
+	//
+	// upload the levels straight from the image cache if they are there,
+	// otherwise they are written to it after the image is built
+	//
+	cacheKey = NULL;
+	if ( r_imageCache->integer && R_ImageCacheKey( &key, name, mipmap, allowPicmip ) ) {
+		start = ri.Microseconds();
+		buffer = R_ReadImageCache( &key, &upload, &width, &height );
+		if ( buffer ) {
+			image = R_AllocImage( name, width, height, mipmap, allowPicmip, glWrapClampMode );
+			image->decodeUsec = ri.Microseconds() - start;
+			R_UploadImage( image, &upload );
+			ri.FS_FreeFile( buffer );
+			return image;
+		}
+		cacheKey = &key;
+	}
+
+	// only defer once the renderer is up, so R_IssueRenderCommands
+	// is sure to flush the queue before anything is drawn
+	if ( r_imageLoadThreads->integer && tr.registered ) {
+		return R_QueueImageFile( name, mipmap, allowPicmip, glWrapClampMode, cacheKey );
+	}
+
 	//
 	// load the pic from disk
 	//
-	R_LoadImage( name, &pic, &width, &height );
+	start = ri.Microseconds();
+	R_LoadImage( name, &pic, &width, &height, NULL );
 	if ( pic == NULL ) {
 		return NULL;
 	}
+	decodeUsec = ri.Microseconds() - start;
 
-	image = R_CreateImage( ( char * ) name, pic, width, height, mipmap, allowPicmip, glWrapClampMode );
+	image = R_BuildImage( name, pic, width, height, mipmap, allowPicmip, glWrapClampMode, cacheKey );
+	image->decodeUsec = decodeUsec;
 	ri.Free( pic );
 	return image;
 }
 
+/*
+===============================================================================
+
+IMAGE KERNEL BENCHMARK
+
+===============================================================================
+*/
+
+typedef enum {
+	BENCH_RESAMPLE,
+	BENCH_MIPBOX,
+	BENCH_MIP4X4,
+	BENCH_LIGHTSCALE,
+	BENCH_BLEND,
+	NUM_BENCH_KERNELS
+} imageBenchKernel_t;
+
+static const char *imageBenchNames[NUM_BENCH_KERNELS] = {
+	"resample", "box mip", "4x4 mip", "light scale", "blend"
+};
+
+typedef struct {
+	uint64_t	usec[2];		// C, then SIMD
+	int			texels;
+	int			mismatches;		// images the two versions disagree on
+} imageBenchStats_t;
+
+/*
+===============
+R_BenchImageKernel
+
+Runs one kernel over pic into out, repeats times, out must hold the
+whole mip chain for the mip kernels.  Returns the number of bytes
+written.
+===============
+*/
+static int R_BenchImageKernel( imageBenchKernel_t kernel, const byte *pic, int width, int height,
+							  int outWidth, int outHeight, byte *out, int repeats, uint64_t *usec ) {
+	int			i, w, h, size;
+	const byte	*src;
+	uint64_t	start;
+
+	size = 0;
+	for ( i = 0 ; i < repeats ; i++ ) {
+		switch ( kernel ) {
+		case BENCH_RESAMPLE:
+			start = ri.Microseconds();
+			ResampleTexture( (const unsigned *)pic, width, height, (unsigned *)out, outWidth, outHeight );
+			*usec += ri.Microseconds() - start;
+			size = outWidth * outHeight * 4;
+			break;
+		case BENCH_MIPBOX:
+		case BENCH_MIP4X4:
+			// the levels that go through the kernels, single
+			// rows and columns are special cased before them
+			src = pic;
+			size = 0;
+			w = width;
+			h = height;
+			start = ri.Microseconds();
+			while ( w > 1 && h > 1 ) {
+				if ( kernel == BENCH_MIPBOX ) {
+					R_MipMapBox( src, out + size, w >> 1, h >> 1 );
+				} else {
+					R_MipMap2( (const unsigned *)src, (unsigned *)( out + size ), w, h );
+				}
+				src = out + size;
+				w >>= 1;
+				h >>= 1;
+				size += w * h * 4;
+			}
+			*usec += ri.Microseconds() - start;
+			break;
+		case BENCH_LIGHTSCALE:
+		case BENCH_BLEND:
+			size = width * height * 4;
+			Com_Memcpy( out, pic, size );
+			start = ri.Microseconds();
+			if ( kernel == BENCH_LIGHTSCALE ) {
+				R_LightScaleTexture( (unsigned *)out, width, height, qfalse );
+			} else {
+				R_BlendOverTexture( out, width * height, mipBlendColors[1] );
+			}
+			*usec += ri.Microseconds() - start;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return size;
+}
+
+/*
+===============
+R_ImageBench_f
+
+Reloads every image that came from a file and runs the pixel kernels
+over it with the C and the SIMD versions, timing both and checking
+that they give the same bytes.  Images that are already a power of two
+are resampled to three quarters of their size, so every image goes
+through the resampler, the mip kernels then start from the power of
+two version.
+===============
+*/
+void R_ImageBench_f( void ) {
+	int			i, k, pass, numPasses;
+	int			repeats, numImages, size;
+	int			width, height, outWidth, outHeight, mipWidth, mipHeight;
+	byte		*pic, *resampled, *out[2];
+	const byte	*mipPic;
+	qboolean	simd;
+	image_t		*image;
+	imageBenchStats_t	stats[NUM_BENCH_KERNELS];
+
+	repeats = 1;
+	if ( ri.Cmd_Argc() > 1 ) {
+		repeats = atoi( ri.Cmd_Argv( 1 ) );
+		if ( repeats < 1 ) {
+			repeats = 1;
+		}
+	}
+
+	// the command runs between frames, so no image jobs are using the kernels
+	simd = imageSIMD;
+	numPasses = simd ? 2 : 1;
+	if ( !simd ) {
+		ri.Printf( PRINT_ALL, "No SIMD image kernels for this cpu or r_simd is 0, timing the C versions only\n" );
+	}
+
+	Com_Memset( stats, 0, sizeof( stats ) );
+	numImages = 0;
+
+	for ( i = 0 ; i < tr.numImages ; i++ ) {
+		image = tr.images[i];
+		if ( image->imgName[0] == '*' ) {
+			continue;
+		}
+		R_LoadImage( image->imgName, &pic, &width, &height, NULL );
+		if ( !pic ) {
+			continue;
+		}
+		numImages++;
+
+		for ( outWidth = 1 ; outWidth < width ; outWidth <<= 1 )
+			;
+		for ( outHeight = 1 ; outHeight < height ; outHeight <<= 1 )
+			;
+		if ( outWidth == width && outHeight == height ) {
+			outWidth = ( width * 3 + 3 ) / 4;
+			outHeight = ( height * 3 + 3 ) / 4;
+			mipPic = pic;
+			mipWidth = width;
+			mipHeight = height;
+		} else {
+			mipPic = NULL;
+			mipWidth = outWidth;
+			mipHeight = outHeight;
+		}
+		if ( outWidth > 2048 ) {
+			ri.Printf( PRINT_WARNING, "imagebench: skipping %s, too wide to resample\n", image->imgName );
+			ri.Free( pic );
+			numImages--;
+			continue;
+		}
+
+		// the C resample result is the mip source for both passes
+		resampled = malloc( outWidth * outHeight * 4 );
+		if ( !resampled ) {
+			ri.Free( pic );
+			ri.Error( ERR_DROP, "imagebench: out of memory" );
+		}
+		ResampleTexture( (const unsigned *)pic, width, height, (unsigned *)resampled, outWidth, outHeight );
+		if ( !mipPic ) {
+			mipPic = resampled;
+		}
+
+		// a mip chain is smaller than the level above it
+		size = ( outWidth > mipWidth ? outWidth : mipWidth ) * ( outHeight > mipHeight ? outHeight : mipHeight ) * 4;
+		out[0] = malloc( size );
+		out[1] = malloc( size );
+		if ( !out[0] || !out[1] ) {
+			free( out[0] );
+			free( out[1] );
+			free( resampled );
+			ri.Free( pic );
+			ri.Error( ERR_DROP, "imagebench: out of memory" );
+		}
+
+		for ( k = 0 ; k < NUM_BENCH_KERNELS ; k++ ) {
+			for ( pass = 0 ; pass < numPasses ; pass++ ) {
+				imageSIMD = pass;
+				if ( k == BENCH_RESAMPLE ) {
+					size = R_BenchImageKernel( k, pic, width, height, outWidth, outHeight, out[pass],
+						repeats, &stats[k].usec[pass] );
+				} else {
+					size = R_BenchImageKernel( k, mipPic, mipWidth, mipHeight, 0, 0, out[pass],
+						repeats, &stats[k].usec[pass] );
+				}
+			}
+			imageSIMD = simd;
+
+			stats[k].texels += ( k == BENCH_RESAMPLE ? outWidth * outHeight : mipWidth * mipHeight );
+			if ( numPasses == 2 && memcmp( out[0], out[1], size ) ) {
+				ri.Printf( PRINT_WARNING, "imagebench: %s differs for %s\n", imageBenchNames[k], image->imgName );
+				stats[k].mismatches++;
+			}
+		}
+
+		free( out[0] );
+		free( out[1] );
+		free( resampled );
+		ri.Free( pic );
+	}
+
+	ri.Printf( PRINT_ALL, "\nkernel      -texels- --C msec- -SIMD msec- speedup mismatches\n" );
+	for ( k = 0 ; k < NUM_BENCH_KERNELS ; k++ ) {
+		ri.Printf( PRINT_ALL, "%-11s %8i %9.2f", imageBenchNames[k], stats[k].texels, stats[k].usec[0] / 1000.0f );
+		if ( numPasses == 2 ) {
+			ri.Printf( PRINT_ALL, " %11.2f %6.2fx %10i", stats[k].usec[1] / 1000.0f,
+				stats[k].usec[1] ? (float)stats[k].usec[0] / stats[k].usec[1] : 0.0f, stats[k].mismatches );
+		}
+		ri.Printf( PRINT_ALL, "\n" );
+	}
+	ri.Printf( PRINT_ALL, "%i images, %i repeats, %s kernels\n", numImages, repeats, R_ImageKernelsString() );
+}
+
+/*
+================
+R_InitImageDecode
+================
+*/
+void R_InitImageDecode( imageDecode_t *decode, void *(*alloc)( int bytes ), void (*release)( void *buf ) ) {
+	Com_Memset( decode, 0, sizeof( *decode ) );
+	decode->Malloc = alloc;
+	decode->Free = release;
+}
+
+/*
+================
+R_ImageDecodeError
+
+Decoders can't call ri.Error on a worker thread, so they record the
+error with this and return.  Frees the partial pic.
+================
+*/
+void QDECL R_ImageDecodeError( imageDecode_t *decode, int errorLevel, const char *fmt, ... ) {
+	va_list		argptr;
+
+	if ( decode->failed ) {
+		return;
+	}
+
+	decode->failed = qtrue;
+	decode->errorLevel = errorLevel;
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( decode->message, sizeof( decode->message ), fmt, argptr );
+	va_end( argptr );
+
+	if ( decode->pic ) {
+		decode->Free( decode->pic );
+		decode->pic = NULL;
+	}
+}
+
+/*
+================
+R_FinishImageDecode
+
+Back on the main thread, raises the decoder's error or prints its
+warning and hands out the pic
+================
+*/
+void R_FinishImageDecode( imageDecode_t *decode, byte **pic, int *width, int *height ) {
+	if ( decode->failed ) {
+		ri.Error( decode->errorLevel, "%s", decode->message );
+	}
+
+	if ( decode->message[0] ) {
+		ri.Printf( PRINT_WARNING, "%s", decode->message );
+	}
+
+	*pic = decode->pic;
+	if ( width ) {
+		*width = decode->width;
+	}
+	if ( height ) {
+		*height = decode->height;
+	}
+}
+
 
 /*
 ================
@@ -1254,6 +2589,10 @@ void R_SetColorMappings( void ) {
 		s_intensitytable[i] = j;
 	}
 
+	for (i=0 ; i<256 ; i++) {
+		s_lighttable[i] = s_gammatable[s_intensitytable[i]];
+	}
+
 	if ( glConfig.deviceSupportsGamma )
 	{
 		GLimp_SetGamma( s_gammatable, s_gammatable, s_gammatable );
@@ -1267,6 +2606,14 @@ R_InitImages
 */
 void	R_InitImages( void ) {
 	Com_Memset(hashTable, 0, sizeof(hashTable));
+
+	imageLoadBatches = 0;
+	imageLoadJobs = 0;
+	imageLoadThreads = 0;
+	imageLoadUsec = 0;
+
+	R_InitImageKernels();
+
 	// build brightness translation tables
 	R_SetColorMappings();
 
@@ -1282,6 +2629,8 @@ R_DeleteTextures
 void R_DeleteTextures( void ) {
 	int		i;
 
+	R_ClearImageJobs();
+
 	for ( i=0; i<tr.numImages ; i++ ) {
 		qglDeleteTextures( 1, &tr.images[i]->texnum );
 	}
@@ -0,0 +1,350 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+#include "tr_local.h"
+
+/*
+========================================================================
+
+IMAGE CACHE
+
+With r_imageCache set, the mip levels R_FindImageFile builds for a file
+image are written to imagecache/ in the home directory, and uploaded
+from there the next time the image is loaded with the same settings,
+which skips the decoding, resampling and mip generation.  When the
+driver compresses textures with GL_EXT_texture_compression_s3tc the
+compressed levels are read back and cached instead, so it doesn't have
+to compress them again either.
+
+There is one file per image name.  It holds the imageCacheKey_t it was
+built with, which includes the pak checksum or the contents checksum
+of the source file and the light scale table, so anything that would
+change the levels makes it stale and it is simply rebuilt.  The files
+are in native byte order, they are not meant to be moved between
+machines.
+
+========================================================================
+*/
+
+#define	IMAGE_CACHE_IDENT		(('C'<<24)+('I'<<16)+('3'<<8)+'Q')
+#define	IMAGE_CACHE_VERSION		1
+
+typedef struct {
+	int				ident;
+	int				version;
+	imageCacheKey_t	key;
+	int				width, height;			// of the source pic
+	int				uploadWidth, uploadHeight;
+	int				internalFormat;
+	int				numLevels;
+	int				compressed;
+	int				levelSizes[MAX_IMAGE_LEVELS];
+} imageCacheHeader_t;
+
+static int		imageCacheHits;
+static int		imageCacheMisses;
+static int		imageCacheWrites;
+static int		imageCacheBytes;		// read by hits
+static uint64_t	imageCacheUsec;			// reading hits
+
+/*
+================
+R_ImageCacheFileName
+================
+*/
+static void R_ImageCacheFileName( const char *name, char *fileName, int fileNameSize ) {
+	unsigned	hash;
+
+	// FNV-1a, case insensitive like the file system
+	hash = 2166136261u;
+	for ( ; *name ; name++ ) {
+		hash = ( hash ^ (byte)tolower( *name ) ) * 16777619u;
+	}
+
+	Com_sprintf( fileName, fileNameSize, "imagecache/%08x.dat", hash );
+}
+
+/*
+================
+R_ImageCacheKey
+
+Fills in the key for the image R_FindImageFile is about to load,
+returns qfalse if there is no file for it
+================
+*/
+qboolean R_ImageCacheKey( imageCacheKey_t *key, const char *name, qboolean mipmap, qboolean allowPicmip ) {
+	const byte	*table;
+	int			i;
+
+	// the padding is compared too
+	Com_Memset( key, 0, sizeof( *key ) );
+
+	if ( strlen( name ) >= sizeof( key->name ) ) {
+		return qfalse;
+	}
+	if ( !R_FindImageSource( name, key->fileName, sizeof( key->fileName ),
+		&key->fileLength, &key->fileChecksum ) ) {
+		return qfalse;
+	}
+
+	Q_strncpyz( key->name, name, sizeof( key->name ) );
+	key->mipmap = mipmap;
+	key->picmip = allowPicmip ? r_picmip->integer : 0;
+	key->roundDown = r_roundImagesDown->integer;
+	key->simpleMipMaps = r_simpleMipMaps->integer;
+	key->colorMipLevels = r_colorMipLevels->integer;
+	key->greyscale = r_greyscale->integer;
+	key->textureBits = r_texturebits->integer;
+	key->maxTextureSize = glConfig.maxTextureSize;
+	key->textureCompression = glConfig.textureCompression;
+
+	table = R_LightScaleTable( !mipmap );
+	if ( table ) {
+		Com_Memcpy( key->lightTable, table, sizeof( key->lightTable ) );
+	} else {
+		for ( i = 0 ; i < 256 ; i++ ) {
+			key->lightTable[i] = i;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+================
+R_ReadImageCache
+
+Points the upload at the cached levels for the key and returns the
+buffer they are in, which has to be released with FS_FreeFile after
+the upload.  Returns NULL if there is no usable cache file.
+================
+*/
+void *R_ReadImageCache( const imageCacheKey_t *key, imageUpload_t *upload, int *width, int *height ) {
+	char				fileName[MAX_QPATH];
+	imageCacheHeader_t	*header;
+	void				*buffer;
+	const byte			*data;
+	int					length, size;
+	int					i, w, h;
+	uint64_t			start;
+
+	start = ri.Microseconds();
+
+	R_ImageCacheFileName( key->name, fileName, sizeof( fileName ) );
+	length = ri.FS_ReadFile( fileName, &buffer );
+	if ( !buffer ) {
+		imageCacheMisses++;
+		return NULL;
+	}
+
+	header = (imageCacheHeader_t *)buffer;
+	if ( length < (int)sizeof( *header )
+		|| header->ident != IMAGE_CACHE_IDENT
+		|| header->version != IMAGE_CACHE_VERSION
+		|| memcmp( &header->key, key, sizeof( *key ) )
+		|| header->numLevels < 1 || header->numLevels > MAX_IMAGE_LEVELS
+		|| header->uploadWidth < 1 || header->uploadWidth > glConfig.maxTextureSize
+		|| header->uploadHeight < 1 || header->uploadHeight > glConfig.maxTextureSize
+		|| ( header->compressed && glConfig.textureCompression != TC_S3TC_ARB ) ) {
+		ri.FS_FreeFile( buffer );
+		imageCacheMisses++;
+		return NULL;
+	}
+
+	Com_Memset( upload, 0, sizeof( *upload ) );
+	upload->internalFormat = header->internalFormat;
+	upload->width = header->uploadWidth;
+	upload->height = header->uploadHeight;
+	upload->numLevels = header->numLevels;
+	upload->compressed = header->compressed;
+
+	data = (const byte *)( header + 1 );
+	size = sizeof( *header );
+	w = upload->width;
+	h = upload->height;
+	for ( i = 0 ; i < upload->numLevels ; i++ ) {
+		if ( upload->compressed ) {
+			upload->levelSizes[i] = header->levelSizes[i];
+		} else {
+			upload->levelSizes[i] = w * h * 4;
+		}
+		if ( upload->levelSizes[i] <= 0 || upload->levelSizes[i] > length - size ) {
+			ri.Printf( PRINT_WARNING, "WARNING: %s for %s is truncated\n", fileName, key->name );
+			ri.FS_FreeFile( buffer );
+			imageCacheMisses++;
+			return NULL;
+		}
+		upload->levels[i] = data;
+		data += upload->levelSizes[i];
+		size += upload->levelSizes[i];
+
+		w = ( w > 1 ) ? w >> 1 : 1;
+		h = ( h > 1 ) ? h >> 1 : 1;
+	}
+
+	*width = header->width;
+	*height = header->height;
+
+	imageCacheHits++;
+	imageCacheBytes += length;
+	imageCacheUsec += ri.Microseconds() - start;
+
+	return buffer;
+}
+
+/*
+================
+R_ReadCompressedLevels
+
+Gets the levels the driver compressed back out of the texture object,
+returns the malloc'd data or NULL if it didn't compress all of them or
+there's no memory for them
+================
+*/
+static byte *R_ReadCompressedLevels( const image_t *image, int numLevels, int *levelSizes, int *size ) {
+	byte	*data;
+	GLint	compressed, levelSize;
+	int		i;
+
+	if ( qglActiveTextureARB ) {
+		GL_SelectTexture( image->TMU );
+	}
+	GL_Bind( (image_t *)image );
+
+	data = NULL;
+	*size = 0;
+	for ( i = 0 ; i < numLevels ; i++ ) {
+		qglGetTexLevelParameteriv( GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_ARB, &compressed );
+		qglGetTexLevelParameteriv( GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE_ARB, &levelSize );
+		if ( !compressed || levelSize <= 0 ) {
+			break;
+		}
+		levelSizes[i] = levelSize;
+		*size += levelSize;
+	}
+
+	if ( i == numLevels ) {
+		data = malloc( *size );
+		for ( i = 0, *size = 0 ; data && i < numLevels ; i++ ) {
+			qglGetCompressedTexImageARB( GL_TEXTURE_2D, i, data + *size );
+			*size += levelSizes[i];
+		}
+	}
+
+	qglBindTexture( GL_TEXTURE_2D, 0 );
+
+	if ( image->TMU == 1 ) {
+		GL_SelectTexture( 0 );
+	}
+
+	return data;
+}
+
+/*
+================
+R_WriteImageCache
+
+Saves the levels of an image R_FindImageFile has just uploaded
+================
+*/
+void R_WriteImageCache( const image_t *image, const imageCacheKey_t *key, const imageUpload_t *upload ) {
+	char				fileName[MAX_QPATH];
+	imageCacheHeader_t	*header;
+	byte				*buffer, *compressed;
+	int					levelSizes[MAX_IMAGE_LEVELS];
+	int					i, w, h, size;
+
+	compressed = NULL;
+	size = 0;
+	if ( upload->internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ) {
+		compressed = R_ReadCompressedLevels( image, upload->numLevels, levelSizes, &size );
+		if ( !compressed ) {
+			return;
+		}
+	} else {
+		w = upload->width;
+		h = upload->height;
+		for ( i = 0 ; i < upload->numLevels ; i++ ) {
+			size += w * h * 4;
+			w = ( w > 1 ) ? w >> 1 : 1;
+			h = ( h > 1 ) ? h >> 1 : 1;
+		}
+	}
+
+	buffer = malloc( sizeof( *header ) + size );
+	if ( !buffer ) {
+		// the cache is only an optimization
+		free( compressed );
+		return;
+	}
+	header = (imageCacheHeader_t *)buffer;
+	Com_Memset( header, 0, sizeof( *header ) );
+	header->ident = IMAGE_CACHE_IDENT;
+	header->version = IMAGE_CACHE_VERSION;
+	header->key = *key;
+	header->width = image->width;
+	header->height = image->height;
+	header->uploadWidth = upload->width;
+	header->uploadHeight = upload->height;
+	header->internalFormat = upload->internalFormat;
+	header->numLevels = upload->numLevels;
+
+	if ( compressed ) {
+		header->compressed = qtrue;
+		Com_Memcpy( header->levelSizes, levelSizes, upload->numLevels * sizeof( int ) );
+		Com_Memcpy( header + 1, compressed, size );
+		free( compressed );
+	} else {
+		size = 0;
+		w = upload->width;
+		h = upload->height;
+		for ( i = 0 ; i < upload->numLevels ; i++ ) {
+			Com_Memcpy( (byte *)( header + 1 ) + size, upload->levels[i], w * h * 4 );
+			size += w * h * 4;
+			w = ( w > 1 ) ? w >> 1 : 1;
+			h = ( h > 1 ) ? h >> 1 : 1;
+		}
+	}
+
+	R_ImageCacheFileName( key->name, fileName, sizeof( fileName ) );
+	ri.FS_WriteFile( fileName, buffer, sizeof( *header ) + size );
+	free( buffer );
+
+	imageCacheWrites++;
+}
+
+/*
+================
+R_ImageCacheInfo
+
+For imagelist
+================
+*/
+void R_ImageCacheInfo( void ) {
+	if ( !imageCacheHits && !imageCacheMisses ) {
+		return;
+	}
+
+	ri.Printf( PRINT_ALL, " image cache: %i hits, %i misses, %i written, %.1f MB read in %.1f msec\n",
+		imageCacheHits, imageCacheMisses, imageCacheWrites,
+		imageCacheBytes / ( 1024.0f * 1024.0f ), imageCacheUsec / 1000.0f );
+}
@@ -33,7 +33,58 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define JPEG_INTERNALS
 #include "../jpeg-6/jpeglib.h"
 
-void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *height ) {
+#include <setjmp.h>
+
+/*
+ * The standard error_exit calls ri.Error, which can't be done on the image
+ * load worker threads, so errors jump back into R_DecodeJPG and are raised
+ * later by R_FinishImageDecode.  This is the "private extension" error
+ * handler from the example in the IJG documentation.
+ */
+typedef struct {
+  struct jpeg_error_mgr pub;	/* "public" fields */
+
+  jmp_buf setjmp_buffer;	/* for return to caller */
+  imageDecode_t *decode;
+} q_jpeg_error_mgr;
+
+METHODDEF void
+R_JPGErrorExit( j_common_ptr cinfo )
+{
+  q_jpeg_error_mgr *err = (q_jpeg_error_mgr *)cinfo->err;
+  char buffer[JMSG_LENGTH_MAX];
+
+  (*cinfo->err->format_message) (cinfo, buffer);
+
+  R_ImageDecodeError( err->decode, ERR_FATAL, "%s\n", buffer );
+
+  longjmp( err->setjmp_buffer, 1 );
+}
+
+METHODDEF void
+R_JPGOutputMessage( j_common_ptr cinfo )
+{
+  q_jpeg_error_mgr *err = (q_jpeg_error_mgr *)cinfo->err;
+  char buffer[JMSG_LENGTH_MAX];
+
+  // only keep the first warning, R_FinishImageDecode prints it
+  if ( err->decode->message[0] ) {
+    return;
+  }
+
+  (*cinfo->err->format_message) (cinfo, buffer);
+
+  Com_sprintf( err->decode->message, sizeof( err->decode->message ), "%s\n", buffer );
+}
+
+/*
+=============
+R_DecodeJPG
+
+Thread safe, see imageDecode_t
+=============
+*/
+void R_DecodeJPG( const char *filename, const byte *fbuffer, int len, imageDecode_t *decode ) {
   /* This struct contains the JPEG decompression parameters and pointers to
    * working space (which is allocated as needed by the JPEG library).
    */
@@ -42,50 +93,40 @@ void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *heig
    * Note that this struct must live as long as the main JPEG parameter
    * struct, to avoid dangling-pointer problems.
    */
-  /* This struct represents a JPEG error handler.  It is declared separately
-   * because applications often want to supply a specialized error handler
-   * (see the second half of this file for an example).  But here we just
-   * take the easy way out and use the standard error handler, which will
-   * print a message on stderr and call exit() if compression fails.
-   * Note that this struct must live as long as the main JPEG parameter
-   * struct, to avoid dangling-pointer problems.
-   */
-  struct jpeg_error_mgr jerr;
+  q_jpeg_error_mgr jerr;
   /* More stuff */
   JSAMPARRAY buffer;		/* Output row buffer */
   unsigned row_stride;		/* physical row width in output buffer */
   unsigned pixelcount, memcount;
   unsigned char *out;
-  int len;
-  byte	*fbuffer;
   byte  *buf;
 
-  /* In this example we want to open the input file before doing anything else,
-   * so that the setjmp() error recovery below can assume the file is open.
-   * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-   * requires it in order to read binary files.
-   */
-
-  len = ri.FS_ReadFile ( ( char * ) filename, (void **)&fbuffer);
-  if (!fbuffer || len < 0) {
-	return;
-  }
-
   /* Step 1: allocate and initialize JPEG decompression object */
 
-  /* We have to set up the error handler first, in case the initialization
-   * step fails.  (Unlikely, but it could happen if you are out of memory.)
-   * This routine fills in the contents of struct jerr, and returns jerr's
-   * address which we place into the link field in cinfo.
+  /* We set up the normal JPEG error routines, then override error_exit
+   * and output_message.
    */
-  cinfo.err = jpeg_std_error(&jerr);
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = R_JPGErrorExit;
+  jerr.pub.output_message = R_JPGOutputMessage;
+  jerr.decode = decode;
+
+  /* Establish the setjmp return context for R_JPGErrorExit to use. */
+  if (setjmp(jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error.
+     * We need to clean up the JPEG object and return, the error
+     * and the partial image were already taken care of.
+     */
+    jpeg_destroy_decompress(&cinfo);
+    return;
+  }
 
   /* Now we can initialize the JPEG decompression object. */
   jpeg_create_decompress(&cinfo);
 
   /* Step 2: specify data source (eg, a file) */
 
-  jpeg_mem_src(&cinfo, fbuffer, len);
+  jpeg_mem_src(&cinfo, (unsigned char *)fbuffer, len);
 
   /* Step 3: read file parameters with jpeg_read_header() */
 
@@ -123,17 +164,22 @@ void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *heig
       || ((pixelcount * 4) / cinfo.output_width) / 4 != cinfo.output_height
       || pixelcount > 0x1FFFFFFF || cinfo.output_components > 4) // 4*1FFFFFFF == 0x7FFFFFFC < 0x7FFFFFFF
   {
-    ri.Error (ERR_DROP, "LoadJPG: %s has an invalid image size: %dx%d*4=%d, components: %d\n", filename,
+    R_ImageDecodeError( decode, ERR_DROP, "LoadJPG: %s has an invalid image size: %dx%d*4=%d, components: %d\n", filename,
 		    cinfo.output_width, cinfo.output_height, pixelcount * 4, cinfo.output_components);
+    jpeg_destroy_decompress(&cinfo);
+    return;
   }
 
   memcount = pixelcount * 4;
   row_stride = cinfo.output_width * cinfo.output_components;
 
-  out = ri.Malloc(memcount);
-
-  *width = cinfo.output_width;
-  *height = cinfo.output_height;
+  out = decode->pic = decode->Malloc(memcount);
+  if(!out)
+  {
+    R_ImageDecodeError( decode, ERR_DROP, "LoadJPG: out of memory for %s\n", filename );
+    jpeg_destroy_decompress(&cinfo);
+    return;
+  }
 
   /* Step 6: while (scan lines remain to be read) */
   /*           jpeg_read_scanlines(...); */
@@ -184,7 +230,8 @@ void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *heig
 	}
   }
 
-  *pic = out;
+  decode->width = cinfo.output_width;
+  decode->height = cinfo.output_height;
 
   /* Step 7: Finish decompression */
 
@@ -198,13 +245,6 @@ void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *heig
   /* This is an important step since it will release a good deal of memory. */
   jpeg_destroy_decompress(&cinfo);
 
-  /* After finish_decompress, we can close the input file.
-   * Here we postpone it until after no more JPEG errors are possible,
-   * so as to simplify the setjmp error logic above.  (Actually, I don't
-   * think that jpeg_destroy can do an error exit, but why assume anything...)
-   */
-  ri.FS_FreeFile (fbuffer);
-
   /* At this point you may want to check to see whether any corrupt-data
    * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
    */
@@ -212,6 +252,30 @@ void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *heig
   /* And we're done! */
 }
 
+/*
+=============
+R_LoadJPG
+=============
+*/
+void R_LoadJPG( const char *filename, unsigned char **pic, int *width, int *height ) {
+  imageDecode_t decode;
+  byte	*fbuffer;
+  int len;
+
+  *pic = NULL;
+
+  len = ri.FS_ReadFile ( ( char * ) filename, (void **)&fbuffer);
+  if (!fbuffer || len < 0) {
+	return;
+  }
+
+  R_InitImageDecode( &decode, ri.Malloc, ri.Free );
+  R_DecodeJPG( filename, fbuffer, len, &decode );
+  ri.FS_FreeFile (fbuffer);
+
+  R_FinishImageDecode( &decode, pic, width, height );
+}
+
 
 /* Expanded data destination object for stdio output */
 
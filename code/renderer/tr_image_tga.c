@@ -38,36 +38,27 @@ typedef struct _TargaHeader {
 	unsigned char	pixel_size, attributes;
 } TargaHeader;
 
-void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
+/*
+=============
+R_DecodeTGA
+
+Thread safe, see imageDecode_t
+=============
+*/
+void R_DecodeTGA( const char *name, const byte *buffer, int length, imageDecode_t *decode )
 {
 	unsigned	columns, rows, numPixels;
 	byte	*pixbuf;
 	int		row, column;
-	byte	*buf_p;
-	byte	*end;
-	byte	*buffer = NULL;
+	const byte	*buf_p;
+	const byte	*end;
 	TargaHeader	targa_header;
 	byte		*targa_rgba;
-	int length;
-
-	*pic = NULL;
-
-	if(width)
-		*width = 0;
-	if(height)
-		*height = 0;
-
-	//
-	// load the file
-	//
-	length = ri.FS_ReadFile ( ( char * ) name, (void **)&buffer);
-	if (!buffer || length < 0) {
-		return;
-	}
 
 	if(length < 18)
 	{
-		ri.Error( ERR_DROP, "LoadTGA: header too short (%s)\n", name );
+		R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: header too short (%s)\n", name );
+		return;
 	}
 
 	buf_p = buffer;
@@ -100,17 +91,20 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 		&& targa_header.image_type!=10
 		&& targa_header.image_type != 3 ) 
 	{
-		ri.Error (ERR_DROP, "LoadTGA: Only type 2 (RGB), 3 (gray), and 10 (RGB) TGA images supported\n");
+		R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: Only type 2 (RGB), 3 (gray), and 10 (RGB) TGA images supported\n" );
+		return;
 	}
 
 	if ( targa_header.colormap_type != 0 )
 	{
-		ri.Error( ERR_DROP, "LoadTGA: colormaps not supported\n" );
+		R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: colormaps not supported\n" );
+		return;
 	}
 
 	if ( ( targa_header.pixel_size != 32 && targa_header.pixel_size != 24 ) && targa_header.image_type != 3 )
 	{
-		ri.Error (ERR_DROP, "LoadTGA: Only 32 or 24 bit images supported (no colormaps)\n");
+		R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: Only 32 or 24 bit images supported (no colormaps)\n" );
+		return;
 	}
 
 	columns = targa_header.width;
@@ -119,16 +113,24 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 
 	if(!columns || !rows || numPixels > 0x7FFFFFFF || numPixels / columns / 4 != rows)
 	{
-		ri.Error (ERR_DROP, "LoadTGA: %s has an invalid image size\n", name);
+		R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: %s has an invalid image size\n", name );
+		return;
 	}
 
 
-	targa_rgba = ri.Malloc (numPixels);
+	targa_rgba = decode->pic = decode->Malloc( numPixels );
+	if ( !targa_rgba )
+	{
+		R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: out of memory for %s\n", name );
+		return;
+	}
 
 	if (targa_header.id_length != 0)
 	{
-		if (buf_p + targa_header.id_length > end)
-			ri.Error( ERR_DROP, "LoadTGA: header too short (%s)\n", name );
+		if (buf_p + targa_header.id_length > end) {
+			R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: header too short (%s)\n", name );
+			return;
+		}
 
 		buf_p += targa_header.id_length;  // skip TARGA image comment
 	}
@@ -137,7 +139,8 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 	{ 
 		if(buf_p + columns*rows*targa_header.pixel_size/8 > end)
 		{
-			ri.Error (ERR_DROP, "LoadTGA: file truncated (%s)\n", name);
+			R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: file truncated (%s)\n", name );
+			return;
 		}
 
 		// Uncompressed RGB or gray scale image
@@ -180,8 +183,8 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 					*pixbuf++ = alphabyte;
 					break;
 				default:
-					ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
-					break;
+					R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
+					return;
 				}
 			}
 		}
@@ -197,13 +200,17 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 		for(row=rows-1; row>=0; row--) {
 			pixbuf = targa_rgba + row*columns*4;
 			for(column=0; column<columns; ) {
-				if(buf_p + 1 > end)
-					ri.Error (ERR_DROP, "LoadTGA: file truncated (%s)\n", name);
+				if(buf_p + 1 > end) {
+					R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: file truncated (%s)\n", name );
+					return;
+				}
 				packetHeader= *buf_p++;
 				packetSize = 1 + (packetHeader & 0x7f);
 				if (packetHeader & 0x80) {        // run-length packet
-					if(buf_p + targa_header.pixel_size/8 > end)
-						ri.Error (ERR_DROP, "LoadTGA: file truncated (%s)\n", name);
+					if(buf_p + targa_header.pixel_size/8 > end) {
+						R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: file truncated (%s)\n", name );
+						return;
+					}
 					switch (targa_header.pixel_size) {
 						case 24:
 								blue = *buf_p++;
@@ -218,8 +225,8 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 								alphabyte = *buf_p++;
 								break;
 						default:
-							ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
-							break;
+							R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
+							return;
 					}
 	
 					for(j=0;j<packetSize;j++) {
@@ -240,8 +247,10 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 				}
 				else {                            // non run-length packet
 
-					if(buf_p + targa_header.pixel_size/8*packetSize > end)
-						ri.Error (ERR_DROP, "LoadTGA: file truncated (%s)\n", name);
+					if(buf_p + targa_header.pixel_size/8*packetSize > end) {
+						R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: file truncated (%s)\n", name );
+						return;
+					}
 					for(j=0;j<packetSize;j++) {
 						switch (targa_header.pixel_size) {
 							case 24:
@@ -264,8 +273,8 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 									*pixbuf++ = alphabyte;
 									break;
 							default:
-								ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
-								break;
+								R_ImageDecodeError( decode, ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
+								return;
 						}
 						column++;
 						if (column==columns) { // pixel packet run spans across rows
@@ -303,15 +312,43 @@ void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
 #endif
   // instead we just print a warning
   if (targa_header.attributes & 0x20) {
-    ri.Printf( PRINT_WARNING, "WARNING: '%s' TGA file header declares top-down image, ignoring\n", name);
+    Com_sprintf( decode->message, sizeof( decode->message ),
+		"WARNING: '%s' TGA file header declares top-down image, ignoring\n", name );
   }
 
-  if (width)
-	  *width = columns;
-  if (height)
-	  *height = rows;
+  decode->width = columns;
+  decode->height = rows;
+}
+
+/*
+=============
+R_LoadTGA
+=============
+*/
+void R_LoadTGA ( const char *name, byte **pic, int *width, int *height)
+{
+	imageDecode_t	decode;
+	byte	*buffer;
+	int		length;
+
+	*pic = NULL;
+
+	if(width)
+		*width = 0;
+	if(height)
+		*height = 0;
+
+	//
+	// load the file
+	//
+	length = ri.FS_ReadFile ( ( char * ) name, (void **)&buffer);
+	if (!buffer || length < 0) {
+		return;
+	}
 
-  *pic = targa_rgba;
+	R_InitImageDecode( &decode, ri.Malloc, ri.Free );
+	R_DecodeTGA( name, buffer, length, &decode );
+	ri.FS_FreeFile (buffer);
 
-  ri.FS_FreeFile (buffer);
+	R_FinishImageDecode( &decode, pic, width, height );
 }
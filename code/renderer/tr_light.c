@@ -371,6 +371,93 @@ void R_SetupEntityLighting( const trRefdef_t *refdef, trRefEntity_t *ent ) {
 	ent->lightDir[2] = DotProduct( lightDir, ent->e.axis[2] );
 }
 
+/*
+=================
+R_EntityNeedsLighting
+
+True for the entities R_AddEntitySurfaces will most likely call
+R_SetupEntityLighting for, the ones that end up culled are just lit
+for nothing
+=================
+*/
+static qboolean R_EntityNeedsLighting( const trRefEntity_t *ent ) {
+	model_t		*model;
+
+	if ( ent->e.reType != RT_MODEL || ent->lightingCalculated ) {
+		return qfalse;
+	}
+
+	if ( tr.viewParms.isPortal ) {
+		if ( ent->e.renderfx & RF_FIRST_PERSON ) {
+			return qfalse;
+		}
+	} else if ( ( ent->e.renderfx & RF_THIRD_PERSON ) && r_shadows->integer <= 1 ) {
+		return qfalse;
+	}
+
+	model = R_GetModelByHandle( ent->e.hModel );
+	switch ( model->type ) {
+	case MOD_MESH:
+	case MOD_MD4:
+#ifdef RAVENMD4
+	case MOD_MDR:
+#endif
+		return qtrue;
+	default:
+		return qfalse;
+	}
+}
+
+#define	ENTITY_LIGHTING_BATCH	8
+
+/*
+=================
+R_EntityLightingJob
+=================
+*/
+static void R_EntityLightingJob( void *data, int index ) {
+	trRefEntity_t	*ent;
+	int				i, last;
+
+	i = index * ENTITY_LIGHTING_BATCH;
+	last = i + ENTITY_LIGHTING_BATCH;
+	if ( last > tr.refdef.num_entities ) {
+		last = tr.refdef.num_entities;
+	}
+
+	for ( ent = &tr.refdef.entities[i] ; i < last ; i++, ent++ ) {
+		if ( R_EntityNeedsLighting( ent ) ) {
+			R_SetupEntityLighting( &tr.refdef, ent );
+		}
+	}
+}
+
+/*
+=================
+R_SetupSceneEntityLighting
+
+With r_frontEndThreads, lights the models of the scene on the worker
+pool before R_AddEntitySurfaces gets to them.  The surfaces still have
+to be added one entity at a time, they go through tr.or.
+=================
+*/
+void R_SetupSceneEntityLighting( void ) {
+	int		numThreads;
+
+	// LogLight output would be interleaved
+	if ( r_debugLight->integer ) {
+		return;
+	}
+
+	numThreads = ri.WorkerThreads( r_frontEndThreads->integer );
+	if ( numThreads <= 1 ) {
+		return;
+	}
+
+	ri.ParallelFor( numThreads, R_EntityLightingJob, NULL,
+		( tr.refdef.num_entities + ENTITY_LIGHTING_BATCH - 1 ) / ENTITY_LIGHTING_BATCH );
+}
+
 /*
 =================
 R_LightForPoint
@@ -42,9 +42,9 @@ long myftol( float f );
 
 
 // everything that is needed by the backend needs
-// to be double buffered to allow it to run in
-// parallel on a dual cpu machine
-#define	SMP_FRAMES		2
+// to be buffered once per frame the render thread can
+// be behind, r_smpFrames picks how many are used
+#define	SMP_FRAMES		4
 
 // 12 bits
 // see QSORT_SHADERNUM_SHIFT
@@ -105,6 +105,11 @@ typedef struct image_s {
 	qboolean	allowPicmip;
 	int			wrapClampMode;		// GL_CLAMP or GL_REPEAT
 
+	// load times for imagelist, in microseconds
+	int			decodeUsec;			// file read and decode
+	int			mipUsec;			// resampling, light scaling and mip levels
+	int			uploadUsec;			// qglTexImage2D
+
 	struct image_s*	next;
 } image_t;
 
@@ -392,6 +397,9 @@ typedef struct shader_s {
 	qboolean	needsST2;
 	qboolean	needsColor;
 
+	qboolean	staticVertexes;			// stages only need the map vertexes as they are, so
+										// world surfaces can be drawn from the vertex buffer
+
 	int			numDeforms;
 	deformStage_t	deforms[MAX_SHADER_DEFORMS];
 
@@ -608,6 +616,10 @@ typedef struct {
 	// dynamic lighting information
 	int			dlightBits[SMP_FRAMES];
 
+	// indexes in the world vertex buffer, 0 if it isn't in it
+	int			vboFirstIndex;
+	int			vboNumIndexes;
+
 	// triangle definitions (no normals at points)
 	int			numPoints;
 	int			numIndices;
@@ -629,6 +641,10 @@ typedef struct {
 	vec3_t			localOrigin;
 	float			radius;
 
+	// indexes in the world vertex buffer, 0 if it isn't in it
+	int				vboFirstIndex;
+	int				vboNumIndexes;
+
 	// triangle definitions
 	int				numIndexes;
 	int				*indexes;
@@ -685,8 +701,23 @@ typedef struct mnode_s {
 
 	msurface_t	**firstmarksurface;
 	int			nummarksurfaces;
+
+	int			numSubtreeSurfaces;	// marksurfaces of all the leafs at or below
 } mnode_t;
 
+// a mark surface found by one of the front end jobs in tr_world.c
+typedef enum {
+	SURFREF_UNTESTED,			// tested when the jobs are merged
+	SURFREF_CULLED,
+	SURFREF_VISIBLE
+} surfRefState_t;
+
+typedef struct {
+	msurface_t		*surf;
+	int				dlightBits;		// of the leaf
+	surfRefState_t	state;
+} worldSurfRef_t;
+
 typedef struct {
 	vec3_t		bounds[2];		// for culling
 	msurface_t	*firstSurface;
@@ -735,6 +766,13 @@ typedef struct {
 
 	char		*entityString;
 	char		*entityParsePoint;
+
+	// static faces and triangle surfaces, see tr_vbo.c
+	GLuint		vertexBuffer;
+	GLuint		indexBuffer;
+	int			numVBOSurfaces;
+
+	worldSurfRef_t	*surfRefs;		// numSubtreeSurfaces of the root
 } world_t;
 
 //======================================================================
@@ -821,6 +859,17 @@ typedef struct {
 	int		c_leafs;
 	int		c_dlightSurfaces;
 	int		c_dlightSurfacesCulled;
+
+	int		c_visCacheHits;		// R_MarkLeaves found the cluster in the vis cache
+	int		c_visCacheMisses;
+	int		c_visLeafsCached;	// frustum result of the last test was still good
+	int		c_visLeafsTested;
+
+	int		c_smpQueued;		// lists the render thread had when this frame was issued
+	int		c_smpWaits;			// frames that had to wait for a free backEndData
+	int		c_smpWaitUsec;
+	int		c_smpSyncs;			// R_SyncRenderThread calls that had to wait
+	int		c_smpSyncUsec;
 } frontEndCounters_t;
 
 #define	FOG_TABLE_SIZE		256
@@ -851,6 +900,13 @@ typedef struct {
 	int		c_flareTests;
 	int		c_flareRenders;
 
+	int		c_vboSurfaces;		// drawn from the world vertex buffer
+	int		c_vboIndexes;
+	int		c_vboDraws;
+	int		c_vboCopied;		// in the vertex buffer but copied to tess anyway
+
+	int		c_smpIdleUsec;	// render thread waiting for commands
+
 	int		msec;			// total msec for backend run
 } backEndCounters_t;
 
@@ -889,7 +945,9 @@ typedef struct {
 	int						viewCount;		// incremented every view (twice a scene if portaled)
 											// and every R_MarkFragments call
 
-	int						smpFrame;		// toggles from 0 to 1 every endFrame
+	int						smpFrame;		// cycles through the backEndData every endFrame
+	int						numSmpFrames;	// backEndData allocated, 1 without r_smp
+	backEndCounters_t		smpBackEndPc;	// of the last backEndData the render thread finished
 
 	int						frameSceneNum;	// zeroed at RE_BeginFrame
 
@@ -1049,6 +1107,7 @@ extern cvar_t	*r_ext_compressed_textures;		// these control use of specific exte
 extern cvar_t	*r_ext_multitexture;
 extern cvar_t	*r_ext_compiled_vertex_array;
 extern cvar_t	*r_ext_texture_env_add;
+extern cvar_t	*r_ext_vertex_buffer_object;
 
 extern cvar_t	*r_ext_texture_filter_anisotropic;
 extern cvar_t	*r_ext_max_anisotropy;
@@ -1090,6 +1149,8 @@ extern	cvar_t	*r_subdivisions;
 extern	cvar_t	*r_lodCurveError;
 extern	cvar_t	*r_smp;
 extern	cvar_t	*r_showSmp;
+extern	cvar_t	*r_smpFrames;
+extern	cvar_t	*r_smpLatency;
 extern	cvar_t	*r_skipBackEnd;
 
 extern	cvar_t	*r_stereoEnabled;
@@ -1104,6 +1165,12 @@ extern	cvar_t	*r_mapOverBrightBits;
 
 extern	cvar_t	*r_debugSurface;
 extern	cvar_t	*r_simpleMipMaps;
+extern	cvar_t	*r_imageLoadThreads;			// decode and mip R_FindImageFile images on the worker pool, -1 = one per cpu
+extern	cvar_t	*r_visCache;					// remember the marked leafs and their frustum results, see tr_world.c
+extern	cvar_t	*r_frontEndThreads;				// walk the world, light models and sort on the worker pool, -1 = one per cpu
+extern	cvar_t	*r_imageCache;					// keep the mip levels of file images in imagecache/
+extern	cvar_t	*r_shaderCache;					// keep the combined shader text and its names in shadercache/
+extern	cvar_t	*r_simd;						// use the SSE2 or NEON image kernels when the cpu has them
 
 extern	cvar_t	*r_showImages;
 extern	cvar_t	*r_debugSort;
@@ -1135,6 +1202,9 @@ void R_DecomposeSort( unsigned sort, int *entityNum, shader_t **shader,
 
 void R_AddDrawSurf( surfaceType_t *surface, shader_t *shader, int fogIndex, int dlightMap );
 
+int R_RadixSort( unsigned *keys, int *indexes, unsigned *tempKeys, int *tempIndexes, int count, int numThreads );
+void R_SortBench_f( void );
+
 
 #define	CULL_IN		0		// completely unclipped
 #define	CULL_CLIP	1		// clipped by one or more planes
@@ -1212,6 +1282,8 @@ model_t		*R_AllocModel( void );
 
 void    	R_Init( void );
 image_t		*R_FindImageFile( const char *name, qboolean mipmap, qboolean allowPicmip, int glWrapClampMode );
+qboolean	R_ImageLoadsPending( void );
+void		R_FinishImageLoads( void );
 
 image_t		*R_CreateImage( const char *name, const byte *pic, int width, int height, qboolean mipmap
 					, qboolean allowPicmip, int wrapClampMode );
@@ -1221,6 +1293,8 @@ void		R_SetColorMappings( void );
 void		R_GammaCorrect( byte *buffer, int bufSize );
 
 void	R_ImageList_f( void );
+void	R_ImageBench_f( void );
+const char *R_ImageKernelsString( void );
 void	R_SkinList_f( void );
 // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=516
 const void *RB_TakeScreenshotCmd( const void *data );
@@ -1269,6 +1343,8 @@ void		GLimp_EndFrame( void );
 qboolean	GLimp_SpawnRenderThread( void (*function)( void ) );
 void		*GLimp_RendererSleep( void );
 void		GLimp_FrontEndSleep( void );
+void		GLimp_FrontEndWait( int maxPending );
+int			GLimp_RendererPending( void );
 void		GLimp_WakeRenderer( void *data );
 
 void		GLimp_LogComment( char *comment );
@@ -1289,6 +1365,8 @@ TESSELATOR/SHADER DECLARATIONS
 */
 typedef byte color4ub_t[4];
 
+#define	MAX_VBO_RANGES	4096
+
 typedef struct stageVars
 {
 	color4ub_t	colors[SHADER_MAX_VERTEXES];
@@ -1318,6 +1396,12 @@ typedef struct shaderCommands_s
 	int			numIndexes;
 	int			numVertexes;
 
+	// index ranges of surfaces in the world vertex buffer,
+	// drawn along with the vertexes above
+	int			numVBORanges;
+	int			numVBOIndexes;
+	int			vboRanges[MAX_VBO_RANGES][2];	// first index, number of indexes
+
 	// info extracted from current shader
 	int			numPasses;
 	void		(*currentStageIteratorFunc)( void );
@@ -1336,6 +1420,8 @@ void RB_StageIteratorSky( void );
 void RB_StageIteratorVertexLitTexture( void );
 void RB_StageIteratorLightmappedMultitexture( void );
 
+qboolean RB_SurfaceVBO( int firstIndex, int numIndexes, int dlightBits );
+
 void RB_AddQuadStamp( vec3_t origin, vec3_t left, vec3_t up, byte *color );
 void RB_AddQuadStampExt( vec3_t origin, vec3_t left, vec3_t up, byte *color, float s1, float t1, float s2, float t2 );
 
@@ -1352,8 +1438,20 @@ WORLD MAP
 
 void R_AddBrushModelSurfaces( trRefEntity_t *e );
 void R_AddWorldSurfaces( void );
+void R_FreeVisCache( void );
 qboolean R_inPVS( const vec3_t p1, const vec3_t p2 );
 
+// the interleaved vertexes in the world vertex buffer
+typedef struct {
+	vec3_t		xyz;
+	vec2_t		st;
+	vec2_t		lightmap;
+	color4ub_t	color;
+} vboVert_t;
+
+void R_BuildWorldVBO( void );
+void R_FreeWorldVBO( void );
+
 
 /*
 ============================================================
@@ -1379,6 +1477,7 @@ LIGHTS
 
 void R_DlightBmodel( bmodel_t *bmodel );
 void R_SetupEntityLighting( const trRefdef_t *refdef, trRefEntity_t *ent );
+void R_SetupSceneEntityLighting( void );
 void R_TransformDlights( int count, dlight_t *dl, orientationr_t *or );
 int R_LightForPoint( vec3_t point, vec3_t ambientLight, vec3_t directedLight, vec3_t lightDir );
 
@@ -1505,6 +1604,78 @@ void R_LoadPCX( const char *name, byte **pic, int *width, int *height );
 void R_LoadPNG( const char *name, byte **pic, int *width, int *height );
 void R_LoadTGA( const char *name, byte **pic, int *width, int *height );
 
+// the TGA and JPG loaders are split into a file read and a decode from
+// memory that is safe to run on the image load worker threads.  A decoder
+// never calls ri.*, it allocates the image with Malloc and records errors
+// and warnings, which R_FinishImageDecode raises or prints afterwards
+typedef struct {
+	void		*(*Malloc)( int bytes );
+	void		(*Free)( void *buf );
+
+	byte		*pic;
+	int			width, height;
+
+	qboolean	failed;
+	int			errorLevel;		// for ri.Error when failed
+	char		message[256];	// the error, or a warning to print
+} imageDecode_t;
+
+void R_DecodeJPG( const char *name, const byte *buffer, int length, imageDecode_t *decode );
+void R_DecodeTGA( const char *name, const byte *buffer, int length, imageDecode_t *decode );
+
+void R_InitImageDecode( imageDecode_t *decode, void *(*alloc)( int bytes ), void (*release)( void *buf ) );
+void QDECL R_ImageDecodeError( imageDecode_t *decode, int errorLevel, const char *fmt, ... ) __attribute__ ((format (printf, 3, 4)));
+void R_FinishImageDecode( imageDecode_t *decode, byte **pic, int *width, int *height );
+
+/*
+=============================================================
+
+IMAGE CACHE
+
+=============================================================
+*/
+
+#define	MAX_IMAGE_LEVELS	16
+
+// an image ready for the texture object: R_PrepareImage does the work
+// and R_UploadImage the GL calls, so they can run on different threads
+typedef struct {
+	GLenum		internalFormat;
+	int			width, height;			// of the first level
+	int			numLevels;
+	const byte	*levels[MAX_IMAGE_LEVELS];
+	int			levelSizes[MAX_IMAGE_LEVELS];	// only set for compressed levels
+	qboolean	compressed;				// levels are internalFormat blocks instead of RGBA
+	byte		*buffer;				// malloc'd, holds the levels unless they are the source pic
+} imageUpload_t;
+
+// everything that goes into the uploaded levels of a file image, a
+// cached copy is only used when all of it matches
+typedef struct {
+	char		name[MAX_QPATH];		// as given to R_FindImageFile
+	char		fileName[MAX_QPATH];	// the file the pic comes from
+	int			fileLength;
+	int			fileChecksum;			// pure checksum of its pak, or of the contents
+	int			mipmap;
+	int			picmip;
+	int			roundDown;
+	int			simpleMipMaps;
+	int			colorMipLevels;
+	int			greyscale;
+	int			textureBits;
+	int			maxTextureSize;
+	int			textureCompression;
+	byte		lightTable[256];		// gamma, overbright and intensity
+} imageCacheKey_t;
+
+qboolean	R_FindImageSource( const char *name, char *fileName, int fileNameSize, int *length, int *checksum );
+const byte	*R_LightScaleTable( qboolean onlyGamma );
+
+qboolean	R_ImageCacheKey( imageCacheKey_t *key, const char *name, qboolean mipmap, qboolean allowPicmip );
+void		*R_ReadImageCache( const imageCacheKey_t *key, imageUpload_t *upload, int *width, int *height );
+void		R_WriteImageCache( const image_t *image, const imageCacheKey_t *key, const imageUpload_t *upload );
+void		R_ImageCacheInfo( void );
+
 /*
 =============================================================
 =============================================================
@@ -1658,8 +1829,8 @@ typedef enum {
 
 // all of the information needed by the back end must be
 // contained in a backEndData_t.  This entire structure is
-// duplicated so the front and back end can run in parallel
-// on an SMP machine
+// allocated once per r_smpFrames so the front and back end
+// can run in parallel on an SMP machine
 typedef struct {
 	drawSurf_t	drawSurfs[MAX_DRAWSURFS];
 	dlight_t	dlights[MAX_DLIGHTS];
@@ -1667,17 +1838,16 @@ typedef struct {
 	srfPoly_t	*polys;//[MAX_POLYS];
 	polyVert_t	*polyVerts;//[MAX_POLYVERTS];
 	renderCommandList_t	commands;
+	backEndCounters_t	pc;		// filled in by the render thread
 } backEndData_t;
 
 extern	int		max_polys;
 extern	int		max_polyverts;
 
-extern	backEndData_t	*backEndData[SMP_FRAMES];	// the second one may not be allocated
+extern	backEndData_t	*backEndData[SMP_FRAMES];	// only tr.numSmpFrames are allocated
 
 extern	volatile renderCommandList_t	*renderCommandList;
 
-extern	volatile qboolean	renderThreadActive;
-
 
 void *R_GetCommandBuffer( int bytes );
 void RB_ExecuteRenderCommands( const void *data );
@@ -1686,6 +1856,7 @@ void R_InitCommandBuffers( void );
 void R_ShutdownCommandBuffers( void );
 
 void R_SyncRenderThread( void );
+void R_WaitRenderThread( int frame );
 
 void R_AddDrawSurfCmd( drawSurf_t *drawSurfs, int numDrawSurfs );
 
@@ -1149,53 +1149,32 @@ DRAWSURF SORTING
 
 /*
 ===============
-R_Radix
+R_SortDrawSurfList
+
+Sorts the drawsurfs by their sort value with R_RadixSort, so the
+surfaces themselves are only moved once
 ===============
 */
-static ID_INLINE void R_Radix( int byte, int size, drawSurf_t *source, drawSurf_t *dest )
-{
-  int           count[ 256 ] = { 0 };
-  int           index[ 256 ];
-  int           i;
-  unsigned char *sortKey = NULL;
-  unsigned char *end = NULL;
-
-  sortKey = ( (unsigned char *)&source[ 0 ].sort ) + byte;
-  end = sortKey + ( size * sizeof( drawSurf_t ) );
-  for( ; sortKey < end; sortKey += sizeof( drawSurf_t ) )
-    ++count[ *sortKey ];
-
-  index[ 0 ] = 0;
-
-  for( i = 1; i < 256; ++i )
-    index[ i ] = index[ i - 1 ] + count[ i - 1 ];
+static void R_SortDrawSurfList( drawSurf_t *drawSurfs, int numDrawSurfs ) {
+	static unsigned		keys[2][MAX_DRAWSURFS];
+	static int			indexes[2][MAX_DRAWSURFS];
+	static drawSurf_t	sorted[MAX_DRAWSURFS];
+	int					i;
 
-  sortKey = ( (unsigned char *)&source[ 0 ].sort ) + byte;
-  for( i = 0; i < size; ++i, sortKey += sizeof( drawSurf_t ) )
-    dest[ index[ *sortKey ]++ ] = source[ i ];
-}
+	for ( i = 0 ; i < numDrawSurfs ; i++ ) {
+		keys[0][i] = drawSurfs[i].sort;
+		indexes[0][i] = i;
+	}
 
-/*
-===============
-R_RadixSort
+	if ( !R_RadixSort( keys[0], indexes[0], keys[1], indexes[1], numDrawSurfs,
+		ri.WorkerThreads( r_frontEndThreads->integer ) ) ) {
+		return;		// already in order
+	}
 
-Radix sort with 4 byte size buckets
-===============
-*/
-static void R_RadixSort( drawSurf_t *source, int size )
-{
-  static drawSurf_t scratch[ MAX_DRAWSURFS ];
-#ifdef Q3_LITTLE_ENDIAN
-  R_Radix( 0, size, source, scratch );
-  R_Radix( 1, size, scratch, source );
-  R_Radix( 2, size, source, scratch );
-  R_Radix( 3, size, scratch, source );
-#else
-  R_Radix( 3, size, source, scratch );
-  R_Radix( 2, size, scratch, source );
-  R_Radix( 1, size, source, scratch );
-  R_Radix( 0, size, scratch, source );
-#endif //Q3_LITTLE_ENDIAN
+	for ( i = 0 ; i < numDrawSurfs ; i++ ) {
+		sorted[i] = drawSurfs[ indexes[0][i] ];
+	}
+	Com_Memcpy( drawSurfs, sorted, numDrawSurfs * sizeof( *drawSurfs ) );
 }
 
 //==========================================================================================
@@ -1260,7 +1239,7 @@ void R_SortDrawSurfs( drawSurf_t *drawSurfs, int numDrawSurfs ) {
 	}
 
 	// sort the drawsurfs by sort type, then orientation, then shader
-	R_RadixSort( drawSurfs, numDrawSurfs );
+	R_SortDrawSurfList( drawSurfs, numDrawSurfs );
 
 	// check for any pass through drawing, which
 	// may cause another view to be rendered first
@@ -1302,6 +1281,8 @@ void R_AddEntitySurfaces (void) {
 		return;
 	}
 
+	R_SetupSceneEntityLighting();
+
 	for ( tr.currentEntityNum = 0; 
 	      tr.currentEntityNum < tr.refdef.num_entities; 
 		  tr.currentEntityNum++ ) {
@@ -24,7 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "tr_types.h"
 
-#define	REF_API_VERSION		8
+#define	REF_API_VERSION		11
 
 //
 // these are the functions exported by the refresh module
@@ -129,6 +129,16 @@ typedef struct {
 	void	*(*Malloc)( int bytes );
 	void	(*Free)( void *buf );
 
+	// data parallel loops on the common worker pool, see threads.c
+	int		(*WorkerThreads)( int requested );
+	void	(*ParallelFor)( int numThreads, workerFunc_t func, void *data, int count );
+
+	// wall clock for load time statistics
+	uint64_t	(*Microseconds)( void );
+
+	// CF_ flags, for picking SIMD code paths
+	cpuFeatures_t	(*GetProcessorFeatures)( void );
+
 	cvar_t	*(*Cvar_Get)( const char *name, const char *value, int flags );
 	void	(*Cvar_Set)( const char *name, const char *value );
 
@@ -146,6 +156,7 @@ typedef struct {
 	// a -1 return means the file does not exist
 	// NULL can be passed for buf to just determine existance
 	int		(*FS_FileIsInPAK)( const char *name, int *pCheckSum );
+	int		(*FS_FileOrigin)( const char *name, int *checksum );
 	int		(*FS_ReadFile)( const char *name, void **buf );
 	void	(*FS_FreeFile)( void *buf );
 	char **	(*FS_ListFiles)( const char *name, const char *extension, int *numfilesfound );
@@ -44,10 +44,11 @@ R_ToggleSmpFrame
 ====================
 */
 void R_ToggleSmpFrame( void ) {
-	if ( r_smp->integer ) {
-		// use the other buffers next frame, because another CPU
-		// may still be rendering into the current ones
-		tr.smpFrame ^= 1;
+	if ( tr.numSmpFrames > 1 ) {
+		// use the next buffers, because another CPU may
+		// still be rendering from the current ones
+		tr.smpFrame = ( tr.smpFrame + 1 ) % tr.numSmpFrames;
+		R_WaitRenderThread( tr.smpFrame );
 	} else {
 		tr.smpFrame = 0;
 	}
@@ -299,6 +300,8 @@ void RE_RenderScene( const refdef_t *fd ) {
 		return;
 	}
 
+	PROFILE_BEGIN( "RE_RenderScene", -1 );
+
 	startTime = ri.Milliseconds();
 
 	if (!tr.world && !( fd->rdflags & RDF_NOWORLDMODEL ) ) {
@@ -411,4 +414,6 @@ void RE_RenderScene( const refdef_t *fd ) {
 	r_firstScenePoly = r_numpolys;
 
 	tr.frontEndMsec += ri.Milliseconds() - startTime;
+
+	PROFILE_END();
 }
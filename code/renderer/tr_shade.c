@@ -320,6 +320,8 @@ void RB_BeginSurface( shader_t *shader, int fogNum ) {
 
 	tess.numIndexes = 0;
 	tess.numVertexes = 0;
+	tess.numVBORanges = 0;
+	tess.numVBOIndexes = 0;
 	tess.shader = state;
 	tess.fogNum = fogNum;
 	tess.dlightBits = 0;		// will be OR'd in by surface functions
@@ -1332,6 +1334,200 @@ void RB_StageIteratorVertexLitTexture( void )
 	}
 }
 
+/*
+===============
+ComputeConstantColor
+
+The color ComputeColors gives every vertex for a stage that
+doesn't use the vertex colors
+===============
+*/
+static void ComputeConstantColor( shaderStage_t *pStage, byte *color ) {
+	switch ( pStage->rgbGen )
+	{
+	case CGEN_IDENTITY:
+		Com_Memset( color, 0xff, 4 );
+		break;
+	default:
+	case CGEN_IDENTITY_LIGHTING:
+		Com_Memset( color, tr.identityLightByte, 4 );
+		break;
+	case CGEN_CONST:
+		*(int *)color = *(int *)pStage->constantColor;
+		break;
+	}
+
+	switch ( pStage->alphaGen )
+	{
+	case AGEN_IDENTITY:
+		color[3] = 0xff;
+		break;
+	case AGEN_CONST:
+		color[3] = pStage->constantColor[3];
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+===============
+VBOTexCoordPointer
+===============
+*/
+static void VBOTexCoordPointer( textureBundle_t *bundle ) {
+	if ( bundle->tcGen == TCGEN_LIGHTMAP ) {
+		qglTexCoordPointer( 2, GL_FLOAT, sizeof( vboVert_t ), &((vboVert_t *)0)->lightmap );
+	} else {
+		qglTexCoordPointer( 2, GL_FLOAT, sizeof( vboVert_t ), &((vboVert_t *)0)->st );
+	}
+}
+
+/*
+===============
+CompareVBORanges
+===============
+*/
+static int CompareVBORanges( const void *a, const void *b ) {
+	return ((const int *)a)[0] - ((const int *)b)[0];
+}
+
+/*
+===============
+DrawVBORanges
+===============
+*/
+static void DrawVBORanges( void ) {
+	int		i;
+
+	for ( i = 0 ; i < tess.numVBORanges ; i++ ) {
+		qglDrawElements( GL_TRIANGLES, tess.vboRanges[i][1], GL_INDEX_TYPE,
+			(glIndex_t *)0 + tess.vboRanges[i][0] );
+	}
+	backEnd.pc.c_vboDraws += tess.numVBORanges;
+}
+
+/*
+** RB_StageIteratorVBO
+**
+** Draws the index ranges in tess from the world vertex buffer.  Only
+** used for shaders with staticVertexes, so the colors are either
+** constant or the vertex colors and the texture coordinates come
+** straight from the buffer.
+*/
+static void RB_StageIteratorVBO( void ) {
+	shaderStage_t	*pStage;
+	byte			color[4];
+	int				stage;
+	int				i, n;
+
+	//
+	// draw the ranges in buffer order, which joins up the
+	// surfaces that were laid out next to each other
+	//
+	qsort( tess.vboRanges, tess.numVBORanges, sizeof( tess.vboRanges[0] ), CompareVBORanges );
+	for ( i = 1, n = 0 ; i < tess.numVBORanges ; i++ ) {
+		if ( tess.vboRanges[n][0] + tess.vboRanges[n][1] == tess.vboRanges[i][0] ) {
+			tess.vboRanges[n][1] += tess.vboRanges[i][1];
+		} else {
+			n++;
+			tess.vboRanges[n][0] = tess.vboRanges[i][0];
+			tess.vboRanges[n][1] = tess.vboRanges[i][1];
+		}
+	}
+	tess.numVBORanges = n + 1;
+
+	if ( r_logFile->integer ) {
+		GLimp_LogComment( va("--- RB_StageIteratorVBO( %s ) ---\n", tess.shader->name) );
+	}
+
+	GL_Cull( tess.shader->cullType );
+
+	if ( tess.shader->polygonOffset ) {
+		qglEnable( GL_POLYGON_OFFSET_FILL );
+		qglPolygonOffset( r_offsetFactor->value, r_offsetUnits->value );
+	}
+
+	qglBindBufferARB( GL_ARRAY_BUFFER_ARB, tr.world->vertexBuffer );
+	qglBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, tr.world->indexBuffer );
+
+	qglVertexPointer( 3, GL_FLOAT, sizeof( vboVert_t ), &((vboVert_t *)0)->xyz );
+
+	for ( stage = 0; stage < MAX_SHADER_STAGES; stage++ ) {
+		pStage = tess.xstages[stage];
+		if ( !pStage ) {
+			break;
+		}
+
+		if ( pStage->rgbGen == CGEN_VERTEX || pStage->rgbGen == CGEN_EXACT_VERTEX ) {
+			qglEnableClientState( GL_COLOR_ARRAY );
+			qglColorPointer( 4, GL_UNSIGNED_BYTE, sizeof( vboVert_t ), &((vboVert_t *)0)->color );
+		} else {
+			qglDisableClientState( GL_COLOR_ARRAY );
+			ComputeConstantColor( pStage, color );
+			qglColor4ubv( color );
+		}
+
+		GL_State( pStage->stateBits );
+
+		if ( pStage->bundle[1].image[0] != 0 ) {
+			// this is an ugly hack to work around a GeForce driver
+			// bug with multitexture and clip planes
+			if ( backEnd.viewParms.isPortal ) {
+				qglPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+			}
+
+			GL_SelectTexture( 0 );
+			qglEnableClientState( GL_TEXTURE_COORD_ARRAY );
+			VBOTexCoordPointer( &pStage->bundle[0] );
+			R_BindAnimatedImage( &pStage->bundle[0] );
+
+			GL_SelectTexture( 1 );
+			qglEnable( GL_TEXTURE_2D );
+			qglEnableClientState( GL_TEXTURE_COORD_ARRAY );
+			if ( r_lightmap->integer ) {
+				GL_TexEnv( GL_REPLACE );
+			} else {
+				GL_TexEnv( tess.shader->multitextureEnv );
+			}
+			VBOTexCoordPointer( &pStage->bundle[1] );
+			R_BindAnimatedImage( &pStage->bundle[1] );
+
+			DrawVBORanges();
+
+			qglDisableClientState( GL_TEXTURE_COORD_ARRAY );
+			qglDisable( GL_TEXTURE_2D );
+			GL_SelectTexture( 0 );
+		} else {
+			qglEnableClientState( GL_TEXTURE_COORD_ARRAY );
+			VBOTexCoordPointer( &pStage->bundle[0] );
+
+			if ( pStage->bundle[0].vertexLightmap && ( (r_vertexLight->integer && !r_uiFullScreen->integer) || glConfig.hardwareType == GLHW_PERMEDIA2 ) && r_lightmap->integer )
+			{
+				GL_Bind( tr.whiteImage );
+			}
+			else 
+				R_BindAnimatedImage( &pStage->bundle[0] );
+
+			DrawVBORanges();
+		}
+
+		// allow skipping out to show just lightmaps during development
+		if ( r_lightmap->integer && ( pStage->bundle[0].isLightmap || pStage->bundle[1].isLightmap || pStage->bundle[0].vertexLightmap ) )
+		{
+			break;
+		}
+	}
+
+	// everything else uses client side arrays
+	qglBindBufferARB( GL_ARRAY_BUFFER_ARB, 0 );
+	qglBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, 0 );
+
+	if ( tess.shader->polygonOffset ) {
+		qglDisable( GL_POLYGON_OFFSET_FILL );
+	}
+}
+
 //define	REPLACE_MODE
 
 void RB_StageIteratorLightmappedMultitexture( void ) {
@@ -1444,7 +1640,7 @@ void RB_EndSurface( void ) {
 
 	input = &tess;
 
-	if (input->numIndexes == 0) {
+	if (input->numIndexes == 0 && input->numVBORanges == 0) {
 		return;
 	}
 
@@ -1470,25 +1666,37 @@ void RB_EndSurface( void ) {
 	//
 	backEnd.pc.c_shaders++;
 	backEnd.pc.c_vertexes += tess.numVertexes;
-	backEnd.pc.c_indexes += tess.numIndexes;
-	backEnd.pc.c_totalIndexes += tess.numIndexes * tess.numPasses;
+	backEnd.pc.c_indexes += tess.numIndexes + tess.numVBOIndexes;
+	backEnd.pc.c_totalIndexes += ( tess.numIndexes + tess.numVBOIndexes ) * tess.numPasses;
+	backEnd.pc.c_vboIndexes += tess.numVBOIndexes;
 
 	//
-	// call off to shader specific tess end function
+	// draw the surfaces in the world vertex buffer
 	//
-	tess.currentStageIteratorFunc();
-
-	//
-	// draw debugging stuff
-	//
-	if ( r_showtris->integer ) {
-		DrawTris (input);
+	if ( tess.numVBORanges ) {
+		RB_StageIteratorVBO();
 	}
-	if ( r_shownormals->integer ) {
-		DrawNormals (input);
+
+	if ( tess.numIndexes ) {
+		//
+		// call off to shader specific tess end function
+		//
+		tess.currentStageIteratorFunc();
+
+		//
+		// draw debugging stuff
+		//
+		if ( r_showtris->integer ) {
+			DrawTris (input);
+		}
+		if ( r_shownormals->integer ) {
+			DrawNormals (input);
+		}
 	}
 	// clear shader so we can tell we don't have any unclosed surfaces
 	tess.numIndexes = 0;
+	tess.numVBORanges = 0;
+	tess.numVBOIndexes = 0;
 
 	GLimp_LogComment( "----------\n" );
 }
@@ -1709,6 +1709,102 @@ done:
 	return;
 }
 
+/*
+===================
+ComputeStaticVertexes
+
+See if every stage can use the map vertexes without changing them,
+so world surfaces can be drawn straight from the vertex buffer.  The
+colors have to be either constant or the vertex colors as they are,
+and the texture coordinates the plain texture or lightmap ones.
+===================
+*/
+static void ComputeStaticVertexes( void )
+{
+	shaderStage_t	*pStage;
+	qboolean		vertexColors;
+	int				i, b;
+
+	shader.staticVertexes = qfalse;
+
+	// portals are read back out of tess by SurfIsOffscreen
+	if ( shader.isSky || shader.sort <= SS_PORTAL || shader.numDeforms || !shader.numUnfoggedPasses )
+	{
+		return;
+	}
+
+	for ( i = 0 ; i < shader.numUnfoggedPasses ; i++ )
+	{
+		pStage = &stages[i];
+
+		switch ( pStage->rgbGen )
+		{
+		case CGEN_IDENTITY:
+		case CGEN_IDENTITY_LIGHTING:
+		case CGEN_CONST:
+			vertexColors = qfalse;
+			break;
+		case CGEN_VERTEX:
+			if ( tr.identityLight != 1 )
+			{
+				return;
+			}
+			vertexColors = qtrue;
+			break;
+		case CGEN_EXACT_VERTEX:
+			vertexColors = qtrue;
+			break;
+		default:
+			return;
+		}
+
+		switch ( pStage->alphaGen )
+		{
+		case AGEN_SKIP:
+			break;
+		case AGEN_IDENTITY:
+			// ComputeColors leaves the vertex alpha for rgbGen vertex
+			if ( vertexColors && pStage->rgbGen != CGEN_VERTEX )
+			{
+				return;
+			}
+			break;
+		case AGEN_CONST:
+			if ( vertexColors )
+			{
+				return;
+			}
+			break;
+		case AGEN_VERTEX:
+			if ( !vertexColors )
+			{
+				return;
+			}
+			break;
+		default:
+			return;
+		}
+
+		for ( b = 0 ; b < NUM_TEXTURE_BUNDLES ; b++ )
+		{
+			if ( b > 0 && !pStage->bundle[b].image[0] )
+			{
+				continue;
+			}
+			if ( pStage->bundle[b].tcGen != TCGEN_TEXTURE && pStage->bundle[b].tcGen != TCGEN_LIGHTMAP )
+			{
+				return;
+			}
+			if ( pStage->bundle[b].numTexMods )
+			{
+				return;
+			}
+		}
+	}
+
+	shader.staticVertexes = qtrue;
+}
+
 typedef struct {
 	int		blendA;
 	int		blendB;
@@ -2306,6 +2402,8 @@ static shader_t *FinishShader( void ) {
 	// determine which stage iterator function is appropriate
 	ComputeStageIteratorFunc();
 
+	ComputeStaticVertexes();
+
 	return GeneratePermanentShader();
 }
 
@@ -2315,8 +2413,9 @@ static shader_t *FinishShader( void ) {
 ====================
 FindShaderInShaderText
 
-Scans the combined text description of all the shader files for
-the given shader name.
+Looks the given shader name up in the combined text description
+of all the shader files.  Every definition in the text is in
+shaderTextHashTable, so there is nothing to scan for.
 
 return NULL if not found
 
@@ -2329,6 +2428,10 @@ static char *FindShaderInShaderText( const char *shadername ) {
 
 	int i, hash;
 
+	if ( !s_shaderText ) {
+		return NULL;
+	}
+
 	hash = generateHashValue(shadername, MAX_SHADERTEXT_HASH);
 
 	for (i = 0; shaderTextHashTable[hash][i]; i++) {
@@ -2339,28 +2442,6 @@ static char *FindShaderInShaderText( const char *shadername ) {
 		}
 	}
 
-	p = s_shaderText;
-
-	if ( !p ) {
-		return NULL;
-	}
-
-	// look for label
-	while ( 1 ) {
-		token = COM_ParseExt( &p, qtrue );
-		if ( token[0] == 0 ) {
-			break;
-		}
-
-		if ( !Q_stricmp( token, shadername ) ) {
-			return p;
-		}
-		else {
-			// skip the definition
-			SkipBracedSection( &p );
-		}
-	}
-
 	return NULL;
 }
 
@@ -2867,6 +2948,213 @@ void	R_ShaderList_f (void) {
 }
 
 
+/*
+====================
+SetupShaderTextHashTable
+
+Points each bucket of shaderTextHashTable at room for its names
+and a NULL after them
+====================
+*/
+static void SetupShaderTextHashTable( const int *sizes, int numNames )
+{
+	char	*hashMem;
+	int		i;
+
+	hashMem = ri.Hunk_Alloc( ( numNames + MAX_SHADERTEXT_HASH ) * sizeof(char *), h_low );
+
+	for (i = 0; i < MAX_SHADERTEXT_HASH; i++) {
+		shaderTextHashTable[i] = (char **) hashMem;
+		hashMem = ((char *) hashMem) + ((sizes[i] + 1) * sizeof(char *));
+	}
+}
+
+/*
+=============================================================================
+
+SHADER TEXT CACHE
+
+With r_shaderCache set, the combined shader text and the position of
+every definition in it are saved to SHADER_CACHE_FILE once they have
+been built, and loaded from there the next time the shader files are
+the same, which skips reading, checking and compressing each of them
+and finding the names.  The files are identified by their names, their
+lengths and the pure checksums of the paks they are in, or a checksum
+of the contents for files in directories, in the order FS_ListFiles
+gives them.
+
+The definitions are still parsed when they are registered, what they
+turn into depends on the lightmap, the images and the cvars at the time.
+
+=============================================================================
+*/
+
+#define	SHADER_CACHE_FILE		"shadercache/scripts.dat"
+#define	SHADER_CACHE_IDENT		(('C'<<24)+('S'<<16)+('3'<<8)+'Q')
+#define	SHADER_CACHE_VERSION	1
+
+typedef struct {
+	int		ident;
+	int		version;
+	int		keyLength;
+	int		textLength;				// including the trailing 0
+	int		numNames;
+} shaderCacheHeader_t;
+
+typedef struct {
+	int		hash;					// in shaderTextHashTable
+	int		offset;					// in s_shaderText
+} shaderCacheName_t;
+
+/*
+====================
+ShaderCacheKey
+
+Identifies the shader files, returns the malloc'd key or NULL if
+there's no memory for it
+====================
+*/
+static byte *ShaderCacheKey( char **shaderFiles, int numShaderFiles, int *keyLength )
+{
+	char	filename[MAX_QPATH];
+	byte	*key;
+	int		i, length, checksum, size;
+
+	key = malloc( numShaderFiles * ( MAX_QPATH + 2 * sizeof( int ) ) );
+	if ( !key ) {
+		return NULL;
+	}
+	size = 0;
+
+	for ( i = 0; i < numShaderFiles; i++ )
+	{
+		Com_sprintf( filename, sizeof( filename ), "scripts/%s", shaderFiles[i] );
+		length = ri.FS_FileOrigin( filename, &checksum );
+
+		Com_Memcpy( key + size, filename, strlen( filename ) + 1 );
+		size += strlen( filename ) + 1;
+		Com_Memcpy( key + size, &length, sizeof( length ) );
+		size += sizeof( length );
+		Com_Memcpy( key + size, &checksum, sizeof( checksum ) );
+		size += sizeof( checksum );
+	}
+
+	*keyLength = size;
+	return key;
+}
+
+/*
+====================
+LoadShaderCache
+
+Sets up s_shaderText and shaderTextHashTable from the cache if it
+was made from the same files, returns the number of names or -1
+====================
+*/
+static int LoadShaderCache( const byte *key, int keyLength )
+{
+	shaderCacheHeader_t	*header;
+	shaderCacheName_t	*names;
+	const char			*text;
+	void				*buffer;
+	int					sizes[MAX_SHADERTEXT_HASH];
+	int					i, length;
+
+	length = ri.FS_ReadFile( SHADER_CACHE_FILE, &buffer );
+	if ( !buffer ) {
+		return -1;
+	}
+
+	// everything is checked before anything goes on the hunk
+	header = (shaderCacheHeader_t *)buffer;
+	if ( length < (int)sizeof( *header )
+		|| header->ident != SHADER_CACHE_IDENT
+		|| header->version != SHADER_CACHE_VERSION
+		|| header->keyLength != keyLength
+		|| header->textLength < 1 || header->numNames < 0
+		|| length != sizeof( *header ) + keyLength + header->textLength
+			+ header->numNames * sizeof( *names )
+		|| memcmp( header + 1, key, keyLength ) ) {
+		ri.FS_FreeFile( buffer );
+		return -1;
+	}
+
+	text = (const char *)( header + 1 ) + keyLength;
+	names = (shaderCacheName_t *)( text + header->textLength );
+	if ( text[header->textLength - 1] ) {
+		ri.FS_FreeFile( buffer );
+		return -1;
+	}
+
+	Com_Memset( sizes, 0, sizeof( sizes ) );
+	for ( i = 0; i < header->numNames; i++ ) {
+		if ( names[i].hash < 0 || names[i].hash >= MAX_SHADERTEXT_HASH
+			|| names[i].offset < 0 || names[i].offset >= header->textLength ) {
+			ri.FS_FreeFile( buffer );
+			return -1;
+		}
+		sizes[names[i].hash]++;
+	}
+
+	s_shaderText = ri.Hunk_Alloc( header->textLength, h_low );
+	Com_Memcpy( s_shaderText, text, header->textLength );
+
+	SetupShaderTextHashTable( sizes, header->numNames );
+
+	Com_Memset( sizes, 0, sizeof( sizes ) );
+	for ( i = 0; i < header->numNames; i++ ) {
+		shaderTextHashTable[names[i].hash][sizes[names[i].hash]++] = s_shaderText + names[i].offset;
+	}
+
+	length = header->numNames;
+	ri.FS_FreeFile( buffer );
+
+	return length;
+}
+
+/*
+====================
+WriteShaderCache
+====================
+*/
+static void WriteShaderCache( const byte *key, int keyLength, int numNames )
+{
+	shaderCacheHeader_t	*header;
+	shaderCacheName_t	*names;
+	char				*text;
+	int					i, j, size;
+
+	header = malloc( sizeof( *header ) + keyLength + strlen( s_shaderText ) + 1
+		+ numNames * sizeof( *names ) );
+	if ( !header ) {
+		ri.Printf( PRINT_WARNING, "WARNING: no memory to write %s\n", SHADER_CACHE_FILE );
+		return;
+	}
+	header->ident = SHADER_CACHE_IDENT;
+	header->version = SHADER_CACHE_VERSION;
+	header->keyLength = keyLength;
+	header->textLength = strlen( s_shaderText ) + 1;
+	header->numNames = numNames;
+
+	Com_Memcpy( header + 1, key, keyLength );
+	text = (char *)( header + 1 ) + keyLength;
+	Com_Memcpy( text, s_shaderText, header->textLength );
+
+	// bucket by bucket, so each bucket keeps the order of the text
+	names = (shaderCacheName_t *)( text + header->textLength );
+	size = 0;
+	for ( i = 0; i < MAX_SHADERTEXT_HASH; i++ ) {
+		for ( j = 0; shaderTextHashTable[i][j]; j++ ) {
+			names[size].hash = i;
+			names[size].offset = shaderTextHashTable[i][j] - s_shaderText;
+			size++;
+		}
+	}
+
+	ri.FS_WriteFile( SHADER_CACHE_FILE, header, (byte *)( names + size ) - (byte *)header );
+	free( header );
+}
+
 /*
 ====================
 ScanAndLoadShaderFiles
@@ -2883,10 +3171,17 @@ static void ScanAndLoadShaderFiles( void )
 	char *p;
 	int numShaderFiles;
 	int i;
-	char *oldp, *token, *hashMem;
+	char *oldp, *token, *end;
 	int shaderTextHashTableSizes[MAX_SHADERTEXT_HASH], hash, size;
+	byte *key;
+	int keyLength;
+	uint64_t start;
 
 	long sum = 0, summand;
+
+	s_shaderText = NULL;
+	start = ri.Microseconds();
+
 	// scan for shader files
 	shaderFiles = ri.FS_ListFiles( "scripts", ".shader", &numShaderFiles );
 
@@ -2900,6 +3195,22 @@ static void ScanAndLoadShaderFiles( void )
 		numShaderFiles = MAX_SHADER_FILES;
 	}
 
+	key = NULL;
+	keyLength = 0;
+	if ( r_shaderCache->integer ) {
+		key = ShaderCacheKey( shaderFiles, numShaderFiles, &keyLength );
+	}
+	if ( key ) {
+		size = LoadShaderCache( key, keyLength );
+		if ( size >= 0 ) {
+			ri.Printf( PRINT_ALL, "...%i shaders in %i files from the shader cache, %.1f msec\n",
+				size, numShaderFiles, ( ri.Microseconds() - start ) / 1000.0f );
+			free( key );
+			ri.FS_FreeFileList( shaderFiles );
+			return;
+		}
+	}
+
 	// load and parse shader files
 	for ( i = 0; i < numShaderFiles; i++ )
 	{
@@ -2944,17 +3255,20 @@ static void ScanAndLoadShaderFiles( void )
 	// build single large buffer
 	s_shaderText = ri.Hunk_Alloc( sum + numShaderFiles*2, h_low );
 	s_shaderText[ 0 ] = '\0';
+	end = s_shaderText;
 
 	// free in reverse order, so the temp files are all dumped
 	for ( i = numShaderFiles - 1; i >= 0 ; i-- )
 	{
 		if(buffers[i])
 		{
-			p = &s_shaderText[strlen(s_shaderText)];
-			strcat( s_shaderText, buffers[i] );
+			p = end;
+			strcpy( p, buffers[i] );
 			ri.FS_FreeFile( buffers[i] );
 			COM_Compress(p);
-			strcat( s_shaderText, "\n" );
+			end = p + strlen( p );
+			strcpy( end, "\n" );
+			end++;
 		}
 	}
 
@@ -2978,14 +3292,7 @@ static void ScanAndLoadShaderFiles( void )
 		SkipBracedSection(&p);
 	}
 
-	size += MAX_SHADERTEXT_HASH;
-
-	hashMem = ri.Hunk_Alloc( size * sizeof(char *), h_low );
-
-	for (i = 0; i < MAX_SHADERTEXT_HASH; i++) {
-		shaderTextHashTable[i] = (char **) hashMem;
-		hashMem = ((char *) hashMem) + ((shaderTextHashTableSizes[i] + 1) * sizeof(char *));
-	}
+	SetupShaderTextHashTable( shaderTextHashTableSizes, size );
 
 	Com_Memset(shaderTextHashTableSizes, 0, sizeof(shaderTextHashTableSizes));
 
@@ -3004,6 +3311,14 @@ static void ScanAndLoadShaderFiles( void )
 		SkipBracedSection(&p);
 	}
 
+	ri.Printf( PRINT_ALL, "...%i shaders in %i files, %.1f msec\n",
+		size, numShaderFiles, ( ri.Microseconds() - start ) / 1000.0f );
+
+	if ( key ) {
+		WriteShaderCache( key, keyLength, size );
+		free( key );
+	}
+
 	return;
 
 }
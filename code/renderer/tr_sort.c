@@ -0,0 +1,369 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_sort.c -- radix sort of 32 bit keys
+
+#include "tr_local.h"
+
+/*
+=============================================================================
+
+RADIX SORT
+
+R_RadixSort sorts an array of 32 bit keys along with an array of indexes
+saying what each key belongs to, so a pass only moves eight bytes per
+element whatever is being sorted.  All four byte histograms are counted
+in one read of the keys, and a pass is skipped when every key has the
+same value in its byte, which for draw surfaces is usually true of the
+top byte and often of the entity byte.
+
+With more than one thread and enough keys, the keys are split into
+ranges that are counted and scattered on the worker pool.  Each range
+writes to its own part of every bucket, so the sort is still stable
+and the result is the same as on one thread.
+
+=============================================================================
+*/
+
+#define	RADIX_MIN_PARALLEL	4096		// fewer keys than this are sorted on one thread
+#define	RADIX_MAX_RANGES	16
+
+typedef struct {
+	const unsigned	*keys;
+	const int		*indexes;
+	unsigned		*outKeys;
+	int				*outIndexes;
+
+	int				count;
+	int				numRanges;
+	int				pass;				// byte being scattered
+
+	int				counts[RADIX_MAX_RANGES][4][256];
+	int				offsets[RADIX_MAX_RANGES][256];
+} radixSort_t;
+
+// R_RadixSort is only called from the main thread
+static radixSort_t	radix;
+
+/*
+=================
+R_RadixRange
+=================
+*/
+static void R_RadixRange( int range, int *start, int *end ) {
+	*start = (int)( (long long)radix.count * range / radix.numRanges );
+	*end = (int)( (long long)radix.count * ( range + 1 ) / radix.numRanges );
+}
+
+/*
+=================
+R_RadixCountAll
+
+Counts all four bytes of the keys in a range
+=================
+*/
+static void R_RadixCountAll( void *data, int range ) {
+	int			(*counts)[256];
+	unsigned	key;
+	int			i, start, end;
+
+	counts = radix.counts[range];
+	Com_Memset( counts, 0, sizeof( radix.counts[0] ) );
+
+	R_RadixRange( range, &start, &end );
+	for ( i = start ; i < end ; i++ ) {
+		key = radix.keys[i];
+		counts[0][key & 255]++;
+		counts[1][( key >> 8 ) & 255]++;
+		counts[2][( key >> 16 ) & 255]++;
+		counts[3][key >> 24]++;
+	}
+}
+
+/*
+=================
+R_RadixCount
+
+Counts the byte of the next pass in a range, once the earlier
+passes have moved the keys around
+=================
+*/
+static void R_RadixCount( void *data, int range ) {
+	int			*counts;
+	int			shift;
+	int			i, start, end;
+
+	counts = radix.counts[range][radix.pass];
+	Com_Memset( counts, 0, sizeof( radix.counts[0][0] ) );
+
+	shift = radix.pass * 8;
+	R_RadixRange( range, &start, &end );
+	for ( i = start ; i < end ; i++ ) {
+		counts[( radix.keys[i] >> shift ) & 255]++;
+	}
+}
+
+/*
+=================
+R_RadixScatter
+=================
+*/
+static void R_RadixScatter( void *data, int range ) {
+	int			*offsets;
+	unsigned	key;
+	int			shift;
+	int			i, start, end, o;
+
+	offsets = radix.offsets[range];
+	shift = radix.pass * 8;
+
+	R_RadixRange( range, &start, &end );
+	for ( i = start ; i < end ; i++ ) {
+		key = radix.keys[i];
+		o = offsets[( key >> shift ) & 255]++;
+		radix.outKeys[o] = key;
+		radix.outIndexes[o] = radix.indexes[i];
+	}
+}
+
+/*
+=================
+R_RadixSort
+
+Sorts the keys in ascending order, moving the indexes along with them
+and keeping equal keys in the order they were in.  The temp arrays
+have to be as big as the key and index arrays, the sorted keys and
+indexes always end up in the key and index arrays.
+
+Returns the number of passes that were needed.
+=================
+*/
+int R_RadixSort( unsigned *keys, int *indexes, unsigned *tempKeys, int *tempIndexes, int count, int numThreads ) {
+	int		total[256];
+	int		i, b, r, pass, numPasses;
+	int		sum;
+	qboolean	counted;
+
+	if ( count < 2 ) {
+		return 0;
+	}
+
+	radix.count = count;
+	radix.numRanges = 1;
+	if ( count >= RADIX_MIN_PARALLEL && numThreads > 1 ) {
+		radix.numRanges = numThreads < RADIX_MAX_RANGES ? numThreads : RADIX_MAX_RANGES;
+	}
+
+	radix.keys = keys;
+	radix.indexes = indexes;
+	radix.outKeys = tempKeys;
+	radix.outIndexes = tempIndexes;
+
+	ri.ParallelFor( radix.numRanges, R_RadixCountAll, NULL, radix.numRanges );
+
+	counted = qtrue;
+	numPasses = 0;
+	for ( pass = 0 ; pass < 4 ; pass++ ) {
+		radix.pass = pass;
+
+		// the total of each bucket doesn't depend on the order
+		Com_Memset( total, 0, sizeof( total ) );
+		for ( r = 0 ; r < radix.numRanges ; r++ ) {
+			for ( b = 0 ; b < 256 ; b++ ) {
+				total[b] += radix.counts[r][pass][b];
+			}
+		}
+
+		// skip the pass if all the keys are in one bucket
+		for ( b = 0 ; b < 256 ; b++ ) {
+			if ( total[b] ) {
+				break;
+			}
+		}
+		if ( total[b] == count ) {
+			continue;
+		}
+
+		// the ranges were counted before the keys moved
+		if ( !counted && radix.numRanges > 1 ) {
+			ri.ParallelFor( radix.numRanges, R_RadixCount, NULL, radix.numRanges );
+		}
+		counted = qfalse;
+
+		// each range goes after the earlier ranges in every bucket
+		sum = 0;
+		for ( b = 0 ; b < 256 ; b++ ) {
+			for ( r = 0 ; r < radix.numRanges ; r++ ) {
+				radix.offsets[r][b] = sum;
+				sum += radix.counts[r][pass][b];
+			}
+		}
+
+		ri.ParallelFor( radix.numRanges, R_RadixScatter, NULL, radix.numRanges );
+		numPasses++;
+
+		// swap the buffers
+		radix.keys = radix.outKeys;
+		radix.indexes = radix.outIndexes;
+		if ( radix.outKeys == tempKeys ) {
+			radix.outKeys = keys;
+			radix.outIndexes = indexes;
+		} else {
+			radix.outKeys = tempKeys;
+			radix.outIndexes = tempIndexes;
+		}
+	}
+
+	if ( radix.keys != keys ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			keys[i] = tempKeys[i];
+			indexes[i] = tempIndexes[i];
+		}
+	}
+
+	return numPasses;
+}
+
+/*
+=============================================================================
+
+SORT BENCHMARK
+
+=============================================================================
+*/
+
+/*
+=================
+R_CompareSortKeys
+
+Reference order for sortbench, qsort isn't stable so the index
+breaks ties
+=================
+*/
+static int R_CompareSortKeys( const void *a, const void *b ) {
+	const unsigned	*ka = (const unsigned *)a;
+	const unsigned	*kb = (const unsigned *)b;
+
+	if ( ka[0] != kb[0] ) {
+		return ( ka[0] < kb[0] ) ? -1 : 1;
+	}
+	return (int)ka[1] - (int)kb[1];
+}
+
+/*
+=================
+R_SortBench_f
+
+Sorts draw surface keys made up from the loaded shaders with qsort and
+with R_RadixSort on one thread and on the worker pool, timing them and
+checking that they all give the same order
+=================
+*/
+void R_SortBench_f( void ) {
+	unsigned	*keys, *sorted, *pairs;
+	int			*indexes, *tempIndexes;
+	unsigned	*tempKeys;
+	int			count, repeats, numThreads;
+	int			i, j, pass, numPasses, entityNum;
+	uint64_t	start, usec[3];
+	shader_t	*shader;
+
+	count = 20000;
+	if ( ri.Cmd_Argc() > 1 ) {
+		count = atoi( ri.Cmd_Argv( 1 ) );
+		if ( count < 1 ) {
+			count = 1;
+		} else if ( count > MAX_DRAWSURFS ) {
+			count = MAX_DRAWSURFS;
+		}
+	}
+	repeats = 10;
+	if ( ri.Cmd_Argc() > 2 ) {
+		repeats = atoi( ri.Cmd_Argv( 2 ) );
+		if ( repeats < 1 ) {
+			repeats = 1;
+		}
+	}
+
+	keys = ri.Malloc( count * sizeof( *keys ) );
+	sorted = ri.Malloc( count * sizeof( *sorted ) );
+	pairs = ri.Malloc( count * 2 * sizeof( *pairs ) );
+	indexes = ri.Malloc( count * sizeof( *indexes ) );
+	tempKeys = ri.Malloc( count * sizeof( *tempKeys ) );
+	tempIndexes = ri.Malloc( count * sizeof( *tempIndexes ) );
+
+	// mostly world surfaces, some entities, a few fogged and dlit
+	srand( 1 );
+	for ( i = 0 ; i < count ; i++ ) {
+		shader = tr.shaders[ rand() % tr.numShaders ];
+		entityNum = ( rand() & 7 ) ? ENTITYNUM_WORLD : rand() & 63;
+		keys[i] = ( shader->sortedIndex << QSORT_SHADERNUM_SHIFT )
+			| ( entityNum << QSORT_ENTITYNUM_SHIFT )
+			| ( ( ( rand() & 15 ) == 0 ) << QSORT_FOGNUM_SHIFT )
+			| ( ( rand() & 15 ) == 0 );
+	}
+
+	// the reference
+	start = ri.Microseconds();
+	for ( j = 0 ; j < repeats ; j++ ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			pairs[i*2] = keys[i];
+			pairs[i*2+1] = i;
+		}
+		qsort( pairs, count, sizeof( *pairs ) * 2, R_CompareSortKeys );
+	}
+	usec[0] = ri.Microseconds() - start;
+
+	numThreads = ri.WorkerThreads( -1 );
+	numPasses = 0;
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		start = ri.Microseconds();
+		for ( j = 0 ; j < repeats ; j++ ) {
+			for ( i = 0 ; i < count ; i++ ) {
+				sorted[i] = keys[i];
+				indexes[i] = i;
+			}
+			numPasses = R_RadixSort( sorted, indexes, tempKeys, tempIndexes, count, pass ? numThreads : 1 );
+		}
+		usec[1+pass] = ri.Microseconds() - start;
+
+		for ( i = 0 ; i < count ; i++ ) {
+			if ( sorted[i] != pairs[i*2] || indexes[i] != (int)pairs[i*2+1] ) {
+				ri.Printf( PRINT_WARNING, "sortbench: %s sort differs from qsort at %i\n",
+					pass ? "threaded" : "single thread", i );
+				break;
+			}
+		}
+	}
+
+	ri.Printf( PRINT_ALL, "%i keys, %i of 4 radix passes, %i repeats\n", count, numPasses, repeats );
+	ri.Printf( PRINT_ALL, "qsort         %8.3f msec\n", usec[0] / ( 1000.0f * repeats ) );
+	ri.Printf( PRINT_ALL, "radix         %8.3f msec\n", usec[1] / ( 1000.0f * repeats ) );
+	ri.Printf( PRINT_ALL, "radix %2i thr  %8.3f msec%s\n", numThreads, usec[2] / ( 1000.0f * repeats ),
+		count < RADIX_MIN_PARALLEL ? " (too few keys to split)" : "" );
+
+	ri.Free( tempIndexes );
+	ri.Free( tempKeys );
+	ri.Free( indexes );
+	ri.Free( pairs );
+	ri.Free( sorted );
+	ri.Free( keys );
+}
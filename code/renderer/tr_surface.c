@@ -66,6 +66,53 @@ void RB_CheckOverflow( int verts, int indexes ) {
 	RB_BeginSurface(tess.shader, tess.fogNum );
 }
 
+/*
+==============
+RB_SurfaceVBO
+
+Adds a surface that is in the world vertex buffer as an index range
+if the current shader can draw it from there, returns qfalse if it
+has to be copied into tess like any other surface.
+==============
+*/
+qboolean RB_SurfaceVBO( int firstIndex, int numIndexes, int dlightBits ) {
+	int		*range;
+
+	// dynamic lights and fog are projected from tess.xyz, and
+	// the debugging views and greyscale work on tess as well
+	if ( !tess.shader->staticVertexes || dlightBits || tess.fogNum
+		|| r_greyscale->integer || r_showtris->integer || r_shownormals->integer ) {
+		backEnd.pc.c_vboCopied++;
+		return qfalse;
+	}
+
+	backEnd.pc.c_vboSurfaces++;
+
+	// join it up with the previous surface if it comes right after it
+	range = NULL;
+	if ( tess.numVBORanges ) {
+		range = tess.vboRanges[ tess.numVBORanges - 1 ];
+		if ( range[0] + range[1] != firstIndex ) {
+			range = NULL;
+		}
+	}
+
+	if ( range ) {
+		range[1] += numIndexes;
+	} else {
+		if ( tess.numVBORanges == MAX_VBO_RANGES ) {
+			RB_EndSurface();
+			RB_BeginSurface( tess.shader, tess.fogNum );
+		}
+		range = tess.vboRanges[ tess.numVBORanges++ ];
+		range[0] = firstIndex;
+		range[1] = numIndexes;
+	}
+	tess.numVBOIndexes += numIndexes;
+
+	return qtrue;
+}
+
 
 /*
 ==============
@@ -232,6 +279,11 @@ void RB_SurfaceTriangles( srfTriangles_t *srf ) {
 	qboolean	needsNormal;
 
 	dlightBits = srf->dlightBits[backEnd.smpFrame];
+
+	if ( srf->vboNumIndexes && RB_SurfaceVBO( srf->vboFirstIndex, srf->vboNumIndexes, dlightBits ) ) {
+		return;
+	}
+
 	tess.dlightBits |= dlightBits;
 
 	RB_CHECKOVERFLOW( srf->numVerts, srf->numIndexes );
@@ -913,9 +965,14 @@ void RB_SurfaceFace( srfSurfaceFace_t *surf ) {
 	int			numPoints;
 	int			dlightBits;
 
+	dlightBits = surf->dlightBits[backEnd.smpFrame];
+
+	if ( surf->vboNumIndexes && RB_SurfaceVBO( surf->vboFirstIndex, surf->vboNumIndexes, dlightBits ) ) {
+		return;
+	}
+
 	RB_CHECKOVERFLOW( surf->numPoints, surf->numIndices );
 
-	dlightBits = surf->dlightBits[backEnd.smpFrame];
 	tess.dlightBits |= dlightBits;
 
 	indices = ( unsigned * ) ( ( ( char  * ) surf ) + surf->ofsIndices );
@@ -151,7 +151,8 @@ typedef enum {
 */
 typedef enum {
 	TC_NONE,
-	TC_S3TC
+	TC_S3TC,
+	TC_S3TC_ARB		// GL_EXT_texture_compression_s3tc, can read the compressed levels back
 } textureCompression_t;
 
 typedef enum {
@@ -0,0 +1,254 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_vbo.c -- static world geometry in vertex buffer objects
+
+#include "tr_local.h"
+
+/*
+=============================================================================
+
+WORLD VERTEX BUFFERS
+
+With GL_ARB_vertex_buffer_object, the faces and triangle surfaces of the
+world and its brush models are put in one vertex buffer and one index
+buffer when the map is loaded.  The surfaces are grouped by shader, and
+each shader already has a single lightmap, so the surfaces a batch draws
+are mostly next to each other in the buffers.
+
+When the shader of a batch has staticVertexes set, RB_SurfaceFace and
+RB_SurfaceTriangles only add the index range of the surface to tess, and
+RB_EndSurface draws the ranges straight from the buffers.  Everything
+else, including surfaces with dynamic lights or fog, is still copied
+into tess every frame.
+
+=============================================================================
+*/
+
+/*
+=================
+R_VBOSurfaceSize
+
+Gets the vertexes and indexes of a surface that can go in the
+vertex buffer, returns qfalse for any other surface
+=================
+*/
+static qboolean R_VBOSurfaceSize( const msurface_t *surf, int *numVertexes, int *numIndexes ) {
+	if ( !surf->shader->staticVertexes ) {
+		return qfalse;
+	}
+
+	switch ( *surf->data ) {
+	case SF_FACE:
+		*numVertexes = ((srfSurfaceFace_t *)surf->data)->numPoints;
+		*numIndexes = ((srfSurfaceFace_t *)surf->data)->numIndices;
+		break;
+	case SF_TRIANGLES:
+		*numVertexes = ((srfTriangles_t *)surf->data)->numVerts;
+		*numIndexes = ((srfTriangles_t *)surf->data)->numIndexes;
+		break;
+	default:
+		return qfalse;
+	}
+
+	return ( *numIndexes > 0 );
+}
+
+/*
+=================
+R_CompareVBOSurfaces
+
+Groups the surfaces by shader, keeping the map order within a shader
+=================
+*/
+static int R_CompareVBOSurfaces( const void *a, const void *b ) {
+	const msurface_t	*sa = *(const msurface_t **)a;
+	const msurface_t	*sb = *(const msurface_t **)b;
+
+	if ( sa->shader->index != sb->shader->index ) {
+		return sa->shader->index - sb->shader->index;
+	}
+	return ( sa < sb ) ? -1 : ( sa > sb );
+}
+
+/*
+=================
+R_BuildWorldVBO
+
+Called by RE_LoadWorldMap once tr.world is set
+=================
+*/
+void R_BuildWorldVBO( void ) {
+	world_t				*w;
+	msurface_t			**surfs;
+	msurface_t			*surf;
+	srfSurfaceFace_t	*face;
+	srfTriangles_t		*tri;
+	vboVert_t			*verts, *vert;
+	glIndex_t			*indexes;
+	int					*faceIndexes;
+	float				*point;
+	drawVert_t			*dv;
+	int					numSurfs, numVertexes, numIndexes;
+	int					surfVertexes, surfIndexes;
+	int					i, j;
+
+	w = tr.world;
+	if ( !w || !qglBindBufferARB ) {
+		return;
+	}
+
+	//
+	// gather the surfaces whose shaders can be drawn from the buffers
+	//
+	surfs = ri.Hunk_AllocateTempMemory( w->numsurfaces * sizeof( *surfs ) );
+	numSurfs = 0;
+	numVertexes = 0;
+	numIndexes = 0;
+	for ( i = 0, surf = w->surfaces ; i < w->numsurfaces ; i++, surf++ ) {
+		if ( !R_VBOSurfaceSize( surf, &surfVertexes, &surfIndexes ) ) {
+			continue;
+		}
+		surfs[numSurfs++] = surf;
+		numVertexes += surfVertexes;
+		numIndexes += surfIndexes;
+	}
+
+	if ( !numSurfs ) {
+		ri.Hunk_FreeTempMemory( surfs );
+		return;
+	}
+
+	qsort( surfs, numSurfs, sizeof( *surfs ), R_CompareVBOSurfaces );
+
+	//
+	// lay out the vertexes and indexes
+	//
+	verts = ri.Hunk_AllocateTempMemory( numVertexes * sizeof( *verts ) );
+	indexes = ri.Hunk_AllocateTempMemory( numIndexes * sizeof( *indexes ) );
+	numVertexes = 0;
+	numIndexes = 0;
+
+	for ( i = 0 ; i < numSurfs ; i++ ) {
+		surf = surfs[i];
+		vert = verts + numVertexes;
+
+		if ( *surf->data == SF_FACE ) {
+			face = (srfSurfaceFace_t *)surf->data;
+			faceIndexes = (int *)( (byte *)face + face->ofsIndices );
+
+			face->vboFirstIndex = numIndexes;
+			face->vboNumIndexes = face->numIndices;
+			for ( j = 0 ; j < face->numIndices ; j++ ) {
+				indexes[numIndexes++] = numVertexes + faceIndexes[j];
+			}
+
+			for ( j = 0, point = face->points[0] ; j < face->numPoints ; j++, point += VERTEXSIZE, vert++ ) {
+				VectorCopy( point, vert->xyz );
+				vert->st[0] = point[3];
+				vert->st[1] = point[4];
+				vert->lightmap[0] = point[5];
+				vert->lightmap[1] = point[6];
+				*(unsigned *)vert->color = *(unsigned *)&point[7];
+			}
+			numVertexes += face->numPoints;
+		} else {
+			tri = (srfTriangles_t *)surf->data;
+
+			tri->vboFirstIndex = numIndexes;
+			tri->vboNumIndexes = tri->numIndexes;
+			for ( j = 0 ; j < tri->numIndexes ; j++ ) {
+				indexes[numIndexes++] = numVertexes + tri->indexes[j];
+			}
+
+			for ( j = 0, dv = tri->verts ; j < tri->numVerts ; j++, dv++, vert++ ) {
+				VectorCopy( dv->xyz, vert->xyz );
+				vert->st[0] = dv->st[0];
+				vert->st[1] = dv->st[1];
+				vert->lightmap[0] = dv->lightmap[0];
+				vert->lightmap[1] = dv->lightmap[1];
+				*(unsigned *)vert->color = *(unsigned *)dv->color;
+			}
+			numVertexes += tri->numVerts;
+		}
+	}
+
+	//
+	// upload them
+	//
+	R_SyncRenderThread();
+
+	qglGenBuffersARB( 1, &w->vertexBuffer );
+	qglBindBufferARB( GL_ARRAY_BUFFER_ARB, w->vertexBuffer );
+	qglBufferDataARB( GL_ARRAY_BUFFER_ARB, numVertexes * sizeof( *verts ), verts, GL_STATIC_DRAW_ARB );
+	qglBindBufferARB( GL_ARRAY_BUFFER_ARB, 0 );
+
+	qglGenBuffersARB( 1, &w->indexBuffer );
+	qglBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, w->indexBuffer );
+	qglBufferDataARB( GL_ELEMENT_ARRAY_BUFFER_ARB, numIndexes * sizeof( *indexes ), indexes, GL_STATIC_DRAW_ARB );
+	qglBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, 0 );
+
+	GL_CheckErrors();
+
+	w->numVBOSurfaces = numSurfs;
+
+	ri.Hunk_FreeTempMemory( indexes );
+	ri.Hunk_FreeTempMemory( verts );
+	ri.Hunk_FreeTempMemory( surfs );
+
+	ri.Printf( PRINT_ALL, "...%i surfaces in vertex buffers, %i verts %i tris\n",
+		numSurfs, numVertexes, numIndexes / 3 );
+}
+
+/*
+=================
+R_FreeWorldVBO
+
+Has to be done before the hunk memory of the world goes away
+=================
+*/
+void R_FreeWorldVBO( void ) {
+	world_t		*w;
+	msurface_t	*surf;
+	int			i;
+
+	w = tr.world;
+	if ( !w || !w->numVBOSurfaces ) {
+		return;
+	}
+
+	if ( qglDeleteBuffersARB ) {
+		qglDeleteBuffersARB( 1, &w->vertexBuffer );
+		qglDeleteBuffersARB( 1, &w->indexBuffer );
+	}
+	w->vertexBuffer = 0;
+	w->indexBuffer = 0;
+
+	// the surfaces are drawn from tess if the world is still used
+	for ( i = 0, surf = w->surfaces ; i < w->numsurfaces ; i++, surf++ ) {
+		if ( *surf->data == SF_FACE ) {
+			((srfSurfaceFace_t *)surf->data)->vboNumIndexes = 0;
+		} else if ( *surf->data == SF_TRIANGLES ) {
+			((srfTriangles_t *)surf->data)->vboNumIndexes = 0;
+		}
+	}
+	w->numVBOSurfaces = 0;
+}
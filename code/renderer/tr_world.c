@@ -276,6 +276,23 @@ static int R_DlightSurface( msurface_t *surf, int dlightBits ) {
 
 
 
+/*
+======================
+R_AddVisibleWorldSurface
+
+The surface has been added to this view and wasn't culled
+======================
+*/
+static void R_AddVisibleWorldSurface( msurface_t *surf, int dlightBits ) {
+	// check for dlighting
+	if ( dlightBits ) {
+		dlightBits = R_DlightSurface( surf, dlightBits );
+		dlightBits = ( dlightBits != 0 );
+	}
+
+	R_AddDrawSurf( surf->data, surf->shader, surf->fogIndex, dlightBits );
+}
+
 /*
 ======================
 R_AddWorldSurface
@@ -294,13 +311,7 @@ static void R_AddWorldSurface( msurface_t *surf, int dlightBits ) {
 		return;
 	}
 
-	// check for dlighting
-	if ( dlightBits ) {
-		dlightBits = R_DlightSurface( surf, dlightBits );
-		dlightBits = ( dlightBits != 0 );
-	}
-
-	R_AddDrawSurf( surf->data, surf->shader, surf->fogIndex, dlightBits );
+	R_AddVisibleWorldSurface( surf, dlightBits );
 }
 
 /*
@@ -350,65 +361,214 @@ void R_AddBrushModelSurfaces ( trRefEntity_t *ent ) {
 
 /*
 ================
-R_RecursiveWorldNode
+R_CullWorldNode
+
+Returns qtrue if nothing below the node can be visible, otherwise
+clears the frustum planes it is completely in front of from planeBits
 ================
 */
-static void R_RecursiveWorldNode( mnode_t *node, int planeBits, int dlightBits ) {
+static qboolean R_CullWorldNode( mnode_t *node, int *planeBits ) {
+	int		i, r;
 
-	do {
-		int			newDlights[2];
+	// if the node wasn't marked as potentially visible, exit
+	if (node->visframe != tr.visCount) {
+		return qtrue;
+	}
 
-		// if the node wasn't marked as potentially visible, exit
-		if (node->visframe != tr.visCount) {
-			return;
+	// if the bounding volume is outside the frustum, nothing
+	// inside can be visible OPTIMIZE: don't do this all the way to leafs?
+
+	if ( r_nocull->integer ) {
+		return qfalse;
+	}
+
+	for ( i = 0 ; i < 4 ; i++ ) {
+		if ( *planeBits & ( 1 << i ) ) {
+			r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[i]);
+			if (r == 2) {
+				return qtrue;				// culled
+			}
+			if ( r == 1 ) {
+				*planeBits &= ~( 1 << i );	// all descendants will also be in front
+			}
 		}
+	}
 
-		// if the bounding volume is outside the frustum, nothing
-		// inside can be visible OPTIMIZE: don't do this all the way to leafs?
+	return qfalse;
+}
 
-		if ( !r_nocull->integer ) {
-			int		r;
+/*
+================
+R_WorldNodeDlights
 
-			if ( planeBits & 1 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[0]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~1;			// all descendants will also be in front
-				}
-			}
+Determines which dlights are needed on each side of a node
+================
+*/
+static void R_WorldNodeDlights( const mnode_t *node, int dlightBits, int newDlights[2] ) {
+	int			i;
+	dlight_t	*dl;
+	float		dist;
 
-			if ( planeBits & 2 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[1]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~2;			// all descendants will also be in front
-				}
-			}
+	newDlights[0] = 0;
+	newDlights[1] = 0;
+	if ( !dlightBits ) {
+		return;
+	}
 
-			if ( planeBits & 4 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[2]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~4;			// all descendants will also be in front
-				}
+	for ( i = 0 ; i < tr.refdef.num_dlights ; i++ ) {
+		if ( dlightBits & ( 1 << i ) ) {
+			dl = &tr.refdef.dlights[i];
+			dist = DotProduct( dl->origin, node->plane->normal ) - node->plane->dist;
+			
+			if ( dist > -dl->radius ) {
+				newDlights[0] |= ( 1 << i );
+			}
+			if ( dist < dl->radius ) {
+				newDlights[1] |= ( 1 << i );
 			}
+		}
+	}
+}
+
+/*
+=============================================================
 
-			if ( planeBits & 8 ) {
-				r = BoxOnPlaneSide(node->mins, node->maxs, &tr.viewParms.frustum[3]);
-				if (r == 2) {
-					return;						// culled
-				}
-				if ( r == 1 ) {
-					planeBits &= ~8;			// all descendants will also be in front
-				}
+	FRONT END JOBS
+
+With r_frontEndThreads, the top WORLD_JOB_DEPTH levels of the tree are
+walked on the calling thread and the visible subtrees below them are
+handed to the worker pool, in the order R_RecursiveWorldNode would have
+reached them.  A job culls its nodes and the faces and triangle surfaces
+of its leafs, and writes the mark surfaces it finds to its own part of
+tr.world->surfRefs, which is as big as all the marksurfaces under the
+subtree.
+
+The jobs are then merged in order on the calling thread.  A surface is
+added the first time it is seen, as it is by the serial walk, so the
+draw surfaces and the counters come out the same either way.  Curves
+are culled in the merge because R_CullGrid counts what it does, and
+dlights are always checked there since they are stored per surface.
+
+=============================================================
+*/
+
+#define	WORLD_JOB_DEPTH		6
+#define	MAX_WORLD_JOBS		( 1 << WORLD_JOB_DEPTH )
+
+typedef struct {
+	mnode_t			*node;
+	int				planeBits;
+	int				dlightBits;
+
+	worldSurfRef_t	*refs;
+	int				numRefs;
+	int				numLeafs;
+	vec3_t			visBounds[2];
+} worldJob_t;
+
+static worldJob_t	worldJobs[MAX_WORLD_JOBS];
+static int			numWorldJobs;
+static int			numWorldRefs;
+
+/*
+================
+R_AddWorldJobLeaf
+================
+*/
+static void R_AddWorldJobLeaf( worldJob_t *job, mnode_t *node, int dlightBits ) {
+	int				c;
+	msurface_t		**mark;
+	worldSurfRef_t	*ref;
+
+	job->numLeafs++;
+
+	// add to z buffer bounds
+	AddPointToBounds( node->mins, job->visBounds[0], job->visBounds[1] );
+	AddPointToBounds( node->maxs, job->visBounds[0], job->visBounds[1] );
+
+	mark = node->firstmarksurface;
+	c = node->nummarksurfaces;
+	while (c--) {
+		ref = &job->refs[job->numRefs++];
+		ref->surf = *mark;
+		ref->dlightBits = dlightBits;
+
+		switch ( *ref->surf->data ) {
+		case SF_FACE:
+		case SF_TRIANGLES:
+			if ( R_CullSurface( ref->surf->data, ref->surf->shader ) ) {
+				ref->state = SURFREF_CULLED;
+			} else {
+				ref->state = SURFREF_VISIBLE;
 			}
+			break;
+		default:
+			ref->state = SURFREF_UNTESTED;
+			break;
+		}
+		mark++;
+	}
+}
+
+/*
+================
+R_AddWorldLeaf
+================
+*/
+static void R_AddWorldLeaf( mnode_t *node, int dlightBits ) {
+	// leaf node, so add mark surfaces
+	int			c;
+	msurface_t	*surf, **mark;
+
+	tr.pc.c_leafs++;
+
+	// add to z buffer bounds
+	if ( node->mins[0] < tr.viewParms.visBounds[0][0] ) {
+		tr.viewParms.visBounds[0][0] = node->mins[0];
+	}
+	if ( node->mins[1] < tr.viewParms.visBounds[0][1] ) {
+		tr.viewParms.visBounds[0][1] = node->mins[1];
+	}
+	if ( node->mins[2] < tr.viewParms.visBounds[0][2] ) {
+		tr.viewParms.visBounds[0][2] = node->mins[2];
+	}
+
+	if ( node->maxs[0] > tr.viewParms.visBounds[1][0] ) {
+		tr.viewParms.visBounds[1][0] = node->maxs[0];
+	}
+	if ( node->maxs[1] > tr.viewParms.visBounds[1][1] ) {
+		tr.viewParms.visBounds[1][1] = node->maxs[1];
+	}
+	if ( node->maxs[2] > tr.viewParms.visBounds[1][2] ) {
+		tr.viewParms.visBounds[1][2] = node->maxs[2];
+	}
+
+	// add the individual surfaces
+	mark = node->firstmarksurface;
+	c = node->nummarksurfaces;
+	while (c--) {
+		// the surface may have already been added if it
+		// spans multiple leafs
+		surf = *mark;
+		R_AddWorldSurface( surf, dlightBits );
+		mark++;
+	}
+}
+
+/*
+================
+R_RecursiveWorldNode
+
+If job is set, the leafs are added to it instead of the view
+================
+*/
+static void R_RecursiveWorldNode( mnode_t *node, int planeBits, int dlightBits, worldJob_t *job ) {
 
+	do {
+		int			newDlights[2];
+
+		if ( R_CullWorldNode( node, &planeBits ) ) {
+			return;
 		}
 
 		if ( node->contents != -1 ) {
@@ -419,80 +579,114 @@ static void R_RecursiveWorldNode( mnode_t *node, int planeBits, int dlightBits )
 		// since we don't care about sort orders, just go positive to negative
 
 		// determine which dlights are needed
-		newDlights[0] = 0;
-		newDlights[1] = 0;
-		if ( dlightBits ) {
-			int	i;
-
-			for ( i = 0 ; i < tr.refdef.num_dlights ; i++ ) {
-				dlight_t	*dl;
-				float		dist;
-
-				if ( dlightBits & ( 1 << i ) ) {
-					dl = &tr.refdef.dlights[i];
-					dist = DotProduct( dl->origin, node->plane->normal ) - node->plane->dist;
-					
-					if ( dist > -dl->radius ) {
-						newDlights[0] |= ( 1 << i );
-					}
-					if ( dist < dl->radius ) {
-						newDlights[1] |= ( 1 << i );
-					}
-				}
-			}
-		}
+		R_WorldNodeDlights( node, dlightBits, newDlights );
 
 		// recurse down the children, front side first
-		R_RecursiveWorldNode (node->children[0], planeBits, newDlights[0] );
+		R_RecursiveWorldNode (node->children[0], planeBits, newDlights[0], job );
 
 		// tail recurse
 		node = node->children[1];
 		dlightBits = newDlights[1];
 	} while ( 1 );
 
-	{
-		// leaf node, so add mark surfaces
-		int			c;
-		msurface_t	*surf, **mark;
+	if ( job ) {
+		R_AddWorldJobLeaf( job, node, dlightBits );
+	} else {
+		R_AddWorldLeaf( node, dlightBits );
+	}
+}
 
-		tr.pc.c_leafs++;
+/*
+================
+R_SplitWorldNode
 
-		// add to z buffer bounds
-		if ( node->mins[0] < tr.viewParms.visBounds[0][0] ) {
-			tr.viewParms.visBounds[0][0] = node->mins[0];
-		}
-		if ( node->mins[1] < tr.viewParms.visBounds[0][1] ) {
-			tr.viewParms.visBounds[0][1] = node->mins[1];
-		}
-		if ( node->mins[2] < tr.viewParms.visBounds[0][2] ) {
-			tr.viewParms.visBounds[0][2] = node->mins[2];
-		}
+Walks the top of the tree like R_RecursiveWorldNode, making a job
+of each visible node depth levels down and of any leaf above that
+================
+*/
+static void R_SplitWorldNode( mnode_t *node, int planeBits, int dlightBits, int depth ) {
+	worldJob_t	*job;
+	int			newDlights[2];
 
-		if ( node->maxs[0] > tr.viewParms.visBounds[1][0] ) {
-			tr.viewParms.visBounds[1][0] = node->maxs[0];
+	do {
+		if ( !depth || node->contents != -1 ) {
+			// the job does the culling again, it's cheap
+			job = &worldJobs[numWorldJobs++];
+			job->node = node;
+			job->planeBits = planeBits;
+			job->dlightBits = dlightBits;
+			job->refs = tr.world->surfRefs + numWorldRefs;
+			numWorldRefs += node->numSubtreeSurfaces;
+			return;
 		}
-		if ( node->maxs[1] > tr.viewParms.visBounds[1][1] ) {
-			tr.viewParms.visBounds[1][1] = node->maxs[1];
+
+		if ( R_CullWorldNode( node, &planeBits ) ) {
+			return;
 		}
-		if ( node->maxs[2] > tr.viewParms.visBounds[1][2] ) {
-			tr.viewParms.visBounds[1][2] = node->maxs[2];
+
+		R_WorldNodeDlights( node, dlightBits, newDlights );
+
+		R_SplitWorldNode( node->children[0], planeBits, newDlights[0], depth - 1 );
+
+		node = node->children[1];
+		dlightBits = newDlights[1];
+		depth--;
+	} while ( 1 );
+}
+
+/*
+================
+R_WorldJob
+================
+*/
+static void R_WorldJob( void *data, int index ) {
+	worldJob_t	*job;
+
+	job = (worldJob_t *)data + index;
+	job->numRefs = 0;
+	job->numLeafs = 0;
+	ClearBounds( job->visBounds[0], job->visBounds[1] );
+
+	R_RecursiveWorldNode( job->node, job->planeBits, job->dlightBits, job );
+}
+
+/*
+================
+R_MergeWorldJobs
+================
+*/
+static void R_MergeWorldJobs( void ) {
+	worldJob_t		*job;
+	worldSurfRef_t	*ref;
+	int				i, j;
+
+	for ( i = 0, job = worldJobs ; i < numWorldJobs ; i++, job++ ) {
+		if ( !job->numLeafs ) {
+			continue;
 		}
 
-		// add the individual surfaces
-		mark = node->firstmarksurface;
-		c = node->nummarksurfaces;
-		while (c--) {
-			// the surface may have already been added if it
-			// spans multiple leafs
-			surf = *mark;
-			R_AddWorldSurface( surf, dlightBits );
-			mark++;
+		tr.pc.c_leafs += job->numLeafs;
+		AddPointToBounds( job->visBounds[0], tr.viewParms.visBounds[0], tr.viewParms.visBounds[1] );
+		AddPointToBounds( job->visBounds[1], tr.viewParms.visBounds[0], tr.viewParms.visBounds[1] );
+
+		for ( j = 0, ref = job->refs ; j < job->numRefs ; j++, ref++ ) {
+			if ( ref->state == SURFREF_UNTESTED ) {
+				R_AddWorldSurface( ref->surf, ref->dlightBits );
+				continue;
+			}
+
+			if ( ref->surf->viewCount == tr.viewCount ) {
+				continue;		// already in this view
+			}
+			ref->surf->viewCount = tr.viewCount;
+
+			if ( ref->state == SURFREF_VISIBLE ) {
+				R_AddVisibleWorldSurface( ref->surf, ref->dlightBits );
+			}
 		}
 	}
-
 }
 
-
 /*
 ===============
 R_PointInLeaf
@@ -556,6 +750,327 @@ qboolean R_inPVS( const vec3_t p1, const vec3_t p2 ) {
 	return qtrue;
 }
 
+/*
+=============================================================
+
+	VISIBILITY CACHE
+
+With r_visCache, the leafs R_MarkLeaves marks are remembered for the
+last VIS_CACHE_SIZE clusters and areamasks, so going back to one of
+them, which a portal or mirror view does every frame, only has to mark
+the parents of its leafs again.
+
+The frustum is then tested against the leafs of the cluster instead of
+walking the tree down to them.  Each leaf keeps its result along with
+how far it is from changing, measured against the frustum of the last
+time all the leafs were tested.  A leaf only has to be tested again if
+the frustum has moved further than that since, which for small camera
+motion is just the leafs near the edges of the view.  Once too many
+have to be tested, they are all tested against the current frustum.
+
+The leafs are kept in the order R_RecursiveWorldNode reaches them and
+their dlights are worked out from their parents, so the surfaces are
+added exactly as they would be by walking the tree.
+
+=============================================================
+*/
+
+#define	VIS_CACHE_SIZE		4
+#define	VIS_CACHE_EPSILON	1.0f	// for the rounding in the motion estimate
+
+typedef struct {
+	mnode_t		*leaf;
+	float		radius;			// farthest corner from the reference origin
+	float		slack;			// how far the frustum can move before the result changes
+	qboolean	culled;
+} visLeaf_t;
+
+typedef struct {
+	qboolean	valid;
+	int			cluster;
+	qboolean	novis;
+	byte		areamask[MAX_MAP_AREA_BYTES];
+	int			lastUsed;
+
+	visLeaf_t	*leafs;			// tr.world->numnodes - numDecisionNodes allocated
+	int			numLeafs;
+
+	qboolean	referenced;		// leafs have been tested against the frustum below
+	qboolean	rebase;			// test them all against the next frustum
+	vec3_t		origin;
+	cplane_t	frustum[4];
+} visCacheEntry_t;
+
+static visCacheEntry_t	visCache[VIS_CACHE_SIZE];
+static visCacheEntry_t	*visCurrent;		// entry the marked leafs are in
+static int				visCacheUses;
+
+/*
+=================
+R_FreeVisCache
+
+Called when the world goes away
+=================
+*/
+void R_FreeVisCache( void ) {
+	int		i;
+
+	for ( i = 0 ; i < VIS_CACHE_SIZE ; i++ ) {
+		if ( visCache[i].leafs ) {
+			ri.Free( visCache[i].leafs );
+		}
+	}
+	Com_Memset( visCache, 0, sizeof( visCache ) );
+	visCurrent = NULL;
+}
+
+/*
+=================
+R_RestoreVisCache
+
+Marks the leafs of the current cluster again if they are in the cache
+=================
+*/
+static qboolean R_RestoreVisCache( int cluster ) {
+	visCacheEntry_t	*entry;
+	mnode_t			*parent;
+	int				i, j;
+
+	for ( i = 0, entry = visCache ; i < VIS_CACHE_SIZE ; i++, entry++ ) {
+		if ( entry->valid && entry->cluster == cluster
+			&& entry->novis == ( r_novis->integer != 0 )
+			&& !memcmp( entry->areamask, tr.refdef.areamask, sizeof( entry->areamask ) ) ) {
+			break;
+		}
+	}
+	if ( i == VIS_CACHE_SIZE ) {
+		tr.pc.c_visCacheMisses++;
+		return qfalse;
+	}
+
+	for ( j = 0 ; j < entry->numLeafs ; j++ ) {
+		parent = entry->leafs[j].leaf;
+		do {
+			if (parent->visframe == tr.visCount)
+				break;
+			parent->visframe = tr.visCount;
+			parent = parent->parent;
+		} while (parent);
+	}
+
+	entry->lastUsed = ++visCacheUses;
+	visCurrent = entry;
+	tr.pc.c_visCacheHits++;
+	return qtrue;
+}
+
+/*
+=================
+R_GatherVisLeafs
+=================
+*/
+static void R_GatherVisLeafs( visCacheEntry_t *entry, mnode_t *node ) {
+	visLeaf_t	*vl;
+
+	do {
+		if ( node->visframe != tr.visCount ) {
+			return;
+		}
+		if ( node->contents != -1 ) {
+			break;
+		}
+		R_GatherVisLeafs( entry, node->children[0] );
+		node = node->children[1];
+	} while ( 1 );
+
+	vl = &entry->leafs[entry->numLeafs++];
+	vl->leaf = node;
+}
+
+/*
+=================
+R_StoreVisCache
+
+Remembers the leafs R_MarkLeaves has just marked, in place of the
+least recently used entry
+=================
+*/
+static void R_StoreVisCache( int cluster ) {
+	visCacheEntry_t	*entry;
+	int				i;
+
+	entry = visCache;
+	for ( i = 1 ; i < VIS_CACHE_SIZE ; i++ ) {
+		if ( visCache[i].lastUsed < entry->lastUsed ) {
+			entry = &visCache[i];
+		}
+	}
+
+	if ( !entry->leafs ) {
+		entry->leafs = ri.Malloc( ( tr.world->numnodes - tr.world->numDecisionNodes ) * sizeof( *entry->leafs ) );
+	}
+
+	entry->valid = qtrue;
+	entry->cluster = cluster;
+	entry->novis = ( r_novis->integer != 0 );
+	Com_Memcpy( entry->areamask, tr.refdef.areamask, sizeof( entry->areamask ) );
+	entry->lastUsed = ++visCacheUses;
+	entry->numLeafs = 0;
+	entry->referenced = qfalse;
+	R_GatherVisLeafs( entry, tr.world->nodes );
+
+	visCurrent = entry;
+}
+
+/*
+=================
+R_TestVisLeaf
+
+Gives the same result as culling the leaf with BoxOnPlaneSide
+=================
+*/
+static void R_TestVisLeaf( visLeaf_t *vl, const cplane_t *frustum ) {
+	const mnode_t	*leaf;
+	const float		*n;
+	float			d, inside, outside;
+	int				i;
+
+	leaf = vl->leaf;
+	inside = 999999;
+	outside = 0;
+	vl->culled = qfalse;
+
+	for ( i = 0 ; i < 4 ; i++ ) {
+		// distance of the corner furthest in front of the plane
+		n = frustum[i].normal;
+		d = n[0] * ( n[0] < 0 ? leaf->mins[0] : leaf->maxs[0] )
+			+ n[1] * ( n[1] < 0 ? leaf->mins[1] : leaf->maxs[1] )
+			+ n[2] * ( n[2] < 0 ? leaf->mins[2] : leaf->maxs[2] );
+		d -= frustum[i].dist;
+
+		if ( d < 0 ) {
+			vl->culled = qtrue;
+			if ( -d > outside ) {
+				outside = -d;
+			}
+		} else if ( d < inside ) {
+			inside = d;
+		}
+	}
+
+	vl->slack = vl->culled ? outside : inside;
+}
+
+/*
+=================
+R_VisLeafRadius
+=================
+*/
+static float R_VisLeafRadius( const mnode_t *leaf, const vec3_t origin ) {
+	vec3_t	v;
+	float	d;
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		v[i] = fabs( leaf->mins[i] - origin[i] );
+		d = fabs( leaf->maxs[i] - origin[i] );
+		if ( d > v[i] ) {
+			v[i] = d;
+		}
+	}
+	return VectorLength( v );
+}
+
+/*
+=================
+R_LeafDlightBits
+
+The dlights R_RecursiveWorldNode would have reached the leaf with
+=================
+*/
+static int R_LeafDlightBits( mnode_t *leaf, int dlightBits ) {
+	mnode_t	*node;
+	int		newDlights[2];
+
+	for ( node = leaf ; node->parent && dlightBits ; node = node->parent ) {
+		R_WorldNodeDlights( node->parent, dlightBits, newDlights );
+		dlightBits = newDlights[ node->parent->children[0] == node ? 0 : 1 ];
+	}
+
+	return dlightBits;
+}
+
+/*
+=================
+R_AddVisCacheLeafs
+=================
+*/
+static void R_AddVisCacheLeafs( visCacheEntry_t *entry, int dlightBits ) {
+	visLeaf_t	*vl;
+	vec3_t		delta;
+	float		planeMove[4], normalMove[4];
+	float		move, m;
+	qboolean	culled;
+	int			i, j, numTested;
+
+	if ( !entry->referenced || entry->rebase ) {
+		VectorCopy( tr.viewParms.or.origin, entry->origin );
+		Com_Memcpy( entry->frustum, tr.viewParms.frustum, sizeof( entry->frustum ) );
+
+		for ( i = 0, vl = entry->leafs ; i < entry->numLeafs ; i++, vl++ ) {
+			vl->radius = R_VisLeafRadius( vl->leaf, entry->origin );
+			R_TestVisLeaf( vl, entry->frustum );
+		}
+		tr.pc.c_visLeafsTested += entry->numLeafs;
+
+		entry->referenced = qtrue;
+		entry->rebase = qfalse;
+	}
+
+	// a point within radius of the reference origin can't have moved
+	// more than planeMove + normalMove * radius relative to a plane
+	for ( j = 0 ; j < 4 ; j++ ) {
+		VectorSubtract( tr.viewParms.frustum[j].normal, entry->frustum[j].normal, delta );
+		normalMove[j] = VectorLength( delta );
+		planeMove[j] = fabs( DotProduct( delta, entry->origin )
+			- ( tr.viewParms.frustum[j].dist - entry->frustum[j].dist ) ) + VIS_CACHE_EPSILON;
+	}
+
+	numTested = 0;
+	for ( i = 0, vl = entry->leafs ; i < entry->numLeafs ; i++, vl++ ) {
+		move = 0;
+		for ( j = 0 ; j < 4 ; j++ ) {
+			m = planeMove[j] + normalMove[j] * vl->radius;
+			if ( m > move ) {
+				move = m;
+			}
+		}
+
+		if ( move < vl->slack ) {
+			culled = vl->culled;
+		} else {
+			visLeaf_t	test;
+
+			test.leaf = vl->leaf;
+			R_TestVisLeaf( &test, tr.viewParms.frustum );
+			culled = test.culled;
+			numTested++;
+		}
+
+		if ( !culled ) {
+			R_AddWorldLeaf( vl->leaf, dlightBits ? R_LeafDlightBits( vl->leaf, dlightBits ) : 0 );
+		}
+	}
+
+	tr.pc.c_visLeafsTested += numTested;
+	tr.pc.c_visLeafsCached += entry->numLeafs - numTested;
+
+	// start over from this frustum next time if it has moved too far
+	if ( numTested > entry->numLeafs / 4 ) {
+		entry->rebase = qtrue;
+	}
+}
+
 /*
 ===============
 R_MarkLeaves
@@ -583,9 +1098,13 @@ static void R_MarkLeaves (void) {
 	// if the cluster is the same and the area visibility matrix
 	// hasn't changed, we don't need to mark everything again
 
+	if ( !r_visCache->integer ) {
+		visCurrent = NULL;
+	}
+
 	// if r_showcluster was just turned on, remark everything 
 	if ( tr.viewCluster == cluster && !tr.refdef.areamaskModified 
-		&& !r_showcluster->modified ) {
+		&& !r_showcluster->modified && ( visCurrent || !r_visCache->integer ) ) {
 		return;
 	}
 
@@ -599,12 +1118,19 @@ static void R_MarkLeaves (void) {
 	tr.visCount++;
 	tr.viewCluster = cluster;
 
+	if ( r_visCache->integer && R_RestoreVisCache( tr.viewCluster ) ) {
+		return;
+	}
+
 	if ( r_novis->integer || tr.viewCluster == -1 ) {
 		for (i=0 ; i<tr.world->numnodes ; i++) {
 			if (tr.world->nodes[i].contents != CONTENTS_SOLID) {
 				tr.world->nodes[i].visframe = tr.visCount;
 			}
 		}
+		if ( r_visCache->integer ) {
+			R_StoreVisCache( tr.viewCluster );
+		}
 		return;
 	}
 
@@ -634,6 +1160,10 @@ static void R_MarkLeaves (void) {
 			parent = parent->parent;
 		} while (parent);
 	}
+
+	if ( r_visCache->integer ) {
+		R_StoreVisCache( tr.viewCluster );
+	}
 }
 
 
@@ -643,6 +1173,8 @@ R_AddWorldSurfaces
 =============
 */
 void R_AddWorldSurfaces (void) {
+	int		numThreads;
+
 	if ( !r_drawworld->integer ) {
 		return;
 	}
@@ -664,5 +1196,19 @@ void R_AddWorldSurfaces (void) {
 	if ( tr.refdef.num_dlights > 32 ) {
 		tr.refdef.num_dlights = 32 ;
 	}
-	R_RecursiveWorldNode( tr.world->nodes, 15, ( 1 << tr.refdef.num_dlights ) - 1 );
+	if ( visCurrent && !r_nocull->integer ) {
+		R_AddVisCacheLeafs( visCurrent, ( 1 << tr.refdef.num_dlights ) - 1 );
+		return;
+	}
+
+	numThreads = ri.WorkerThreads( r_frontEndThreads->integer );
+	if ( numThreads > 1 ) {
+		numWorldJobs = 0;
+		numWorldRefs = 0;
+		R_SplitWorldNode( tr.world->nodes, 15, ( 1 << tr.refdef.num_dlights ) - 1, WORLD_JOB_DEPTH );
+		ri.ParallelFor( numThreads, R_WorldJob, worldJobs, numWorldJobs );
+		R_MergeWorldJobs();
+	} else {
+		R_RecursiveWorldNode( tr.world->nodes, 15, ( 1 << tr.refdef.num_dlights ) - 1, NULL );
+	}
 }
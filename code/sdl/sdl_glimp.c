@@ -57,10 +57,22 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 typedef CGLContextObj QGLContext;
 #define GLimp_GetCurrentContext() CGLGetCurrentContext()
 #define GLimp_SetCurrentContext(ctx) CGLSetCurrentContext(ctx)
+#define GLimp_InitThreads()
+#elif defined( SMP ) && !defined( _WIN32 )
+// the render thread takes the context SDL made with glXMakeCurrent
+#include <GL/glx.h>
+typedef GLXContext QGLContext;
+static Display *opengl_display;
+static GLXDrawable opengl_drawable;
+#define GLimp_GetCurrentContext() ( opengl_display = glXGetCurrentDisplay(), \
+	opengl_drawable = glXGetCurrentDrawable(), glXGetCurrentContext() )
+#define GLimp_SetCurrentContext(ctx) glXMakeCurrent( opengl_display, (ctx) ? opengl_drawable : None, (ctx) )
+#define GLimp_InitThreads() XInitThreads()
 #else
 typedef void *QGLContext;
 #define GLimp_GetCurrentContext() (NULL)
 #define GLimp_SetCurrentContext(ctx)
+#define GLimp_InitThreads()
 #endif
 
 static QGLContext opengl_context;
@@ -86,6 +98,15 @@ void (APIENTRYP qglMultiTexCoord2fARB) (GLenum target, GLfloat s, GLfloat t);
 void (APIENTRYP qglLockArraysEXT) (GLint first, GLsizei count);
 void (APIENTRYP qglUnlockArraysEXT) (void);
 
+void (APIENTRYP qglCompressedTexImage2DARB) (GLenum target, GLint level, GLenum internalformat,
+	GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid *data);
+void (APIENTRYP qglGetCompressedTexImageARB) (GLenum target, GLint level, GLvoid *img);
+
+void (APIENTRYP qglBindBufferARB) (GLenum target, GLuint buffer);
+void (APIENTRYP qglDeleteBuffersARB) (GLsizei n, const GLuint *buffers);
+void (APIENTRYP qglGenBuffersARB) (GLsizei n, GLuint *buffers);
+void (APIENTRYP qglBufferDataARB) (GLenum target, GLsizeiptrARB size, const GLvoid *data, GLenum usage);
+
 /*
 ===============
 GLimp_Shutdown
@@ -412,6 +433,10 @@ static qboolean GLimp_StartDriverAndSetMode( int mode, qboolean fullscreen )
 
 	if (!SDL_WasInit(SDL_INIT_VIDEO))
 	{
+		// the render thread swaps buffers on the display SDL opens
+		if (r_smp->integer)
+			GLimp_InitThreads();
+
 		ri.Printf( PRINT_ALL, "SDL_Init( SDL_INIT_VIDEO )... ");
 		if (SDL_Init(SDL_INIT_VIDEO) == -1)
 		{
@@ -460,24 +485,58 @@ static void GLimp_InitExtensions( void )
 
 	ri.Printf( PRINT_ALL, "Initializing OpenGL extensions\n" );
 
-	// GL_S3_s3tc
-	if ( Q_stristr( glConfig.extensions_string, "GL_S3_s3tc" ) )
+	// GL_EXT_texture_compression_s3tc
+	glConfig.textureCompression = TC_NONE;
+	qglCompressedTexImage2DARB = NULL;
+	qglGetCompressedTexImageARB = NULL;
+	if ( Q_stristr( glConfig.extensions_string, "GL_ARB_texture_compression" ) &&
+		Q_stristr( glConfig.extensions_string, "GL_EXT_texture_compression_s3tc" ) )
 	{
 		if ( r_ext_compressed_textures->value )
 		{
-			glConfig.textureCompression = TC_S3TC;
-			ri.Printf( PRINT_ALL, "...using GL_S3_s3tc\n" );
+			qglCompressedTexImage2DARB = SDL_GL_GetProcAddress( "glCompressedTexImage2DARB" );
+			qglGetCompressedTexImageARB = SDL_GL_GetProcAddress( "glGetCompressedTexImageARB" );
+			if ( qglCompressedTexImage2DARB && qglGetCompressedTexImageARB )
+			{
+				glConfig.textureCompression = TC_S3TC_ARB;
+				ri.Printf( PRINT_ALL, "...using GL_EXT_texture_compression_s3tc\n" );
+			}
+			else
+			{
+				qglCompressedTexImage2DARB = NULL;
+				qglGetCompressedTexImageARB = NULL;
+				ri.Printf( PRINT_ALL, "...GL_ARB_texture_compression functions not found\n" );
+			}
 		}
 		else
 		{
-			glConfig.textureCompression = TC_NONE;
-			ri.Printf( PRINT_ALL, "...ignoring GL_S3_s3tc\n" );
+			ri.Printf( PRINT_ALL, "...ignoring GL_EXT_texture_compression_s3tc\n" );
 		}
 	}
 	else
 	{
-		glConfig.textureCompression = TC_NONE;
-		ri.Printf( PRINT_ALL, "...GL_S3_s3tc not found\n" );
+		ri.Printf( PRINT_ALL, "...GL_EXT_texture_compression_s3tc not found\n" );
+	}
+
+	// GL_S3_s3tc, the older extension
+	if ( glConfig.textureCompression == TC_NONE )
+	{
+		if ( Q_stristr( glConfig.extensions_string, "GL_S3_s3tc" ) )
+		{
+			if ( r_ext_compressed_textures->value )
+			{
+				glConfig.textureCompression = TC_S3TC;
+				ri.Printf( PRINT_ALL, "...using GL_S3_s3tc\n" );
+			}
+			else
+			{
+				ri.Printf( PRINT_ALL, "...ignoring GL_S3_s3tc\n" );
+			}
+		}
+		else
+		{
+			ri.Printf( PRINT_ALL, "...GL_S3_s3tc not found\n" );
+		}
 	}
 
 	// GL_EXT_texture_env_add
@@ -563,6 +622,42 @@ static void GLimp_InitExtensions( void )
 		ri.Printf( PRINT_ALL, "...GL_EXT_compiled_vertex_array not found\n" );
 	}
 
+	// GL_ARB_vertex_buffer_object
+	qglBindBufferARB = NULL;
+	qglDeleteBuffersARB = NULL;
+	qglGenBuffersARB = NULL;
+	qglBufferDataARB = NULL;
+	if ( Q_stristr( glConfig.extensions_string, "GL_ARB_vertex_buffer_object" ) )
+	{
+		if ( r_ext_vertex_buffer_object->integer )
+		{
+			qglBindBufferARB = SDL_GL_GetProcAddress( "glBindBufferARB" );
+			qglDeleteBuffersARB = SDL_GL_GetProcAddress( "glDeleteBuffersARB" );
+			qglGenBuffersARB = SDL_GL_GetProcAddress( "glGenBuffersARB" );
+			qglBufferDataARB = SDL_GL_GetProcAddress( "glBufferDataARB" );
+			if ( qglBindBufferARB && qglDeleteBuffersARB && qglGenBuffersARB && qglBufferDataARB )
+			{
+				ri.Printf( PRINT_ALL, "...using GL_ARB_vertex_buffer_object\n" );
+			}
+			else
+			{
+				qglBindBufferARB = NULL;
+				qglDeleteBuffersARB = NULL;
+				qglGenBuffersARB = NULL;
+				qglBufferDataARB = NULL;
+				ri.Printf( PRINT_ALL, "...GL_ARB_vertex_buffer_object functions not found\n" );
+			}
+		}
+		else
+		{
+			ri.Printf( PRINT_ALL, "...ignoring GL_ARB_vertex_buffer_object\n" );
+		}
+	}
+	else
+	{
+		ri.Printf( PRINT_ALL, "...GL_ARB_vertex_buffer_object not found\n" );
+	}
+
 	textureFilterAnisotropic = qfalse;
 	if ( strstr( glConfig.extensions_string, "GL_EXT_texture_filter_anisotropic" ) )
 	{
@@ -706,22 +801,35 @@ void GLimp_EndFrame( void )
 
 SMP acceleration
 
+The front end hands command lists to the render thread through a ring
+of SMP_FRAMES entries.  Handing over and taking a list are just atomic
+counter updates; the semaphores are only touched when one side actually
+has to sleep, which it announces with its waiting count first.  Each
+side bumps its counter and then checks the other's waiting count, so
+one of them always sees the other.
+
+The render thread keeps the GL context for as long as it has lists
+queued, and only lets go of it before finishing the last one, so the
+front end can take it once GLimp_FrontEndSleep sees the ring empty.
+
 ===========================================================
 */
 
-/*
- * I have no idea if this will even work...most platforms don't offer
- * thread-safe OpenGL libraries, and it looks like the original Linux
- * code counted on each thread claiming the GL context with glXMakeCurrent(),
- * which you can't currently do in SDL. We'll just have to hope for the best.
- */
-
-static SDL_mutex *smpMutex = NULL;
-static SDL_cond *renderCommandsEvent = NULL;
-static SDL_cond *renderCompletedEvent = NULL;
+static void *smpCommandsEvent = NULL;		// posted when a list is queued for a sleeping renderer
+static void *smpCompletedEvent = NULL;		// posted when a list is finished for a sleeping front end
 static void (*glimpRenderThread)( void ) = NULL;
 static SDL_Thread *renderThread = NULL;
 
+static void * volatile smpQueue[SMP_FRAMES];
+static volatile int smpQueued;				// lists handed to the render thread
+static volatile int smpFinished;			// lists it has finished
+static volatile int smpRendererWaiting;
+static volatile int smpFrontEndWaiting;
+
+// only used by the render thread
+static qboolean smpRendering;
+static qboolean smpRendererContext;
+
 /*
 ===============
 GLimp_ShutdownRenderThread
@@ -729,22 +837,16 @@ GLimp_ShutdownRenderThread
 */
 static void GLimp_ShutdownRenderThread(void)
 {
-	if (smpMutex != NULL)
+	if (smpCommandsEvent != NULL)
 	{
-		SDL_DestroyMutex(smpMutex);
-		smpMutex = NULL;
+		Sys_DestroySemaphore(smpCommandsEvent);
+		smpCommandsEvent = NULL;
 	}
 
-	if (renderCommandsEvent != NULL)
+	if (smpCompletedEvent != NULL)
 	{
-		SDL_DestroyCond(renderCommandsEvent);
-		renderCommandsEvent = NULL;
-	}
-
-	if (renderCompletedEvent != NULL)
-	{
-		SDL_DestroyCond(renderCompletedEvent);
-		renderCompletedEvent = NULL;
+		Sys_DestroySemaphore(smpCompletedEvent);
+		smpCompletedEvent = NULL;
 	}
 
 	glimpRenderThread = NULL;
@@ -761,8 +863,6 @@ static int GLimp_RenderThreadWrapper( void *arg )
 
 	glimpRenderThread();
 
-	GLimp_SetCurrentContext(NULL);
-
 	Com_Printf( "Render thread terminating\n" );
 
 	return 0;
@@ -782,10 +882,6 @@ qboolean GLimp_SpawnRenderThread( void (*function)( void ) )
 		warned = qtrue;
 	}
 
-#ifndef MACOS_X
-	return qfalse;  /* better safe than sorry for now. */
-#endif
-
 	if (renderThread != NULL)  /* hopefully just a zombie at this point... */
 	{
 		Com_Printf("Already a render thread? Trying to clean it up...\n");
@@ -794,29 +890,27 @@ qboolean GLimp_SpawnRenderThread( void (*function)( void ) )
 		GLimp_ShutdownRenderThread();
 	}
 
-	smpMutex = SDL_CreateMutex();
-	if (smpMutex == NULL)
+	if (!opengl_context)
 	{
-		Com_Printf( "smpMutex creation failed: %s\n", SDL_GetError() );
-		GLimp_ShutdownRenderThread();
+		Com_Printf( "No GL context to share with a render thread\n" );
 		return qfalse;
 	}
 
-	renderCommandsEvent = SDL_CreateCond();
-	if (renderCommandsEvent == NULL)
+	smpCommandsEvent = Sys_CreateSemaphore();
+	smpCompletedEvent = Sys_CreateSemaphore();
+	if (smpCommandsEvent == NULL || smpCompletedEvent == NULL)
 	{
-		Com_Printf( "renderCommandsEvent creation failed: %s\n", SDL_GetError() );
+		Com_Printf( "SMP semaphore creation failed\n" );
 		GLimp_ShutdownRenderThread();
 		return qfalse;
 	}
 
-	renderCompletedEvent = SDL_CreateCond();
-	if (renderCompletedEvent == NULL)
-	{
-		Com_Printf( "renderCompletedEvent creation failed: %s\n", SDL_GetError() );
-		GLimp_ShutdownRenderThread();
-		return qfalse;
-	}
+	smpQueued = 0;
+	smpFinished = 0;
+	smpRendererWaiting = 0;
+	smpFrontEndWaiting = 0;
+	smpRendering = qfalse;
+	smpRendererContext = qfalse;
 
 	glimpRenderThread = function;
 	renderThread = SDL_CreateThread(GLimp_RenderThreadWrapper, NULL);
@@ -826,67 +920,116 @@ qboolean GLimp_SpawnRenderThread( void (*function)( void ) )
 		GLimp_ShutdownRenderThread();
 		return qfalse;
 	}
-	else
-	{
-		// tma 01/09/07: don't think this is necessary anyway?
-		//
-		// !!! FIXME: No detach API available in SDL!
-		//ret = pthread_detach( renderThread );
-		//if ( ret ) {
-		//ri.Printf( PRINT_ALL, "pthread_detach returned %d: %s", ret, strerror( ret ) );
-		//}
-	}
 
 	return qtrue;
 }
 
-static volatile void    *smpData = NULL;
-static volatile qboolean smpDataReady;
+/*
+===============
+GLimp_RendererPending
+
+Lists queued or being drawn
+===============
+*/
+int GLimp_RendererPending( void )
+{
+	// the atomic adds are also the barriers for the queue entries
+	return Sys_AtomicAdd( &smpQueued, 0 ) - Sys_AtomicAdd( &smpFinished, 0 );
+}
 
 /*
 ===============
 GLimp_RendererSleep
+
+Finishes the list the render thread was drawing and waits for the
+next one, NULL means the renderer is shutting down
 ===============
 */
 void *GLimp_RendererSleep( void )
 {
-	void  *data = NULL;
+	void  *data;
 
-	GLimp_SetCurrentContext(NULL);
+	if ( smpRendering )
+	{
+		smpRendering = qfalse;
+
+		// let go of the context if nothing else is queued
+		if ( smpRendererContext && GLimp_RendererPending() == 1 )
+		{
+			GLimp_SetCurrentContext(NULL);
+			smpRendererContext = qfalse;
+		}
 
-	SDL_LockMutex(smpMutex);
+		Sys_AtomicAdd( &smpFinished, 1 );
+		if ( Sys_AtomicAdd( &smpFrontEndWaiting, 0 ) )
+			Sys_SemaphorePost( smpCompletedEvent );
+	}
+
+	if ( !GLimp_RendererPending() )
 	{
-		smpData = NULL;
-		smpDataReady = qfalse;
+		// a post left over from an earlier wait only costs another pass
+		Sys_AtomicAdd( &smpRendererWaiting, 1 );
+		while ( !GLimp_RendererPending() )
+			Sys_SemaphoreWait( smpCommandsEvent );
+		Sys_AtomicAdd( &smpRendererWaiting, -1 );
+	}
 
-		// after this, the front end can exit GLimp_FrontEndSleep
-		SDL_CondSignal(renderCompletedEvent);
+	data = smpQueue[smpFinished % SMP_FRAMES];
 
-		while ( !smpDataReady )
-			SDL_CondWait(renderCommandsEvent, smpMutex);
+	if ( !data )
+	{
+		// quitting, the front end gets the context back from GLimp_FrontEndSleep
+		if ( smpRendererContext )
+		{
+			GLimp_SetCurrentContext(NULL);
+			smpRendererContext = qfalse;
+		}
 
-		data = (void *)smpData;
+		Sys_AtomicAdd( &smpFinished, 1 );
+		if ( Sys_AtomicAdd( &smpFrontEndWaiting, 0 ) )
+			Sys_SemaphorePost( smpCompletedEvent );
+		return NULL;
 	}
-	SDL_UnlockMutex(smpMutex);
 
-	GLimp_SetCurrentContext(opengl_context);
+	if ( !smpRendererContext )
+	{
+		GLimp_SetCurrentContext(opengl_context);
+		smpRendererContext = qtrue;
+	}
+
+	smpRendering = qtrue;
 
 	return data;
 }
 
+/*
+===============
+GLimp_FrontEndWait
+
+Sleeps until at most maxPending lists are queued or being drawn
+===============
+*/
+void GLimp_FrontEndWait( int maxPending )
+{
+	if ( GLimp_RendererPending() <= maxPending )
+		return;
+
+	Sys_AtomicAdd( &smpFrontEndWaiting, 1 );
+	while ( GLimp_RendererPending() > maxPending )
+		Sys_SemaphoreWait( smpCompletedEvent );
+	Sys_AtomicAdd( &smpFrontEndWaiting, -1 );
+}
+
 /*
 ===============
 GLimp_FrontEndSleep
+
+Waits for the render thread to go idle and takes the context
 ===============
 */
 void GLimp_FrontEndSleep( void )
 {
-	SDL_LockMutex(smpMutex);
-	{
-		while ( smpData )
-			SDL_CondWait(renderCompletedEvent, smpMutex);
-	}
-	SDL_UnlockMutex(smpMutex);
+	GLimp_FrontEndWait( 0 );
 
 	GLimp_SetCurrentContext(opengl_context);
 }
@@ -894,22 +1037,21 @@ void GLimp_FrontEndSleep( void )
 /*
 ===============
 GLimp_WakeRenderer
+
+Queues a list for the render thread without waiting for it
 ===============
 */
 void GLimp_WakeRenderer( void *data )
 {
-	GLimp_SetCurrentContext(NULL);
+	// the ring can't be full, but don't overwrite anything if it is
+	GLimp_FrontEndWait( SMP_FRAMES - 1 );
 
-	SDL_LockMutex(smpMutex);
-	{
-		assert( smpData == NULL );
-		smpData = data;
-		smpDataReady = qtrue;
+	GLimp_SetCurrentContext(NULL);
 
-		// after this, the renderer can continue through GLimp_RendererSleep
-		SDL_CondSignal(renderCommandsEvent);
-	}
-	SDL_UnlockMutex(smpMutex);
+	smpQueue[smpQueued % SMP_FRAMES] = data;
+	Sys_AtomicAdd( &smpQueued, 1 );
+	if ( Sys_AtomicAdd( &smpRendererWaiting, 0 ) )
+		Sys_SemaphorePost( smpCommandsEvent );
 }
 
 #else
@@ -930,6 +1072,15 @@ void *GLimp_RendererSleep( void )
 	return NULL;
 }
 
+int GLimp_RendererPending( void )
+{
+	return 0;
+}
+
+void GLimp_FrontEndWait( int maxPending )
+{
+}
+
 void GLimp_FrontEndSleep( void )
 {
 }
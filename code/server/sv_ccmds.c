@@ -1080,6 +1080,11 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("tracecache", SV_TraceCache_f);
+	Cmd_AddCommand ("deltacache", SV_DeltaCache_f);
+	Cmd_AddCommand ("vm_interpreterBench", SV_InterpreterBench_f);
+	Cmd_AddCommand ("vm_compileCompare", SV_CompileCompare_f);
+	Cmd_AddCommand ("sv_querystats", SV_QueryStats_f);
 	Cmd_AddCommand ("map", SV_Map_f);
 #ifndef PRE_RELEASE_DEMO
 	Cmd_AddCommand ("devmap", SV_Map_f);
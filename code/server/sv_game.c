@@ -298,6 +298,272 @@ static int	FloatAsInt( float f ) {
 	return temp.i;
 }
 
+/*
+=============================================================================
+
+SYSCALL TABLE
+
+The syscalls the game makes every frame are registered with
+VM_SetSyscallTable and skip SV_GameSystemCalls.  Their pointer
+arguments are converted inline instead of with VM_ArgPtr.
+
+=============================================================================
+*/
+
+static byte		*sv_gameImage;
+static intptr_t	sv_gameMask;
+
+#define	GA(x)	( args[x] ? (void *)( sv_gameImage + ( args[x] & sv_gameMask ) ) : NULL )
+
+// for the memory traps, which can't take NULL, 0 is the start of the image
+#define	GM(x)	( (void *)( sv_gameImage + ( args[x] & sv_gameMask ) ) )
+
+static intptr_t SV_G_LinkEntity( intptr_t *args ) {
+	SV_LinkEntity( GA(1) );
+	return 0;
+}
+
+static intptr_t SV_G_UnlinkEntity( intptr_t *args ) {
+	SV_UnlinkEntity( GA(1) );
+	return 0;
+}
+
+static intptr_t SV_G_EntitiesInBox( intptr_t *args ) {
+	return SV_AreaEntities( GA(1), GA(2), GA(3), args[4] );
+}
+
+static intptr_t SV_G_EntityContact( intptr_t *args ) {
+	return SV_EntityContact( GA(1), GA(2), GA(3), /*int capsule*/ qfalse );
+}
+
+static intptr_t SV_G_EntityContactCapsule( intptr_t *args ) {
+	return SV_EntityContact( GA(1), GA(2), GA(3), /*int capsule*/ qtrue );
+}
+
+static intptr_t SV_G_Trace( intptr_t *args ) {
+	SV_Trace( GA(1), GA(2), GA(3), GA(4), GA(5), args[6], args[7], /*int capsule*/ qfalse );
+	return 0;
+}
+
+static intptr_t SV_G_TraceCapsule( intptr_t *args ) {
+	SV_Trace( GA(1), GA(2), GA(3), GA(4), GA(5), args[6], args[7], /*int capsule*/ qtrue );
+	return 0;
+}
+
+static intptr_t SV_G_PointContents( intptr_t *args ) {
+	return SV_PointContents( GA(1), args[2] );
+}
+
+static intptr_t SV_G_InPVS( intptr_t *args ) {
+	return SV_inPVS( GA(1), GA(2) );
+}
+
+static intptr_t SV_G_InPVSIgnorePortals( intptr_t *args ) {
+	return SV_inPVSIgnorePortals( GA(1), GA(2) );
+}
+
+static intptr_t SV_Botlib_UpdateEntity( intptr_t *args ) {
+	return botlib_export->BotLibUpdateEntity( args[1], GA(2) );
+}
+
+static intptr_t SV_Botlib_AAS_BBoxAreas( intptr_t *args ) {
+	return botlib_export->aas.AAS_BBoxAreas( GA(1), GA(2), GA(3), args[4] );
+}
+
+static intptr_t SV_Botlib_AAS_AreaInfo( intptr_t *args ) {
+	return botlib_export->aas.AAS_AreaInfo( args[1], GA(2) );
+}
+
+static intptr_t SV_Botlib_AAS_EntityInfo( intptr_t *args ) {
+	botlib_export->aas.AAS_EntityInfo( args[1], GA(2) );
+	return 0;
+}
+
+static intptr_t SV_Botlib_AAS_PointAreaNum( intptr_t *args ) {
+	return botlib_export->aas.AAS_PointAreaNum( GA(1) );
+}
+
+static intptr_t SV_Botlib_AAS_TraceAreas( intptr_t *args ) {
+	return botlib_export->aas.AAS_TraceAreas( GA(1), GA(2), GA(3), GA(4), args[5] );
+}
+
+static intptr_t SV_Botlib_AAS_PointContents( intptr_t *args ) {
+	return botlib_export->aas.AAS_PointContents( GA(1) );
+}
+
+static intptr_t SV_Botlib_AAS_AreaTravelTimeToGoalArea( intptr_t *args ) {
+	return botlib_export->aas.AAS_AreaTravelTimeToGoalArea( args[1], GA(2), args[3], args[4] );
+}
+
+static intptr_t SV_Botlib_EA_Move( intptr_t *args ) {
+	botlib_export->ea.EA_Move( args[1], GA(2), VMF(3) );
+	return 0;
+}
+
+static intptr_t SV_Botlib_EA_View( intptr_t *args ) {
+	botlib_export->ea.EA_View( args[1], GA(2) );
+	return 0;
+}
+
+static intptr_t SV_Botlib_EA_EndRegular( intptr_t *args ) {
+	botlib_export->ea.EA_EndRegular( args[1], VMF(2) );
+	return 0;
+}
+
+static intptr_t SV_Botlib_EA_GetInput( intptr_t *args ) {
+	botlib_export->ea.EA_GetInput( args[1], VMF(2), GA(3) );
+	return 0;
+}
+
+static intptr_t SV_Botlib_EA_ResetInput( intptr_t *args ) {
+	botlib_export->ea.EA_ResetInput( args[1] );
+	return 0;
+}
+
+static intptr_t SV_Botlib_AI_CharacteristicFloat( intptr_t *args ) {
+	return FloatAsInt( botlib_export->ai.Characteristic_Float( args[1], args[2] ) );
+}
+
+static intptr_t SV_Botlib_AI_CharacteristicBFloat( intptr_t *args ) {
+	return FloatAsInt( botlib_export->ai.Characteristic_BFloat( args[1], args[2], VMF(3), VMF(4) ) );
+}
+
+static intptr_t SV_Botlib_AI_MoveToGoal( intptr_t *args ) {
+	botlib_export->ai.BotMoveToGoal( GA(1), args[2], GA(3), args[4] );
+	return 0;
+}
+
+static intptr_t SV_Botlib_AI_ReachabilityArea( intptr_t *args ) {
+	return botlib_export->ai.BotReachabilityArea( GA(1), args[2] );
+}
+
+static intptr_t SV_Botlib_AI_MovementViewTarget( intptr_t *args ) {
+	return botlib_export->ai.BotMovementViewTarget( args[1], GA(2), args[3], VMF(4), GA(5) );
+}
+
+static intptr_t SV_Botlib_AI_PredictVisiblePosition( intptr_t *args ) {
+	return botlib_export->ai.BotPredictVisiblePosition( GA(1), args[2], GA(3), args[4], GA(5) );
+}
+
+static intptr_t SV_Trap_Memset( intptr_t *args ) {
+	Com_Memset( GM(1), args[2], args[3] );
+	return 0;
+}
+
+static intptr_t SV_Trap_Memcpy( intptr_t *args ) {
+	Com_Memcpy( GM(1), GM(2), args[3] );
+	return 0;
+}
+
+static intptr_t SV_Trap_Strncpy( intptr_t *args ) {
+	char		*dest = GM(1);
+	const char	*src = GM(2);
+	intptr_t	i;
+
+	// strncpy written out, the compiler can't tell the two strings apart
+	for ( i = 0 ; i < args[3] && src[i] ; i++ ) {
+		dest[i] = src[i];
+	}
+	for ( ; i < args[3] ; i++ ) {
+		dest[i] = 0;
+	}
+	return args[1];
+}
+
+static intptr_t SV_Trap_Sin( intptr_t *args ) {
+	return FloatAsInt( sin( VMF(1) ) );
+}
+
+static intptr_t SV_Trap_Cos( intptr_t *args ) {
+	return FloatAsInt( cos( VMF(1) ) );
+}
+
+static intptr_t SV_Trap_Atan2( intptr_t *args ) {
+	return FloatAsInt( atan2( VMF(1), VMF(2) ) );
+}
+
+static intptr_t SV_Trap_Sqrt( intptr_t *args ) {
+	return FloatAsInt( sqrt( VMF(1) ) );
+}
+
+static intptr_t SV_Trap_MatrixMultiply( intptr_t *args ) {
+	MatrixMultiply( GA(1), GA(2), GA(3) );
+	return 0;
+}
+
+static intptr_t SV_Trap_AngleVectors( intptr_t *args ) {
+	AngleVectors( GA(1), GA(2), GA(3), GA(4) );
+	return 0;
+}
+
+static intptr_t SV_Trap_PerpendicularVector( intptr_t *args ) {
+	PerpendicularVector( GA(1), GA(2) );
+	return 0;
+}
+
+static intptr_t SV_Trap_Floor( intptr_t *args ) {
+	return FloatAsInt( floor( VMF(1) ) );
+}
+
+static intptr_t SV_Trap_Ceil( intptr_t *args ) {
+	return FloatAsInt( ceil( VMF(1) ) );
+}
+
+#define	MAX_GAME_SYSCALLS	( BOTLIB_PC_SOURCE_FILE_AND_LINE + 1 )
+
+static vmSyscall_t	sv_gameSyscalls[MAX_GAME_SYSCALLS];
+
+/*
+====================
+SV_InitGameSyscalls
+====================
+*/
+static void SV_InitGameSyscalls( void ) {
+	vmSyscall_t	*t = sv_gameSyscalls;
+
+	t[G_LINKENTITY] = SV_G_LinkEntity;
+	t[G_UNLINKENTITY] = SV_G_UnlinkEntity;
+	t[G_ENTITIES_IN_BOX] = SV_G_EntitiesInBox;
+	t[G_ENTITY_CONTACT] = SV_G_EntityContact;
+	t[G_ENTITY_CONTACTCAPSULE] = SV_G_EntityContactCapsule;
+	t[G_TRACE] = SV_G_Trace;
+	t[G_TRACECAPSULE] = SV_G_TraceCapsule;
+	t[G_POINT_CONTENTS] = SV_G_PointContents;
+	t[G_IN_PVS] = SV_G_InPVS;
+	t[G_IN_PVS_IGNORE_PORTALS] = SV_G_InPVSIgnorePortals;
+	t[BOTLIB_UPDATENTITY] = SV_Botlib_UpdateEntity;
+	t[BOTLIB_AAS_BBOX_AREAS] = SV_Botlib_AAS_BBoxAreas;
+	t[BOTLIB_AAS_AREA_INFO] = SV_Botlib_AAS_AreaInfo;
+	t[BOTLIB_AAS_ENTITY_INFO] = SV_Botlib_AAS_EntityInfo;
+	t[BOTLIB_AAS_POINT_AREA_NUM] = SV_Botlib_AAS_PointAreaNum;
+	t[BOTLIB_AAS_TRACE_AREAS] = SV_Botlib_AAS_TraceAreas;
+	t[BOTLIB_AAS_POINT_CONTENTS] = SV_Botlib_AAS_PointContents;
+	t[BOTLIB_AAS_AREA_TRAVEL_TIME_TO_GOAL_AREA] = SV_Botlib_AAS_AreaTravelTimeToGoalArea;
+	t[BOTLIB_EA_MOVE] = SV_Botlib_EA_Move;
+	t[BOTLIB_EA_VIEW] = SV_Botlib_EA_View;
+	t[BOTLIB_EA_END_REGULAR] = SV_Botlib_EA_EndRegular;
+	t[BOTLIB_EA_GET_INPUT] = SV_Botlib_EA_GetInput;
+	t[BOTLIB_EA_RESET_INPUT] = SV_Botlib_EA_ResetInput;
+	t[BOTLIB_AI_CHARACTERISTIC_FLOAT] = SV_Botlib_AI_CharacteristicFloat;
+	t[BOTLIB_AI_CHARACTERISTIC_BFLOAT] = SV_Botlib_AI_CharacteristicBFloat;
+	t[BOTLIB_AI_MOVE_TO_GOAL] = SV_Botlib_AI_MoveToGoal;
+	t[BOTLIB_AI_REACHABILITY_AREA] = SV_Botlib_AI_ReachabilityArea;
+	t[BOTLIB_AI_MOVEMENT_VIEW_TARGET] = SV_Botlib_AI_MovementViewTarget;
+	t[BOTLIB_AI_PREDICT_VISIBLE_POSITION] = SV_Botlib_AI_PredictVisiblePosition;
+	t[TRAP_MEMSET] = SV_Trap_Memset;
+	t[TRAP_MEMCPY] = SV_Trap_Memcpy;
+	t[TRAP_STRNCPY] = SV_Trap_Strncpy;
+	t[TRAP_SIN] = SV_Trap_Sin;
+	t[TRAP_COS] = SV_Trap_Cos;
+	t[TRAP_ATAN2] = SV_Trap_Atan2;
+	t[TRAP_SQRT] = SV_Trap_Sqrt;
+	t[TRAP_MATRIXMULTIPLY] = SV_Trap_MatrixMultiply;
+	t[TRAP_ANGLEVECTORS] = SV_Trap_AngleVectors;
+	t[TRAP_PERPENDICULARVECTOR] = SV_Trap_PerpendicularVector;
+	t[TRAP_FLOOR] = SV_Trap_Floor;
+	t[TRAP_CEIL] = SV_Trap_Ceil;
+}
+
 /*
 ====================
 SV_GameSystemCalls
@@ -363,33 +629,12 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_SEND_SERVER_COMMAND:
 		SV_GameSendServerCommand( args[1], VMA(2) );
 		return 0;
-	case G_LINKENTITY:
-		SV_LinkEntity( VMA(1) );
-		return 0;
-	case G_UNLINKENTITY:
-		SV_UnlinkEntity( VMA(1) );
-		return 0;
-	case G_ENTITIES_IN_BOX:
-		return SV_AreaEntities( VMA(1), VMA(2), VMA(3), args[4] );
-	case G_ENTITY_CONTACT:
-		return SV_EntityContact( VMA(1), VMA(2), VMA(3), /*int capsule*/ qfalse );
-	case G_ENTITY_CONTACTCAPSULE:
-		return SV_EntityContact( VMA(1), VMA(2), VMA(3), /*int capsule*/ qtrue );
-	case G_TRACE:
-		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
-		return 0;
-	case G_TRACECAPSULE:
-		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
-		return 0;
-	case G_POINT_CONTENTS:
-		return SV_PointContents( VMA(1), args[2] );
+
+	// the per frame world queries are in sv_gameSyscalls
+
 	case G_SET_BRUSH_MODEL:
 		SV_SetBrushModel( VMA(1), VMA(2) );
 		return 0;
-	case G_IN_PVS:
-		return SV_inPVS( VMA(1), VMA(2) );
-	case G_IN_PVS_IGNORE_PORTALS:
-		return SV_inPVSIgnorePortals( VMA(1), VMA(2) );
 
 	case G_SET_CONFIGSTRING:
 		SV_SetConfigstring( args[1], VMA(2) );
@@ -471,8 +716,6 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		return botlib_export->BotLibStartFrame( VMF(1) );
 	case BOTLIB_LOAD_MAP:
 		return botlib_export->BotLibLoadMap( VMA(1) );
-	case BOTLIB_UPDATENTITY:
-		return botlib_export->BotLibUpdateEntity( args[1], VMA(2) );
 	case BOTLIB_TEST:
 		return botlib_export->Test( args[1], VMA(2), VMA(3), VMA(4) );
 
@@ -484,15 +727,8 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 		SV_ClientThink( &svs.clients[args[1]], VMA(2) );
 		return 0;
 
-	case BOTLIB_AAS_BBOX_AREAS:
-		return botlib_export->aas.AAS_BBoxAreas( VMA(1), VMA(2), VMA(3), args[4] );
-	case BOTLIB_AAS_AREA_INFO:
-		return botlib_export->aas.AAS_AreaInfo( args[1], VMA(2) );
 	case BOTLIB_AAS_ALTERNATIVE_ROUTE_GOAL:
 		return botlib_export->aas.AAS_AlternativeRouteGoals( VMA(1), args[2], VMA(3), args[4], args[5], VMA(6), args[7], args[8] );
-	case BOTLIB_AAS_ENTITY_INFO:
-		botlib_export->aas.AAS_EntityInfo( args[1], VMA(2) );
-		return 0;
 
 	case BOTLIB_AAS_INITIALIZED:
 		return botlib_export->aas.AAS_Initialized();
@@ -502,15 +738,9 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AAS_TIME:
 		return FloatAsInt( botlib_export->aas.AAS_Time() );
 
-	case BOTLIB_AAS_POINT_AREA_NUM:
-		return botlib_export->aas.AAS_PointAreaNum( VMA(1) );
 	case BOTLIB_AAS_POINT_REACHABILITY_AREA_INDEX:
 		return botlib_export->aas.AAS_PointReachabilityAreaIndex( VMA(1) );
-	case BOTLIB_AAS_TRACE_AREAS:
-		return botlib_export->aas.AAS_TraceAreas( VMA(1), VMA(2), VMA(3), VMA(4), args[5] );
 
-	case BOTLIB_AAS_POINT_CONTENTS:
-		return botlib_export->aas.AAS_PointContents( VMA(1) );
 	case BOTLIB_AAS_NEXT_BSP_ENTITY:
 		return botlib_export->aas.AAS_NextBSPEntity( args[1] );
 	case BOTLIB_AAS_VALUE_FOR_BSP_EPAIR_KEY:
@@ -525,8 +755,6 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AAS_AREA_REACHABILITY:
 		return botlib_export->aas.AAS_AreaReachability( args[1] );
 
-	case BOTLIB_AAS_AREA_TRAVEL_TIME_TO_GOAL_AREA:
-		return botlib_export->aas.AAS_AreaTravelTimeToGoalArea( args[1], VMA(2), args[3], args[4] );
 	case BOTLIB_AAS_ENABLE_ROUTING_AREA:
 		return botlib_export->aas.AAS_EnableRoutingArea( args[1], args[2] );
 	case BOTLIB_AAS_PREDICT_ROUTE:
@@ -597,32 +825,13 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_EA_DELAYED_JUMP:
 		botlib_export->ea.EA_DelayedJump( args[1] );
 		return 0;
-	case BOTLIB_EA_MOVE:
-		botlib_export->ea.EA_Move( args[1], VMA(2), VMF(3) );
-		return 0;
-	case BOTLIB_EA_VIEW:
-		botlib_export->ea.EA_View( args[1], VMA(2) );
-		return 0;
 
-	case BOTLIB_EA_END_REGULAR:
-		botlib_export->ea.EA_EndRegular( args[1], VMF(2) );
-		return 0;
-	case BOTLIB_EA_GET_INPUT:
-		botlib_export->ea.EA_GetInput( args[1], VMF(2), VMA(3) );
-		return 0;
-	case BOTLIB_EA_RESET_INPUT:
-		botlib_export->ea.EA_ResetInput( args[1] );
-		return 0;
 
 	case BOTLIB_AI_LOAD_CHARACTER:
 		return botlib_export->ai.BotLoadCharacter( VMA(1), VMF(2) );
 	case BOTLIB_AI_FREE_CHARACTER:
 		botlib_export->ai.BotFreeCharacter( args[1] );
 		return 0;
-	case BOTLIB_AI_CHARACTERISTIC_FLOAT:
-		return FloatAsInt( botlib_export->ai.Characteristic_Float( args[1], args[2] ) );
-	case BOTLIB_AI_CHARACTERISTIC_BFLOAT:
-		return FloatAsInt( botlib_export->ai.Characteristic_BFloat( args[1], args[2], VMF(3), VMF(4) ) );
 	case BOTLIB_AI_CHARACTERISTIC_INTEGER:
 		return botlib_export->ai.Characteristic_Integer( args[1], args[2] );
 	case BOTLIB_AI_CHARACTERISTIC_BINTEGER:
@@ -765,9 +974,6 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AI_ADD_AVOID_SPOT:
 		botlib_export->ai.BotAddAvoidSpot( args[1], VMA(2), VMF(3), args[4] );
 		return 0;
-	case BOTLIB_AI_MOVE_TO_GOAL:
-		botlib_export->ai.BotMoveToGoal( VMA(1), args[2], VMA(3), args[4] );
-		return 0;
 	case BOTLIB_AI_MOVE_IN_DIRECTION:
 		return botlib_export->ai.BotMoveInDirection( args[1], VMA(2), VMF(3), args[4] );
 	case BOTLIB_AI_RESET_AVOID_REACH:
@@ -776,12 +982,6 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AI_RESET_LAST_AVOID_REACH:
 		botlib_export->ai.BotResetLastAvoidReach( args[1] );
 		return 0;
-	case BOTLIB_AI_REACHABILITY_AREA:
-		return botlib_export->ai.BotReachabilityArea( VMA(1), args[2] );
-	case BOTLIB_AI_MOVEMENT_VIEW_TARGET:
-		return botlib_export->ai.BotMovementViewTarget( args[1], VMA(2), args[3], VMF(4), VMA(5) );
-	case BOTLIB_AI_PREDICT_VISIBLE_POSITION:
-		return botlib_export->ai.BotPredictVisiblePosition( VMA(1), args[2], VMA(3), args[4], VMA(5) );
 	case BOTLIB_AI_ALLOC_MOVE_STATE:
 		return botlib_export->ai.BotAllocMoveState();
 	case BOTLIB_AI_FREE_MOVE_STATE:
@@ -810,48 +1010,6 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case BOTLIB_AI_GENETIC_PARENTS_AND_CHILD_SELECTION:
 		return botlib_export->ai.GeneticParentsAndChildSelection(args[1], VMA(2), VMA(3), VMA(4), VMA(5));
 
-	case TRAP_MEMSET:
-		Com_Memset( VMA(1), args[2], args[3] );
-		return 0;
-
-	case TRAP_MEMCPY:
-		Com_Memcpy( VMA(1), VMA(2), args[3] );
-		return 0;
-
-	case TRAP_STRNCPY:
-		strncpy( VMA(1), VMA(2), args[3] );
-		return args[1];
-
-	case TRAP_SIN:
-		return FloatAsInt( sin( VMF(1) ) );
-
-	case TRAP_COS:
-		return FloatAsInt( cos( VMF(1) ) );
-
-	case TRAP_ATAN2:
-		return FloatAsInt( atan2( VMF(1), VMF(2) ) );
-
-	case TRAP_SQRT:
-		return FloatAsInt( sqrt( VMF(1) ) );
-
-	case TRAP_MATRIXMULTIPLY:
-		MatrixMultiply( VMA(1), VMA(2), VMA(3) );
-		return 0;
-
-	case TRAP_ANGLEVECTORS:
-		AngleVectors( VMA(1), VMA(2), VMA(3), VMA(4) );
-		return 0;
-
-	case TRAP_PERPENDICULARVECTOR:
-		PerpendicularVector( VMA(1), VMA(2) );
-		return 0;
-
-	case TRAP_FLOOR:
-		return FloatAsInt( floor( VMF(1) ) );
-
-	case TRAP_CEIL:
-		return FloatAsInt( ceil( VMF(1) ) );
-
 
 	default:
 		Com_Error( ERR_DROP, "Bad game system trap: %ld", (long int) args[0] );
@@ -885,6 +1043,9 @@ Called for both a full init and a restart
 static void SV_InitGameVM( qboolean restart ) {
 	int		i;
 
+	// a restarted dll gets a new image
+	sv_gameImage = VM_DataImage( gvm, &sv_gameMask );
+
 	// start the entity parsing at the beginning
 	sv.entityParsePoint = CM_EntityString();
 
@@ -951,6 +1112,8 @@ void SV_InitGameProgs( void ) {
 	if ( !gvm ) {
 		Com_Error( ERR_FATAL, "VM_Create on game failed" );
 	}
+	SV_InitGameSyscalls();
+	VM_SetSyscallTable( gvm, sv_gameSyscalls, MAX_GAME_SYSCALLS );
 
 	SV_InitGameVM( qfalse );
 }
@@ -971,3 +1134,76 @@ qboolean SV_GameCommand( void ) {
 	return VM_Call( gvm, GAME_CONSOLE_COMMAND );
 }
 
+
+
+/*
+====================
+SV_InterpreterBenchReset
+
+Puts the world links back in line with the restored game data
+====================
+*/
+static int	sv_benchNumEntities;
+
+static void SV_InterpreterBenchReset( void ) {
+	sharedEntity_t	*ent;
+	int				i;
+
+	sv.num_entities = sv_benchNumEntities;
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		ent = SV_GentityNum( i );
+		if ( ent->r.linked ) {
+			SV_LinkEntity( ent );
+		} else {
+			SV_UnlinkEntity( ent );
+		}
+	}
+}
+
+/*
+====================
+SV_InterpreterBench_f
+
+vm_interpreterBench [passes]
+
+Replays the next G_RunFrame from the current game state with both
+interpreters.  Anything the frame sends to clients is sent once per
+pass, so don't run it on a busy server.
+====================
+*/
+void SV_InterpreterBench_f( void ) {
+	int		passes;
+
+	if ( !com_sv_running->integer || sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	passes = 10;
+	if ( Cmd_Argc() > 1 ) {
+		passes = atoi( Cmd_Argv( 1 ) );
+	}
+
+	sv_benchNumEntities = sv.num_entities;
+	VM_InterpreterBench( gvm, SV_InterpreterBenchReset, GAME_RUN_FRAME, sv.time, passes );
+}
+
+/*
+====================
+SV_CompileCompare_f
+
+vm_compileCompare
+
+Replays the next G_RunFrame from the current game state with the
+interpreter and with the bytecode compiler, to find compiler bugs.
+====================
+*/
+void SV_CompileCompare_f( void ) {
+	if ( !com_sv_running->integer || sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	sv_benchNumEntities = sv.num_entities;
+	VM_CompareCompiled( gvm, SV_InterpreterBenchReset, GAME_RUN_FRAME, sv.time );
+}
@@ -124,6 +124,10 @@ void SV_SetConfigstring (int index, const char *val) {
 	Z_Free( sv.configstrings[index] );
 	sv.configstrings[index] = CopyString( val );
 
+	if ( index == CS_SERVERINFO || index == CS_SYSTEMINFO ) {
+		SV_InvalidateQueryCache();
+	}
+
 	// send it to all the clients if we aren't
 	// spawning a new server
 	if ( sv.state == SS_GAME || sv.restarting ) {
@@ -492,6 +496,9 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	sv.checksumFeedServerId = sv.serverId;
 	Cvar_Set( "sv_serverid", va("%i", sv.serverId ) );
 
+	// get a latched sv_broadphase before the world is set up
+	sv_broadphase = Cvar_Get( "sv_broadphase", "0", CVAR_ARCHIVE | CVAR_LATCH );
+
 	// clear physics interaction links
 	SV_ClearWorld ();
 	
@@ -681,6 +688,12 @@ void SV_Init (void) {
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_lanForceRate = Cvar_Get ("sv_lanForceRate", "1", CVAR_ARCHIVE );
 	sv_strictAuth = Cvar_Get ("sv_strictAuth", "1", CVAR_ARCHIVE );
+	sv_snapshotThreads = Cvar_Get ("sv_snapshotThreads", "0", CVAR_ARCHIVE );
+	sv_broadphase = Cvar_Get ("sv_broadphase", "0", CVAR_ARCHIVE | CVAR_LATCH );
+	sv_traceCache = Cvar_Get ("sv_traceCache", "0", CVAR_ARCHIVE );
+	sv_deltaCache = Cvar_Get ("sv_deltaCache", "0", CVAR_ARCHIVE );
+	sv_queryRate = Cvar_Get ("sv_queryRate", "10", CVAR_ARCHIVE );
+	sv_queryGlobalRate = Cvar_Get ("sv_queryGlobalRate", "1000", CVAR_ARCHIVE );
 
 	// initialize bot cvars so they are listed and can be set before loading the botlib
 	SV_BotInitCvars();
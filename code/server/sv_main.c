@@ -53,6 +53,12 @@ cvar_t	*sv_pure;
 cvar_t	*sv_floodProtect;
 cvar_t	*sv_lanForceRate; // dedicated 1 (LAN) server forces local client rates to 99999 (bug #491)
 cvar_t	*sv_strictAuth;
+cvar_t	*sv_snapshotThreads;	// threads used to build client snapshots, -1 = one per cpu
+cvar_t	*sv_broadphase;			// 1 = loose octree for entity area queries instead of world sectors
+cvar_t	*sv_traceCache;			// remember SV_Trace results for the rest of the game frame
+cvar_t	*sv_deltaCache;			// share encoded entity deltas between the clients of a frame
+cvar_t	*sv_queryRate;			// getstatus/getinfo per second from one address, 0 = no limit
+cvar_t	*sv_queryGlobalRate;	// getstatus/getinfo per second from everyone, 0 = no limit
 
 serverBan_t serverBans[SERVER_MAXBANS];
 int serverBansCount = 0;
@@ -306,37 +312,226 @@ CONNECTIONLESS COMMANDS
 ==============================================================================
 */
 
+/*
+===============================================================================
+
+CONNECTIONLESS QUERIES
+
+getstatus and getinfo are answered from cached responses, which are only
+rebuilt when the serverinfo or systeminfo configstrings change, or when
+a client connects, leaves, or changes its score, ping or name.  Only the
+challenge is filled in for every query.
+
+Every source address gets a token bucket of sv_queryRate queries per
+second, and all queries together are held to sv_queryGlobalRate.  Both
+buckets hold two seconds worth of queries, so a browser refreshing the
+list is never limited.
+
+===============================================================================
+*/
+
+#define	QUERY_BUCKETS		1024	// must be a power of two
+#define	QUERY_BUCKET_PROBE	4
+#define	QUERY_BURST_MSEC	2000
+
+typedef struct {
+	netadr_t	adr;
+	int			lastTime;
+	int			tokens;			// 1000 per query
+} queryBucket_t;
+
+typedef struct {
+	qboolean	connected;
+	int			score;
+	int			ping;
+	char		name[MAX_NAME_LENGTH];
+} queryClient_t;
+
+typedef struct {
+	int			status, info;
+	int			cached, rebuilt;
+	int			limitedAddress, limitedGlobal;
+} queryStats_t;
+
+static queryBucket_t	queryBuckets[QUERY_BUCKETS];
+static queryBucket_t	queryGlobalBucket;
+static queryStats_t		queryStats;
+
+static qboolean			statusValid;
+static queryClient_t	statusClients[MAX_CLIENTS];
+static char				statusInfo[MAX_INFO_STRING];
+static char				statusPlayers[MAX_MSGLEN];
+
+static qboolean			infoValid;
+static int				infoClients;
+static char				infoKeys[MAX_INFO_STRING];	// everything after the challenge
+
 /*
 ================
-SVC_Status
+SV_InvalidateQueryCache
 
-Responds with all the info that qplug or qspy can see about the server
-and all connected players.  Used for getting detailed information after
-the simple info query.
+Called when the serverinfo or systeminfo configstrings change
 ================
 */
-void SVC_Status( netadr_t from ) {
+void SV_InvalidateQueryCache( void ) {
+	statusValid = qfalse;
+	infoValid = qfalse;
+}
+
+/*
+================
+SVC_TakeQueryToken
+================
+*/
+static qboolean SVC_TakeQueryToken( queryBucket_t *bucket, int rate, int now ) {
+	int		elapsed;
+
+	elapsed = now - bucket->lastTime;
+	if ( elapsed < 0 || elapsed > QUERY_BURST_MSEC ) {
+		elapsed = QUERY_BURST_MSEC;
+	}
+	bucket->lastTime = now;
+
+	bucket->tokens += elapsed * rate;
+	if ( bucket->tokens > rate * QUERY_BURST_MSEC ) {
+		bucket->tokens = rate * QUERY_BURST_MSEC;
+	}
+
+	if ( bucket->tokens < 1000 ) {
+		return qfalse;
+	}
+	bucket->tokens -= 1000;
+	return qtrue;
+}
+
+/*
+================
+SVC_QueryBucket
+
+Finds the bucket of an address, or recycles the least recently used
+one of its hash chain
+================
+*/
+static queryBucket_t *SVC_QueryBucket( netadr_t from, int now ) {
+	queryBucket_t	*bucket, *oldest;
+	unsigned		hash;
+	int				i;
+
+	hash = 0;
+	if ( from.type == NA_IP6 ) {
+		for ( i = 0 ; i < 16 ; i++ ) {
+			hash = hash * 31 + from.ip6[i];
+		}
+	} else {
+		for ( i = 0 ; i < 4 ; i++ ) {
+			hash = hash * 31 + from.ip[i];
+		}
+	}
+
+	oldest = NULL;
+	for ( i = 0 ; i < QUERY_BUCKET_PROBE ; i++ ) {
+		bucket = &queryBuckets[( hash + i ) & ( QUERY_BUCKETS - 1 )];
+		if ( NET_CompareBaseAdr( bucket->adr, from ) ) {
+			return bucket;
+		}
+		if ( !oldest || now - bucket->lastTime > now - oldest->lastTime ) {
+			oldest = bucket;
+		}
+	}
+
+	// new addresses start with a full bucket
+	Com_Memset( oldest, 0, sizeof( *oldest ) );
+	oldest->adr = from;
+	oldest->lastTime = now - QUERY_BURST_MSEC;
+	return oldest;
+}
+
+/*
+================
+SVC_QueryAllowed
+
+Applies the per address and the global query rate limits
+================
+*/
+static qboolean SVC_QueryAllowed( netadr_t from ) {
+	int		now;
+
+	if ( NET_IsLocalAddress( from ) ) {
+		return qtrue;
+	}
+
+	now = Sys_Milliseconds();
+
+	if ( sv_queryRate->integer > 0 ) {
+		if ( !SVC_TakeQueryToken( SVC_QueryBucket( from, now ), sv_queryRate->integer, now ) ) {
+			queryStats.limitedAddress++;
+			return qfalse;
+		}
+	}
+
+	if ( sv_queryGlobalRate->integer > 0 ) {
+		if ( !SVC_TakeQueryToken( &queryGlobalBucket, sv_queryGlobalRate->integer, now ) ) {
+			queryStats.limitedGlobal++;
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+================
+SVC_StatusClientsChanged
+
+Remembers everything about the clients that goes into a status response,
+returns qtrue if any of it is different from the last call
+================
+*/
+static qboolean SVC_StatusClientsChanged( void ) {
+	client_t		*cl;
+	queryClient_t	*qc;
+	qboolean		changed, connected;
+	int				i, score;
+
+	changed = qfalse;
+	for ( i = 0, cl = svs.clients, qc = statusClients ; i < sv_maxclients->integer ; i++, cl++, qc++ ) {
+		connected = ( cl->state >= CS_CONNECTED );
+		if ( connected != qc->connected ) {
+			qc->connected = connected;
+			changed = qtrue;
+		}
+		if ( !connected ) {
+			continue;
+		}
+
+		score = SV_GameClientNum( i )->persistant[PERS_SCORE];
+		if ( score != qc->score || cl->ping != qc->ping || strcmp( cl->name, qc->name ) ) {
+			qc->score = score;
+			qc->ping = cl->ping;
+			Q_strncpyz( qc->name, cl->name, sizeof( qc->name ) );
+			changed = qtrue;
+		}
+	}
+
+	return changed;
+}
+
+/*
+================
+SVC_BuildStatus
+================
+*/
+static void SVC_BuildStatus( void ) {
 	char	player[1024];
-	char	status[MAX_MSGLEN];
 	int		i;
 	client_t	*cl;
 	playerState_t	*ps;
 	int		statusLength;
 	int		playerLength;
-	char	infostring[MAX_INFO_STRING];
 
-	// ignore if we are in single player
-	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER ) {
-		return;
-	}
-
-	strcpy( infostring, Cvar_InfoString( CVAR_SERVERINFO ) );
+	Q_strncpyz( statusInfo, Cvar_InfoString( CVAR_SERVERINFO ), sizeof( statusInfo ) );
 
-	// echo back the parameter to status. so master servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
-
-	status[0] = 0;
+	statusPlayers[0] = 0;
 	statusLength = 0;
 
 	for (i=0 ; i < sv_maxclients->integer ; i++) {
@@ -346,15 +541,92 @@ void SVC_Status( netadr_t from ) {
 			Com_sprintf (player, sizeof(player), "%i %i \"%s\"\n", 
 				ps->persistant[PERS_SCORE], cl->ping, cl->name);
 			playerLength = strlen(player);
-			if (statusLength + playerLength >= sizeof(status) ) {
+			if (statusLength + playerLength >= sizeof(statusPlayers) ) {
 				break;		// can't hold any more
 			}
-			strcpy (status + statusLength, player);
+			strcpy (statusPlayers + statusLength, player);
 			statusLength += playerLength;
 		}
 	}
 
-	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+	statusValid = qtrue;
+}
+
+/*
+================
+SVC_Status
+
+Responds with all the info that qplug or qspy can see about the server
+and all connected players.  Used for getting detailed information after
+the simple info query.
+================
+*/
+void SVC_Status( netadr_t from ) {
+	char	infostring[MAX_INFO_STRING];
+	qboolean	changed;
+
+	// ignore if we are in single player
+	if ( Cvar_VariableValue( "g_gametype" ) == GT_SINGLE_PLAYER ) {
+		return;
+	}
+
+	queryStats.status++;
+	if ( !SVC_QueryAllowed( from ) ) {
+		return;
+	}
+
+	// serverinfo cvars changed this frame won't be in the configstring yet
+	changed = SVC_StatusClientsChanged();
+	if ( changed || !statusValid || ( cvar_modifiedFlags & CVAR_SERVERINFO ) ) {
+		SVC_BuildStatus();
+		queryStats.rebuilt++;
+	} else {
+		queryStats.cached++;
+	}
+
+	strcpy( infostring, statusInfo );
+
+	// echo back the parameter to status. so master servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
+
+	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, statusPlayers );
+}
+
+/*
+================
+SVC_BuildInfo
+
+All of the info response except for the challenge
+================
+*/
+static void SVC_BuildInfo( int count ) {
+	char	*gamedir;
+
+	infoKeys[0] = 0;
+
+	Info_SetValueForKey( infoKeys, "protocol", va("%i", PROTOCOL_VERSION) );
+	Info_SetValueForKey( infoKeys, "hostname", sv_hostname->string );
+	Info_SetValueForKey( infoKeys, "mapname", sv_mapname->string );
+	Info_SetValueForKey( infoKeys, "clients", va("%i", count) );
+	Info_SetValueForKey( infoKeys, "sv_maxclients", 
+		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
+	Info_SetValueForKey( infoKeys, "gametype", va("%i", sv_gametype->integer ) );
+	Info_SetValueForKey( infoKeys, "pure", va("%i", sv_pure->integer ) );
+
+	if( sv_minPing->integer ) {
+		Info_SetValueForKey( infoKeys, "minPing", va("%i", sv_minPing->integer) );
+	}
+	if( sv_maxPing->integer ) {
+		Info_SetValueForKey( infoKeys, "maxPing", va("%i", sv_maxPing->integer) );
+	}
+	gamedir = Cvar_VariableString( "fs_game" );
+	if( *gamedir ) {
+		Info_SetValueForKey( infoKeys, "game", gamedir );
+	}
+
+	infoClients = count;
+	infoValid = qtrue;
 }
 
 /*
@@ -367,7 +639,6 @@ if a user is interested in a server to do a full status
 */
 void SVC_Info( netadr_t from ) {
 	int		i, count;
-	char	*gamedir;
 	char	infostring[MAX_INFO_STRING];
 
 	// ignore if we are in single player
@@ -384,6 +655,11 @@ void SVC_Info( netadr_t from ) {
 	if(strlen(Cmd_Argv(1)) > 128)
 		return;
 
+	queryStats.info++;
+	if ( !SVC_QueryAllowed( from ) ) {
+		return;
+	}
+
 	// don't count privateclients
 	count = 0;
 	for ( i = sv_privateClients->integer ; i < sv_maxclients->integer ; i++ ) {
@@ -392,35 +668,44 @@ void SVC_Info( netadr_t from ) {
 		}
 	}
 
+	if ( count != infoClients || !infoValid || ( cvar_modifiedFlags & ( CVAR_SERVERINFO | CVAR_SYSTEMINFO ) ) ) {
+		SVC_BuildInfo( count );
+		queryStats.rebuilt++;
+	} else {
+		queryStats.cached++;
+	}
+
 	infostring[0] = 0;
 
 	// echo back the parameter to status. so servers can use it as a challenge
 	// to prevent timed spoofed reply packets that add ghost servers
 	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
 
-	Info_SetValueForKey( infostring, "protocol", va("%i", PROTOCOL_VERSION) );
-	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
-	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
-	Info_SetValueForKey( infostring, "clients", va("%i", count) );
-	Info_SetValueForKey( infostring, "sv_maxclients", 
-		va("%i", sv_maxclients->integer - sv_privateClients->integer ) );
-	Info_SetValueForKey( infostring, "gametype", va("%i", sv_gametype->integer ) );
-	Info_SetValueForKey( infostring, "pure", va("%i", sv_pure->integer ) );
-
-	if( sv_minPing->integer ) {
-		Info_SetValueForKey( infostring, "minPing", va("%i", sv_minPing->integer) );
-	}
-	if( sv_maxPing->integer ) {
-		Info_SetValueForKey( infostring, "maxPing", va("%i", sv_maxPing->integer) );
-	}
-	gamedir = Cvar_VariableString( "fs_game" );
-	if( *gamedir ) {
-		Info_SetValueForKey( infostring, "game", gamedir );
+	if ( strlen( infostring ) + strlen( infoKeys ) >= sizeof( infostring ) ) {
+		Com_Printf( "Info string length exceeded\n" );
+		return;
 	}
+	strcat( infostring, infoKeys );
 
 	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
 }
 
+/*
+================
+SV_QueryStats_f
+================
+*/
+void SV_QueryStats_f( void ) {
+	Com_Printf( "%i getstatus, %i getinfo\n", queryStats.status, queryStats.info );
+	Com_Printf( "%i answered from cache, %i rebuilt\n", queryStats.cached, queryStats.rebuilt );
+	Com_Printf( "%i limited by sv_queryRate, %i limited by sv_queryGlobalRate\n",
+		queryStats.limitedAddress, queryStats.limitedGlobal );
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		Com_Memset( &queryStats, 0, sizeof( queryStats ) );
+	}
+}
+
 /*
 ================
 SVC_FlushRedirect
@@ -850,6 +1135,8 @@ void SV_Frame( int msec ) {
 		startTime = 0;	// quite a compiler warning
 	}
 
+	PROFILE_BEGIN( "SV_Frame", -1 );
+
 	// update ping based on the all received frames
 	SV_CalcPings();
 
@@ -861,6 +1148,8 @@ void SV_Frame( int msec ) {
 		svs.time += frameMsec;
 		sv.time += frameMsec;
 
+		SV_ClearTraceCache();
+
 		// let everything in the world think and move
 		VM_Call (gvm, GAME_RUN_FRAME, sv.time);
 	}
@@ -873,10 +1162,14 @@ void SV_Frame( int msec ) {
 	SV_CheckTimeouts();
 
 	// send messages back to the clients
+	PROFILE_BEGIN( "SV_SendClientMessages", -1 );
 	SV_SendClientMessages();
+	PROFILE_END();
 
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat();
+
+	PROFILE_END();
 }
 
 //============================================================================
@@ -45,6 +45,226 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Shared entity deltas
+
+Clients that are sent the same change of an entity (usually from the
+baseline or from the same acknowledged server frame) get exactly the same
+bits, so with sv_deltaCache 1 the first encoding of every (from, to,
+force) combination is kept for the rest of the frame and copied into the
+other clients' messages.  Entries are matched on full copies of both
+states, so a hit never changes what goes on the wire.
+
+The cache is filled from the snapshot worker threads without locks:
+slots and data are reserved with atomic adds and an entry is only read
+once its ready flag has been set.
+
+=============================================================================
+*/
+
+#define	DELTA_CACHE_SLOTS		4			// encodings kept per entity number
+#define	DELTA_CACHE_DATA		0x40000
+#define	DELTA_CACHE_MAXBYTES	2048		// largest single entity delta
+
+typedef struct {
+	volatile int	ready;
+	unsigned int	hash;				// of the from state
+	qboolean		force;
+	int				bits;
+	int				offset;				// in deltaCache.data
+	entityState_t	from;
+	entityState_t	to;
+} deltaCacheSlot_t;
+
+typedef struct {
+	volatile int		numSlots;
+	deltaCacheSlot_t	slots[DELTA_CACHE_SLOTS];
+} deltaCacheEntity_t;
+
+typedef struct {
+	deltaCacheEntity_t	entities[MAX_GENTITIES];
+	volatile int		dataUsed;
+	byte				data[DELTA_CACHE_DATA];
+
+	// statistics since the last deltacache command
+	volatile int		hits;
+	volatile int		misses;
+	volatile int		full;
+	volatile int		bytesCopied;
+} deltaCache_t;
+
+static deltaCache_t	*sv_sharedDeltas;		// allocated on first use
+static qboolean		sv_sharedDeltasActive;
+
+/*
+=============
+SV_ClearDeltaCache
+
+Called at the start of every SV_SendClientMessages
+=============
+*/
+static void SV_ClearDeltaCache( void ) {
+	deltaCacheEntity_t	*entity;
+	int					i, j;
+
+	sv_sharedDeltasActive = ( sv_deltaCache->integer != 0 );
+	if ( !sv_sharedDeltasActive ) {
+		return;
+	}
+	if ( !sv_sharedDeltas ) {
+		sv_sharedDeltas = Z_Malloc( sizeof( *sv_sharedDeltas ) );
+	}
+	for ( i = 0, entity = sv_sharedDeltas->entities ; i < MAX_GENTITIES ; i++, entity++ ) {
+		// a slot reserved again this frame must not look ready before it is written
+		for ( j = 0 ; j < entity->numSlots && j < DELTA_CACHE_SLOTS ; j++ ) {
+			entity->slots[j].ready = 0;
+		}
+		entity->numSlots = 0;
+	}
+	sv_sharedDeltas->dataUsed = 0;
+}
+
+/*
+=============
+SV_HashEntityState
+=============
+*/
+static unsigned int SV_HashEntityState( const entityState_t *s ) {
+	const int		*p;
+	unsigned int	hash;
+	int				i;
+
+	p = (const int *)s;
+	hash = 2166136261u;
+	for ( i = 0 ; i < sizeof( *s ) / 4 ; i++ ) {
+		hash = ( hash ^ p[i] ) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+=============
+SV_WriteDeltaEntityCached
+
+MSG_WriteDeltaEntity through the shared entity delta cache, stats
+collects the hits, misses, dropped stores and copied bytes of the
+calling message
+=============
+*/
+static void SV_WriteDeltaEntityCached( msg_t *msg, entityState_t *from, entityState_t *to,
+									   qboolean force, int *stats ) {
+	deltaCacheEntity_t	*entity;
+	deltaCacheSlot_t	*slot;
+	msg_t				encoded;
+	byte				buffer[DELTA_CACHE_MAXBYTES];
+	unsigned int		hash;
+	int					i, numSlots, bytes, offset;
+
+	// an unchanged entity doesn't produce any bits without force
+	if ( !force && !memcmp( from, to, sizeof( *to ) ) ) {
+		return;
+	}
+
+	// leave running out of space to MSG_WriteDeltaEntity, so
+	// an overflowing message ends exactly as it would without the cache
+	if ( msg->maxsize - msg->cursize < DELTA_CACHE_MAXBYTES + 4 ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	hash = SV_HashEntityState( from );
+	entity = &sv_sharedDeltas->entities[to->number];
+
+	numSlots = entity->numSlots;
+	if ( numSlots > DELTA_CACHE_SLOTS ) {
+		numSlots = DELTA_CACHE_SLOTS;
+	}
+	for ( i = 0, slot = entity->slots ; i < numSlots ; i++, slot++ ) {
+		if ( !slot->ready ) {
+			continue;		// still being written
+		}
+		Sys_AtomicAdd( &slot->ready, 0 );	// don't read the entry ahead of the flag
+		if ( slot->hash != hash || slot->force != force ) {
+			continue;
+		}
+		if ( memcmp( &slot->from, from, sizeof( *from ) ) || memcmp( &slot->to, to, sizeof( *to ) ) ) {
+			continue;
+		}
+		MSG_CopyBits( msg, sv_sharedDeltas->data + slot->offset, slot->bits );
+		stats[0]++;
+		stats[3] += ( slot->bits + 7 ) >> 3;
+		return;
+	}
+
+	stats[1]++;
+
+	MSG_Init( &encoded, buffer, sizeof( buffer ) );
+	encoded.allowoverflow = qtrue;
+	MSG_WriteDeltaEntity( &encoded, from, to, force );
+	if ( encoded.overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+	MSG_CopyBits( msg, buffer, encoded.bit );
+
+	// remember it for the other clients
+	if ( numSlots == DELTA_CACHE_SLOTS ) {
+		stats[2]++;
+		return;
+	}
+	i = Sys_AtomicAdd( &entity->numSlots, 1 ) - 1;
+	if ( i >= DELTA_CACHE_SLOTS ) {
+		stats[2]++;
+		return;
+	}
+	slot = &entity->slots[i];
+
+	bytes = ( encoded.bit + 7 ) >> 3;
+	offset = Sys_AtomicAdd( &sv_sharedDeltas->dataUsed, bytes ) - bytes;
+	if ( offset + bytes > DELTA_CACHE_DATA ) {
+		stats[2]++;
+		return;		// the slot stays unready for the rest of the frame
+	}
+
+	Com_Memcpy( sv_sharedDeltas->data + offset, buffer, bytes );
+	slot->hash = hash;
+	slot->force = force;
+	slot->bits = encoded.bit;
+	slot->offset = offset;
+	slot->from = *from;
+	slot->to = *to;
+	Sys_AtomicAdd( &slot->ready, 1 );
+}
+
+/*
+===============
+SV_DeltaCache_f
+===============
+*/
+void SV_DeltaCache_f( void ) {
+	int		total;
+
+	if ( !sv_sharedDeltas ) {
+		Com_Printf( "Delta cache not in use, set sv_deltaCache 1\n" );
+		return;
+	}
+
+	total = sv_sharedDeltas->hits + sv_sharedDeltas->misses;
+	Com_Printf( "%i entity deltas, %i hits, %i misses, %i not stored", total,
+		sv_sharedDeltas->hits, sv_sharedDeltas->misses, sv_sharedDeltas->full );
+	if ( total ) {
+		Com_Printf( " (%.1f%% hit rate)", 100.0f * sv_sharedDeltas->hits / total );
+	}
+	Com_Printf( "\n" );
+	Com_Printf( "%i bytes copied, %i of %i data bytes used last frame\n",
+		sv_sharedDeltas->bytesCopied, sv_sharedDeltas->dataUsed, DELTA_CACHE_DATA );
+
+	sv_sharedDeltas->hits = sv_sharedDeltas->misses = sv_sharedDeltas->full = 0;
+	sv_sharedDeltas->bytesCopied = 0;
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -57,6 +277,9 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 	int		oldindex, newindex;
 	int		oldnum, newnum;
 	int		from_num_entities;
+	int		stats[4];
+
+	stats[0] = stats[1] = stats[2] = stats[3] = 0;
 
 	// generate the delta update
 	if ( !from ) {
@@ -88,7 +311,11 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			if ( sv_sharedDeltasActive ) {
+				SV_WriteDeltaEntityCached( msg, oldent, newent, qfalse, stats );
+			} else {
+				MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			}
 			oldindex++;
 			newindex++;
 			continue;
@@ -96,7 +323,11 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			if ( sv_sharedDeltasActive ) {
+				SV_WriteDeltaEntityCached( msg, &sv.svEntities[newnum].baseline, newent, qtrue, stats );
+			} else {
+				MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			}
 			newindex++;
 			continue;
 		}
@@ -110,48 +341,68 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 	}
 
 	MSG_WriteBits( msg, (MAX_GENTITIES-1), GENTITYNUM_BITS );	// end of packetentities
+
+	if ( sv_sharedDeltasActive ) {
+		Sys_AtomicAdd( &sv_sharedDeltas->hits, stats[0] );
+		Sys_AtomicAdd( &sv_sharedDeltas->misses, stats[1] );
+		Sys_AtomicAdd( &sv_sharedDeltas->full, stats[2] );
+		Sys_AtomicAdd( &sv_sharedDeltas->bytesCopied, stats[3] );
+	}
 }
 
 
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SnapshotDeltaFrame
+
+Picks the previous frame to delta compress the current one against,
+must be called right after the current frame's entities were reserved
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
-	int					lastframe;
-	int					i;
-	int					snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+static clientSnapshot_t *SV_SnapshotDeltaFrame( client_t *client, int *lastframe ) {
+	clientSnapshot_t	*oldframe;
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ) {
 		// client is asking for a retransmit
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->netchan.outgoingSequence - client->deltaMessage 
 		>= (PACKET_BACKUP - 3) ) {
 		// client hasn't gotten a good message through in a long time
 		Com_DPrintf ("%s: Delta request from out of date packet.\n", client->name);
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else {
 		// we have a valid snapshot to delta from
 		oldframe = &client->frames[ client->deltaMessage & PACKET_MASK ];
-		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+		*lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
 		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
 			Com_DPrintf ("%s: Delta request from out of date entities.\n", client->name);
 			oldframe = NULL;
-			lastframe = 0;
+			*lastframe = 0;
 		}
 	}
 
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+==================
+*/
+static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -239,6 +490,8 @@ Build a client snapshot structure
 typedef struct {
 	int		numSnapshotEntities;
 	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];	
+	byte	added[MAX_GENTITIES/8];		// used to prevent double adding from portal views
+	char	*error;						// set instead of calling Com_Error, see SV_BuildClientSnapshot
 } snapshotEntityNumbers_t;
 
 /*
@@ -252,10 +505,6 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 	ea = (int *)a;
 	eb = (int *)b;
 
-	if ( *ea == *eb ) {
-		Com_Error( ERR_DROP, "SV_QsortEntityStates: duplicated entity" );
-	}
-
 	if ( *ea < *eb ) {
 		return -1;
 	}
@@ -269,12 +518,14 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		num = gEnt->s.number;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( eNums->added[num >> 3] & (1 << (num & 7)) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[num >> 3] |= 1 << (num & 7);
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
@@ -352,22 +603,24 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 		// entities can be flagged to be sent to a given mask of clients
 		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 32)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: cientNum > 32\n" );
+			if (frame->ps.clientNum >= 32) {
+				eNums->error = "SVF_CLIENTMASK: cientNum > 32\n";
+				return;
+			}
 			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
 				continue;
 		}
 
-		svEnt = SV_SvEntityForGentity( ent );
+		svEnt = &sv.svEntities[e];
 
 		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+		if ( eNums->added[e >> 3] & (1 << (e & 7)) ) {
 			continue;
 		}
 
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			SV_AddEntToSnapshot( ent, eNums );
 			continue;
 		}
 
@@ -413,7 +666,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 
 		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		SV_AddEntToSnapshot( ent, eNums );
 
 		// if its a portal entity, add everything visible from its camera position
 		if ( ent->r.svFlags & SVF_PORTAL ) {
@@ -425,6 +678,9 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 				}
 			}
 			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, qtrue );
+			if ( eNums->error ) {
+				return;
+			}
 		}
 
 	}
@@ -440,29 +696,27 @@ copies off the playerstate and areabits.
 This properly handles multiple recursive portals, but the render
 currently doesn't.
 
+Only reads the world, so it can run for several clients at once.
+Errors are left in eNums->error for the caller to raise.
+
 For viewing through other player's eyes, clent can be something other than client->gentity
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static void SV_BuildClientSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
 	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
 	int							clientNum;
 	playerState_t				*ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	entityNumbers->error = NULL;
+	Com_Memset( entityNumbers->added, 0, sizeof( entityNumbers->added ) );
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
@@ -481,11 +735,10 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// be regenerated from the playerstate
 	clientNum = frame->ps.clientNum;
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
-		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
+		entityNumbers->error = "SV_SvEntityForGentity: bad gEnt";
+		return;
 	}
-	svEnt = &sv.svEntities[ clientNum ];
-
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[clientNum >> 3] |= 1 << (clientNum & 7);
 
 	// find the client's viewpoint
 	VectorCopy( ps->origin, org );
@@ -493,34 +746,63 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, qfalse );
+	if ( entityNumbers->error ) {
+		return;
+	}
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
-	// to work correctly.  This also catches the error condition
-	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, 
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	// to work correctly.
+	qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities, 
+		sizeof( entityNumbers->snapshotEntities[0] ), SV_QsortEntityNumbers );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
 	for ( i = 0 ; i < MAX_MAP_AREA_BYTES/4 ; i++ ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
+}
+
+/*
+=============
+SV_ReserveSnapshotEntities
+
+Claims the next run of svs.snapshotEntities for the frame
+=============
+*/
+static void SV_ReserveSnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t	*frame;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
-	// copy the entity states out
-	frame->num_entities = 0;
 	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
-		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
-		*state = ent->s;
-		svs.nextSnapshotEntities++;
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
-			Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
-		}
-		frame->num_entities++;
+	frame->num_entities = entityNumbers->numSnapshotEntities;
+	svs.nextSnapshotEntities += entityNumbers->numSnapshotEntities;
+
+	// this should never hit, map should always be restarted first in SV_Frame
+	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
+		Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+	}
+}
+
+/*
+=============
+SV_CopySnapshotEntities
+
+Copies the entity states out into the reserved run
+=============
+*/
+static void SV_CopySnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t	*frame;
+	sharedEntity_t		*ent;
+	int					i;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	for ( i = 0 ; i < frame->num_entities ; i++ ) {
+		ent = SV_GentityNum(entityNumbers->snapshotEntities[i]);
+		svs.snapshotEntities[(frame->first_entity + i) % svs.numSnapshotEntities] = ent->s;
 	}
 }
 
@@ -626,9 +908,19 @@ Also called by SV_FinalMessage
 void SV_SendClientSnapshot( client_t *client ) {
 	byte		msg_buf[MAX_MSGLEN];
 	msg_t		msg;
+	snapshotEntityNumbers_t	entityNumbers;
+	clientSnapshot_t	*oldframe;
+	int			lastframe;
 
 	// build the snapshot
-	SV_BuildClientSnapshot( client );
+	PROFILE_BEGIN( "SV_BuildClientSnapshot", client - svs.clients );
+	SV_BuildClientSnapshot( client, &entityNumbers );
+	PROFILE_END();
+	if ( entityNumbers.error ) {
+		Com_Error( ERR_DROP, "%s", entityNumbers.error );
+	}
+	SV_ReserveSnapshotEntities( client, &entityNumbers );
+	SV_CopySnapshotEntities( client, &entityNumbers );
 
 	// bots need to have their snapshots build, but
 	// the query them directly without needing to be sent
@@ -636,6 +928,8 @@ void SV_SendClientSnapshot( client_t *client ) {
 		return;
 	}
 
+	oldframe = SV_SnapshotDeltaFrame( client, &lastframe );
+
 	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
 	msg.allowoverflow = qtrue;
 
@@ -648,7 +942,7 @@ void SV_SendClientSnapshot( client_t *client ) {
 
 	// send over all the relevant entityState_t
 	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	SV_WriteSnapshotToClient( client, &msg, oldframe, lastframe );
 
 	// Add any download data if the client is downloading
 	SV_WriteDownloadToClient( client, &msg );
@@ -662,6 +956,216 @@ void SV_SendClientSnapshot( client_t *client ) {
 	SV_SendMessageToClient( &msg, client );
 }
 
+/*
+=============================================================================
+
+Parallel snapshot building
+
+With sv_snapshotThreads > 1 the snapshots for all clients that are due
+this frame are built in four passes:
+
+1. (parallel) PVS walk and entity selection for each client
+2. (serial)   reserve svs.snapshotEntities runs in client order and pick
+              the delta frames, exactly as the serial path would
+3. (parallel) copy entity states and delta encode each message
+4. (serial)   download data, overflow checks and transmission in client order
+
+The world is not modified between the first and third pass, so the
+resulting packets are byte-identical to the serial path.
+
+The jobs can't call Com_Printf or Com_Error, so anything the encode would
+complain about is looked for in the second pass, and then the third pass
+runs on the main thread where the message functions can report it.
+
+=============================================================================
+*/
+
+typedef struct {
+	client_t				*client;
+	qboolean				bot;
+	clientSnapshot_t		*oldframe;
+	int						lastframe;
+	snapshotEntityNumbers_t	entityNumbers;
+	msg_t					msg;
+	byte					msgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t	*sv_snapshotJobs;		// [MAX_CLIENTS], allocated on first use
+static int				sv_numSnapshotJobs;
+
+/*
+=======================
+SV_BuildSnapshotJob
+=======================
+*/
+static void SV_BuildSnapshotJob( void *data, int index ) {
+	snapshotJob_t	*job = &sv_snapshotJobs[index];
+
+	PROFILE_BEGIN( "SV_BuildClientSnapshot", job->client - svs.clients );
+	SV_BuildClientSnapshot( job->client, &job->entityNumbers );
+	PROFILE_END();
+}
+
+/*
+=======================
+SV_EncodeSnapshotJob
+=======================
+*/
+static void SV_EncodeSnapshotJob( void *data, int index ) {
+	snapshotJob_t	*job = &sv_snapshotJobs[index];
+	client_t		*client = job->client;
+
+	SV_CopySnapshotEntities( client, &job->entityNumbers );
+
+	if ( job->bot ) {
+		return;
+	}
+
+	MSG_WriteLong( &job->msg, client->lastClientCommand );
+	SV_UpdateServerCommandsToClient( client, &job->msg );
+	SV_WriteSnapshotToClient( client, &job->msg, job->oldframe, job->lastframe );
+}
+
+/*
+=======================
+SV_SnapshotJobCanFail
+
+True if encoding the job would make MSG_WriteString or
+MSG_WriteDeltaEntity print or raise an error
+=======================
+*/
+static qboolean SV_SnapshotJobCanFail( snapshotJob_t *job ) {
+	client_t	*client = job->client;
+	int			i, num;
+
+	for ( i = client->reliableAcknowledge + 1 ; i <= client->reliableSequence ; i++ ) {
+		if ( strlen( client->reliableCommands[ i & (MAX_RELIABLE_COMMANDS-1) ] ) >= MAX_STRING_CHARS ) {
+			return qtrue;
+		}
+	}
+
+	for ( i = 0 ; i < job->entityNumbers.numSnapshotEntities ; i++ ) {
+		num = SV_GentityNum( job->entityNumbers.snapshotEntities[i] )->s.number;
+		if ( num < 0 || num >= MAX_GENTITIES ) {
+			return qtrue;
+		}
+	}
+
+	return qfalse;
+}
+
+/*
+=======================
+SV_SendClientMessagesParallel
+=======================
+*/
+static void SV_SendClientMessagesParallel( int numThreads ) {
+	int				i, e;
+	client_t		*c;
+	snapshotJob_t	*job;
+	sharedEntity_t	*ent;
+	int				oldest;
+	qboolean		serial;
+
+	if ( !sv_snapshotJobs ) {
+		sv_snapshotJobs = Z_Malloc( MAX_CLIENTS * sizeof( *sv_snapshotJobs ) );
+	}
+
+	// entity states are read only from here on, so fix the numbers
+	// SV_AddEntitiesVisibleFromPoint would otherwise patch up
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum(e);
+		if ( ent->r.linked && ent->s.number != e ) {
+			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+	}
+
+	// collect the clients that get a new snapshot this frame
+	sv_numSnapshotJobs = 0;
+	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
+		if ( !c->state || svs.time < c->nextSnapshotTime || c->netchan.unsentFragments ) {
+			continue;
+		}
+		job = &sv_snapshotJobs[sv_numSnapshotJobs++];
+		job->client = c;
+		job->bot = ( c->gentity && c->gentity->r.svFlags & SVF_BOT );
+	}
+
+	Com_ParallelFor( numThreads, SV_BuildSnapshotJob, NULL, sv_numSnapshotJobs );
+
+	for ( i = 0, job = sv_snapshotJobs ; i < sv_numSnapshotJobs ; i++, job++ ) {
+		if ( job->entityNumbers.error ) {
+			Com_Error( ERR_DROP, "%s", job->entityNumbers.error );
+		}
+		SV_ReserveSnapshotEntities( job->client, &job->entityNumbers );
+
+		if ( job->bot ) {
+			continue;
+		}
+		job->oldframe = SV_SnapshotDeltaFrame( job->client, &job->lastframe );
+
+		MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+		job->msg.allowoverflow = qtrue;
+	}
+
+	// if a later client's entities would overwrite something an earlier
+	// client still has to read, encode in order to keep the serial results,
+	// and encode on this thread if a message would print or error
+	serial = qfalse;
+	for ( i = 0, job = sv_snapshotJobs ; i < sv_numSnapshotJobs ; i++, job++ ) {
+		if ( !job->bot && SV_SnapshotJobCanFail( job ) ) {
+			serial = qtrue;
+			break;
+		}
+		oldest = job->client->frames[ job->client->netchan.outgoingSequence & PACKET_MASK ].first_entity;
+		if ( job->oldframe && job->oldframe->num_entities && job->oldframe->first_entity < oldest ) {
+			oldest = job->oldframe->first_entity;
+		}
+		if ( oldest + svs.numSnapshotEntities < svs.nextSnapshotEntities ) {
+			serial = qtrue;
+			break;
+		}
+	}
+
+	Com_ParallelFor( serial ? 1 : numThreads, SV_EncodeSnapshotJob, NULL, sv_numSnapshotJobs );
+
+	// transmit in the same order as the serial path
+	job = sv_snapshotJobs;
+	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
+		if (!c->state) {
+			continue;		// not connected
+		}
+
+		if ( job < sv_snapshotJobs + sv_numSnapshotJobs && job->client == c ) {
+			if ( !job->bot ) {
+				SV_WriteDownloadToClient( c, &job->msg );
+
+				if ( job->msg.overflowed ) {
+					Com_Printf ("WARNING: msg overflowed for %s\n", c->name);
+					MSG_Clear (&job->msg);
+				}
+
+				SV_SendMessageToClient( &job->msg, c );
+			}
+			job++;
+			continue;
+		}
+
+		if ( svs.time < c->nextSnapshotTime ) {
+			continue;		// not time yet
+		}
+
+		// send additional message fragments if the last message
+		// was too large to send at once
+		if ( c->netchan.unsentFragments ) {
+			c->nextSnapshotTime = svs.time + 
+				SV_RateMsec( c, c->netchan.unsentLength - c->netchan.unsentFragmentStart );
+			SV_Netchan_TransmitNextFragment( c );
+		}
+	}
+}
+
 
 /*
 =======================
@@ -671,6 +1175,15 @@ SV_SendClientMessages
 void SV_SendClientMessages( void ) {
 	int			i;
 	client_t	*c;
+	int			numThreads;
+
+	SV_ClearDeltaCache();
+
+	numThreads = Com_WorkerThreads( sv_snapshotThreads->integer );
+	if ( numThreads > 1 ) {
+		SV_SendClientMessagesParallel( numThreads );
+		return;
+	}
 
 	// send a message to each connected client
 	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
@@ -695,4 +1208,3 @@ void SV_SendClientMessages( void ) {
 		SV_SendClientSnapshot( c );
 	}
 }
-
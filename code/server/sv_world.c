@@ -75,6 +75,267 @@ worldSector_t	sv_worldSectors[AREA_NODES];
 int			sv_numworldSectors;
 
 
+/*
+===============================================================================
+
+LOOSE OCTREE
+
+With sv_broadphase 1 the entities are kept in a loose octree instead.
+Each node's bounds are its cell expanded by half the cell size on every
+side, so an entity whose center is in a cell and whose half extent is
+no more than half the cell size always fits that node.  The tree is a
+fixed set of levels laid out one after another, so linking only touches
+the nodes on the path to the root, and every node counts the entities
+at or below it so that empty branches are skipped by queries.
+
+Area queries collect hits in a bit vector, so the results come back
+sorted by entity number.
+
+===============================================================================
+*/
+
+#define	BROADPHASE_DEPTH	5			// levels below the root
+#define	BROADPHASE_NODES	( 1 + 8 + 64 + 512 + 4096 + 32768 )
+
+typedef struct broadphaseNode_s {
+	svEntity_t	*entities;
+	int			numEntities;			// including all nodes below this one
+} broadphaseNode_t;
+
+static broadphaseNode_t	*sv_broadphaseNodes;		// [BROADPHASE_NODES], on the hunk
+static int				sv_broadphaseLevels[BROADPHASE_DEPTH+1];	// first node of each level
+static vec3_t			sv_broadphaseMins;			// root cell corner
+static float			sv_broadphaseSize;			// root cell size
+static qboolean			sv_broadphaseActive;
+
+// sectorlist statistics
+static int	sv_broadphaseQueries, sv_broadphaseTested, sv_broadphaseReturned;
+static int	sv_broadphaseLinks;
+
+/*
+===============
+SV_BroadphaseNode
+===============
+*/
+static broadphaseNode_t *SV_BroadphaseNode( int level, int x, int y, int z ) {
+	return &sv_broadphaseNodes[ sv_broadphaseLevels[level] +
+		( x << ( level << 1 ) ) + ( y << level ) + z ];
+}
+
+/*
+===============
+SV_BroadphaseNodeCell
+
+Recovers the level and cell coordinates of a node
+===============
+*/
+static int SV_BroadphaseNodeCell( broadphaseNode_t *node, int *x, int *y, int *z ) {
+	int		level, index, mask;
+
+	index = node - sv_broadphaseNodes;
+	for ( level = BROADPHASE_DEPTH ; level > 0 ; level-- ) {
+		if ( index >= sv_broadphaseLevels[level] ) {
+			break;
+		}
+	}
+
+	index -= sv_broadphaseLevels[level];
+	mask = ( 1 << level ) - 1;
+	*x = index >> ( level << 1 );
+	*y = ( index >> level ) & mask;
+	*z = index & mask;
+
+	return level;
+}
+
+/*
+===============
+SV_BroadphaseCount
+
+Adds delta to the entity count of the node and everything above it
+===============
+*/
+static void SV_BroadphaseCount( broadphaseNode_t *node, int delta ) {
+	int		level, x, y, z;
+
+	level = SV_BroadphaseNodeCell( node, &x, &y, &z );
+	for ( ; level >= 0 ; level--, x >>= 1, y >>= 1, z >>= 1 ) {
+		SV_BroadphaseNode( level, x, y, z )->numEntities += delta;
+	}
+}
+
+/*
+===============
+SV_ClearBroadphase
+===============
+*/
+static void SV_ClearBroadphase( const vec3_t mins, const vec3_t maxs ) {
+	int		i, count;
+	float	size;
+
+	sv_broadphaseActive = sv_broadphase->integer ? qtrue : qfalse;
+	if ( !sv_broadphaseActive ) {
+		sv_broadphaseNodes = NULL;
+		return;
+	}
+
+	sv_broadphaseNodes = Hunk_Alloc( BROADPHASE_NODES * sizeof( broadphaseNode_t ), h_high );
+
+	count = 0;
+	for ( i = 0 ; i <= BROADPHASE_DEPTH ; i++ ) {
+		sv_broadphaseLevels[i] = count;
+		count += 1 << ( 3 * i );
+	}
+
+	// the root is a cube around the world bounds
+	sv_broadphaseSize = 0;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		size = maxs[i] - mins[i];
+		if ( size > sv_broadphaseSize ) {
+			sv_broadphaseSize = size;
+		}
+	}
+	sv_broadphaseSize += 2;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		sv_broadphaseMins[i] = 0.5f * ( mins[i] + maxs[i] - sv_broadphaseSize );
+	}
+
+	sv_broadphaseQueries = sv_broadphaseTested = sv_broadphaseReturned = 0;
+	sv_broadphaseLinks = 0;
+}
+
+/*
+===============
+SV_BroadphaseUnlink
+===============
+*/
+static void SV_BroadphaseUnlink( svEntity_t *ent ) {
+	broadphaseNode_t	*node;
+
+	node = ent->broadphaseNode;
+	if ( !node ) {
+		return;
+	}
+	ent->broadphaseNode = NULL;
+
+	if ( ent->prevEntityInNode ) {
+		ent->prevEntityInNode->nextEntityInNode = ent->nextEntityInNode;
+	} else {
+		node->entities = ent->nextEntityInNode;
+	}
+	if ( ent->nextEntityInNode ) {
+		ent->nextEntityInNode->prevEntityInNode = ent->prevEntityInNode;
+	}
+	ent->nextEntityInNode = ent->prevEntityInNode = NULL;
+
+	SV_BroadphaseCount( node, -1 );
+}
+
+/*
+===============
+SV_BroadphaseLink
+===============
+*/
+static void SV_BroadphaseLink( svEntity_t *ent, sharedEntity_t *gEnt ) {
+	broadphaseNode_t	*node;
+	vec3_t		center;
+	float		extent, cellSize;
+	int			cell[3];
+	int			i, level;
+
+	extent = 0;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		center[i] = 0.5f * ( gEnt->r.absmin[i] + gEnt->r.absmax[i] );
+		if ( gEnt->r.absmax[i] - center[i] > extent ) {
+			extent = gEnt->r.absmax[i] - center[i];
+		}
+	}
+
+	// find the deepest level with cells large enough, then walk up
+	// until the cell holding the center really contains the entity,
+	// which only fails near or outside the world edges
+	level = BROADPHASE_DEPTH;
+	cellSize = sv_broadphaseSize / ( 1 << level );
+	while ( level > 0 && extent > 0.5f * cellSize ) {
+		level--;
+		cellSize *= 2;
+	}
+
+	for ( ; level > 0 ; level--, cellSize *= 2 ) {
+		for ( i = 0 ; i < 3 ; i++ ) {
+			cell[i] = (int)floor( ( center[i] - sv_broadphaseMins[i] ) / cellSize );
+			if ( cell[i] < 0 || cell[i] >= ( 1 << level ) ) {
+				break;
+			}
+			if ( gEnt->r.absmin[i] < sv_broadphaseMins[i] + ( cell[i] - 0.5f ) * cellSize
+				|| gEnt->r.absmax[i] > sv_broadphaseMins[i] + ( cell[i] + 1.5f ) * cellSize ) {
+				break;
+			}
+		}
+		if ( i == 3 ) {
+			break;
+		}
+	}
+
+	if ( level == 0 ) {
+		cell[0] = cell[1] = cell[2] = 0;
+	}
+	node = SV_BroadphaseNode( level, cell[0], cell[1], cell[2] );
+
+	ent->broadphaseNode = node;
+	ent->prevEntityInNode = NULL;
+	ent->nextEntityInNode = node->entities;
+	if ( node->entities ) {
+		node->entities->prevEntityInNode = ent;
+	}
+	node->entities = ent;
+
+	SV_BroadphaseCount( node, 1 );
+	sv_broadphaseLinks++;
+}
+
+/*
+===============
+SV_BroadphaseList
+===============
+*/
+static void SV_BroadphaseList( void ) {
+	int		i, level, nodes, used, count;
+
+	for ( level = 0 ; level <= BROADPHASE_DEPTH ; level++ ) {
+		nodes = 1 << ( 3 * level );
+		used = 0;
+		count = 0;
+		for ( i = 0 ; i < nodes ; i++ ) {
+			broadphaseNode_t	*node = &sv_broadphaseNodes[sv_broadphaseLevels[level] + i];
+			svEntity_t			*ent;
+			int					c = 0;
+
+			for ( ent = node->entities ; ent ; ent = ent->nextEntityInNode ) {
+				c++;
+			}
+			if ( c ) {
+				used++;
+				count += c;
+			}
+		}
+		Com_Printf( "level %i: %i units, %i entities in %i of %i nodes\n", level,
+			(int)( sv_broadphaseSize / ( 1 << level ) ), count, used, nodes );
+	}
+	Com_Printf( "%i entities, %i links\n", sv_broadphaseNodes[0].numEntities, sv_broadphaseLinks );
+	Com_Printf( "%i queries, %i tested, %i returned", sv_broadphaseQueries,
+		sv_broadphaseTested, sv_broadphaseReturned );
+	if ( sv_broadphaseQueries ) {
+		Com_Printf( " (%.1f / %.1f per query)", (float)sv_broadphaseTested / sv_broadphaseQueries,
+			(float)sv_broadphaseReturned / sv_broadphaseQueries );
+	}
+	Com_Printf( "\n" );
+
+	sv_broadphaseQueries = sv_broadphaseTested = sv_broadphaseReturned = 0;
+	sv_broadphaseLinks = 0;
+}
+
+
 /*
 ===============
 SV_SectorList_f
@@ -85,6 +346,11 @@ void SV_SectorList_f( void ) {
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
+	if ( sv_broadphaseActive ) {
+		SV_BroadphaseList();
+		return;
+	}
+
 	for ( i = 0 ; i < AREA_NODES ; i++ ) {
 		sec = &sv_worldSectors[i];
 
@@ -96,6 +362,127 @@ void SV_SectorList_f( void ) {
 	}
 }
 
+/*
+===============================================================================
+
+TRACE CACHE
+
+The game and the bots often run the exact same trace several times in a
+frame.  With sv_traceCache 1 the results of SV_Trace are remembered for
+the rest of the game frame, and dropped as soon as an entity touching
+the swept box is linked or unlinked.  Entities are expected to be relinked
+whenever their origin, bounds, contents or owner change, which is what
+SV_LinkEntity already requires.
+
+===============================================================================
+*/
+
+#define	TRACE_CACHE_SIZE	1024		// must be a power of two
+
+typedef struct {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int			passEntityNum;
+	int			passOwnerNum;
+	int			contentmask;
+	int			capsule;
+} traceKey_t;
+
+typedef struct {
+	traceKey_t	key;
+	vec3_t		boxmins, boxmaxs;		// swept box, for invalidation
+	int			frame;					// in sv_traceCacheUsed if sv_traceCacheFrame
+	qboolean	valid;
+	trace_t		trace;
+} traceCacheEntry_t;
+
+static traceCacheEntry_t	sv_traceEntries[TRACE_CACHE_SIZE];
+static int					sv_traceCacheUsed[TRACE_CACHE_SIZE];	// slots filled this frame
+static int					sv_traceCacheNumUsed;
+static int					sv_traceCacheFrame = 1;
+
+static int	sv_traceCacheHits, sv_traceCacheMisses, sv_traceCacheInvalidated;
+
+/*
+===============
+SV_ClearTraceCache
+
+Called before every game frame
+===============
+*/
+void SV_ClearTraceCache( void ) {
+	sv_traceCacheFrame++;
+	sv_traceCacheNumUsed = 0;
+}
+
+/*
+===============
+SV_InvalidateTraceCache
+
+Drops every cached trace whose swept box touches the given bounds
+===============
+*/
+static void SV_InvalidateTraceCache( const vec3_t absmin, const vec3_t absmax ) {
+	traceCacheEntry_t	*entry;
+	int					i;
+
+	for ( i = 0 ; i < sv_traceCacheNumUsed ; i++ ) {
+		entry = &sv_traceEntries[sv_traceCacheUsed[i]];
+		if ( !entry->valid ) {
+			continue;
+		}
+		if ( entry->boxmins[0] > absmax[0]
+		|| entry->boxmins[1] > absmax[1]
+		|| entry->boxmins[2] > absmax[2]
+		|| entry->boxmaxs[0] < absmin[0]
+		|| entry->boxmaxs[1] < absmin[1]
+		|| entry->boxmaxs[2] < absmin[2] ) {
+			continue;
+		}
+		entry->valid = qfalse;
+		sv_traceCacheInvalidated++;
+	}
+}
+
+/*
+===============
+SV_TraceCacheSlot
+===============
+*/
+static traceCacheEntry_t *SV_TraceCacheSlot( const traceKey_t *key ) {
+	const int	*p;
+	unsigned	hash;
+	int			i;
+
+	hash = 0;
+	p = (const int *)key;
+	for ( i = 0 ; i < sizeof( *key ) / sizeof( int ) ; i++ ) {
+		hash = hash * 31 + p[i];
+	}
+	hash ^= hash >> 16;
+
+	return &sv_traceEntries[hash & ( TRACE_CACHE_SIZE - 1 )];
+}
+
+/*
+===============
+SV_TraceCache_f
+===============
+*/
+void SV_TraceCache_f( void ) {
+	int		total;
+
+	total = sv_traceCacheHits + sv_traceCacheMisses;
+	Com_Printf( "%i traces, %i hits, %i misses, %i invalidated", total,
+		sv_traceCacheHits, sv_traceCacheMisses, sv_traceCacheInvalidated );
+	if ( total ) {
+		Com_Printf( " (%.1f%% hit rate)", 100.0f * sv_traceCacheHits / total );
+	}
+	Com_Printf( "\n" );
+
+	sv_traceCacheHits = sv_traceCacheMisses = sv_traceCacheInvalidated = 0;
+}
+
 /*
 ===============
 SV_CreateworldSector
@@ -155,6 +542,9 @@ void SV_ClearWorld( void ) {
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	SV_ClearBroadphase( mins, maxs );
+	SV_ClearTraceCache();
 }
 
 
@@ -171,8 +561,13 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 
 	ent = SV_SvEntityForGentity( gEnt );
 
+	if ( gEnt->r.linked ) {
+		SV_InvalidateTraceCache( gEnt->r.absmin, gEnt->r.absmax );
+	}
 	gEnt->r.linked = qfalse;
 
+	SV_BroadphaseUnlink( ent );
+
 	ws = ent->worldSector;
 	if ( !ws ) {
 		return;		// not linked in anywhere
@@ -215,7 +610,7 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
+	if ( ent->worldSector || ent->broadphaseNode ) {
 		SV_UnlinkEntity( gEnt );	// unlink from old position
 	}
 
@@ -333,6 +728,14 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
+	SV_InvalidateTraceCache( gEnt->r.absmin, gEnt->r.absmax );
+
+	if ( sv_broadphaseActive ) {
+		SV_BroadphaseLink( ent, gEnt );
+		gEnt->r.linked = qtrue;
+		return;
+	}
+
 	// find the first world sector node that the ent's box crosses
 	node = sv_worldSectors;
 	while (1)
@@ -370,6 +773,7 @@ typedef struct {
 	const float	*maxs;
 	int			*list;
 	int			count, maxcount;
+	unsigned	hits[MAX_GENTITIES/32];		// sv_broadphase only
 } areaParms_t;
 
 
@@ -422,6 +826,64 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_BroadphaseEntities_r
+
+====================
+*/
+static void SV_BroadphaseEntities_r( int level, int x, int y, int z, areaParms_t *ap ) {
+	broadphaseNode_t	*node;
+	svEntity_t	*check;
+	sharedEntity_t *gcheck;
+	float		cellSize;
+	int			i, num;
+
+	node = SV_BroadphaseNode( level, x, y, z );
+	if ( !node->numEntities ) {
+		return;
+	}
+
+	// the root holds everything that doesn't fit anywhere else
+	if ( level ) {
+		cellSize = sv_broadphaseSize / ( 1 << level );
+		if ( sv_broadphaseMins[0] + ( x - 0.5f ) * cellSize > ap->maxs[0]
+		|| sv_broadphaseMins[1] + ( y - 0.5f ) * cellSize > ap->maxs[1]
+		|| sv_broadphaseMins[2] + ( z - 0.5f ) * cellSize > ap->maxs[2]
+		|| sv_broadphaseMins[0] + ( x + 1.5f ) * cellSize < ap->mins[0]
+		|| sv_broadphaseMins[1] + ( y + 1.5f ) * cellSize < ap->mins[1]
+		|| sv_broadphaseMins[2] + ( z + 1.5f ) * cellSize < ap->mins[2] ) {
+			return;
+		}
+	}
+
+	for ( check = node->entities ; check ; check = check->nextEntityInNode ) {
+		gcheck = SV_GEntityForSvEntity( check );
+		sv_broadphaseTested++;
+
+		if ( gcheck->r.absmin[0] > ap->maxs[0]
+		|| gcheck->r.absmin[1] > ap->maxs[1]
+		|| gcheck->r.absmin[2] > ap->maxs[2]
+		|| gcheck->r.absmax[0] < ap->mins[0]
+		|| gcheck->r.absmax[1] < ap->mins[1]
+		|| gcheck->r.absmax[2] < ap->mins[2]) {
+			continue;
+		}
+
+		num = check - sv.svEntities;
+		ap->hits[num >> 5] |= 1u << ( num & 31 );
+	}
+
+	if ( level == BROADPHASE_DEPTH ) {
+		return;
+	}
+
+	for ( i = 0 ; i < 8 ; i++ ) {
+		SV_BroadphaseEntities_r( level + 1, ( x << 1 ) + ( i >> 2 ),
+			( y << 1 ) + ( ( i >> 1 ) & 1 ), ( z << 1 ) + ( i & 1 ), ap );
+	}
+}
+
 /*
 ================
 SV_AreaEntities
@@ -429,6 +891,7 @@ SV_AreaEntities
 */
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
 	areaParms_t		ap;
+	int				i, j;
 
 	ap.mins = mins;
 	ap.maxs = maxs;
@@ -436,7 +899,32 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.count = 0;
 	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( !sv_broadphaseActive ) {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+		return ap.count;
+	}
+
+	Com_Memset( ap.hits, 0, sizeof( ap.hits ) );
+	SV_BroadphaseEntities_r( 0, 0, 0, 0, &ap );
+	sv_broadphaseQueries++;
+
+	for ( i = 0 ; i < MAX_GENTITIES/32 ; i++ ) {
+		if ( !ap.hits[i] ) {
+			continue;
+		}
+		for ( j = 0 ; j < 32 ; j++ ) {
+			if ( !( ap.hits[i] & ( 1u << j ) ) ) {
+				continue;
+			}
+			if ( ap.count == ap.maxcount ) {
+				Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
+				sv_broadphaseReturned += ap.count;
+				return ap.count;
+			}
+			ap.list[ap.count++] = ( i << 5 ) + j;
+		}
+	}
+	sv_broadphaseReturned += ap.count;
 
 	return ap.count;
 }
@@ -591,27 +1079,17 @@ void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 /*
 ==================
-SV_Trace
-
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+SV_TraceUncached
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+static void SV_TraceUncached( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
 	moveclip_t	clip;
 	int			i;
 
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
-	}
-
 	Com_Memset ( &clip, 0, sizeof ( moveclip_t ) );
 
 	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
+	CM_BoxTrace( &clip.trace, start, end, (float *)mins, (float *)maxs, 0, contentmask, capsule );
 	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
 	if ( clip.trace.fraction == 0 ) {
 		*results = clip.trace;
@@ -649,6 +1127,83 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 
 
 
+/*
+==================
+SV_CachedTrace
+==================
+*/
+static void SV_CachedTrace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+	traceKey_t			key;
+	traceCacheEntry_t	*entry;
+	int					i;
+
+	Com_Memset( &key, 0, sizeof( key ) );
+	VectorCopy( start, key.start );
+	VectorCopy( end, key.end );
+	VectorCopy( mins, key.mins );
+	VectorCopy( maxs, key.maxs );
+	key.passEntityNum = passEntityNum;
+	if ( passEntityNum != ENTITYNUM_NONE ) {
+		key.passOwnerNum = SV_GentityNum( passEntityNum )->r.ownerNum;
+	}
+	key.contentmask = contentmask;
+	key.capsule = capsule;
+
+	entry = SV_TraceCacheSlot( &key );
+	if ( entry->frame == sv_traceCacheFrame && entry->valid
+		&& !memcmp( &entry->key, &key, sizeof( key ) ) ) {
+		sv_traceCacheHits++;
+		*results = entry->trace;
+		return;
+	}
+	sv_traceCacheMisses++;
+
+	SV_TraceUncached( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+
+	if ( entry->frame != sv_traceCacheFrame ) {
+		sv_traceCacheUsed[sv_traceCacheNumUsed++] = entry - sv_traceEntries;
+		entry->frame = sv_traceCacheFrame;
+	}
+	entry->key = key;
+	entry->trace = *results;
+	entry->valid = qtrue;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( end[i] > start[i] ) {
+			entry->boxmins[i] = start[i] + mins[i] - 1;
+			entry->boxmaxs[i] = end[i] + maxs[i] + 1;
+		} else {
+			entry->boxmins[i] = end[i] + mins[i] - 1;
+			entry->boxmaxs[i] = start[i] + maxs[i] + 1;
+		}
+	}
+}
+
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	if ( sv_traceCache->integer ) {
+		SV_CachedTrace( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+		return;
+	}
+
+	SV_TraceUncached( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+}
+
+
+
 /*
 =============
 SV_PointContents
@@ -183,6 +183,11 @@ cpuFeatures_t Sys_GetProcessorFeatures( void )
 	if( SDL_HasAltiVec( ) )  features |= CF_ALTIVEC;
 #endif
 
+	// SDL can't tell, but a compiler only targets NEON when the cpu has it
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+	features |= CF_NEON;
+#endif
+
 	return features;
 }
 
@@ -29,11 +29,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <errno.h>
 #include <stdio.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pwd.h>
 #include <libgen.h>
+#include <pthread.h>
 
 // Used to determine where to store user-specific files
 static char homePath[ MAX_OSPATH ] = { 0 };
@@ -104,6 +107,27 @@ int Sys_Milliseconds (void)
 	return curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+uint64_t Sys_Microseconds( void )
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if ( clock_gettime( CLOCK_MONOTONIC, &ts ) == 0 )
+		return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+	{
+		struct timeval tp;
+
+		gettimeofday( &tp, NULL );
+		return (uint64_t)tp.tv_sec * 1000000 + tp.tv_usec;
+	}
+}
+
 #if !id386
 /*
 ==================
@@ -423,6 +447,46 @@ void Sys_FreeFileList( char **list )
 	Z_Free( list );
 }
 
+/*
+==================
+Sys_MapFile
+==================
+*/
+void *Sys_MapFile( const char *path, int *length )
+{
+	struct stat	st;
+	void		*base;
+	int			fd;
+
+	fd = open( path, O_RDONLY );
+	if ( fd == -1 ) {
+		return NULL;
+	}
+	if ( fstat( fd, &st ) == -1 || st.st_size <= 0 || st.st_size > 0x7fffffff ) {
+		close( fd );
+		return NULL;
+	}
+
+	base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( base == MAP_FAILED ) {
+		return NULL;
+	}
+
+	*length = st.st_size;
+	return base;
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *base, int length )
+{
+	munmap( base, length );
+}
+
 #ifdef MACOS_X
 /*
 =================
@@ -508,3 +572,260 @@ void Sys_ErrorDialog( const char *error )
 
 	FS_FCloseFile( f );
 }
+
+/*
+==============================================================
+
+THREADS
+
+==============================================================
+*/
+
+typedef struct
+{
+	void	(*function)( void *data );
+	void	*data;
+} sysThreadStart_t;
+
+typedef struct
+{
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	int				count;
+} sysSemaphore_t;
+
+/*
+==================
+Sys_ThreadStart
+==================
+*/
+static void *Sys_ThreadStart( void *arg )
+{
+	sysThreadStart_t start = *(sysThreadStart_t *)arg;
+
+	free( arg );
+	start.function( start.data );
+
+	return NULL;
+}
+
+/*
+==================
+Sys_CreateThread
+
+Starts a detached thread running function( data )
+==================
+*/
+qboolean Sys_CreateThread( void (*function)( void *data ), void *data )
+{
+	pthread_t thread;
+	pthread_attr_t attr;
+	sysThreadStart_t *start;
+	int err;
+
+	start = malloc( sizeof( *start ) );
+	if( !start )
+		return qfalse;
+
+	start->function = function;
+	start->data = data;
+
+	pthread_attr_init( &attr );
+	pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+	err = pthread_create( &thread, &attr, Sys_ThreadStart, start );
+	pthread_attr_destroy( &attr );
+
+	if( err )
+	{
+		Com_Printf( "Sys_CreateThread: %s\n", strerror( err ) );
+		free( start );
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+Sys_CreateMutex
+==================
+*/
+void *Sys_CreateMutex( void )
+{
+	pthread_mutex_t *mutex = malloc( sizeof( *mutex ) );
+
+	if( mutex )
+		pthread_mutex_init( mutex, NULL );
+
+	return mutex;
+}
+
+/*
+==================
+Sys_DestroyMutex
+==================
+*/
+void Sys_DestroyMutex( void *mutex )
+{
+	if( !mutex )
+		return;
+
+	pthread_mutex_destroy( (pthread_mutex_t *)mutex );
+	free( mutex );
+}
+
+/*
+==================
+Sys_LockMutex
+==================
+*/
+void Sys_LockMutex( void *mutex )
+{
+	pthread_mutex_lock( (pthread_mutex_t *)mutex );
+}
+
+/*
+==================
+Sys_UnlockMutex
+==================
+*/
+void Sys_UnlockMutex( void *mutex )
+{
+	pthread_mutex_unlock( (pthread_mutex_t *)mutex );
+}
+
+/*
+==================
+Sys_CreateSemaphore
+
+Counting semaphore with an initial count of zero.  Unnamed POSIX
+semaphores aren't available everywhere (OS X), so build it from a
+mutex and a condition variable.
+==================
+*/
+void *Sys_CreateSemaphore( void )
+{
+	sysSemaphore_t *sem = malloc( sizeof( *sem ) );
+
+	if( sem )
+	{
+		pthread_mutex_init( &sem->mutex, NULL );
+		pthread_cond_init( &sem->cond, NULL );
+		sem->count = 0;
+	}
+
+	return sem;
+}
+
+/*
+==================
+Sys_DestroySemaphore
+==================
+*/
+void Sys_DestroySemaphore( void *semaphore )
+{
+	sysSemaphore_t *sem = semaphore;
+
+	if( !sem )
+		return;
+
+	pthread_cond_destroy( &sem->cond );
+	pthread_mutex_destroy( &sem->mutex );
+	free( sem );
+}
+
+/*
+==================
+Sys_SemaphorePost
+==================
+*/
+void Sys_SemaphorePost( void *semaphore )
+{
+	sysSemaphore_t *sem = semaphore;
+
+	pthread_mutex_lock( &sem->mutex );
+	sem->count++;
+	pthread_cond_signal( &sem->cond );
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+/*
+==================
+Sys_SemaphoreWait
+==================
+*/
+void Sys_SemaphoreWait( void *semaphore )
+{
+	sysSemaphore_t *sem = semaphore;
+
+	pthread_mutex_lock( &sem->mutex );
+	while( sem->count == 0 )
+		pthread_cond_wait( &sem->cond, &sem->mutex );
+	sem->count--;
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+/*
+==================
+Sys_SemaphoreWaitTimeout
+
+Returns qfalse if the semaphore wasn't posted within msec
+==================
+*/
+qboolean Sys_SemaphoreWaitTimeout( void *semaphore, int msec )
+{
+	sysSemaphore_t *sem = semaphore;
+	struct timeval now;
+	struct timespec timeout;
+	qboolean posted;
+
+	gettimeofday( &now, NULL );
+	timeout.tv_sec = now.tv_sec + msec / 1000;
+	timeout.tv_nsec = ( now.tv_usec + ( msec % 1000 ) * 1000 ) * 1000;
+	if( timeout.tv_nsec >= 1000000000 )
+	{
+		timeout.tv_sec++;
+		timeout.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock( &sem->mutex );
+	while( sem->count == 0 )
+	{
+		if( pthread_cond_timedwait( &sem->cond, &sem->mutex, &timeout ) == ETIMEDOUT )
+			break;
+	}
+	posted = ( sem->count > 0 );
+	if( posted )
+		sem->count--;
+	pthread_mutex_unlock( &sem->mutex );
+
+	return posted;
+}
+
+/*
+==================
+Sys_AtomicAdd
+
+Returns the new value
+==================
+*/
+int Sys_AtomicAdd( volatile int *value, int add )
+{
+	return __sync_add_and_fetch( value, add );
+}
+
+/*
+==================
+Sys_NumProcessors
+==================
+*/
+int Sys_NumProcessors( void )
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+	if( n > 0 )
+		return (int)n;
+#endif
+	return 1;
+}
@@ -110,6 +110,25 @@ int Sys_Milliseconds (void)
 	return sys_curtime;
 }
 
+/*
+================
+Sys_Microseconds
+================
+*/
+uint64_t Sys_Microseconds( void )
+{
+	static LARGE_INTEGER	frequency;
+	LARGE_INTEGER			count;
+
+	if ( !frequency.QuadPart ) {
+		QueryPerformanceFrequency( &frequency );
+	}
+	QueryPerformanceCounter( &count );
+
+	return (uint64_t)( count.QuadPart / frequency.QuadPart ) * 1000000
+		+ (uint64_t)( count.QuadPart % frequency.QuadPart ) * 1000000 / frequency.QuadPart;
+}
+
 #ifndef __GNUC__ //see snapvectora.s
 /*
 ================
@@ -509,6 +528,52 @@ void Sys_FreeFileList( char **list )
 	Z_Free( list );
 }
 
+/*
+==============
+Sys_MapFile
+==============
+*/
+void *Sys_MapFile( const char *path, int *length )
+{
+	HANDLE	file, mapping;
+	DWORD	sizeHigh, size;
+	void	*base;
+
+	file = CreateFile( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+	size = GetFileSize( file, &sizeHigh );
+	if ( size == INVALID_FILE_SIZE || sizeHigh || size == 0 || size > 0x7fffffff ) {
+		CloseHandle( file );
+		return NULL;
+	}
+
+	mapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( !mapping ) {
+		return NULL;
+	}
+	base = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if ( !base ) {
+		return NULL;
+	}
+
+	*length = size;
+	return base;
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *base, int length )
+{
+	UnmapViewOfFile( base );
+}
+
 
 /*
 ==============
@@ -565,3 +630,195 @@ void Sys_ErrorDialog( const char *error )
 		}
 	}
 }
+
+/*
+==============================================================
+
+THREADS
+
+==============================================================
+*/
+
+typedef struct
+{
+	void	(*function)( void *data );
+	void	*data;
+} sysThreadStart_t;
+
+/*
+==================
+Sys_ThreadStart
+==================
+*/
+static DWORD WINAPI Sys_ThreadStart( LPVOID arg )
+{
+	sysThreadStart_t start = *(sysThreadStart_t *)arg;
+
+	free( arg );
+	start.function( start.data );
+
+	return 0;
+}
+
+/*
+==================
+Sys_CreateThread
+
+Starts a detached thread running function( data )
+==================
+*/
+qboolean Sys_CreateThread( void (*function)( void *data ), void *data )
+{
+	HANDLE thread;
+	sysThreadStart_t *start;
+
+	start = malloc( sizeof( *start ) );
+	if( !start )
+		return qfalse;
+
+	start->function = function;
+	start->data = data;
+
+	thread = CreateThread( NULL, 0, Sys_ThreadStart, start, 0, NULL );
+	if( !thread )
+	{
+		Com_Printf( "Sys_CreateThread: error %lu\n", GetLastError( ) );
+		free( start );
+		return qfalse;
+	}
+
+	CloseHandle( thread );
+	return qtrue;
+}
+
+/*
+==================
+Sys_CreateMutex
+==================
+*/
+void *Sys_CreateMutex( void )
+{
+	CRITICAL_SECTION *mutex = malloc( sizeof( *mutex ) );
+
+	if( mutex )
+		InitializeCriticalSection( mutex );
+
+	return mutex;
+}
+
+/*
+==================
+Sys_DestroyMutex
+==================
+*/
+void Sys_DestroyMutex( void *mutex )
+{
+	if( !mutex )
+		return;
+
+	DeleteCriticalSection( (CRITICAL_SECTION *)mutex );
+	free( mutex );
+}
+
+/*
+==================
+Sys_LockMutex
+==================
+*/
+void Sys_LockMutex( void *mutex )
+{
+	EnterCriticalSection( (CRITICAL_SECTION *)mutex );
+}
+
+/*
+==================
+Sys_UnlockMutex
+==================
+*/
+void Sys_UnlockMutex( void *mutex )
+{
+	LeaveCriticalSection( (CRITICAL_SECTION *)mutex );
+}
+
+/*
+==================
+Sys_CreateSemaphore
+
+Counting semaphore with an initial count of zero
+==================
+*/
+void *Sys_CreateSemaphore( void )
+{
+	return CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+}
+
+/*
+==================
+Sys_DestroySemaphore
+==================
+*/
+void Sys_DestroySemaphore( void *semaphore )
+{
+	if( semaphore )
+		CloseHandle( (HANDLE)semaphore );
+}
+
+/*
+==================
+Sys_SemaphorePost
+==================
+*/
+void Sys_SemaphorePost( void *semaphore )
+{
+	ReleaseSemaphore( (HANDLE)semaphore, 1, NULL );
+}
+
+/*
+==================
+Sys_SemaphoreWait
+==================
+*/
+void Sys_SemaphoreWait( void *semaphore )
+{
+	WaitForSingleObject( (HANDLE)semaphore, INFINITE );
+}
+
+/*
+==================
+Sys_SemaphoreWaitTimeout
+
+Returns qfalse if the semaphore wasn't posted within msec
+==================
+*/
+qboolean Sys_SemaphoreWaitTimeout( void *semaphore, int msec )
+{
+	return WaitForSingleObject( (HANDLE)semaphore, msec ) == WAIT_OBJECT_0;
+}
+
+/*
+==================
+Sys_AtomicAdd
+
+Returns the new value
+==================
+*/
+int Sys_AtomicAdd( volatile int *value, int add )
+{
+	return InterlockedExchangeAdd( (LONG volatile *)value, add ) + add;
+}
+
+/*
+==================
+Sys_NumProcessors
+==================
+*/
+int Sys_NumProcessors( void )
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+	if( info.dwNumberOfProcessors > 0 )
+		return (int)info.dwNumberOfProcessors;
+
+	return 1;
+}